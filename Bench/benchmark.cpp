@@ -0,0 +1,138 @@
+#include "benchmark.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QSysInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+
+#include "Helpers/inputscheduler.h"
+
+// each timed batch should be long enough for the timer resolution to not matter
+#define BENCHMARK_BATCH_NS  1000000
+
+volatile double Benchmark::s_sink = 0.0;
+
+void Benchmark::Run(const QString &name, const QJsonObject &params, const std::function<void ()> &function)
+{
+    if (m_filter.isValid() && !m_filter.pattern().isEmpty() && !m_filter.match(name).hasMatch())
+    {
+        return;
+    }
+
+    // warm up caches and lazily created state (FFT plans, color tables), then size the batch
+    qint64 batch = 1;
+    while (true)
+    {
+        qint64 const start = InputScheduler::Now();
+        for (qint64 i = 0; i < batch; i++)
+        {
+            function();
+        }
+
+        if (InputScheduler::Now() - start >= BENCHMARK_BATCH_NS)
+        {
+            break;
+        }
+        batch *= 2;
+    }
+
+    QVector<double> samples;
+    qint64 const runStart = InputScheduler::Now();
+    while (samples.size() < m_minSamples || InputScheduler::Now() - runStart < m_minTime)
+    {
+        qint64 const start = InputScheduler::Now();
+        for (qint64 i = 0; i < batch; i++)
+        {
+            function();
+        }
+        samples.push_back(double(InputScheduler::Now() - start) / double(batch));
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.m_name = name;
+    result.m_params = params;
+    result.m_iterations = batch * samples.size();
+    result.m_samples = samples.size();
+    result.m_min = samples.front();
+    result.m_median = samples[samples.size() / 2];
+    result.m_p95 = samples[qMin(int(samples.size()) - 1, int(samples.size() * 95 / 100))];
+    for (double const sample : std::as_const(samples))
+    {
+        result.m_mean += sample;
+    }
+    result.m_mean /= samples.size();
+    for (double const sample : std::as_const(samples))
+    {
+        result.m_stddev += (sample - result.m_mean) * (sample - result.m_mean);
+    }
+    result.m_stddev = std::sqrt(result.m_stddev / samples.size());
+
+    m_results.push_back(result);
+}
+
+QJsonDocument Benchmark::ToJson() const
+{
+    QJsonArray results;
+    for (Result const& result : m_results)
+    {
+        QJsonObject object;
+        object["name"] = result.m_name;
+        object["params"] = result.m_params;
+        object["iterations"] = result.m_iterations;
+        object["samples"] = result.m_samples;
+        object["mean_ns"] = result.m_mean;
+        object["median_ns"] = result.m_median;
+        object["min_ns"] = result.m_min;
+        object["p95_ns"] = result.m_p95;
+        object["stddev_ns"] = result.m_stddev;
+        results.append(object);
+    }
+
+    QJsonObject root;
+    root["version"] = 1;
+    root["label"] = m_label;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qt"] = qVersion();
+    root["os"] = QSysInfo::prettyProductName();
+    root["cpu"] = QSysInfo::currentCpuArchitecture();
+    root["threads"] = QThread::idealThreadCount();
+    root["results"] = results;
+    return QJsonDocument(root);
+}
+
+int Benchmark::Compare(const QJsonDocument &baseline, double threshold, QStringList &report) const
+{
+    QMap<QString, double> baselineMedians;
+    for (QJsonValue const& value : baseline.object()["results"].toArray())
+    {
+        QJsonObject const object = value.toObject();
+        baselineMedians.insert(object["name"].toString(), object["median_ns"].toDouble());
+    }
+
+    int regressions = 0;
+    for (Result const& result : m_results)
+    {
+        auto iter = baselineMedians.constFind(result.m_name);
+        if (iter == baselineMedians.constEnd() || iter.value() <= 0.0)
+        {
+            report << result.m_name + ": no baseline";
+            continue;
+        }
+
+        double const change = (result.m_median / iter.value() - 1.0) * 100.0;
+        QString line = result.m_name + ": " + QString::number(change, 'f', 1) + "%";
+        if (change > threshold)
+        {
+            line += " REGRESSED";
+            regressions++;
+        }
+        report << line;
+    }
+
+    return regressions;
+}
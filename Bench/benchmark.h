@@ -0,0 +1,55 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+// Times small functions in batches until both the minimum time and sample count are reached
+// Results are kept in nanoseconds per call and written as JSON so runs can be compared across commits
+class Benchmark
+{
+public:
+    struct Result
+    {
+        QString     m_name;
+        QJsonObject m_params;
+        qint64      m_iterations = 0;
+        int         m_samples = 0;
+        double      m_mean = 0.0;
+        double      m_median = 0.0;
+        double      m_min = 0.0;
+        double      m_p95 = 0.0;
+        double      m_stddev = 0.0;
+    };
+
+    void SetFilter(QRegularExpression const& filter) { m_filter = filter; }
+    void SetMinTime(int ms) { m_minTime = qint64(qMax(1, ms)) * 1000000; }
+    void SetLabel(QString const& label) { m_label = label; }
+
+    // skipped if name doesn't match the filter, function result must go through Keep() so it isn't optimized away
+    void Run(QString const& name, QJsonObject const& params, std::function<void()> const& function);
+
+    static void Keep(double value) { s_sink = s_sink + value; }
+
+    QVector<Result> const& GetResults() const { return m_results; }
+    QJsonDocument ToJson() const;
+
+    // compares median time with a previous ToJson(), returns the number of benchmarks slower than threshold percent
+    int Compare(QJsonDocument const& baseline, double threshold, QStringList& report) const;
+
+private:
+    static volatile double  s_sink;
+
+    QRegularExpression  m_filter;
+    qint64              m_minTime = 500000000;
+    int                 m_minSamples = 10;
+    QString             m_label;
+    QVector<Result>     m_results;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,317 @@
+#include <QAudioFormat>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QtMath>
+
+#include "Bench/benchmark.h"
+#include "Helpers/audioconversionutils.h"
+#include "Helpers/commandcompiler.h"
+#include "Helpers/frameanalysis.h"
+
+namespace
+{
+// frames are seeded so every run analyzes the same pixels
+QImage CreateFrame(QSize size)
+{
+    QRandomGenerator random(size.width());
+    QImage frame(size, QImage::Format_ARGB32);
+    for (int y = 0; y < frame.height(); y++)
+    {
+        QRgb* rowData = (QRgb*)frame.scanLine(y);
+        for (int x = 0; x < frame.width(); x++)
+        {
+            // gradient with noise, so both matched and unmatched branches are taken
+            int const noise = int(random.bounded(32));
+            rowData[x] = qRgb((x * 255 / frame.width() + noise) & 0xFF, (y * 255 / frame.height() + noise) & 0xFF, (x + y + noise) & 0xFF);
+        }
+    }
+    return frame;
+}
+
+QString SizeName(QSize size)
+{
+    return QString::number(size.width()) + "x" + QString::number(size.height());
+}
+
+QJsonObject SizeParams(QSize size)
+{
+    return QJsonObject{{"width", size.width()}, {"height", size.height()}};
+}
+
+void BenchFrames(Benchmark& benchmark)
+{
+    // what LibVLC delivers and VideoManager scales down for captures
+    QVector<QPair<QString, QSize>> const frameSizes =
+    {
+        {"720p", QSize(1280,720)},
+        {"1080p", QSize(1920,1080)},
+        {"4K", QSize(3840,2160)},
+    };
+
+    for (auto const& frameSize : frameSizes)
+    {
+        QImage const frame = CreateFrame(frameSize.second);
+        benchmark.Run("VideoManager::ScaleToCapture/" + frameSize.first, SizeParams(frameSize.second), [&frame]
+        {
+            QImage const scaled = FrameAnalysis::ScaleToCapture(frame);
+            Benchmark::Keep(scaled.constBits()[0]);
+        });
+    }
+
+    // regions at capture resolution, from a single dialog icon up to the whole frame
+    QImage const frame = CreateFrame(FrameAnalysis::GetCaptureResolution());
+    QVector<QSize> const areaSizes =
+    {
+        QSize(16,16),
+        QSize(64,64),
+        QSize(200,100),
+        QSize(640,360),
+        FrameAnalysis::GetCaptureResolution(),
+    };
+
+    HsvRange const range(0,100,100,60,255,255);
+    HsvRange const wrapRange(300,50,50,30,255,255);
+    for (QSize const& areaSize : areaSizes)
+    {
+        QImage const area = frame.copy(QRect(QPoint(0,0), areaSize));
+        benchmark.Run("CaptureHolder::GetAverageColor/" + SizeName(areaSize), SizeParams(areaSize), [&area]
+        {
+            Benchmark::Keep(FrameAnalysis::GetAverageColor(area).rgba());
+        });
+
+        benchmark.Run("CaptureHolder::GetBrightnessMean/" + SizeName(areaSize), SizeParams(areaSize), [&area, &range]
+        {
+            Benchmark::Keep(FrameAnalysis::GetBrightnessMean(area, range));
+        });
+
+        // what Dev Frame Capture does to preview the mask
+        benchmark.Run("CaptureHolder::GetBrightnessMean/Masked/" + SizeName(areaSize), SizeParams(areaSize), [&area, &range]
+        {
+            QImage masked;
+            Benchmark::Keep(FrameAnalysis::GetBrightnessMean(area, range, &masked));
+        });
+    }
+
+    // point captures test one pixel per frame, time a row of them so the call dominates
+    QVector<QColor> pixels;
+    QRgb const* rowData = (QRgb const*)frame.constScanLine(frame.height() / 2);
+    for (int x = 0; x < frame.width(); x++)
+    {
+        pixels.push_back(QColor::fromRgb(rowData[x]));
+    }
+
+    QJsonObject const pixelParams{{"pixels", pixels.size()}};
+    benchmark.Run("CaptureHolder::GetColorMatchHSV/Range", pixelParams, [&pixels, &range]
+    {
+        int matched = 0;
+        for (QColor const& pixel : pixels)
+        {
+            matched += FrameAnalysis::GetColorMatchHSV(pixel, range);
+        }
+        Benchmark::Keep(matched);
+    });
+
+    benchmark.Run("CaptureHolder::GetColorMatchHSV/WrappedHue", pixelParams, [&pixels, &wrapRange]
+    {
+        int matched = 0;
+        for (QColor const& pixel : pixels)
+        {
+            matched += FrameAnalysis::GetColorMatchHSV(pixel, wrapRange);
+        }
+        Benchmark::Keep(matched);
+    });
+}
+
+void BenchAudio(Benchmark& benchmark)
+{
+    int const sampleCount = FFT_SAMPLE_COUNT;
+    QRandomGenerator random(sampleCount);
+
+    // one analysis window of interleaved stereo in each format a capture card may deliver
+    QVector<QPair<QString, QAudioFormat::SampleFormat>> const formats =
+    {
+        {"Int16", QAudioFormat::Int16},
+        {"Int32", QAudioFormat::Int32},
+        {"Float", QAudioFormat::Float},
+    };
+
+    for (auto const& format : formats)
+    {
+        QAudioFormat audioFormat;
+        audioFormat.setSampleRate(48000);
+        audioFormat.setChannelCount(2);
+        audioFormat.setSampleFormat(format.second);
+
+        QByteArray data(sampleCount * audioFormat.bytesPerFrame(), Qt::Uninitialized);
+        if (format.second == QAudioFormat::Float)
+        {
+            float* samples = (float*)data.data();
+            for (int i = 0; i < sampleCount * 2; i++)
+            {
+                samples[i] = float(random.generateDouble() * 2.0 - 1.0);
+            }
+        }
+        else
+        {
+            random.fillRange((quint32*)data.data(), data.size() / sizeof(quint32));
+        }
+
+        QVector<float> out;
+        QJsonObject const params{{"samples", sampleCount}, {"channels", 2}, {"format", format.first}};
+        benchmark.Run("AudioConversionUtils::convertSamplesToFloat/" + format.first, params, [&audioFormat, &data, &out]
+        {
+            AudioConversionUtils::convertSamplesToFloat(audioFormat, data.constData(), data.size(), out);
+            Benchmark::Keep(out[0]);
+        });
+    }
+
+    // same buffers and windowing as AudioManager
+    fftwf_complex* in = fftwf_alloc_complex(sampleCount);
+    fftwf_complex* out = fftwf_alloc_complex(sampleCount);
+    QVector<float> const& hanningFunction = AudioConversionUtils::getHanningFunction(sampleCount);
+    for (int i = 0; i < sampleCount; i++)
+    {
+        float const sample = float(qSin(i * 0.05) * 0.5 + (random.generateDouble() - 0.5) * 0.1);
+        in[i][REAL] = sample * hanningFunction[i];
+        in[i][IMAG] = 0.0f;
+    }
+
+    QJsonObject const params{{"samples", sampleCount}};
+    benchmark.Run("AudioConversionUtils::fft/" + QString::number(sampleCount), params, [sampleCount, in, out]
+    {
+        AudioConversionUtils::fft(sampleCount, in, out);
+        Benchmark::Keep(out[1][REAL]);
+    });
+
+    QVector<float> spectrogram;
+    AudioConversionUtils::fft(sampleCount, in, out);
+    benchmark.Run("AudioConversionUtils::fftOutToSpectrogram/" + QString::number(sampleCount), params, [sampleCount, out, &spectrogram]
+    {
+        AudioConversionUtils::fftOutToSpectrogram(sampleCount, out, spectrogram);
+        Benchmark::Keep(spectrogram[1]);
+    });
+
+    fftwf_free(in);
+    fftwf_free(out);
+}
+
+void BenchCommands(Benchmark& benchmark)
+{
+    QString longCommand;
+    for (int i = 0; i < 100; i++)
+    {
+        longCommand += "(A|D-Pad Up|100,Nothing|200,LX0.5|LY-1.0|300)3,B|100,Nothing|" + QString::number(i + 1) + ",";
+    }
+    longCommand.chop(1);
+
+    QVector<QPair<QString, QString>> const commands =
+    {
+        {"Short", "A|100,Nothing|400"},
+        {"Reset", "(A|100,Nothing|400)10,Home|100,Nothing|1000,X|100,Nothing|800,A|100,Nothing|2000,(A|100,Nothing|500)0"},
+        {"Long", longCommand},
+    };
+
+    for (auto const& command : commands)
+    {
+        QJsonObject const params{{"length", command.second.size()}};
+
+        // what SerialManager::VerifyCommand and Custom Command do on every edit
+        benchmark.Run("CommandCompiler::Compile/" + command.first, params, [&command]
+        {
+            CommandCompiler::Program program;
+            QString errorMsg;
+            Benchmark::Keep(CommandCompiler::Compile(command.second, program, errorMsg));
+        });
+
+        // what RunCommand steps through, infinite loops stop after a fixed number of states
+        CommandCompiler::Program program;
+        QString errorMsg;
+        if (!CommandCompiler::Compile(command.second, program, errorMsg))
+        {
+            qWarning() << "Bench: command" << command.first << "failed to compile," << errorMsg;
+            continue;
+        }
+
+        benchmark.Run("CommandCompiler::Interpreter/" + command.first, params, [&program]
+        {
+            CommandCompiler::Interpreter interpreter;
+            interpreter.Reset(&program);
+
+            int states = 0;
+            while (states < 10000 && interpreter.Next())
+            {
+                states++;
+            }
+            Benchmark::Keep(states);
+        });
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("AutoController2Bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks for the frame, audio and command kernels");
+    parser.addHelpOption();
+
+    QCommandLineOption outputOption({"o", "output"}, "Write results as JSON to <file>, default is stdout.", "file");
+    QCommandLineOption filterOption({"f", "filter"}, "Only run benchmarks whose name matches <regex>.", "regex");
+    QCommandLineOption minTimeOption({"t", "min-time"}, "Minimum time per benchmark in milliseconds, default 500.", "ms", "500");
+    QCommandLineOption labelOption({"l", "label"}, "Label stored with the results, e.g. the commit hash.", "label");
+    QCommandLineOption baselineOption({"b", "baseline"}, "Compare with a previous JSON output and fail on regressions.", "file");
+    QCommandLineOption thresholdOption("threshold", "Median slowdown in percent counted as a regression, default 10.", "percent", "10");
+    parser.addOptions({outputOption, filterOption, minTimeOption, labelOption, baselineOption, thresholdOption});
+    parser.process(a);
+
+    Benchmark benchmark;
+    benchmark.SetFilter(QRegularExpression(parser.value(filterOption)));
+    benchmark.SetMinTime(parser.value(minTimeOption).toInt());
+    benchmark.SetLabel(parser.value(labelOption));
+
+    BenchFrames(benchmark);
+    BenchAudio(benchmark);
+    BenchCommands(benchmark);
+
+    QByteArray const json = benchmark.ToJson().toJson();
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size())
+        {
+            qCritical() << "Bench: failed to write" << file.fileName();
+            return 1;
+        }
+    }
+    else
+    {
+        QTextStream(stdout) << json;
+    }
+
+    if (parser.isSet(baselineOption))
+    {
+        QFile file(parser.value(baselineOption));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qCritical() << "Bench: failed to read" << file.fileName();
+            return 1;
+        }
+
+        QStringList report;
+        int const regressions = benchmark.Compare(QJsonDocument::fromJson(file.readAll()), parser.value(thresholdOption).toDouble(), report);
+        QTextStream err(stderr);
+        for (QString const& line : std::as_const(report))
+        {
+            err << line << Qt::endl;
+        }
+        return regressions > 0 ? 2 : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "commandrunner.h"
+
+#include "Helpers/commandplayer.h"
+
+CommandRunner::CommandRunner(InputScheduler *scheduler, QObject *parent)
+    : QThread{parent}
+    , m_scheduler(scheduler)
+{
+
+}
+
+bool CommandRunner::SetCommand(const QString &command, QString &errorMsg)
+{
+    if (!CommandCompiler::Compile(command, m_program, errorMsg))
+    {
+        return false;
+    }
+
+    m_interpreter.Reset(&m_program);
+    return true;
+}
+
+void CommandRunner::stop()
+{
+    m_terminate = true;
+}
+
+void CommandRunner::run()
+{
+    emit notifyLog("Command", "Compiled " + QString::number(m_program.m_code.size()) + " instructions ("
+                   + QString::number(m_program.GetMemoryUsage()) + " bytes) in "
+                   + QString::number(qreal(m_program.m_compileTime) / 1000.0, 'f', 1) + "us");
+
+    InputScheduler::Stats stats;
+    if (CommandPlayer::Play(m_scheduler, quintptr(this), m_interpreter, m_terminate, stats))
+    {
+        emit notifyLog("Command", "Command finished", LOG_Success);
+    }
+    else
+    {
+        // pending steps were cancelled, make sure nothing is left held
+        m_scheduler->Submit(quintptr(this), InputScheduler::Now(), 0);
+        m_scheduler->WaitForPending(quintptr(this), 0, 100);
+        emit notifyLog("Command", "Command terminated", LOG_Warning);
+    }
+
+    QString const timing = CommandPlayer::FormatStats(stats);
+    if (!timing.isEmpty())
+    {
+        emit notifyLog("Command", timing);
+    }
+}
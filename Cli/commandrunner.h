@@ -0,0 +1,41 @@
+#ifndef COMMANDRUNNER_H
+#define COMMANDRUNNER_H
+
+#include <QThread>
+
+#include <atomic>
+
+#include "Helpers/commandcompiler.h"
+#include "Types/system.h"
+
+class InputScheduler;
+
+// Headless version of Module::Common::RunCommand without timeline support, plays through CommandPlayer like its RunTimer()
+class CommandRunner : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CommandRunner(InputScheduler* scheduler, QObject *parent = nullptr);
+
+    // call before start(), errorMsg can hold a warning even if it succeeded
+    bool SetCommand(QString const& command, QString& errorMsg);
+
+    // any thread, releases all buttons and returns from run() as soon as possible
+    void stop();
+
+signals:
+    void notifyLog(QString const& category, QString const& log, LogType type = LOG_Normal) const;
+
+protected:
+    // from QThread
+    void run() override;
+
+private:
+    InputScheduler*                 m_scheduler = Q_NULLPTR;
+    CommandCompiler::Program        m_program;
+    CommandCompiler::Interpreter    m_interpreter;
+    std::atomic_bool                m_terminate = false;
+};
+
+#endif // COMMANDRUNNER_H
@@ -0,0 +1,255 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QTextStream>
+#include <QTimer>
+
+#include <atomic>
+#include <csignal>
+
+#include "Cli/commandrunner.h"
+#include "Helpers/inputscheduler.h"
+#include "Helpers/jsonhelper.h"
+#include "Helpers/metricsexporter.h"
+#include "Helpers/serialholder.h"
+#include "defines.h"
+
+// same files the Custom Command program saves
+#define CUSTOM_COMMAND_DIRECTORY "../Resources/CustomCommand/"
+#define CUSTOM_COMMAND_FORMAT QString(".customcommand")
+
+namespace
+{
+std::atomic_bool s_interrupted = false;
+
+void OnInterrupt(int)
+{
+    s_interrupted = true;
+}
+
+QMutex s_printMutex;
+
+void Print(QString const& category, QString const& log, LogType type)
+{
+    // called from the serial, scheduler and runner threads
+    QMutexLocker locker(&s_printMutex);
+    static QTextStream out(stdout);
+    static QTextStream err(stderr);
+
+    QString line = "[" + category + "] ";
+    switch (type)
+    {
+    case LOG_Warning:   line += "Warning: "; break;
+    case LOG_Error:     line += "Error: "; break;
+    default: break;
+    }
+    line += log;
+
+    QTextStream& stream = type == LOG_Error ? err : out;
+    stream << line << Qt::endl;
+}
+
+QStringList ListCommands()
+{
+    QDir const directory(CUSTOM_COMMAND_DIRECTORY);
+    QStringList names;
+    for (QString const& file : directory.entryList({"*" + CUSTOM_COMMAND_FORMAT}, QDir::Files))
+    {
+        names << QFileInfo(file).completeBaseName();
+    }
+    return names;
+}
+
+bool LoadCommand(QString const& name, QString& command)
+{
+    QString const path = CUSTOM_COMMAND_DIRECTORY + name + CUSTOM_COMMAND_FORMAT;
+    if (!QFile::exists(path))
+    {
+        return false;
+    }
+
+    QVariant value;
+    if (!JsonHelper::ReadValue(JsonHelper::ReadJson(path), "Command", value))
+    {
+        return false;
+    }
+
+    command = value.toString();
+    return true;
+}
+
+// same keys and limits as SerialManager::LoadSettings()
+void LoadSerialSettings(SerialHolder& serialHolder, QString& portName)
+{
+    quint8 protocolVersion = SerialProtocol::Version;
+    qint32 baudRate = 500000;
+    qint32 reportInterval = 8000;
+
+    QJsonObject const settings = JsonHelper::ReadSetting("SerialSettings");
+    QVariant value;
+    if (portName.isEmpty() && JsonHelper::ReadValue(settings, "PortName", value))
+    {
+        portName = value.toString();
+    }
+    if (JsonHelper::ReadValue(settings, "ProtocolVersion", value))
+    {
+        protocolVersion = qBound(1, value.toInt(), int(SerialProtocol::Version));
+    }
+    if (JsonHelper::ReadValue(settings, "BaudRate", value))
+    {
+        baudRate = value.toInt();
+    }
+    if (JsonHelper::ReadValue(settings, "ReportInterval", value))
+    {
+        reportInterval = qBound(1000, value.toInt(), 20000);
+    }
+
+    serialHolder.SetProtocolOptions(protocolVersion, baudRate, reportInterval);
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("AutoController2Cli");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs a custom command on AutoController2 without the GUI.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("name", "Saved custom command to run.", "[name]");
+    QCommandLineOption const listOption({"l", "list"}, "List saved custom commands.");
+    QCommandLineOption const commandOption({"c", "command"}, "Run this command string instead of a saved one.", "command");
+    QCommandLineOption const portOption({"p", "port"}, "Serial port, defaults to the one last used by the GUI.", "port");
+    parser.addOptions({listOption, commandOption, portOption});
+    parser.process(a);
+
+    if (parser.isSet(listOption))
+    {
+        QTextStream out(stdout);
+        for (QString const& name : ListCommands())
+        {
+            out << name << Qt::endl;
+        }
+        return 0;
+    }
+
+    QString command = parser.value(commandOption);
+    if (command.isEmpty())
+    {
+        QStringList const args = parser.positionalArguments();
+        if (args.size() != 1)
+        {
+            parser.showHelp(1);
+        }
+
+        if (!LoadCommand(args[0], command))
+        {
+            Print("Command", "Custom command \"" + args[0] + "\" not found", LOG_Error);
+            return 1;
+        }
+    }
+
+    SerialHolder serialHolder;
+    InputScheduler scheduler;
+    CommandRunner runner(&scheduler);
+    QObject::connect(&serialHolder, &SerialHolder::notifyLog, &serialHolder, &Print, Qt::DirectConnection);
+    QObject::connect(&runner, &CommandRunner::notifyLog, &runner, &Print, Qt::DirectConnection);
+    QObject::connect(&scheduler, &InputScheduler::notifyButton, &serialHolder, [&serialHolder](quint32 buttonFlag, QPointF lStick, QPointF rStick, qint64 deadline)
+    {
+        serialHolder.SubmitState(SerialHolder::StateSource::Scheduler, buttonFlag, lStick, rStick, deadline);
+    }, Qt::DirectConnection);
+
+    QString errorMsg;
+    bool const compiled = runner.SetCommand(command, errorMsg);
+    if (!errorMsg.isEmpty())
+    {
+        Print("Command", errorMsg, compiled ? LOG_Warning : LOG_Error);
+    }
+    if (!compiled)
+    {
+        return 1;
+    }
+
+    MetricsExporter metricsExporter;
+    QObject::connect(&metricsExporter, &MetricsExporter::notifyLog, &metricsExporter, &Print, Qt::DirectConnection);
+    metricsExporter.LoadSettings();
+
+    QString portName = parser.value(portOption);
+    LoadSerialSettings(serialHolder, portName);
+    if (portName.isEmpty())
+    {
+        Print("Global", "No serial port given", LOG_Error);
+        return 1;
+    }
+
+    int result = 0;
+    QObject::connect(&serialHolder, &SerialHolder::notifyConnecting, &a, [&a](bool failed)
+    {
+        if (failed)
+        {
+            a.exit(1);
+        }
+    });
+    QObject::connect(&serialHolder, &SerialHolder::notifyConnectTimeout, &a, [&](bool failed, quint8 version)
+    {
+        if (failed)
+        {
+            if (version > 0 && SERIAL_VERSION != version)
+            {
+                Print("Global", "AutoController2.hex version " + QString::number(version) + " does not match " + QString::number(SERIAL_VERSION), LOG_Error);
+            }
+            a.exit(1);
+            return;
+        }
+
+        runner.start();
+    });
+    QObject::connect(&serialHolder, &SerialHolder::notifyErrorOccured, &a, [&a, &runner, &result]
+    {
+        result = 1;
+        if (runner.isRunning())
+        {
+            runner.stop();
+        }
+        else
+        {
+            a.exit(result);
+        }
+    });
+    QObject::connect(&runner, &QThread::finished, &serialHolder, &SerialHolder::OnDisconnectClicked);
+    QObject::connect(&serialHolder, &SerialHolder::notifyDisconnectTimeout, &a, [&a, &result]
+    {
+        a.exit(result);
+    });
+
+    // Ctrl+C releases the buttons and disconnects cleanly, infinite loops need this to end
+    std::signal(SIGINT, &OnInterrupt);
+    QTimer interruptTimer;
+    QObject::connect(&interruptTimer, &QTimer::timeout, &a, [&]
+    {
+        if (s_interrupted.exchange(false))
+        {
+            result = 2;
+            if (runner.isRunning())
+            {
+                runner.stop();
+            }
+            else
+            {
+                a.exit(result);
+            }
+        }
+    });
+    interruptTimer.start(100);
+
+    QMetaObject::invokeMethod(&serialHolder, "OnConnectClicked", Qt::QueuedConnection, Q_ARG(QString, portName));
+    int const exitCode = a.exec();
+
+    runner.stop();
+    runner.wait();
+    return exitCode;
+}
@@ -8,19 +8,19 @@ AudioConversionUtils& AudioConversionUtils::instance()
 
 AudioConversionUtils::AudioConversionUtils()
 {
-    m_hanningFunction.resize(FFT_SAMPLE_COUNT);
-    for (int i = 0; i < FFT_SAMPLE_COUNT / 2; i++)
-    {
-        m_hanningFunction[i] = 0.5f - 0.5f * std::cos((2.0f * float(M_PI) * i) / (FFT_SAMPLE_COUNT - 1));
-        m_hanningFunction[FFT_SAMPLE_COUNT - 1 - i] = m_hanningFunction[i];
-    }
-
     m_spikeConvFunction.resize(18);
     for (int i = 0; i < 9; i++)
     {
         m_spikeConvFunction[i] = -4.0f + 8.f * i / 8.0f;
         m_spikeConvFunction[17 - i];
     }
+
+    // 256-entry LUT for getMagnitudeColor(), index with getMagnitudeIndex()
+    m_magnitudeColorTable.resize(256);
+    for (int i = 0; i < 256; i++)
+    {
+        m_magnitudeColorTable[i] = getMagnitudeColor(float(i) / 255.0f).rgb();
+    }
 }
 
 void AudioConversionUtils::debugAudioFormat(const QAudioFormat &audioFormat)
@@ -42,9 +42,25 @@ void AudioConversionUtils::debugAudioFormat(const QAudioFormat &audioFormat)
     qDebug() << "Sample Rate:" << audioFormat.sampleRate();
 }
 
-const QVector<float> &AudioConversionUtils::getHanningFunction()
+const QVector<float> &AudioConversionUtils::getHanningFunction(int sampleSize)
 {
-    return instance().m_hanningFunction;
+    // FFT size depends on analysis sample rate, cache one window per size
+    AudioConversionUtils& utils = instance();
+    QMutexLocker locker(&utils.m_hanningMutex);
+
+    auto iter = utils.m_hanningFunctions.find(sampleSize);
+    if (iter == utils.m_hanningFunctions.end())
+    {
+        QVector<float> hanningFunction(sampleSize);
+        for (int i = 0; i < (sampleSize + 1) / 2; i++)
+        {
+            hanningFunction[i] = 0.5f - 0.5f * std::cos((2.0f * float(M_PI) * i) / (sampleSize - 1));
+            hanningFunction[sampleSize - 1 - i] = hanningFunction[i];
+        }
+        iter = utils.m_hanningFunctions.insert(sampleSize, hanningFunction);
+    }
+
+    return iter.value();
 }
 
 const QVector<float> &AudioConversionUtils::getSpikeConvFunction()
@@ -52,6 +68,11 @@ const QVector<float> &AudioConversionUtils::getSpikeConvFunction()
     return instance().m_spikeConvFunction;
 }
 
+const QRgb *AudioConversionUtils::getMagnitudeColorTable()
+{
+    return instance().m_magnitudeColorTable.constData();
+}
+
 QColor AudioConversionUtils::getMagnitudeColor(float v)
 {
     if (v <= 0.0f)
@@ -141,28 +162,12 @@ void AudioConversionUtils::normalizeAudio(const Type *in, float *out, size_t out
 //-----------------------------------------
 void AudioConversionUtils::fft(int sampleSize, fftwf_complex *in, fftwf_complex *out)
 {
-    // create a DFT plan
-    fftwf_plan plan = fftwf_plan_dft_1d(sampleSize, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-
-    // execute the plan
-    fftwf_execute(plan);
-
-    // do some cleaning
-    fftwf_destroy_plan(plan);
-    fftwf_cleanup();
+    executePlan(sampleSize, FFTW_FORWARD, in, out);
 }
 
 void AudioConversionUtils::ifft(int sampleSize, fftwf_complex *in, fftwf_complex *out)
 {
-    // create an IDFT plan
-    fftwf_plan plan = fftwf_plan_dft_1d(sampleSize, in, out, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-    // execute the plan
-    fftwf_execute(plan);
-
-    // do some cleaning
-    fftwf_destroy_plan(plan);
-    fftwf_cleanup();
+    executePlan(sampleSize, FFTW_BACKWARD, in, out);
 
     // scale the output to obtain the exact inverse
     for (int i = 0; i < sampleSize; ++i)
@@ -172,6 +177,41 @@ void AudioConversionUtils::ifft(int sampleSize, fftwf_complex *in, fftwf_complex
     }
 }
 
+void AudioConversionUtils::executePlan(int sampleSize, int sign, fftwf_complex *in, fftwf_complex *out)
+{
+    // FFTW planning is not thread safe, plans are made once per size and direction and shared by all sessions
+    AudioConversionUtils& utils = instance();
+    QMutexLocker locker(&utils.m_planMutex);
+
+    QMap<int, FFTPlan>& plans = sign == FFTW_FORWARD ? utils.m_forwardPlans : utils.m_backwardPlans;
+    auto iter = plans.find(sampleSize);
+    if (iter == plans.end())
+    {
+        // planned out of place on fftwf_alloc_complex() buffers
+        FFTPlan plan;
+        plan.m_in = fftwf_alloc_complex(sampleSize);
+        plan.m_out = fftwf_alloc_complex(sampleSize);
+        plan.m_plan = fftwf_plan_dft_1d(sampleSize, plan.m_in, plan.m_out, sign, FFTW_ESTIMATE);
+        iter = plans.insert(sampleSize, plan);
+    }
+
+    FFTPlan const plan = iter.value();
+    if (in == out
+     || fftwf_alignment_of(reinterpret_cast<float*>(in)) != fftwf_alignment_of(reinterpret_cast<float*>(plan.m_in))
+     || fftwf_alignment_of(reinterpret_cast<float*>(out)) != fftwf_alignment_of(reinterpret_cast<float*>(plan.m_out)))
+    {
+        // new-array execute needs the same alignment and placement, plan this one separately
+        fftwf_plan const oneOff = fftwf_plan_dft_1d(sampleSize, in, out, sign, FFTW_ESTIMATE);
+        fftwf_execute(oneOff);
+        fftwf_destroy_plan(oneOff);
+        return;
+    }
+
+    // executing is thread safe
+    locker.unlock();
+    fftwf_execute_dft(plan.m_plan, in, out);
+}
+
 void AudioConversionUtils::debugComplex(fftwf_complex *c, int size)
 {
     for (int i = 0; i < size; ++i)
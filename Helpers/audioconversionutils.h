@@ -2,9 +2,12 @@
 #define AUDIOCONVERSIONUTILS_H
 
 #include <QAudioFormat>
+#include <QColor>
 #include <QDebug>
+#include <QMap>
 #include <QMetaEnum>
-#include <QWidget>
+#include <QMutex>
+#include <QVector>
 #include <QtMath>
 
 #include <fftw3.h>
@@ -25,14 +28,16 @@ private:
 public:
     // Utils
     static void debugAudioFormat(QAudioFormat const& audioFormat);
-    static QVector<float> const& getHanningFunction();
+    static QVector<float> const& getHanningFunction(int sampleSize = FFT_SAMPLE_COUNT);
     static QVector<float> const& getSpikeConvFunction();
     static QColor getMagnitudeColor(float v);
+    static QRgb const* getMagnitudeColorTable();
+    static inline int getMagnitudeIndex(float v) { return v <= 0.0f ? 0 : (v >= 1.0f ? 255 : int(v * 255.0f + 0.5f)); }
 
     // Main conversion function
     static bool convertSamplesToFloat(const QAudioFormat& format, const char* data, size_t dataSize, QVector<float>& out);
 
-    // Fast Fourier Transform
+    // Fast Fourier Transform, fastest with separate in and out from fftwf_alloc_complex()
     static void fft(int sampleSize, fftwf_complex *in, fftwf_complex *out);
     static void ifft(int sampleSize, fftwf_complex *in, fftwf_complex *out);
     static void debugComplex(fftwf_complex *c, int size);
@@ -40,6 +45,14 @@ public:
     static void spikeConvolution(int indexStart, int indexEnd, QVector<float> const& in, QVector<float>& out, float threshold = 1.0f);
 
 private:
+    struct FFTPlan
+    {
+        fftwf_plan      m_plan = Q_NULLPTR;
+        fftwf_complex*  m_in = Q_NULLPTR;
+        fftwf_complex*  m_out = Q_NULLPTR;
+    };
+    static void executePlan(int sampleSize, int sign, fftwf_complex *in, fftwf_complex *out);
+
     // Byte swap template functions
     inline static uint8_t byteSwap(uint8_t x) { return x; }
     inline static int8_t byteSwap(int8_t x) { return x; }
@@ -55,8 +68,13 @@ private:
     static void normalizeAudio(const Type* in, float* out, size_t outSize, bool isLittleEndian);
 
 private:
-    QVector<float> m_hanningFunction;
+    QMutex m_hanningMutex;
+    QMap<int, QVector<float>> m_hanningFunctions;
+    QMutex m_planMutex;
+    QMap<int, FFTPlan> m_forwardPlans;
+    QMap<int, FFTPlan> m_backwardPlans;
     QVector<float> m_spikeConvFunction;
+    QVector<QRgb> m_magnitudeColorTable;
 };
 
 #endif // AUDIOCONVERSIONUTILS_H
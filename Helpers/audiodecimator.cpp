@@ -0,0 +1,114 @@
+#include "audiodecimator.h"
+
+#include <QtMath>
+
+#define DECIMATOR_TAPS_PER_PHASE 16
+#define DECIMATOR_CUTOFF_RATIO 0.45f
+
+void AudioDecimator::Initialize(int inputRate, int channelCount, int outputRate)
+{
+    m_inputRate = inputRate;
+    m_channelCount = qMax(1, channelCount);
+    m_factor = 1;
+    m_taps.clear();
+
+    // only integer factors are supported (48k -> 24k/16k), otherwise just mix down to mono
+    if (outputRate > 0 && outputRate < inputRate && inputRate % outputRate == 0)
+    {
+        m_factor = inputRate / outputRate;
+    }
+
+    if (m_factor > 1)
+    {
+        // Blackman windowed-sinc low-pass, cutoff just below the new Nyquist frequency
+        int const tapCount = DECIMATOR_TAPS_PER_PHASE * m_factor + 1;
+        float const cutoff = DECIMATOR_CUTOFF_RATIO / float(m_factor);
+        float const center = float(tapCount - 1) * 0.5f;
+
+        m_taps.resize(tapCount);
+        float sum = 0.0f;
+        for (int i = 0; i < tapCount; i++)
+        {
+            float const x = float(i) - center;
+            float const sinc = (x == 0.0f) ? 2.0f * cutoff : std::sin(2.0f * float(M_PI) * cutoff * x) / (float(M_PI) * x);
+            float const phase = 2.0f * float(M_PI) * i / (tapCount - 1);
+            float const window = 0.42f - 0.5f * std::cos(phase) + 0.08f * std::cos(2.0f * phase);
+            m_taps[i] = sinc * window;
+            sum += m_taps[i];
+        }
+
+        // unity gain at DC
+        for (float& tap : m_taps)
+        {
+            tap /= sum;
+        }
+    }
+
+    Reset();
+}
+
+void AudioDecimator::Reset()
+{
+    m_phase = 0;
+    m_buffer.fill(0.0f, qMax(0, int(m_taps.size()) - 1));
+}
+
+void AudioDecimator::Process(const QVector<float> &in, QVector<float> &out)
+{
+    int const frameCount = in.size() / m_channelCount;
+    float const channelScale = 1.0f / float(m_channelCount);
+
+    if (m_factor == 1)
+    {
+        // nothing to filter, average all channels
+        out.resize(frameCount);
+        for (int i = 0; i < frameCount; i++)
+        {
+            float sample = 0.0f;
+            for (int c = 0; c < m_channelCount; c++)
+            {
+                sample += in[i * m_channelCount + c];
+            }
+            out[i] = sample * channelScale;
+        }
+        return;
+    }
+
+    // m_buffer holds (tapCount - 1) samples of history followed by the new mono samples
+    int const historySize = m_taps.size() - 1;
+    m_buffer.resize(historySize + frameCount);
+    for (int i = 0; i < frameCount; i++)
+    {
+        float sample = 0.0f;
+        for (int c = 0; c < m_channelCount; c++)
+        {
+            sample += in[i * m_channelCount + c];
+        }
+        m_buffer[historySize + i] = sample * channelScale;
+    }
+
+    // Only every m_factor-th output is evaluated, which is what the polyphase form computes,
+    // the discarded outputs are never filtered
+    out.resize(0);
+    out.reserve(frameCount / m_factor + 1);
+
+    int const tapCount = m_taps.size();
+    float const* taps = m_taps.constData();
+    int pos = m_phase;
+    while (pos < frameCount)
+    {
+        float const* x = m_buffer.constData() + pos;
+        float sum = 0.0f;
+        for (int k = 0; k < tapCount; k++)
+        {
+            sum += taps[k] * x[k];
+        }
+        out.append(sum);
+        pos += m_factor;
+    }
+    m_phase = pos - frameCount;
+
+    // keep the tail as history for the next block
+    std::copy(m_buffer.cbegin() + frameCount, m_buffer.cend(), m_buffer.begin());
+    m_buffer.resize(historySize);
+}
@@ -0,0 +1,35 @@
+#ifndef AUDIODECIMATOR_H
+#define AUDIODECIMATOR_H
+
+#include <QVector>
+
+class AudioDecimator
+{
+public:
+    AudioDecimator() {}
+
+    void Initialize(int inputRate, int channelCount, int outputRate);
+    void Reset();
+
+    int GetInputRate() const { return m_inputRate; }
+    int GetOutputRate() const { return m_inputRate / m_factor; }
+    int GetFactor() const { return m_factor; }
+
+    // input index (relative to next block) of the next output sample, and filter delay in input samples
+    int GetPhase() const { return m_phase; }
+    int GetGroupDelay() const { return qMax(0, int(m_taps.size()) - 1) / 2; }
+
+    // interleaved input at input rate -> mono output at output rate
+    void Process(QVector<float> const& in, QVector<float>& out);
+
+private:
+    int m_inputRate = 48000;
+    int m_channelCount = 2;
+    int m_factor = 1;
+    int m_phase = 0;
+
+    QVector<float> m_taps;
+    QVector<float> m_buffer;
+};
+
+#endif // AUDIODECIMATOR_H
@@ -0,0 +1,135 @@
+#include "audioenvelope.h"
+
+#include <QDeadlineTimer>
+#include <QtMath>
+
+#define ENVELOPE_MIN_DB -120.0f
+
+void AudioEnvelope::Initialize(int sampleRate, float attackMs, float releaseMs, float thresholdDb, float hysteresisDb)
+{
+    m_sampleRate = qMax(1, sampleRate);
+
+    // one-pole smoothing, reaches ~63% of a step after the given time
+    auto timeToCoef = [this](float ms)
+    {
+        float const samples = qMax(1.0f, ms * 0.001f * float(m_sampleRate));
+        return 1.0f - std::exp(-1.0f / samples);
+    };
+    m_attackCoef = timeToCoef(attackMs);
+    m_releaseCoef = timeToCoef(releaseMs);
+
+    // thresholds are compared against mean square
+    m_onLevel = std::pow(10.0f, thresholdDb / 10.0f);
+    m_offLevel = std::pow(10.0f, (thresholdDb - qMax(0.0f, hysteresisDb)) / 10.0f);
+
+    Reset();
+}
+
+void AudioEnvelope::Reset()
+{
+    m_resetPending = true;
+    m_rmsOut = 0.0f;
+    m_peakOut = 0.0f;
+
+    // count keeps going so waiters never miss a crossing, crossings before this are no longer reported
+    QMutexLocker locker(&m_mutex);
+    m_active = false;
+    m_resetCount = m_crossingCount;
+}
+
+void AudioEnvelope::Process(const float *data, int count, qint64 time)
+{
+    if (m_resetPending.exchange(false))
+    {
+        m_meanSquare = 0.0f;
+        m_peak = 0.0f;
+    }
+
+    float meanSquare = m_meanSquare;
+    float peak = m_peak;
+    bool active = m_active;
+
+    for (int i = 0; i < count; i++)
+    {
+        float const x = data[i];
+        float const square = x * x;
+        meanSquare += (square > meanSquare ? m_attackCoef : m_releaseCoef) * (square - meanSquare);
+
+        float const magnitude = std::abs(x);
+        peak += (magnitude > peak ? m_attackCoef : m_releaseCoef) * (magnitude - peak);
+
+        if (active ? (meanSquare < m_offLevel) : (meanSquare > m_onLevel))
+        {
+            active = !active;
+
+            Crossing crossing;
+            crossing.m_time = time + qint64(i) * 1000000 / m_sampleRate;
+            crossing.m_active = active;
+            crossing.m_rmsDb = ToDb(std::sqrt(meanSquare));
+            crossing.m_peakDb = ToDb(peak);
+
+            QMutexLocker locker(&m_mutex);
+            m_active = active;
+            m_lastCrossing[active] = crossing;
+            m_lastCrossingCount[active] = ++m_crossingCount;
+            m_condition.wakeAll();
+        }
+    }
+
+    m_meanSquare = meanSquare;
+    m_peak = peak;
+    m_rmsOut = std::sqrt(meanSquare);
+    m_peakOut = peak;
+}
+
+float AudioEnvelope::GetRmsDb() const
+{
+    return ToDb(m_rmsOut);
+}
+
+float AudioEnvelope::GetPeakDb() const
+{
+    return ToDb(m_peakOut);
+}
+
+bool AudioEnvelope::WaitForCrossing(bool active, quint64 sinceCount, unsigned long timeoutMs, Crossing &crossing)
+{
+    QDeadlineTimer const deadline(timeoutMs);
+
+    QMutexLocker locker(&m_mutex);
+    while (m_lastCrossingCount[active] <= sinceCount)
+    {
+        if (!m_condition.wait(&m_mutex, deadline))
+        {
+            return false;
+        }
+    }
+
+    crossing = m_lastCrossing[active];
+    return true;
+}
+
+bool AudioEnvelope::GetLastCrossing(Crossing &crossing)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_crossingCount == m_resetCount) return false;
+
+    crossing = m_lastCrossing[m_active];
+    return true;
+}
+
+bool AudioEnvelope::GetState(quint64 &count, bool &active, Crossing &crossing)
+{
+    QMutexLocker locker(&m_mutex);
+    count = m_crossingCount;
+    active = m_active;
+    if (count == m_resetCount) return false;
+
+    crossing = m_lastCrossing[active];
+    return true;
+}
+
+float AudioEnvelope::ToDb(float linear)
+{
+    return linear > 0.0f ? qMax(ENVELOPE_MIN_DB, 20.0f * std::log10(linear)) : ENVELOPE_MIN_DB;
+}
@@ -0,0 +1,74 @@
+#ifndef AUDIOENVELOPE_H
+#define AUDIOENVELOPE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+
+class AudioEnvelope
+{
+public:
+    struct Crossing
+    {
+        qint64  m_time = 0;         // media time of the sample that crossed
+        bool    m_active = false;   // true = sound started, false = went silent
+        float   m_rmsDb = -120.0f;
+        float   m_peakDb = -120.0f;
+    };
+
+public:
+    AudioEnvelope() {}
+
+    // called with ingest stopped or under the ingest lock
+    void Initialize(int sampleRate, float attackMs, float releaseMs, float thresholdDb, float hysteresisDb);
+
+    // any thread, back to silent with no crossing
+    void Reset();
+
+    // called from ingest thread, mono samples, time is media time of data[0]
+    void Process(float const* data, int count, qint64 time);
+
+    // latest values, safe from any thread
+    float GetRmsDb() const;
+    float GetPeakDb() const;
+    bool IsActive() const { return m_active; }
+    quint64 GetCrossingCount() const { return m_crossingCount; }
+
+    // block until a crossing into the given state, returns immediately if one happened after sinceCount
+    bool WaitForCrossing(bool active, quint64 sinceCount, unsigned long timeoutMs, Crossing& crossing);
+    bool GetLastCrossing(Crossing& crossing);
+
+    // count and state read together, a wait from this count can't miss a crossing that already changed the state
+    // returns false if there was no crossing since Reset(), crossing is the last one into the current state
+    bool GetState(quint64& count, bool& active, Crossing& crossing);
+
+    static float ToDb(float linear);
+
+private:
+    int     m_sampleRate = 48000;
+    float   m_attackCoef = 0.0f;
+    float   m_releaseCoef = 0.0f;
+    float   m_onLevel = 0.0f;       // mean square, avoids log per sample
+    float   m_offLevel = 0.0f;
+
+    // ingest thread only
+    float   m_meanSquare = 0.0f;
+    float   m_peak = 0.0f;
+
+    // published once per block
+    std::atomic<float>      m_rmsOut = 0.0f;
+    std::atomic<float>      m_peakOut = 0.0f;
+    std::atomic_bool        m_active = false;
+    std::atomic<quint64>    m_crossingCount = 0;
+    std::atomic_bool        m_resetPending = false;    // ingest thread clears its state on the next block
+
+    // crossings are rare, only they take the lock
+    QMutex          m_mutex;
+    QWaitCondition  m_condition;
+    Crossing        m_lastCrossing[2];   // indexed by m_active
+    quint64         m_lastCrossingCount[2] = {0, 0};
+    quint64         m_resetCount = 0;   // crossing count at the last Reset()
+};
+
+#endif // AUDIOENVELOPE_H
@@ -0,0 +1,181 @@
+#include "audiojitterbuffer.h"
+
+#include <cstring>
+
+// outside target +/- this, one frame is dropped or repeated every JITTER_DRIFT_FRAMES frames played
+#define JITTER_DRIFT_BAND_PERCENT   50
+#define JITTER_DRIFT_FRAMES         500     // 2000 ppm, well above any real clock mismatch and too sparse to hear
+
+void AudioJitterBuffer::Initialize(const QAudioFormat &format, int capacityMs)
+{
+    m_format = format;
+    m_capacity = MsToBytes(capacityMs);
+    m_ring.fill(0, m_capacity);
+
+    m_writePos = 0;
+    m_readPos = 0;
+    m_active = false;
+
+    if (!isOpen())
+    {
+        open(QIODevice::ReadOnly);
+    }
+}
+
+void AudioJitterBuffer::Reset(int targetLatencyMs)
+{
+    // drop everything buffered, only the consumer moves the read position
+    m_targetBytes = qMin(MsToBytes(targetLatencyMs), m_capacity / 2);
+    m_readPos = m_writePos.load(std::memory_order_acquire);
+    m_buffering = true;
+    m_driftPhase = 0;
+
+    m_underruns = 0;
+    m_overruns = 0;
+    m_driftCorrections = 0;
+    m_droppedBytes = 0;
+    m_pushedBytes = 0;
+    m_playedBytes = 0;
+}
+
+void AudioJitterBuffer::Push(const char *data, qint64 size)
+{
+    if (!m_active || m_capacity == 0) return;
+
+    quint64 const writePos = m_writePos.load(std::memory_order_relaxed);
+    quint64 const readPos = m_readPos.load(std::memory_order_acquire);
+    qint64 const space = m_capacity - qint64(writePos - readPos);
+
+    qint64 count = size;
+    if (count > space)
+    {
+        // full, playback is stalled, drop the newest data instead of blocking decode
+        int const bytesPerFrame = m_format.bytesPerFrame();
+        count = space - (space % bytesPerFrame);
+        m_overruns++;
+        m_droppedBytes += size - count;
+    }
+
+    qint64 const start = qint64(writePos % quint64(m_capacity));
+    qint64 const first = qMin(count, m_capacity - start);
+    memcpy(m_ring.data() + start, data, first);
+    if (count > first)
+    {
+        memcpy(m_ring.data(), data + first, count - first);
+    }
+
+    m_pushedBytes += count;
+    m_writePos.store(writePos + count, std::memory_order_release);
+}
+
+AudioJitterBuffer::Stats AudioJitterBuffer::GetStats() const
+{
+    Stats stats;
+    stats.m_underruns = m_underruns;
+    stats.m_overruns = m_overruns;
+    stats.m_driftCorrections = m_driftCorrections;
+    stats.m_droppedBytes = m_droppedBytes;
+    stats.m_fillMs = BytesToMs(qint64(m_writePos - m_readPos));
+    stats.m_targetMs = BytesToMs(m_targetBytes);
+
+    // pushed minus played is what the drift correction dropped or repeated, plus what's still buffered
+    quint64 const played = m_playedBytes;
+    if (played > 0)
+    {
+        stats.m_driftPpm = (qreal(m_pushedBytes) - qreal(played)) / qreal(played) * 1000000.0;
+    }
+
+    return stats;
+}
+
+qint64 AudioJitterBuffer::bytesAvailable() const
+{
+    return qint64(m_writePos - m_readPos) + QIODevice::bytesAvailable();
+}
+
+qint64 AudioJitterBuffer::readData(char *data, qint64 maxSize)
+{
+    int const bytesPerFrame = m_format.bytesPerFrame();
+    maxSize -= maxSize % bytesPerFrame;
+    if (maxSize <= 0) return 0;
+
+    quint64 readPos = m_readPos.load(std::memory_order_relaxed);
+    qint64 filled = qint64(m_writePos.load(std::memory_order_acquire) - readPos);
+
+    // prebuffer up to target latency before starting or after an underrun, silence doesn't count as played
+    if (m_buffering)
+    {
+        if (filled < m_targetBytes)
+        {
+            memset(data, 0, maxSize);
+            return maxSize;
+        }
+        m_buffering = false;
+    }
+
+    // input and output clocks drift apart, nudge the buffer back towards target one frame at a time
+    qint64 const band = m_targetBytes * JITTER_DRIFT_BAND_PERCENT / 100;
+    qint64 written = 0;
+    while (written < maxSize && filled > 0)
+    {
+        qint64 const count = qMin(qMin(maxSize - written, filled), qint64(JITTER_DRIFT_FRAMES - m_driftPhase) * bytesPerFrame);
+        CopyFromRing(data + written, readPos, count);
+        readPos += count;
+        filled -= count;
+        written += count;
+
+        m_driftPhase += int(count / bytesPerFrame);
+        if (m_driftPhase < JITTER_DRIFT_FRAMES) continue;
+        m_driftPhase = 0;
+
+        if (filled > m_targetBytes + band)
+        {
+            // input is faster, skip a frame
+            readPos += bytesPerFrame;
+            filled -= bytesPerFrame;
+            m_driftCorrections++;
+            m_droppedBytes += bytesPerFrame;
+        }
+        else if (filled < m_targetBytes - band && written < maxSize)
+        {
+            // output is faster, play the last frame again
+            memcpy(data + written, data + written - bytesPerFrame, bytesPerFrame);
+            written += bytesPerFrame;
+            m_driftCorrections++;
+        }
+    }
+    m_readPos.store(readPos, std::memory_order_release);
+    m_playedBytes += written;
+
+    if (written < maxSize)
+    {
+        // ran dry, pad with silence and buffer up again
+        memset(data + written, 0, maxSize - written);
+        m_underruns++;
+        m_buffering = true;
+    }
+
+    return maxSize;
+}
+
+void AudioJitterBuffer::CopyFromRing(char *data, quint64 pos, qint64 count) const
+{
+    qint64 const start = qint64(pos % quint64(m_capacity));
+    qint64 const first = qMin(count, m_capacity - start);
+    memcpy(data, m_ring.constData() + start, first);
+    if (count > first)
+    {
+        memcpy(data + first, m_ring.constData(), count - first);
+    }
+}
+
+qint64 AudioJitterBuffer::MsToBytes(int ms) const
+{
+    return qint64(m_format.bytesForDuration(qint64(ms) * 1000));
+}
+
+int AudioJitterBuffer::BytesToMs(qint64 bytes) const
+{
+    if (!m_format.isValid()) return 0;
+    return int(m_format.durationForBytes(qint32(bytes)) / 1000);
+}
@@ -0,0 +1,74 @@
+#ifndef AUDIOJITTERBUFFER_H
+#define AUDIOJITTERBUFFER_H
+
+#include <QAudioFormat>
+#include <QIODevice>
+
+#include <atomic>
+
+class AudioJitterBuffer : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    struct Stats
+    {
+        quint64 m_underruns = 0;        // sink wanted data but buffer was empty
+        quint64 m_overruns = 0;         // producer had to drop data, buffer was full
+        quint64 m_driftCorrections = 0; // frames dropped or repeated to keep the buffer near target
+        quint64 m_droppedBytes = 0;     // total bytes dropped by overruns and drift corrections
+        int     m_fillMs = 0;           // current buffered audio
+        int     m_targetMs = 0;         // configured target latency
+        qreal   m_driftPpm = 0.0;       // input rate vs output rate mismatch
+    };
+
+public:
+    explicit AudioJitterBuffer(QObject* parent = nullptr) : QIODevice(parent) {}
+
+    void Initialize(QAudioFormat const& format, int capacityMs);
+
+    // called from consumer thread
+    void Reset(int targetLatencyMs);
+    void SetActive(bool active) { m_active = active; }
+
+    // called from producer thread, lock-free and never blocks
+    void Push(const char* data, qint64 size);
+
+    Stats GetStats() const;
+
+    // from QIODevice
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override { return -1; }
+
+private:
+    void CopyFromRing(char* data, quint64 pos, qint64 count) const;
+    qint64 MsToBytes(int ms) const;
+    int BytesToMs(qint64 bytes) const;
+
+private:
+    QAudioFormat    m_format;
+    QByteArray      m_ring;
+    qint64          m_capacity = 0;
+    qint64          m_targetBytes = 0;
+    bool            m_buffering = true;
+    int             m_driftPhase = 0;       // frames played since the last drift check
+
+    // monotonic byte positions, ring index is position % m_capacity
+    std::atomic<quint64>    m_writePos = 0;
+    std::atomic<quint64>    m_readPos = 0;
+    std::atomic_bool        m_active = false;
+
+    // statistics
+    std::atomic<quint64>    m_underruns = 0;
+    std::atomic<quint64>    m_overruns = 0;
+    std::atomic<quint64>    m_driftCorrections = 0;
+    std::atomic<quint64>    m_droppedBytes = 0;
+    std::atomic<quint64>    m_pushedBytes = 0;
+    std::atomic<quint64>    m_playedBytes = 0;
+};
+
+#endif // AUDIOJITTERBUFFER_H
@@ -0,0 +1,92 @@
+#include "audioplayer.h"
+
+#include "Helpers/sessioncontext.h"
+#include "Managers/managercollection.h"
+#include "Managers/logmanager.h"
+
+// ring capacity, target latency is capped at half of this
+#define AUDIO_PLAYER_CAPACITY_MS 1000
+
+AudioPlayer::AudioPlayer(QObject *parent)
+    : QThread{parent}
+{
+    m_buffer.moveToThread(this);
+
+    LogManager* logManager = ManagerCollection::GetManager<LogManager>();
+    connect(this, &AudioPlayer::notifyLog, logManager, &LogManager::PrintLog, Qt::DirectConnection);
+
+    SessionContext::AttachThread(this);
+    this->moveToThread(this);
+    this->start();
+}
+
+AudioPlayer::~AudioPlayer()
+{
+    // sink must be deleted in the thread it was created
+    QMetaObject::invokeMethod(this, [this]{ StopSink(); }, Qt::BlockingQueuedConnection);
+
+    this->quit();
+    this->wait();
+}
+
+void AudioPlayer::Initialize(const QAudioFormat &format)
+{
+    m_format = format;
+    m_buffer.Initialize(format, AUDIO_PLAYER_CAPACITY_MS);
+}
+
+void AudioPlayer::Play(const QAudioDevice &device, qreal volume, int latencyMs)
+{
+    QMetaObject::invokeMethod(this, [this, device, volume, latencyMs]{ StartSink(device, volume, latencyMs); });
+}
+
+void AudioPlayer::Stop()
+{
+    QMetaObject::invokeMethod(this, [this]{ StopSink(); });
+}
+
+void AudioPlayer::SetVolume(qreal volume)
+{
+    QMetaObject::invokeMethod(this, [this, volume]
+    {
+        if (m_audioSink)
+        {
+            m_audioSink->setVolume(volume);
+        }
+    });
+}
+
+void AudioPlayer::StartSink(const QAudioDevice &device, qreal volume, int latencyMs)
+{
+    StopSink();
+
+    m_buffer.Reset(latencyMs);
+    m_buffer.SetActive(true);
+
+    // jitter buffer absorbs the jitter, keep device buffer small so total latency stays near target
+    m_audioSink = new QAudioSink(device, m_format, this);
+    m_audioSink->setBufferSize(m_format.bytesForDuration(qMax(10, latencyMs / 2) * 1000));
+    m_audioSink->setVolume(volume);
+    m_audioSink->start(&m_buffer);
+
+    m_playing = true;
+}
+
+void AudioPlayer::StopSink()
+{
+    if (!m_audioSink) return;
+
+    m_playing = false;
+    m_buffer.SetActive(false);
+
+    m_audioSink->stop();
+    delete m_audioSink;
+    m_audioSink = Q_NULLPTR;
+
+    AudioJitterBuffer::Stats const stats = m_buffer.GetStats();
+    emit notifyLog("Global", "Audio playback stopped: underruns = " + QString::number(stats.m_underruns)
+                   + ", overruns = " + QString::number(stats.m_overruns)
+                   + ", drift corrections = " + QString::number(stats.m_driftCorrections)
+                   + ", drift = " + QString::number(stats.m_driftPpm, 'f', 1) + "ppm",
+                   (stats.m_underruns || stats.m_overruns) ? LOG_Warning : LOG_Normal);
+}
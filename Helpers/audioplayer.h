@@ -0,0 +1,47 @@
+#ifndef AUDIOPLAYER_H
+#define AUDIOPLAYER_H
+
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QThread>
+
+#include "Helpers/audiojitterbuffer.h"
+#include "Types/system.h"
+
+class AudioPlayer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit AudioPlayer(QObject *parent = nullptr);
+    ~AudioPlayer();
+
+    void Initialize(QAudioFormat const& format);
+
+    // thread safe, sink is (re)created in player thread
+    void Play(QAudioDevice const& device, qreal volume, int latencyMs);
+    void Stop();
+    void SetVolume(qreal volume);
+    bool IsPlaying() const { return m_playing; }
+
+    // called from LibVLC thread, never blocks on the sink
+    void PushAudioData(const char* data, qint64 size) { m_buffer.Push(data, size); }
+
+    AudioJitterBuffer::Stats GetStats() const { return m_buffer.GetStats(); }
+
+signals:
+    void notifyLog(QString const& category, QString const& log, LogType type = LOG_Normal) const;
+
+private:
+    void StartSink(QAudioDevice const& device, qreal volume, int latencyMs);
+    void StopSink();
+
+private:
+    QAudioFormat        m_format;
+    AudioJitterBuffer   m_buffer;
+    QAudioSink*         m_audioSink = Q_NULLPTR;
+    std::atomic_bool    m_playing = false;
+};
+
+#endif // AUDIOPLAYER_H
@@ -1,12 +1,11 @@
 #include "captureholder.h"
 
+#include "Helpers/inputscheduler.h"
+#include "Helpers/mediatimeline.h"
+#include "Helpers/tracer.h"
 #include "Managers/managercollection.h"
 #include "Managers/videomanager.h"
 
-#define SET_BIT(var,pos) (var |= (1U << pos))
-#define CLEAR_BIT(var,pos) (var &= ~(1U << pos))
-#define COLOR_MATCH_THRESHOLD 10
-
 CaptureHolder::CaptureHolder(QPoint point, QColor targetColor, QColor displayColor)
     : m_point(point)
     , m_targetColor(targetColor)
@@ -72,11 +71,17 @@ void CaptureHolder::SetHsvRange(HsvRange range)
     m_range = range;
 }
 
-void CaptureHolder::PushFrameData(const QImage &frame)
+void CaptureHolder::PushFrameData(const QImage &frame, qint64 time)
 {
     // frame should already be in 1280x720
     // this is called by VLC thread
+    TRACE_SCOPE("capture", "CaptureHolder::PushFrameData");
     QMutexLocker locker(&m_mutex);
+    if (m_testTime > 0 && time > m_testTime)
+    {
+        m_framePeriod += (qreal(time - m_testTime) - m_framePeriod) * 0.1;
+    }
+    m_testTime = time;
     switch (m_mode)
     {
     case Mode::PointColorMatch:
@@ -106,6 +111,67 @@ QColor CaptureHolder::GetPixelData() const
     return m_testColor;
 }
 
+qint64 CaptureHolder::GetFrameTime() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_testTime;
+}
+
+void CaptureHolder::SetEventName(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    m_eventName = name;
+}
+
+bool CaptureHolder::AnalyzeFrame(const QImage &frame, qint64 time, qreal meanThreshold)
+{
+    TRACE_SCOPE("capture", "CaptureHolder::AnalyzeFrame");
+    QMutexLocker resultLocker(&m_resultMutex);
+    m_resultTime = time;
+    switch (m_mode)
+    {
+    case Mode::PointColorMatch:
+    {
+        QColor const pixel = frame.pixelColor(GetPoint());
+        m_resultColor = pixel;
+        m_resultMatched = GetColorMatch(pixel, GetTargetColor());
+        break;
+    }
+    case Mode::PointRangeMatch:
+    {
+        QColor const pixel = frame.pixelColor(GetPoint());
+        m_resultColor = pixel.toHsv();
+        m_resultMatched = GetColorMatchHSV(pixel, GetHsvRange());
+        break;
+    }
+    case Mode::AreaColorMatch:
+    {
+        m_resultColor = GetAverageColor(frame.copy(GetRect()));
+        m_resultMatched = GetColorMatch(m_resultColor, GetTargetColor());
+        break;
+    }
+    case Mode::AreaRangeMatch:
+    {
+        m_resultMean = GetBrightnessMean(frame.copy(GetRect()), GetHsvRange());
+        m_resultMatched = m_resultMean >= meanThreshold;
+        break;
+    }
+    }
+    return m_resultMatched;
+}
+
+qint64 CaptureHolder::ToSchedulerTime(qint64 time)
+{
+    // LibVLC clock is microseconds, both clocks are monotonic
+    return InputScheduler::Now() - (MediaTimeline::Now() - time) * 1000;
+}
+
+qreal CaptureHolder::GetFramePeriod() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_framePeriod;
+}
+
 QRect CaptureHolder::GetRect() const
 {
     QMutexLocker locker(&m_mutex);
@@ -154,73 +220,10 @@ QImage CaptureHolder::GetResultMasked() const
     return m_resultMasked.copy();
 }
 
-bool CaptureHolder::GetColorMatch(QColor testColor, QColor target)
-{
-    int const r = target.red() - testColor.red();
-    int const g = target.green() - testColor.green();
-    int const b = target.blue() - testColor.blue();
-    return r*r + g*g + b*b <= COLOR_MATCH_THRESHOLD * COLOR_MATCH_THRESHOLD;
-}
-
-bool CaptureHolder::GetColorMatchHSV(QColor testColor, HsvRange range)
-{
-    testColor = testColor.toHsv();
-
-    // Test value and saturation first
-    bool matched = testColor.value() >= range.min().value() && testColor.value() <= range.max().value()
-                   && testColor.hsvSaturation() >= range.min().hsvSaturation() && testColor.hsvSaturation() <= range.max().hsvSaturation();
-
-    // For achromatic colors it should be filltered in saturation and value
-    if (matched && testColor.hsvHue() != -1)
-    {
-        int const h = testColor.hsvHue();
-        int const h0 = range.min().hsvHue();
-        int const h1 = range.max().hsvHue();
-
-        if (h0 > h1)
-        {
-            // 0-----------------359
-            //     ^max     ^min
-            //    <---        --->
-            matched &= (h >= h0 || h <= h1);
-        }
-        else
-        {
-            // 0-----------------359
-            //     ^max     ^min
-            //       ---> <---
-            matched &= (h >= h0 && h <= h1);
-        }
-    }
-
-    return matched;
-}
-
-QColor CaptureHolder::GetAverageColor(const QImage &image)
+qint64 CaptureHolder::GetResultTime() const
 {
-    qreal r = 0;
-    qreal g = 0;
-    qreal b = 0;
-    for (int y = 0; y < image.height(); y++)
-    {
-        QRgb const* rowData = (QRgb*)image.scanLine(y);
-        for (int x = 0; x < image.width(); x++)
-        {
-            QColor const color = QColor::fromRgb(rowData[x]);
-            r += color.redF();
-            g += color.greenF();
-            b += color.blueF();
-        }
-    }
-
-    qreal const pixelCount = image.height() * image.width();
-    r /= pixelCount;
-    g /= pixelCount;
-    b /= pixelCount;
-
-    QColor testColor;
-    testColor.setRgbF(r,g,b);
-    return testColor;
+    QMutexLocker locker(&m_resultMutex);
+    return m_resultTime;
 }
 
 bool CaptureHolder::GetAverageColorMatch(const QImage &image, QColor target)
@@ -229,47 +232,14 @@ bool CaptureHolder::GetAverageColorMatch(const QImage &image, QColor target)
     return GetColorMatch(testColor, target);
 }
 
-qreal CaptureHolder::GetBrightnessMean(const QImage &image, HsvRange range, QImage *masked)
-{
-    if (masked)
-    {
-        *masked = QImage(image.size(), QImage::Format_MonoLSB);
-        masked->setColorTable({0xFF000000,0xFFFFFFFF});
-    }
-
-    double mean = 0;
-
-    for (int y = 0; y < image.height(); y++)
-    {
-        QRgb const* rowData = (QRgb*)image.scanLine(y);
-        uint8_t *rowMaskedData = masked ? (uint8_t*)masked->scanLine(y) : Q_NULLPTR;
-        for (int x = 0; x < image.width(); x++)
-        {
-            // Mask the target color
-            bool matched = GetColorMatchHSV(QColor::fromRgb(rowData[x]), range);
-            if (matched)
-            {
-                mean += 1;
-            }
-
-            if (rowMaskedData)
-            {
-                matched ? SET_BIT(rowMaskedData[x / 8], x % 8) : CLEAR_BIT(rowMaskedData[x / 8], x % 8);
-            }
-        }
-    }
-
-    // Get average value of brightness
-    mean /= (image.height() * image.width());
-    return mean;
-}
-
 void CaptureHolder::Register()
 {
-    ManagerCollection::GetManager<VideoManager>()->RegisterCapture(this);
+    // video of the session creating it, may be destroyed from another thread
+    m_videoManager = ManagerCollection::GetManager<VideoManager>();
+    m_videoManager->RegisterCapture(this);
 }
 
 void CaptureHolder::Unregister()
 {
-    ManagerCollection::GetManager<VideoManager>()->UnregisterCapture(this);
+    m_videoManager->UnregisterCapture(this);
 }
@@ -7,33 +7,9 @@
 #include <qrect.h>
 #include <qpoint.h>
 
-struct HsvRange
-{
-    HsvRange()
-    {
-        m_minHSV.setHsv(0,0,0);
-        m_maxHSV.setHsv(359,255,255);
-    }
-    HsvRange(int minH, int minS, int minV, int maxH, int maxS, int maxV)
-    {
-        m_minHSV.setHsv(minH,minS,minV);
-        m_maxHSV.setHsv(maxH,maxS,maxV);
-    }
-    HsvRange(QColor minHSV, QColor maxHSV)
-    {
-        Q_ASSERT(minHSV.spec() == QColor::Hsv);
-        Q_ASSERT(maxHSV.spec() == QColor::Hsv);
-        m_minHSV = minHSV;
-        m_maxHSV = maxHSV;
-    }
-
-    QColor min() const {return m_minHSV;}
-    QColor max() const {return m_maxHSV;}
+#include "Helpers/frameanalysis.h"
 
-private:
-    QColor m_minHSV;
-    QColor m_maxHSV;
-};
+class VideoManager;
 
 class CaptureHolder
 {
@@ -63,9 +39,22 @@ public:
     void SetHsvRange(HsvRange range);
 
     // get data for analysis
-    virtual void PushFrameData(QImage const& frame);
+    virtual void PushFrameData(QImage const& frame, qint64 time);
     QImage GetFrameData() const;
     QColor GetPixelData() const;
+    qint64 GetFrameTime() const;
+
+    // when set, match changes are added to MediaTimeline with this name
+    void SetEventName(QString const& name);
+
+    // analyze on the calling thread and update results, AreaRangeMatch is matched when mean >= meanThreshold
+    bool AnalyzeFrame(QImage const& frame, qint64 time, qreal meanThreshold);
+
+    // media time of a frame on the InputScheduler clock, call as soon as the frame is received
+    static qint64 ToSchedulerTime(qint64 time);
+
+    // microseconds between pushed frames on the media clock, smoothed so a dropped frame doesn't throw it off
+    qreal GetFramePeriod() const;
 
     // get fixed data
     QRect GetRect() const;
@@ -74,12 +63,12 @@ public:
     HsvRange GetHsvRange() const;
 
     // analysis
-    static QSize GetCaptureResolution() { return QSize(1280,720); }
-    static bool GetColorMatch(QColor testColor, QColor target);
-    static bool GetColorMatchHSV(QColor testColor, HsvRange range);
-    static QColor GetAverageColor(QImage const& image);
+    static QSize GetCaptureResolution() { return FrameAnalysis::GetCaptureResolution(); }
+    static bool GetColorMatch(QColor testColor, QColor target) { return FrameAnalysis::GetColorMatch(testColor, target); }
+    static bool GetColorMatchHSV(QColor testColor, HsvRange range) { return FrameAnalysis::GetColorMatchHSV(testColor, range); }
+    static QColor GetAverageColor(QImage const& image) { return FrameAnalysis::GetAverageColor(image); }
     static bool GetAverageColorMatch(QImage const& image, QColor target);
-    static qreal GetBrightnessMean(QImage const& image, HsvRange range, QImage* masked = Q_NULLPTR);
+    static qreal GetBrightnessMean(QImage const& image, HsvRange range, QImage* masked = Q_NULLPTR) { return FrameAnalysis::GetBrightnessMean(image, range, masked); }
 
     // json utils
     static QString GetDirectory() { return "../Resources/FrameCapture/"; }
@@ -90,11 +79,15 @@ public:
     qreal GetResultMean() const;
     QColor GetResultColor() const;
     QImage GetResultMasked() const;
+    qint64 GetResultTime() const;
 
 private:
     void Register();
     void Unregister();
 
+private:
+    VideoManager*   m_videoManager = Q_NULLPTR;
+
 protected:
     // init data
     QColor  m_displayColor;
@@ -110,6 +103,9 @@ protected:
     // frame data
     QImage  m_testImage;
     QColor  m_testColor;
+    qint64  m_testTime = 0;
+    qreal   m_framePeriod = 1000000.0 / 60.0;
+    QString m_eventName;
 
     // results
     mutable QMutex  m_resultMutex;
@@ -117,6 +113,7 @@ protected:
     qreal   m_resultMean = 0.0;
     QColor  m_resultColor = QColor(0,0,0);
     QImage  m_resultMasked;
+    qint64  m_resultTime = 0;
 };
 
 #endif // CAPTUREHOLDER_H
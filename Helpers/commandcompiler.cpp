@@ -0,0 +1,256 @@
+#include "commandcompiler.h"
+
+#include <QElapsedTimer>
+
+#include "Types/system.h"
+
+namespace CommandCompiler
+{
+
+qsizetype Program::GetMemoryUsage() const
+{
+    return sizeof(Program) + m_code.capacity() * sizeof(Instruction);
+}
+
+static bool CompileState(QString const& str, int index, Instruction& instruction, QString& errorMsg)
+{
+    QStringList const buttons = str.split('|');
+    if (buttons.size() < 2)
+    {
+        errorMsg = "Command '" + str + "' is invalid at index " + QString::number(index) + ", expecting Button1|Button2|...|Duration";
+        return false;
+    }
+
+    instruction.m_op = Op::State;
+    for (int b = 0; b < buttons.size() - 1; b++)
+    {
+        QString const button = buttons[b].trimmed().toLower();
+        if (button.startsWith("lx") || button.startsWith("ly") || button.startsWith("rx") || button.startsWith("ry"))
+        {
+            bool ok = false;
+            qreal const stickPos = button.mid(2).toDouble(&ok);
+            if (!ok || qAbs(stickPos) > 1.0)
+            {
+                errorMsg = "'" + button + "' does not have valid stick position (between -1.0 to 1.0) at index " + QString::number(index);
+                return false;
+            }
+
+            float& axis = button[0] == 'l'
+                    ? (button[1] == 'x' ? instruction.m_lx : instruction.m_ly)
+                    : (button[1] == 'x' ? instruction.m_rx : instruction.m_ry);
+            axis = float(stickPos);
+        }
+        else
+        {
+            ButtonType const type = StringToButton(button);
+            if (type == BTN_COUNT)
+            {
+                errorMsg = "'" + button + "' is not a recognized button at index " + QString::number(index);
+                return false;
+            }
+            instruction.m_buttonFlag |= ButtonToFlag(type);
+        }
+    }
+
+    bool ok = false;
+    instruction.m_value = buttons.back().trimmed().toInt(&ok);
+    if (!ok || instruction.m_value <= 0)
+    {
+        errorMsg = "Duration '" + buttons.back() + "' is invalid at index " + QString::number(index);
+        return false;
+    }
+
+    return true;
+}
+
+bool Compile(QString const& command, Program& program, QString& errorMsg)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    program = Program();
+    errorMsg.clear();
+
+    auto fail = [&program, &errorMsg](QString const& msg)
+    {
+        errorMsg = msg;
+        program.m_code.clear();
+        program.m_stateCount = 0;
+        return false;
+    };
+
+    if (command.isEmpty())
+    {
+        return fail("Command is empty");
+    }
+
+    if (command.endsWith(',') || command.endsWith('|') || command.endsWith('-') || command.endsWith('.') || command.endsWith(')'))
+    {
+        return fail("Ending character not expected");
+    }
+
+    // every state is separated by ',' and every loop adds two instructions
+    program.m_code.reserve(command.count(',') + command.count('(') * 2 + 1);
+
+    QVector<int> loopStarts;
+    int minDuration = INT_MAX;
+    bool hasInfiniteLoop = false;
+
+    qsizetype const size = command.size();
+    qsizetype i = 0;
+    while (i < size)
+    {
+        if (hasInfiniteLoop)
+        {
+            return fail("No more command should be after infinite loop");
+        }
+
+        // loop starts, only at the beginning of a command
+        while (i < size && command[i] == '(')
+        {
+            if (loopStarts.size() > 0xFFFF)
+            {
+                return fail("Too many nested loops at index " + QString::number(i));
+            }
+
+            Instruction instruction;
+            instruction.m_op = Op::LoopBegin;
+            instruction.m_slot = quint16(loopStarts.size());
+            loopStarts.push_back(program.m_code.size());
+            program.m_code.push_back(instruction);
+            program.m_loopDepth = qMax(program.m_loopDepth, int(loopStarts.size()));
+            i++;
+        }
+
+        // state, until next ',' or ')'
+        qsizetype end = i;
+        while (end < size && command[end] != ',' && command[end] != ')')
+        {
+            if (command[end] == '(')
+            {
+                return fail("Loop start '(' is not expected at index " + QString::number(end));
+            }
+            end++;
+        }
+
+        Instruction instruction;
+        if (!CompileState(command.mid(i, end - i), int(i), instruction, errorMsg))
+        {
+            return fail(errorMsg);
+        }
+        minDuration = qMin(minDuration, instruction.m_value);
+        program.m_code.push_back(instruction);
+        program.m_stateCount++;
+        i = end;
+
+        // loop ends, each followed by its loop count
+        while (i < size && command[i] == ')')
+        {
+            if (hasInfiniteLoop)
+            {
+                return fail("No more command should be after infinite loop");
+            }
+
+            if (loopStarts.isEmpty())
+            {
+                return fail("Number of '(' is not matching number of ')'");
+            }
+
+            i++;
+            if (i < size && command[i] == ')')
+            {
+                return fail("Double loop ending '))' is not allowed");
+            }
+
+            end = i;
+            while (end < size && command[end] != ',' && command[end] != ')')
+            {
+                end++;
+            }
+
+            QString const countStr = command.mid(i, end - i);
+            bool ok = false;
+            int const count = countStr.trimmed().toInt(&ok);
+            if (!ok || count < 0)
+            {
+                return fail("Loop Count '" + countStr + "' is invalid at index " + QString::number(i));
+            }
+
+            int const begin = loopStarts.takeLast();
+            Instruction loopEnd;
+            loopEnd.m_op = Op::LoopEnd;
+            loopEnd.m_slot = program.m_code[begin].m_slot;
+            loopEnd.m_value = count;
+            loopEnd.m_target = begin + 1;
+            program.m_code.push_back(loopEnd);
+
+            hasInfiniteLoop = (count == 0);
+            i = end;
+        }
+
+        // skip ','
+        i++;
+    }
+
+    if (!loopStarts.isEmpty())
+    {
+        return fail("Number of '(' is not matching number of ')'");
+    }
+
+    program.m_minDuration = minDuration;
+    program.m_compileTime = timer.nsecsElapsed();
+
+    if (minDuration < 50)
+    {
+        errorMsg = "Command with duration " + QString::number(minDuration) + " is less than 50, this may get skipped";
+    }
+    return true;
+}
+
+void Interpreter::Reset(const Program *program)
+{
+    m_program = program;
+    m_pc = 0;
+    m_counters.fill(0, program ? program->m_loopDepth : 0);
+}
+
+const Instruction *Interpreter::Next()
+{
+    if (!m_program)
+    {
+        return Q_NULLPTR;
+    }
+
+    // every loop contains at least one state, so this never spins
+    Instruction const* code = m_program->m_code.constData();
+    int const size = int(m_program->m_code.size());
+    while (m_pc < size)
+    {
+        Instruction const& instruction = code[m_pc++];
+        switch (instruction.m_op)
+        {
+        case Op::State:
+        {
+            return &instruction;
+        }
+        case Op::LoopBegin:
+        {
+            m_counters[instruction.m_slot] = 0;
+            break;
+        }
+        case Op::LoopEnd:
+        {
+            // loop count 0 loops forever
+            if (instruction.m_value == 0 || ++m_counters[instruction.m_slot] < instruction.m_value)
+            {
+                m_pc = instruction.m_target;
+            }
+            break;
+        }
+        }
+    }
+
+    return Q_NULLPTR;
+}
+
+} // namespace CommandCompiler
@@ -0,0 +1,60 @@
+#ifndef COMMANDCOMPILER_H
+#define COMMANDCOMPILER_H
+
+#include <QString>
+#include <QVector>
+
+// Custom command syntax: Button1|Button2|...|Duration, comma separated
+// loops are written as (Command,Command)LoopCount, LoopCount 0 loops forever
+namespace CommandCompiler
+{
+    enum class Op : quint8
+    {
+        State,      // hold buttons and sticks for m_value ms
+        LoopBegin,  // reset counter m_slot
+        LoopEnd,    // jump to m_target until counter m_slot reaches m_value
+    };
+
+    struct Instruction
+    {
+        Op      m_op = Op::State;
+        quint16 m_slot = 0;
+        quint32 m_buttonFlag = 0;
+        qint32  m_value = 0;
+        qint32  m_target = 0;
+        float   m_lx = 0.0f;
+        float   m_ly = 0.0f;
+        float   m_rx = 0.0f;
+        float   m_ry = 0.0f;
+    };
+
+    struct Program
+    {
+        QVector<Instruction> m_code;
+        int     m_loopDepth = 0;        // number of loop counters needed
+        int     m_stateCount = 0;
+        int     m_minDuration = 0;
+        qint64  m_compileTime = 0;      // nanoseconds
+
+        bool IsEmpty() const { return m_stateCount == 0; }
+        qsizetype GetMemoryUsage() const;
+    };
+
+    // errorMsg can hold a warning even if compile succeeded
+    bool Compile(QString const& command, Program& program, QString& errorMsg);
+
+    // Walks the bytecode, returns the next state to hold or Q_NULLPTR when finished
+    class Interpreter
+    {
+    public:
+        void Reset(Program const* program);
+        Instruction const* Next();
+
+    private:
+        Program const*  m_program = Q_NULLPTR;
+        int             m_pc = 0;
+        QVector<int>    m_counters;
+    };
+};
+
+#endif // COMMANDCOMPILER_H
@@ -0,0 +1,50 @@
+#include "commandplayer.h"
+
+#include "Helpers/tracer.h"
+
+// steps handed to the input scheduler before they are due
+#define COMMAND_PLAYER_SCHEDULE_AHEAD 4
+
+bool CommandPlayer::Play(InputScheduler *scheduler, quintptr source, CommandCompiler::Interpreter &interpreter, const std::atomic_bool &terminate, InputScheduler::Stats &stats)
+{
+    quint64 const sampleStart = scheduler->GetSampleCount();
+
+    // absolute deadlines, a late send never delays the steps after it
+    qint64 deadline = InputScheduler::Now();
+    CommandCompiler::Instruction const* instruction = Q_NULLPTR;
+    while (!terminate && (instruction = interpreter.Next()) != Q_NULLPTR)
+    {
+        // stay a few steps ahead so infinite loops don't flood the scheduler
+        while (!terminate && !scheduler->WaitForPending(source, COMMAND_PLAYER_SCHEDULE_AHEAD, 100)) {}
+        if (terminate)
+        {
+            break;
+        }
+
+        TRACE_SCOPE("command", "CommandPlayer submit step");
+        QPointF const lStick(instruction->m_lx, instruction->m_ly);
+        QPointF const rStick(instruction->m_rx, instruction->m_ry);
+        scheduler->Submit(source, deadline, instruction->m_buttonFlag, lStick, rStick);
+        deadline += qint64(instruction->m_value) * 1000000;
+    }
+
+    if (!terminate)
+    {
+        // release everything exactly when the last step ends
+        scheduler->Submit(source, deadline, 0);
+        while (!terminate && !scheduler->WaitForPending(source, 0, 100)) {}
+    }
+    scheduler->Cancel(source);
+
+    stats = scheduler->GetStats(sampleStart);
+    return !terminate;
+}
+
+QString CommandPlayer::FormatStats(const InputScheduler::Stats &stats)
+{
+    if (stats.m_count == 0) return QString();
+
+    auto toUs = [](qint64 ns) { return QString::number(qreal(ns) / 1000.0, 'f', 1); };
+    return "Input timing over " + QString::number(stats.m_count) + " sends, handed to serial late by p50 = " + toUs(stats.m_p50)
+           + "us, p90 = " + toUs(stats.m_p90) + "us, p99 = " + toUs(stats.m_p99) + "us, max = " + toUs(stats.m_max) + "us";
+}
@@ -0,0 +1,20 @@
+#ifndef COMMANDPLAYER_H
+#define COMMANDPLAYER_H
+
+#include <atomic>
+
+#include "Helpers/commandcompiler.h"
+#include "Helpers/inputscheduler.h"
+
+// Plays a compiled command through the input scheduler, used by RunCommand and the command line runner
+namespace CommandPlayer
+{
+    // blocks until the last step is released or terminate is set, returns false if terminated,
+    // pending steps of source are cancelled either way, stats cover the sends of this call
+    bool Play(InputScheduler* scheduler, quintptr source, CommandCompiler::Interpreter& interpreter, std::atomic_bool const& terminate, InputScheduler::Stats& stats);
+
+    // one line summary of the stats for the log, empty if nothing was sent
+    QString FormatStats(InputScheduler::Stats const& stats);
+};
+
+#endif // COMMANDPLAYER_H
@@ -0,0 +1,120 @@
+#include "frameanalysis.h"
+
+#define SET_BIT(var,pos) (var |= (1U << pos))
+#define CLEAR_BIT(var,pos) (var &= ~(1U << pos))
+#define COLOR_MATCH_THRESHOLD 10
+
+namespace FrameAnalysis
+{
+
+QImage ScaleToCapture(const QImage &frame)
+{
+    QSize const captureRes = GetCaptureResolution();
+    return (frame.size() == captureRes) ? frame.copy() : frame.scaled(captureRes);
+}
+
+bool GetColorMatch(QColor testColor, QColor target)
+{
+    int const r = target.red() - testColor.red();
+    int const g = target.green() - testColor.green();
+    int const b = target.blue() - testColor.blue();
+    return r*r + g*g + b*b <= COLOR_MATCH_THRESHOLD * COLOR_MATCH_THRESHOLD;
+}
+
+bool GetColorMatchHSV(QColor testColor, HsvRange range)
+{
+    testColor = testColor.toHsv();
+
+    // Test value and saturation first
+    bool matched = testColor.value() >= range.min().value() && testColor.value() <= range.max().value()
+                   && testColor.hsvSaturation() >= range.min().hsvSaturation() && testColor.hsvSaturation() <= range.max().hsvSaturation();
+
+    // For achromatic colors it should be filltered in saturation and value
+    if (matched && testColor.hsvHue() != -1)
+    {
+        int const h = testColor.hsvHue();
+        int const h0 = range.min().hsvHue();
+        int const h1 = range.max().hsvHue();
+
+        if (h0 > h1)
+        {
+            // 0-----------------359
+            //     ^max     ^min
+            //    <---        --->
+            matched &= (h >= h0 || h <= h1);
+        }
+        else
+        {
+            // 0-----------------359
+            //     ^max     ^min
+            //       ---> <---
+            matched &= (h >= h0 && h <= h1);
+        }
+    }
+
+    return matched;
+}
+
+QColor GetAverageColor(const QImage &image)
+{
+    qreal r = 0;
+    qreal g = 0;
+    qreal b = 0;
+    for (int y = 0; y < image.height(); y++)
+    {
+        QRgb const* rowData = (QRgb*)image.scanLine(y);
+        for (int x = 0; x < image.width(); x++)
+        {
+            QColor const color = QColor::fromRgb(rowData[x]);
+            r += color.redF();
+            g += color.greenF();
+            b += color.blueF();
+        }
+    }
+
+    qreal const pixelCount = image.height() * image.width();
+    r /= pixelCount;
+    g /= pixelCount;
+    b /= pixelCount;
+
+    QColor testColor;
+    testColor.setRgbF(r,g,b);
+    return testColor;
+}
+
+qreal GetBrightnessMean(const QImage &image, HsvRange range, QImage *masked)
+{
+    if (masked)
+    {
+        *masked = QImage(image.size(), QImage::Format_MonoLSB);
+        masked->setColorTable({0xFF000000,0xFFFFFFFF});
+    }
+
+    double mean = 0;
+
+    for (int y = 0; y < image.height(); y++)
+    {
+        QRgb const* rowData = (QRgb*)image.scanLine(y);
+        uint8_t *rowMaskedData = masked ? (uint8_t*)masked->scanLine(y) : Q_NULLPTR;
+        for (int x = 0; x < image.width(); x++)
+        {
+            // Mask the target color
+            bool matched = GetColorMatchHSV(QColor::fromRgb(rowData[x]), range);
+            if (matched)
+            {
+                mean += 1;
+            }
+
+            if (rowMaskedData)
+            {
+                matched ? SET_BIT(rowMaskedData[x / 8], x % 8) : CLEAR_BIT(rowMaskedData[x / 8], x % 8);
+            }
+        }
+    }
+
+    // Get average value of brightness
+    mean /= (image.height() * image.width());
+    return mean;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef FRAMEANALYSIS_H
+#define FRAMEANALYSIS_H
+
+#include <qcolor.h>
+#include <qimage.h>
+#include <qsize.h>
+
+struct HsvRange
+{
+    HsvRange()
+    {
+        m_minHSV.setHsv(0,0,0);
+        m_maxHSV.setHsv(359,255,255);
+    }
+    HsvRange(int minH, int minS, int minV, int maxH, int maxS, int maxV)
+    {
+        m_minHSV.setHsv(minH,minS,minV);
+        m_maxHSV.setHsv(maxH,maxS,maxV);
+    }
+    HsvRange(QColor minHSV, QColor maxHSV)
+    {
+        Q_ASSERT(minHSV.spec() == QColor::Hsv);
+        Q_ASSERT(maxHSV.spec() == QColor::Hsv);
+        m_minHSV = minHSV;
+        m_maxHSV = maxHSV;
+    }
+
+    QColor min() const {return m_minHSV;}
+    QColor max() const {return m_maxHSV;}
+
+private:
+    QColor m_minHSV;
+    QColor m_maxHSV;
+};
+
+// Pixel analysis used by CaptureHolder and VideoManager, no managers involved so it can run anywhere
+namespace FrameAnalysis
+{
+    inline QSize GetCaptureResolution() { return QSize(1280,720); }
+
+    // captured frames are scaled to capture resolution before analysis
+    QImage ScaleToCapture(QImage const& frame);
+
+    bool GetColorMatch(QColor testColor, QColor target);
+    bool GetColorMatchHSV(QColor testColor, HsvRange range);
+    QColor GetAverageColor(QImage const& image);
+    qreal GetBrightnessMean(QImage const& image, HsvRange range, QImage* masked = Q_NULLPTR);
+}
+
+#endif // FRAMEANALYSIS_H
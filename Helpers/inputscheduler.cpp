@@ -0,0 +1,204 @@
+#include "inputscheduler.h"
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+#include "Helpers/sessioncontext.h"
+#include "Helpers/tracer.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+// OS sleep is only trusted to wake up this close to the deadline, spin the rest
+#define INPUT_SCHEDULER_SPIN_NS     2000000
+#define INPUT_SCHEDULER_SAMPLES     4096
+
+InputScheduler::InputScheduler(QObject *parent)
+    : QThread{parent}
+{
+    m_samples.resize(INPUT_SCHEDULER_SAMPLES);
+
+    QString const session = Metrics::SessionLabel();
+    m_metricLateness = Metrics::GetHistogram("ac2_input_submit_lateness_seconds", "How late each scheduled controller state was handed to the serial thread (command step jitter)", Metrics::LatencyBounds(), 1e-9, session);
+    m_metricSends = Metrics::GetCounter("ac2_input_sends_total", "Controller states sent by the input scheduler", session);
+
+    SessionContext::AttachThread(this);
+    this->start(QThread::TimeCriticalPriority);
+}
+
+InputScheduler::~InputScheduler()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_terminate = true;
+        m_condition.wakeAll();
+    }
+    this->wait();
+}
+
+qint64 InputScheduler::Now()
+{
+    static QElapsedTimer const timer = []
+    {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return timer.nsecsElapsed();
+}
+
+void InputScheduler::Submit(quintptr source, qint64 deadline, quint32 buttonFlag, QPointF lStick, QPointF rStick)
+{
+    Event event;
+    event.m_source = source;
+    event.m_buttonFlag = buttonFlag;
+    event.m_lStick = lStick;
+    event.m_rStick = rStick;
+
+    QMutexLocker locker(&m_mutex);
+    event.m_id = m_nextID++;
+    m_events.insert(deadline, event);
+    m_pending[source]++;
+    m_condition.wakeAll();
+}
+
+void InputScheduler::Cancel(quintptr source)
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_events.begin(); it != m_events.end();)
+    {
+        it = (it->m_source == source) ? m_events.erase(it) : std::next(it);
+    }
+    m_pending.remove(source);
+    m_condition.wakeAll();
+    m_sentCondition.wakeAll();
+}
+
+bool InputScheduler::WaitForPending(quintptr source, int maxPending, unsigned long timeoutMs)
+{
+    QDeadlineTimer const deadline(timeoutMs);
+
+    QMutexLocker locker(&m_mutex);
+    while (m_pending.value(source) > maxPending)
+    {
+        if (!m_sentCondition.wait(&m_mutex, deadline))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+quint64 InputScheduler::GetSampleCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_sampleCount;
+}
+
+InputScheduler::Stats InputScheduler::GetStats(quint64 sinceCount) const
+{
+    QVector<qint64> samples;
+    {
+        QMutexLocker locker(&m_mutex);
+        quint64 const size = quint64(m_samples.size());
+        quint64 const first = qMax(sinceCount, m_sampleCount > size ? m_sampleCount - size : 0);
+        samples.reserve(int(m_sampleCount - qMin(first, m_sampleCount)));
+        for (quint64 i = first; i < m_sampleCount; i++)
+        {
+            samples.push_back(m_samples[int(i % size)]);
+        }
+    }
+
+    Stats stats;
+    if (samples.isEmpty()) return stats;
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](int p)
+    {
+        return samples[qMin(int(samples.size()) - 1, int(samples.size()) * p / 100)];
+    };
+
+    qint64 total = 0;
+    for (qint64 sample : samples)
+    {
+        total += sample;
+    }
+
+    stats.m_count = quint64(samples.size());
+    stats.m_mean = total / samples.size();
+    stats.m_p50 = percentile(50);
+    stats.m_p90 = percentile(90);
+    stats.m_p99 = percentile(99);
+    stats.m_max = samples.back();
+    return stats;
+}
+
+void InputScheduler::run()
+{
+#ifdef Q_OS_WIN
+    // 1ms sleep granularity instead of the default ~15.6ms
+    timeBeginPeriod(1);
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    while (!m_terminate)
+    {
+        if (m_events.isEmpty())
+        {
+            m_condition.wait(&m_mutex);
+            continue;
+        }
+
+        qint64 const deadline = m_events.firstKey();
+        quint64 const id = m_events.first().m_id;
+        qint64 const remaining = deadline - Now();
+        if (remaining > INPUT_SCHEDULER_SPIN_NS)
+        {
+            // sleep most of the way, new earlier events and cancels wake us up
+            m_condition.wait(&m_mutex, (remaining - INPUT_SCHEDULER_SPIN_NS) / 1000000);
+            continue;
+        }
+
+        locker.unlock();
+        while (Now() < deadline)
+        {
+            QThread::yieldCurrentThread();
+        }
+        locker.relock();
+
+        // cancelled or something earlier came in while spinning
+        if (m_events.isEmpty() || m_events.first().m_id != id)
+        {
+            continue;
+        }
+
+        Event const event = m_events.first();
+        m_events.erase(m_events.begin());
+
+        qint64 const sendTime = Now();
+        {
+            TRACE_SCOPE("input", "InputScheduler send");
+            emit notifyButton(event.m_buttonFlag, event.m_lStick, event.m_rStick, deadline);
+        }
+
+        m_samples[int(m_sampleCount % quint64(m_samples.size()))] = sendTime - deadline;
+        m_sampleCount++;
+        m_metricLateness->Observe(sendTime - deadline);
+        m_metricSends->Add();
+
+        int& pending = m_pending[event.m_source];
+        if (--pending <= 0)
+        {
+            m_pending.remove(event.m_source);
+        }
+        m_sentCondition.wakeAll();
+    }
+
+#ifdef Q_OS_WIN
+    timeEndPeriod(1);
+#endif
+}
@@ -0,0 +1,83 @@
+#ifndef INPUTSCHEDULER_H
+#define INPUTSCHEDULER_H
+
+#include <QHash>
+#include <QMultiMap>
+#include <QMutex>
+#include <QPointF>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "Helpers/metrics.h"
+
+// Sends controller states at absolute deadlines, sleeps until close then spins the rest
+class InputScheduler : public QThread
+{
+    Q_OBJECT
+
+public:
+    // lateness of each hand-off to notifyButton (actual - target) in nanoseconds,
+    // the serial write comes after that, SerialHolder measures it against the same deadline
+    struct Stats
+    {
+        quint64 m_count = 0;
+        qint64  m_mean = 0;
+        qint64  m_p50 = 0;
+        qint64  m_p90 = 0;
+        qint64  m_p99 = 0;
+        qint64  m_max = 0;
+    };
+
+public:
+    explicit InputScheduler(QObject *parent = nullptr);
+    ~InputScheduler();
+
+    // monotonic nanoseconds, all deadlines use this clock
+    static qint64 Now();
+
+    void Submit(quintptr source, qint64 deadline, quint32 buttonFlag, QPointF lStick = QPointF(), QPointF rStick = QPointF());
+    void Cancel(quintptr source);
+
+    // true when no more than maxPending events of source are waiting
+    bool WaitForPending(quintptr source, int maxPending, unsigned long timeoutMs);
+
+    quint64 GetSampleCount() const;
+    Stats GetStats(quint64 sinceCount = 0) const;
+
+signals:
+    // emitted from scheduler thread at the deadline
+    void notifyButton(quint32 buttonFlag, QPointF lStick = QPointF(), QPointF rStick = QPointF(), qint64 deadline = 0);
+
+protected:
+    // from QThread
+    void run() override;
+
+private: // types
+    struct Event
+    {
+        quint64 m_id = 0;
+        quintptr m_source = 0;
+        quint32 m_buttonFlag = 0;
+        QPointF m_lStick;
+        QPointF m_rStick;
+    };
+
+private:
+    mutable QMutex  m_mutex;
+    QWaitCondition  m_condition;        // wakes scheduler thread
+    QWaitCondition  m_sentCondition;    // wakes WaitForPending()
+    bool            m_terminate = false;
+
+    QMultiMap<qint64, Event>    m_events;
+    QHash<quintptr, int>        m_pending;
+    quint64                     m_nextID = 0;
+
+    // lateness ring
+    QVector<qint64> m_samples;
+    quint64         m_sampleCount = 0;
+
+    MetricHistogram*    m_metricLateness = Q_NULLPTR;
+    MetricCounter*      m_metricSends = Q_NULLPTR;
+};
+
+#endif // INPUTSCHEDULER_H
@@ -1,5 +1,10 @@
 #include "jsonhelper.h"
 
+#include <QSaveFile>
+
+#include "Helpers/sessioncontext.h"
+#include "Helpers/settingsstore.h"
+
 QJsonObject JsonHelper::ReadJson(const QString &path)
 {
     QFile file(path);
@@ -20,25 +25,27 @@ void JsonHelper::WriteJson(const QString &path, QJsonObject &object)
 {
     QJsonDocument doc(object);
 
-    QFile file(path);
-    if (file.open(QFile::WriteOnly | QFile::Text | QFile::Truncate))
+    QSaveFile file(path);
+    if (file.open(QFile::WriteOnly | QFile::Text))
     {
         file.write(doc.toJson());
-        file.close();
+        file.commit();
     }
 }
 
 QJsonObject JsonHelper::ReadSetting(const QString &key)
 {
-    QJsonObject settings = ReadJson(SETTINGS_FILE);
-    return ReadObject(settings, key);
+    return SettingsStore::GetInstance()->Read(SessionContext::GetSettingKey(key));
 }
 
 void JsonHelper::WriteSetting(const QString &key, QJsonObject &object)
 {
-    QJsonObject settings = ReadJson(SETTINGS_FILE);
-    settings.insert(key, object);
-    WriteJson(SETTINGS_FILE, settings);
+    SettingsStore::GetInstance()->Write(SessionContext::GetSettingKey(key), object);
+}
+
+void JsonHelper::FlushSettings()
+{
+    SettingsStore::GetInstance()->Flush();
 }
 
 QJsonObject JsonHelper::ReadObject(const QJsonObject &object, const QString &key)
@@ -12,8 +12,11 @@ namespace JsonHelper
     QJsonObject ReadJson(QString const& path);
     void WriteJson(QString const& path, QJsonObject& object);
 
+    // served from SettingsStore, the file is parsed once and written shortly after the last change
+    // keys are per session, session 0 uses the key as is
     QJsonObject ReadSetting(QString const& key);
     void WriteSetting(QString const& key, QJsonObject& object);
+    void FlushSettings();
 
     QJsonObject ReadObject(QJsonObject const& object, QString const& key);
     bool ReadValue(QJsonObject const& object, QString const& key, QVariant& value, QVariant defaultValue = QVariant());
@@ -0,0 +1,116 @@
+#include "linkhealth.h"
+
+#include <QStringList>
+
+#include <algorithm>
+
+#define LINK_HEALTH_WINDOW 1024
+
+// upper bound of each bucket in microseconds, last bucket takes everything above
+static const qint64 c_bucketLimits[LinkHealth::HistogramBuckets - 1] =
+{
+    500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000
+};
+
+LinkHealth::LinkHealth()
+{
+    m_rtts.reserve(LINK_HEALTH_WINDOW);
+}
+
+void LinkHealth::Reset(qint64 time)
+{
+    m_snapshot = Snapshot();
+    m_rtts.clear();
+    m_rttCount = 0;
+    m_txBytes = 0;
+    m_rxBytes = 0;
+    m_rateTime = time;
+}
+
+void LinkHealth::AddRtt(qint64 rtt)
+{
+    m_snapshot.m_acked++;
+
+    if (m_rtts.size() < LINK_HEALTH_WINDOW)
+    {
+        m_rtts.push_back(rtt);
+    }
+    else
+    {
+        m_rtts[int(m_rttCount % LINK_HEALTH_WINDOW)] = rtt;
+    }
+    m_rttCount++;
+
+    int bucket = 0;
+    while (bucket < HistogramBuckets - 1 && rtt / 1000 >= c_bucketLimits[bucket])
+    {
+        bucket++;
+    }
+    m_snapshot.m_histogram[bucket]++;
+}
+
+LinkHealth::Snapshot LinkHealth::TakeSnapshot(qint64 time)
+{
+    Snapshot snapshot = m_snapshot;
+
+    if (!m_rtts.isEmpty())
+    {
+        QVector<qint64> sorted = m_rtts;
+        std::sort(sorted.begin(), sorted.end());
+        snapshot.m_rttP50 = sorted[sorted.size() / 2];
+        snapshot.m_rttP99 = sorted[qMin(int(sorted.size()) - 1, int(sorted.size()) * 99 / 100)];
+        snapshot.m_rttMax = sorted.back();
+    }
+
+    if (snapshot.m_sent > 0)
+    {
+        snapshot.m_lossRate = qreal(snapshot.m_lost) / qreal(snapshot.m_sent);
+    }
+
+    qint64 const elapsed = time - m_rateTime;
+    if (elapsed > 0)
+    {
+        snapshot.m_txRate = qreal(m_txBytes) * 1e9 / qreal(elapsed);
+        snapshot.m_rxRate = qreal(m_rxBytes) * 1e9 / qreal(elapsed);
+    }
+    m_txBytes = 0;
+    m_rxBytes = 0;
+    m_rateTime = time;
+
+    return snapshot;
+}
+
+QString LinkHealth::HistogramBucketName(int bucket)
+{
+    auto toMs = [](qint64 us) { return QString::number(qreal(us) / 1000.0); };
+    if (bucket < HistogramBuckets - 1)
+    {
+        return "<" + toMs(c_bucketLimits[bucket]) + "ms";
+    }
+    return ">=" + toMs(c_bucketLimits[HistogramBuckets - 2]) + "ms";
+}
+
+QString LinkHealth::ToString(const Snapshot &snapshot, bool withHistogram)
+{
+    auto toMs = [](qint64 ns) { return QString::number(qreal(ns) / 1000000.0, 'f', 2); };
+
+    QString str = "RTT p50 = " + toMs(snapshot.m_rttP50) + "ms";
+    str += ", p99 = " + toMs(snapshot.m_rttP99) + "ms";
+    str += ", max = " + toMs(snapshot.m_rttMax) + "ms";
+    str += ", sent = " + QString::number(snapshot.m_sent);
+    str += ", lost = " + QString::number(snapshot.m_lost) + " (" + QString::number(snapshot.m_lossRate * 100.0, 'f', 2) + "%)";
+    str += ", garbled = " + QString::number(snapshot.m_garbled);
+    str += ", tx = " + QString::number(snapshot.m_txRate, 'f', 0) + "B/s";
+    str += ", rx = " + QString::number(snapshot.m_rxRate, 'f', 0) + "B/s";
+
+    if (withHistogram)
+    {
+        QStringList buckets;
+        for (int i = 0; i < HistogramBuckets; i++)
+        {
+            buckets << HistogramBucketName(i) + ": " + QString::number(snapshot.m_histogram[i]);
+        }
+        str += "\nRTT histogram: " + buckets.join(", ");
+    }
+    return str;
+}
@@ -0,0 +1,61 @@
+#ifndef LINKHEALTH_H
+#define LINKHEALTH_H
+
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+// Serial link round trip and loss statistics, owned by the serial thread
+class LinkHealth
+{
+public:
+    enum : int
+    {
+        HistogramBuckets = 10,
+    };
+
+    struct Snapshot
+    {
+        quint64 m_sent = 0;         // packets that expect an echo/ACK
+        quint64 m_acked = 0;
+        quint64 m_lost = 0;         // no echo in time (v1) or a go-back-N resend (v2)
+        quint64 m_garbled = 0;      // unexpected bytes, bad CRC either way
+        qint64  m_rttP50 = 0;       // nanoseconds, over the rolling window
+        qint64  m_rttP99 = 0;
+        qint64  m_rttMax = 0;
+        qreal   m_lossRate = 0.0;   // 0 to 1, since connect
+        qreal   m_txRate = 0.0;     // bytes per second since last snapshot
+        qreal   m_rxRate = 0.0;
+        quint64 m_histogram[HistogramBuckets] = {};
+    };
+
+public:
+    LinkHealth();
+
+    void Reset(qint64 time);
+
+    void AddSent(quint64 count = 1) { m_snapshot.m_sent += count; }
+    void AddRtt(qint64 rtt);
+    void AddLost(quint64 count = 1) { m_snapshot.m_lost += count; }
+    void AddGarbled(quint64 count = 1) { m_snapshot.m_garbled += count; }
+    void AddTxBytes(qint64 bytes) { m_txBytes += bytes; }
+    void AddRxBytes(qint64 bytes) { m_rxBytes += bytes; }
+
+    // percentiles and byte rates are computed here, rates restart from this time
+    Snapshot TakeSnapshot(qint64 time);
+
+    static QString HistogramBucketName(int bucket);
+    static QString ToString(Snapshot const& snapshot, bool withHistogram = false);
+
+private:
+    Snapshot        m_snapshot;
+    QVector<qint64> m_rtts;         // rolling window
+    quint64         m_rttCount = 0;
+    qint64          m_txBytes = 0;
+    qint64          m_rxBytes = 0;
+    qint64          m_rateTime = 0;
+};
+
+Q_DECLARE_METATYPE(LinkHealth::Snapshot)
+
+#endif // LINKHEALTH_H
@@ -0,0 +1,340 @@
+#include "logwriter.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+
+#include "Helpers/sessioncontext.h"
+
+#define LOG_WRITER_BATCH_MS         20
+#define LOG_WRITER_FLUSH_MS         1000
+#define LOG_WRITER_BUFFER_SIZE      65536
+#define LOG_WRITER_MAX_LINES        1000    // pending for the log window
+
+QMutex LogWriter::s_openMutex;
+QSet<QString> LogWriter::s_openFiles;
+
+LogWriter::LogWriter(QObject *parent)
+    : QThread{parent}
+{
+    m_fileBuffer.reserve(LOG_WRITER_BUFFER_SIZE);
+    SessionContext::AttachThread(this);
+    this->start(QThread::LowPriority);
+}
+
+LogWriter::~LogWriter()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_terminate = true;
+        m_condition.wakeAll();
+    }
+    this->wait();
+}
+
+void LogWriter::Push(const QString &category, const QString &log, LogType type)
+{
+    Record record;
+    record.m_time = QDateTime::currentMSecsSinceEpoch();
+    record.m_type = type;
+    record.m_category = category;
+    record.m_log = log;
+
+    if (!m_queue.Push(record))
+    {
+        m_dropped++;
+        m_droppedTotal++;
+    }
+}
+
+void LogWriter::SetFile(const QString &file)
+{
+    // goes through the queue so every record lands in the file that was current when it was logged
+    Record record;
+    record.m_isFile = true;
+    record.m_log = file;
+    while (!m_queue.Push(record))
+    {
+        QThread::msleep(1);
+    }
+}
+
+void LogWriter::SetRotation(const Rotation &rotation)
+{
+    QMutexLocker locker(&m_mutex);
+    m_rotation = rotation;
+}
+
+QStringList LogWriter::TakeLines(int &skipped)
+{
+    QMutexLocker locker(&m_linesMutex);
+    skipped = m_linesSkipped;
+    m_linesSkipped = 0;
+
+    QStringList lines;
+    lines.swap(m_lines);
+    return lines;
+}
+
+void LogWriter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    while (true)
+    {
+        bool terminate = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_terminate)
+            {
+                m_condition.wait(&m_mutex, LOG_WRITER_BATCH_MS);
+            }
+            terminate = m_terminate;
+        }
+
+        WriteBatch();
+
+        // the buffer is written out when full, the file is flushed periodically so a crash loses at most this much
+        if (m_file.isOpen() && (terminate || timer.elapsed() - m_lastFlush >= LOG_WRITER_FLUSH_MS))
+        {
+            m_file.write(m_fileBuffer);
+            m_file.flush();
+            m_fileBuffer.clear();
+            m_lastFlush = timer.elapsed();
+        }
+
+        if (terminate) break;
+    }
+
+    CloseSegment(false);
+}
+
+void LogWriter::WriteBatch()
+{
+    Record record;
+    while (m_queue.Pop(record))
+    {
+        if (record.m_isFile)
+        {
+            SwitchFile(record.m_log);
+        }
+        else
+        {
+            Write(record);
+        }
+    }
+
+    quint32 const dropped = m_dropped.exchange(0);
+    if (dropped > 0)
+    {
+        record.m_time = QDateTime::currentMSecsSinceEpoch();
+        record.m_type = LOG_Warning;
+        record.m_category = "Global";
+        record.m_log = QString::number(dropped) + " log message(s) dropped, logging faster than they can be written";
+        Write(record);
+    }
+}
+
+void LogWriter::Write(const Record &record)
+{
+    QString const header = QDateTime::fromMSecsSinceEpoch(record.m_time).toString("yyyy-MM-dd hh:mm:ss.zzz") + " - [" + record.m_category + "]";
+    QColor const color = LogTypeToColor(record.m_type);
+    QString r,g,b;
+    r.setNum(color.red(), 16); if (color.red() < 0x10) r = "0" + r;
+    g.setNum(color.green(), 16); if (color.green() < 0x10) g = "0" + g;
+    b.setNum(color.blue(), 16); if (color.blue() < 0x10) b = "0" + b;
+    QString const html = "<font color=\"#FF" + r + g + b + "\">" + header + " " + record.m_log + "</font>";
+
+    {
+        QMutexLocker locker(&m_linesMutex);
+        m_lines.push_back(html);
+        if (m_lines.size() > LOG_WRITER_MAX_LINES)
+        {
+            m_lines.pop_front();
+            m_linesSkipped++;
+        }
+    }
+
+    if (m_file.isOpen())
+    {
+        QByteArray const line = (header + LogTypeDisplayText(record.m_type) + " " + record.m_log + "\n").toUtf8();
+        m_fileBuffer += line;
+        m_segmentSize += line.size();
+        if (m_fileBuffer.size() >= LOG_WRITER_BUFFER_SIZE)
+        {
+            m_file.write(m_fileBuffer);
+            m_fileBuffer.clear();
+        }
+
+        if (m_segmentSize >= m_segmentRotation.m_maxSegmentBytes || record.m_time - m_segmentStart >= m_segmentRotation.m_maxSegmentSecs * 1000)
+        {
+            CloseSegment(true);
+            m_segmentIndex++;
+            OpenSegment();
+        }
+    }
+}
+
+void LogWriter::SwitchFile(const QString &fileName)
+{
+    // the last segment of a run is left uncompressed so it's easy to read
+    CloseSegment(false);
+
+    m_segmentBase = fileName.endsWith(".log") ? fileName.chopped(4) : fileName;
+    m_segmentIndex = 0;
+    if (!fileName.isEmpty())
+    {
+        OpenSegment();
+    }
+}
+
+void LogWriter::OpenSegment()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_segmentRotation = m_rotation;
+    }
+
+    // Program_20250101_120000.log, Program_20250101_120000_001.log...
+    QString const fileName = m_segmentBase + (m_segmentIndex > 0 ? QString("_%1").arg(m_segmentIndex, 3, 10, QChar('0')) : QString()) + ".log";
+    m_file.setFileName(fileName);
+    if (m_file.open(QIODevice::Append))
+    {
+        m_segmentSize = m_file.size();
+        m_segmentStart = QDateTime::currentMSecsSinceEpoch();
+
+        QMutexLocker locker(&s_openMutex);
+        s_openFiles.insert(QFileInfo(fileName).absoluteFilePath());
+    }
+
+    if (m_segmentIndex == 0)
+    {
+        QString const directory = QFileInfo(fileName).absolutePath();
+        Rotation const rotation = m_segmentRotation;
+        (void)QtConcurrent::run([directory, rotation]{ ApplyRetention(directory, rotation); });
+    }
+}
+
+void LogWriter::CloseSegment(bool archive)
+{
+    if (!m_file.isOpen()) return;
+
+    m_file.write(m_fileBuffer);
+    m_file.close();
+    m_fileBuffer.clear();
+
+    {
+        QMutexLocker locker(&s_openMutex);
+        s_openFiles.remove(QFileInfo(m_file.fileName()).absoluteFilePath());
+    }
+
+    if (archive)
+    {
+        QString const fileName = m_file.fileName();
+        Rotation const rotation = m_segmentRotation;
+        (void)QtConcurrent::run([fileName, rotation]{ ArchiveSegment(fileName, rotation); });
+    }
+}
+
+void LogWriter::ArchiveSegment(const QString &fileName, const Rotation &rotation)
+{
+    if (CompressFile(fileName))
+    {
+        QFile::remove(fileName);
+    }
+    ApplyRetention(QFileInfo(fileName).absolutePath(), rotation);
+}
+
+bool LogWriter::CompressFile(const QString &fileName)
+{
+    static quint32 const* table = []
+    {
+        static quint32 crcTable[256];
+        for (quint32 i = 0; i < 256; i++)
+        {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+            }
+            crcTable[i] = c;
+        }
+        return crcTable;
+    }();
+
+    QFile input(fileName);
+    if (!input.open(QIODevice::ReadOnly)) return false;
+    QByteArray const data = input.readAll();
+    input.close();
+
+    // qCompress gives [size x4][zlib header x2][deflate][adler32 x4], gzip wraps the same deflate stream
+    QByteArray const zlib = qCompress(data, 9);
+    if (zlib.size() < 10) return false;
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (char const c : data)
+    {
+        crc = table[(crc ^ quint8(c)) & 0xFF] ^ (crc >> 8);
+    }
+    crc ^= 0xFFFFFFFFu;
+
+    auto appendLE = [](QByteArray& bytes, quint32 value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            bytes.append(char((value >> (8 * i)) & 0xFF));
+        }
+    };
+
+    QByteArray gzip;
+    gzip.reserve(zlib.size() + 12);
+    gzip.append("\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\xff", 10);
+    gzip.append(zlib.constData() + 6, zlib.size() - 10);
+    appendLE(gzip, crc);
+    appendLE(gzip, quint32(data.size()));
+
+    // written to a temporary name first so a crash never leaves a truncated archive
+    QString const archiveName = fileName + ".gz";
+    QFile output(archiveName + ".tmp");
+    if (!output.open(QIODevice::WriteOnly) || output.write(gzip) != gzip.size())
+    {
+        output.remove();
+        return false;
+    }
+    output.close();
+
+    QFile::remove(archiveName);
+    return output.rename(archiveName);
+}
+
+void LogWriter::ApplyRetention(const QString &directory, const Rotation &rotation)
+{
+    QFileInfoList const files = QDir(directory).entryInfoList({"*.log", "*.log.gz"}, QDir::Files, QDir::Time);
+    QDateTime const now = QDateTime::currentDateTime();
+    QDateTime const cutoff = now.addDays(-rotation.m_keepDays);
+
+    // a .log written to within the last rotation period may be another instance's open segment
+    QDateTime const idle = now.addSecs(-rotation.m_maxSegmentSecs);
+
+    QSet<QString> openFiles;
+    {
+        QMutexLocker locker(&s_openMutex);
+        openFiles = s_openFiles;
+    }
+
+    // newest first, open segments still count towards the total
+    qint64 total = 0;
+    for (QFileInfo const& info : files)
+    {
+        total += info.size();
+        if (openFiles.contains(info.absoluteFilePath())) continue;
+        if (info.suffix() == "log" && info.lastModified() >= idle) continue;
+
+        if (info.lastModified() < cutoff || total > rotation.m_maxTotalBytes)
+        {
+            QFile::remove(info.absoluteFilePath());
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QFile>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+#include "Helpers/mpscqueue.h"
+#include "Types/system.h"
+
+// Producers push log records without locking, a writer thread formats them in batches,
+// writes them to the current log file and queues html lines for the log window
+// Log files are split into segments, closed segments are gzipped in the background
+class LogWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Rotation
+    {
+        qint64  m_maxSegmentBytes = 16 * 1024 * 1024;
+        qint64  m_maxSegmentSecs = 24 * 3600;
+        int     m_keepDays = 30;                            // older logs in the same directory are deleted, never open ones
+        qint64  m_maxTotalBytes = 1024LL * 1024 * 1024;     // then the oldest until under this
+    };
+
+public:
+    explicit LogWriter(QObject *parent = nullptr);
+    ~LogWriter();
+
+    // any thread, the record is counted as dropped if the queue is full
+    void Push(QString const& category, QString const& log, LogType type);
+
+    // any thread, empty to stop writing to file
+    void SetFile(QString const& file);
+    void SetRotation(Rotation const& rotation);
+
+    // html lines since the last call, oldest lines are skipped if the window fell behind
+    QStringList TakeLines(int& skipped);
+
+    quint64 GetDroppedCount() const { return m_droppedTotal; }
+
+protected:
+    // from QThread
+    void run() override;
+
+private: // types
+    struct Record
+    {
+        qint64      m_time = 0;     // ms since epoch
+        LogType     m_type = LOG_Normal;
+        QString     m_category;
+        QString     m_log;          // file name if m_isFile
+        bool        m_isFile = false;
+    };
+
+private:
+    void WriteBatch();
+    void Write(Record const& record);
+    void SwitchFile(QString const& fileName);
+    void OpenSegment();
+    void CloseSegment(bool archive);
+
+    // run on the global thread pool
+    static void ArchiveSegment(QString const& fileName, Rotation const& rotation);
+    static bool CompressFile(QString const& fileName);
+    static void ApplyRetention(QString const& directory, Rotation const& rotation);
+
+private:
+    // segments open in any session of this process, retention never deletes them
+    static QMutex           s_openMutex;
+    static QSet<QString>    s_openFiles;
+
+private:
+    MpscQueue<Record, 4096>     m_queue;
+    std::atomic<quint32>        m_dropped = 0;
+    std::atomic<quint64>        m_droppedTotal = 0;
+
+    QMutex          m_mutex;
+    QWaitCondition  m_condition;
+    bool            m_terminate = false;
+    Rotation        m_rotation;
+
+    // writer thread only
+    QFile           m_file;
+    QByteArray      m_fileBuffer;
+    qint64          m_lastFlush = 0;
+    QString         m_segmentBase;      // file name without .log
+    int             m_segmentIndex = 0;
+    qint64          m_segmentSize = 0;
+    qint64          m_segmentStart = 0; // ms since epoch
+    Rotation        m_segmentRotation;
+
+    QMutex          m_linesMutex;
+    QStringList     m_lines;
+    int             m_linesSkipped = 0;
+};
+
+#endif // LOGWRITER_H
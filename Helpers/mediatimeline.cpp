@@ -0,0 +1,98 @@
+#include "mediatimeline.h"
+
+#include <vlc/vlc.h>
+
+#include "Helpers/sessioncontext.h"
+
+#define MEDIA_EVENT_CAPACITY 1024
+
+MediaTimeline &MediaTimeline::instance()
+{
+    // each session has its own capture and audio, events never mix
+    static MediaTimeline timelines[SESSION_MAX_COUNT];
+    return timelines[SessionContext::Current()];
+}
+
+MediaTimeline::MediaTimeline()
+{
+    m_events.resize(MEDIA_EVENT_CAPACITY);
+}
+
+qint64 MediaTimeline::Now()
+{
+    return libvlc_clock();
+}
+
+void MediaTimeline::AddEvent(MediaStream stream, qint64 time, const QString &name, qreal value)
+{
+    MediaTimeline& timeline = instance();
+    QMutexLocker locker(&timeline.m_mutex);
+
+    MediaEvent& event = timeline.m_events[timeline.m_next];
+    event.m_stream = stream;
+    event.m_time = time;
+    event.m_name = name;
+    event.m_value = value;
+
+    timeline.m_next = (timeline.m_next + 1) % MEDIA_EVENT_CAPACITY;
+    timeline.m_count = qMin(timeline.m_count + 1, MEDIA_EVENT_CAPACITY);
+}
+
+void MediaTimeline::Clear()
+{
+    MediaTimeline& timeline = instance();
+    QMutexLocker locker(&timeline.m_mutex);
+
+    timeline.m_next = 0;
+    timeline.m_count = 0;
+}
+
+QVector<MediaEvent> MediaTimeline::GetEvents(qint64 time, int rangeMs, const QString &name)
+{
+    MediaTimeline& timeline = instance();
+    qint64 const range = MsToTime(rangeMs);
+
+    QVector<MediaEvent> events;
+    {
+        QMutexLocker locker(&timeline.m_mutex);
+
+        // audio is pushed ahead of video (pts is in the future), insert order is not time order
+        int index = (timeline.m_next - timeline.m_count + MEDIA_EVENT_CAPACITY) % MEDIA_EVENT_CAPACITY;
+        for (int i = 0; i < timeline.m_count; i++)
+        {
+            MediaEvent const& event = timeline.m_events[index];
+            if (qAbs(event.m_time - time) <= range && (name.isEmpty() || event.m_name == name))
+            {
+                events.push_back(event);
+            }
+            index = (index + 1) % MEDIA_EVENT_CAPACITY;
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](MediaEvent const& a, MediaEvent const& b)
+    {
+        return a.m_time < b.m_time;
+    });
+    return events;
+}
+
+bool MediaTimeline::GetLastEvent(const QString &name, MediaEvent &event)
+{
+    MediaTimeline& timeline = instance();
+    QMutexLocker locker(&timeline.m_mutex);
+
+    bool found = false;
+    int index = (timeline.m_next - timeline.m_count + MEDIA_EVENT_CAPACITY) % MEDIA_EVENT_CAPACITY;
+    for (int i = 0; i < timeline.m_count; i++)
+    {
+        MediaEvent const& e = timeline.m_events[index];
+        if (e.m_name == name && (!found || e.m_time >= event.m_time))
+        {
+            event = e;
+            found = true;
+        }
+        index = (index + 1) % MEDIA_EVENT_CAPACITY;
+    }
+
+    return found;
+}
@@ -0,0 +1,51 @@
+#ifndef MEDIATIMELINE_H
+#define MEDIATIMELINE_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+enum class MediaStream
+{
+    Audio,
+    Video,
+};
+
+struct MediaEvent
+{
+    MediaStream m_stream = MediaStream::Video;
+    qint64      m_time = 0;     // microseconds on the media clock
+    QString     m_name;
+    qreal       m_value = 0.0;
+};
+
+// All timestamps are on the LibVLC clock (microseconds, monotonic), audio uses the pts
+// passed to the audio callback, video uses the clock when the frame is handed over
+// One timeline per session, picked by the session of the calling thread
+class MediaTimeline
+{
+private:
+    static MediaTimeline& instance();
+    MediaTimeline();
+
+public:
+    static qint64 Now();
+    static qint64 MsToTime(qreal ms) { return qint64(ms * 1000.0); }
+    static qreal TimeToMs(qint64 time) { return qreal(time) / 1000.0; }
+
+    // events, oldest are overwritten when full
+    static void AddEvent(MediaStream stream, qint64 time, QString const& name, qreal value = 0.0);
+    static void Clear();
+
+    // events within [time - rangeMs, time + rangeMs] sorted by time, empty name matches all
+    static QVector<MediaEvent> GetEvents(qint64 time, int rangeMs, QString const& name = QString());
+    static bool GetLastEvent(QString const& name, MediaEvent& event);
+
+private:
+    QMutex              m_mutex;
+    QVector<MediaEvent> m_events;
+    int                 m_next = 0;
+    int                 m_count = 0;
+};
+
+#endif // MEDIATIMELINE_H
@@ -0,0 +1,197 @@
+#include "metrics.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+
+#include "Helpers/sessioncontext.h"
+
+MetricHistogram::MetricHistogram(const QVector<qint64> &bounds, double scale)
+    : m_bounds(bounds)
+    , m_scale(scale)
+    , m_buckets(new std::atomic<quint64>[bounds.size() + 1])
+{
+    for (int i = 0; i <= bounds.size(); i++)
+    {
+        m_buckets[i] = 0;
+    }
+}
+
+namespace
+{
+enum class MetricType
+{
+    Counter,
+    Gauge,
+    Histogram,
+};
+
+struct Callback
+{
+    QObject const*          m_owner = Q_NULLPTR;
+    std::function<double()> m_function;
+};
+
+struct Family
+{
+    QString     m_help;
+    MetricType  m_type = MetricType::Counter;
+
+    // by labels, never deleted
+    QMap<QString, MetricCounter*>   m_counters;
+    QMap<QString, MetricGauge*>     m_gauges;
+    QMap<QString, MetricHistogram*> m_histograms;
+    QMap<QString, Callback>         m_callbacks;
+};
+
+QMutex s_mutex;
+QMap<QString, Family> s_families;
+
+Family& GetFamily(QString const& name, QString const& help, MetricType type)
+{
+    auto iter = s_families.find(name);
+    if (iter == s_families.end())
+    {
+        Family family;
+        family.m_help = help;
+        family.m_type = type;
+        iter = s_families.insert(name, family);
+    }
+
+    Q_ASSERT(iter->m_type == type);
+    return iter.value();
+}
+
+QByteArray WithLabel(QString const& labels, QByteArray const& label)
+{
+    return "{" + (labels.isEmpty() ? label : labels.toUtf8() + "," + label) + "}";
+}
+
+QByteArray Labels(QString const& labels)
+{
+    return labels.isEmpty() ? QByteArray() : "{" + labels.toUtf8() + "}";
+}
+}
+
+MetricCounter *Metrics::GetCounter(const QString &name, const QString &help, const QString &labels)
+{
+    QMutexLocker locker(&s_mutex);
+    Family& family = GetFamily(name, help, MetricType::Counter);
+    MetricCounter*& counter = family.m_counters[labels];
+    if (!counter)
+    {
+        counter = new MetricCounter();
+    }
+    return counter;
+}
+
+MetricGauge *Metrics::GetGauge(const QString &name, const QString &help, const QString &labels)
+{
+    QMutexLocker locker(&s_mutex);
+    Family& family = GetFamily(name, help, MetricType::Gauge);
+    MetricGauge*& gauge = family.m_gauges[labels];
+    if (!gauge)
+    {
+        gauge = new MetricGauge();
+    }
+    return gauge;
+}
+
+MetricHistogram *Metrics::GetHistogram(const QString &name, const QString &help, const QVector<qint64> &bounds, double scale, const QString &labels)
+{
+    QMutexLocker locker(&s_mutex);
+    Family& family = GetFamily(name, help, MetricType::Histogram);
+    MetricHistogram*& histogram = family.m_histograms[labels];
+    if (!histogram)
+    {
+        histogram = new MetricHistogram(bounds, scale);
+    }
+    return histogram;
+}
+
+void Metrics::AddCallback(const QString &name, const QString &help, bool isCounter, const QString &labels, QObject *owner, std::function<double ()> callback)
+{
+    {
+        QMutexLocker locker(&s_mutex);
+        Family& family = GetFamily(name, help, isCounter ? MetricType::Counter : MetricType::Gauge);
+        family.m_callbacks.insert(labels, Callback{owner, std::move(callback)});
+    }
+
+    QObject::connect(owner, &QObject::destroyed, [name, labels, owner]
+    {
+        QMutexLocker locker(&s_mutex);
+        auto iter = s_families.find(name);
+        if (iter != s_families.end() && iter->m_callbacks.value(labels).m_owner == owner)
+        {
+            iter->m_callbacks.remove(labels);
+        }
+    });
+}
+
+QString Metrics::SessionLabel()
+{
+    return "session=\"" + QString::number(SessionContext::Current() + 1) + "\"";
+}
+
+QVector<qint64> Metrics::LatencyBounds()
+{
+    return {10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 1000000000};
+}
+
+QByteArray Metrics::Export()
+{
+    QMutexLocker locker(&s_mutex);
+
+    QByteArray text;
+    text.reserve(16384);
+    for (auto iter = s_families.cbegin(); iter != s_families.cend(); ++iter)
+    {
+        QByteArray const name = iter.key().toUtf8();
+        Family const& family = iter.value();
+
+        text += "# HELP " + name + " " + family.m_help.toUtf8() + "\n";
+        switch (family.m_type)
+        {
+        case MetricType::Counter:   text += "# TYPE " + name + " counter\n"; break;
+        case MetricType::Gauge:     text += "# TYPE " + name + " gauge\n"; break;
+        case MetricType::Histogram: text += "# TYPE " + name + " histogram\n"; break;
+        }
+
+        for (auto counter = family.m_counters.cbegin(); counter != family.m_counters.cend(); ++counter)
+        {
+            text += name + Labels(counter.key()) + " " + QByteArray::number(counter.value()->Get()) + "\n";
+        }
+
+        for (auto gauge = family.m_gauges.cbegin(); gauge != family.m_gauges.cend(); ++gauge)
+        {
+            text += name + Labels(gauge.key()) + " " + QByteArray::number(gauge.value()->Get()) + "\n";
+        }
+
+        // called on the exporting thread, must not use the registry
+        for (auto callback = family.m_callbacks.cbegin(); callback != family.m_callbacks.cend(); ++callback)
+        {
+            text += name + Labels(callback.key()) + " " + QByteArray::number(callback.value().m_function(), 'g', 12) + "\n";
+        }
+
+        for (auto histogram = family.m_histograms.cbegin(); histogram != family.m_histograms.cend(); ++histogram)
+        {
+            MetricHistogram const* h = histogram.value();
+            QVector<qint64> const& bounds = h->GetBounds();
+
+            // buckets are stored separately and exported cumulative
+            quint64 count = 0;
+            for (int i = 0; i < bounds.size(); i++)
+            {
+                count += h->GetBucket(i);
+                QByteArray const le = "le=\"" + QByteArray::number(double(bounds[i]) * h->GetScale(), 'g', 12) + "\"";
+                text += name + "_bucket" + WithLabel(histogram.key(), le) + " " + QByteArray::number(count) + "\n";
+            }
+            count += h->GetBucket(bounds.size());
+            text += name + "_bucket" + WithLabel(histogram.key(), "le=\"+Inf\"") + " " + QByteArray::number(count) + "\n";
+            text += name + "_sum" + Labels(histogram.key()) + " " + QByteArray::number(double(h->GetSum()) * h->GetScale(), 'g', 12) + "\n";
+            text += name + "_count" + Labels(histogram.key()) + " " + QByteArray::number(count) + "\n";
+        }
+    }
+
+    return text;
+}
@@ -0,0 +1,84 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class QObject;
+
+class MetricCounter
+{
+public:
+    void Add(quint64 value = 1) { m_value.fetch_add(value, std::memory_order_relaxed); }
+    quint64 Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_value = 0;
+};
+
+class MetricGauge
+{
+public:
+    void Set(qint64 value) { m_value.store(value, std::memory_order_relaxed); }
+    void Add(qint64 value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+    qint64 Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value = 0;
+};
+
+// Fixed buckets in the observed unit (e.g. nanoseconds), exported multiplied by scale (e.g. 1e-9 for seconds)
+class MetricHistogram
+{
+public:
+    MetricHistogram(QVector<qint64> const& bounds, double scale);
+
+    void Observe(qint64 value)
+    {
+        int i = 0;
+        while (i < m_bounds.size() && value > m_bounds[i]) i++;
+        m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    QVector<qint64> const& GetBounds() const { return m_bounds; }
+    double GetScale() const { return m_scale; }
+    quint64 GetBucket(int index) const { return m_buckets[index].load(std::memory_order_relaxed); }
+    qint64 GetSum() const { return m_sum.load(std::memory_order_relaxed); }
+
+private:
+    QVector<qint64>                         m_bounds;
+    double                                  m_scale;
+    std::unique_ptr<std::atomic<quint64>[]> m_buckets;  // one more than bounds for +Inf
+    std::atomic<qint64>                     m_sum = 0;
+};
+
+// Process wide registry exported in the Prometheus text format
+// Getting a metric takes a lock, keep the pointer and update it from any thread without locking
+// Metrics live until exit, getting the same name and labels again returns the same metric
+class Metrics
+{
+public:
+    // labels are preformatted, e.g. session="1",mode="area"
+    static MetricCounter* GetCounter(QString const& name, QString const& help, QString const& labels = QString());
+    static MetricGauge* GetGauge(QString const& name, QString const& help, QString const& labels = QString());
+    static MetricHistogram* GetHistogram(QString const& name, QString const& help, QVector<qint64> const& bounds, double scale, QString const& labels = QString());
+
+    // evaluated only when exported, on the exporting thread, removed when owner is destroyed
+    static void AddCallback(QString const& name, QString const& help, bool isCounter, QString const& labels, QObject* owner, std::function<double()> callback);
+
+    // label of the calling thread's session
+    static QString SessionLabel();
+
+    // latency buckets in nanoseconds from 10us to 1s
+    static QVector<qint64> LatencyBounds();
+
+    static QByteArray Export();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,119 @@
+#include "metricsexporter.h"
+
+#include <QSaveFile>
+#include <QTcpSocket>
+
+#include "Helpers/jsonhelper.h"
+#include "Helpers/metrics.h"
+
+#define METRICS_REQUEST_MAX_BYTES   8192
+#define METRICS_REQUEST_TIMEOUT_MS  2000
+
+MetricsExporter::MetricsExporter(QObject *parent)
+    : QObject{parent}
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &MetricsExporter::OnNewConnection);
+    connect(&m_fileTimer, &QTimer::timeout, this, &MetricsExporter::OnWriteFile);
+}
+
+void MetricsExporter::LoadSettings()
+{
+    QJsonObject settings = JsonHelper::ReadSetting("Metrics");
+    {
+        QVariant port;
+        if (JsonHelper::ReadValue(settings, "Port", port) && port.toInt() > 0)
+        {
+            Listen(quint16(port.toInt()));
+        }
+
+        QVariant file, interval;
+        JsonHelper::ReadValue(settings, "FileIntervalSecs", interval, 15);
+        if (JsonHelper::ReadValue(settings, "File", file) && !file.toString().isEmpty())
+        {
+            SetFile(file.toString(), interval.toInt());
+        }
+    }
+}
+
+bool MetricsExporter::Listen(quint16 port)
+{
+    // never reachable from other machines
+    m_server.close();
+    if (!m_server.listen(QHostAddress::LocalHost, port))
+    {
+        emit notifyLog("Metrics", "Failed to listen on port " + QString::number(port) + ", " + m_server.errorString(), LOG_Warning);
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::SetFile(const QString &fileName, int intervalSecs)
+{
+    m_fileName = fileName;
+    m_fileTimer.stop();
+    if (!m_fileName.isEmpty())
+    {
+        m_fileTimer.start(qMax(1, intervalSecs) * 1000);
+    }
+}
+
+void MetricsExporter::OnNewConnection()
+{
+    while (QTcpSocket* socket = m_server.nextPendingConnection())
+    {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+        // drop clients that never finish the request
+        QTimer::singleShot(METRICS_REQUEST_TIMEOUT_MS, socket, [socket] { socket->abort(); });
+
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]
+        {
+            if (socket->bytesAvailable() > METRICS_REQUEST_MAX_BYTES)
+            {
+                socket->abort();
+                return;
+            }
+
+            // wait for the whole header, only the request line matters
+            QByteArray const request = socket->peek(METRICS_REQUEST_MAX_BYTES);
+            if (!request.contains("\r\n\r\n")) return;
+            socket->readAll();
+
+            QList<QByteArray> const requestLine = request.left(request.indexOf("\r\n")).split(' ');
+            QByteArray const path = requestLine.size() >= 2 ? requestLine[1] : QByteArray();
+
+            QByteArray status = "200 OK";
+            QByteArray body;
+            if (requestLine[0] != "GET")
+            {
+                status = "405 Method Not Allowed";
+            }
+            else if (path == "/metrics" || path == "/")
+            {
+                body = Metrics::Export();
+            }
+            else
+            {
+                status = "404 Not Found";
+            }
+
+            QByteArray response = "HTTP/1.1 " + status + "\r\n";
+            response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+            response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+            response += "Connection: close\r\n\r\n";
+            socket->write(response + body);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+void MetricsExporter::OnWriteFile()
+{
+    // scrapers never see a half written file
+    QByteArray const text = Metrics::Export();
+    QSaveFile file(m_fileName);
+    if (file.open(QIODevice::WriteOnly) && file.write(text) == text.size())
+    {
+        file.commit();
+    }
+}
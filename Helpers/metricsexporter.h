@@ -0,0 +1,38 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTimer>
+
+#include "Types/system.h"
+
+// Serves Metrics::Export() on http://127.0.0.1:<Port>/metrics and/or rewrites it to a file,
+// metrics are only formatted when scraped or written
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsExporter(QObject *parent = nullptr);
+
+    // reads "Metrics" from settings, Port 0 and empty File disable the exporter
+    void LoadSettings();
+
+    bool Listen(quint16 port);
+    void SetFile(QString const& fileName, int intervalSecs);
+
+signals:
+    void notifyLog(QString const& category, QString const& log, LogType type = LOG_Normal) const;
+
+private slots:
+    void OnNewConnection();
+    void OnWriteFile();
+
+private:
+    QTcpServer  m_server;
+    QTimer      m_fileTimer;
+    QString     m_fileName;
+};
+
+#endif // METRICSEXPORTER_H
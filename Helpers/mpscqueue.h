@@ -0,0 +1,82 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <utility>
+
+// Bounded lock-free multi-producer single-consumer queue, storage is preallocated
+// each cell carries a sequence number so producers can claim slots with one CAS
+template<typename T, quint32 Capacity>
+class MpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    MpscQueue()
+    {
+        for (quint32 i = 0; i < Capacity; i++)
+        {
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // any thread, returns false if full
+    bool Push(T const& data)
+    {
+        quint32 pos = m_pushPos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = m_cells[pos & (Capacity - 1)];
+            qint32 const diff = qint32(cell.m_sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (m_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.m_data = data;
+                    cell.m_sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // consumer hasn't released this cell yet
+                return false;
+            }
+            else
+            {
+                pos = m_pushPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // consumer thread only
+    bool Pop(T& data)
+    {
+        Cell& cell = m_cells[m_popPos & (Capacity - 1)];
+        if (qint32(cell.m_sequence.load(std::memory_order_acquire) - (m_popPos + 1)) < 0)
+        {
+            return false;
+        }
+
+        // moved out so the cell doesn't keep heap data alive until it's reused
+        data = std::move(cell.m_data);
+        cell.m_sequence.store(m_popPos + Capacity, std::memory_order_release);
+        m_popPos++;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<quint32>    m_sequence;
+        T                       m_data;
+    };
+
+    Cell                            m_cells[Capacity];
+    alignas(64) std::atomic<quint32> m_pushPos = 0;
+    alignas(64) quint32             m_popPos = 0;
+};
+
+#endif // MPSCQUEUE_H
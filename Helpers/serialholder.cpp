@@ -1,9 +1,22 @@
 #include "serialholder.h"
 
-#include "Managers/managercollection.h"
-#include "Managers/logmanager.h"
+#include "Helpers/inputscheduler.h"
+#include "Helpers/sessioncontext.h"
+#include "Helpers/sessionrecorder.h"
+#include "Helpers/tracer.h"
 #include "defines.h"
 
+#define SERIAL_V2_WINDOW            8
+#define SERIAL_V2_RETRANSMIT_MS     50
+#define SERIAL_V2_MAX_RETRIES       20
+#define SERIAL_V2_KEEPALIVE_MS      500
+#define SERIAL_V2_SWITCH_DELAY_MS   10
+#define SERIAL_STATE_PUSH_ATTEMPTS  100
+#define SERIAL_V1_ECHO_TIMEOUT_MS   250
+#define SERIAL_LINK_HEALTH_MS       1000
+#define SERIAL_LINK_LOG_TICKS       600     // summary every 10 minutes
+#define SERIAL_LINK_LOSS_LOG_MS     10000
+
 SerialHolder::SerialHolder(QObject *parent)
     : QThread{parent}
 {
@@ -11,9 +24,27 @@ SerialHolder::SerialHolder(QObject *parent)
     connect(&m_serialPort, &QSerialPort::errorOccurred, this, &SerialHolder::OnErrorOccured);
     m_serialPort.moveToThread(this);
 
-    LogManager* logManager = ManagerCollection::GetManager<LogManager>();
-    connect(this, &SerialHolder::notifyLog, logManager, &LogManager::PrintLog);
+    m_retransmitTimer.setInterval(SERIAL_V2_RETRANSMIT_MS);
+    m_keepAliveTimer.setInterval(SERIAL_V2_KEEPALIVE_MS);
+    connect(&m_retransmitTimer, &QTimer::timeout, this, &SerialHolder::OnRetransmitTimeout);
+    connect(&m_keepAliveTimer, &QTimer::timeout, this, &SerialHolder::OnKeepAliveTimeout);
+    m_retransmitTimer.moveToThread(this);
+    m_keepAliveTimer.moveToThread(this);
+
+    m_linkHealthTimer.setInterval(SERIAL_LINK_HEALTH_MS);
+    connect(&m_linkHealthTimer, &QTimer::timeout, this, &SerialHolder::OnLinkHealthTimeout);
+    m_linkHealthTimer.moveToThread(this);
+
+    QString const session = Metrics::SessionLabel();
+    m_metricPackets = Metrics::GetCounter("ac2_serial_packets_total", "Controller state packets (v1) and frames (v2) written, including resends", session);
+    m_metricResent = Metrics::GetCounter("ac2_serial_resent_total", "v2 frames written again after a NAK or timeout", session);
+    m_metricNak = Metrics::GetCounter("ac2_serial_nak_total", "v2 NAKs received", session);
+    m_metricDeviceDropped = Metrics::GetCounter("ac2_serial_device_rx_dropped_total", "Bytes firmware lost to a full receive buffer or UART overrun (v2)", session);
+    m_metricTxBytes = Metrics::GetCounter("ac2_serial_tx_bytes_total", "Bytes written to the serial port", session);
+    m_metricRxBytes = Metrics::GetCounter("ac2_serial_rx_bytes_total", "Bytes read from the serial port", session);
+    m_metricWriteLateness = Metrics::GetHistogram("ac2_input_write_lateness_seconds", "How late each scheduled controller state was written to the serial port", Metrics::LatencyBounds(), 1e-9, session);
 
+    SessionContext::AttachThread(this);
     this->moveToThread(this);
     this->start();
 }
@@ -36,26 +67,132 @@ bool SerialHolder::IsConnected() const
     return m_serialState == SerialState::Connected;
 }
 
+bool SerialHolder::IsVirtual() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_virtual;
+}
+
+quint8 SerialHolder::GetProtocolVersion() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_protocolVersion;
+}
+
+void SerialHolder::SetProtocolOptions(quint8 maxVersion, qint32 baudRate, qint32 reportInterval)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxProtocolVersion = maxVersion;
+    m_v2BaudRate = baudRate;
+    m_reportInterval = reportInterval;
+}
+
+bool SerialHolder::SupportsTimeline() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_serialState == SerialState::Connected && m_protocolVersion >= SerialProtocol::Version;
+}
+
+int SerialHolder::GetTimelineCapacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_timelineCapacity;
+}
+
+qint32 SerialHolder::GetReportInterval() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_reportInterval;
+}
+
 void SerialHolder::OnReadyRead()
 {
     QMutexLocker locker(&m_mutex);
     QByteArray ba = m_serialPort.readAll();
-    if (m_serialState != SerialState::Connected)
+    if (ba.isEmpty()) return;
+    m_linkHealth.AddRxBytes(ba.size());
+    m_metricRxBytes->Add(ba.size());
+
+    if (m_protocolVersion >= SerialProtocol::Version)
     {
-        if (!ba.isEmpty())
+        QVector<SerialProtocol::Frame> frames;
+        quint64 const crcErrors = m_parser.GetCRCErrors();
+        m_parser.Feed(ba, frames);
+        m_linkHealth.AddGarbled(m_parser.GetCRCErrors() - crcErrors);
+        for (SerialProtocol::Frame const& frame : frames)
+        {
+            HandleFrame(frame);
+        }
+        return;
+    }
+
+    switch (m_serialState)
+    {
+    case SerialState::FeedbackTest:
+    {
+        // Version checking
+        m_serialVersion = ba.front();
+        if (m_serialVersion != SERIAL_VERSION)
+        {
+            m_serialState = SerialState::FeedbackFailed;
+        }
+        else if (m_maxProtocolVersion >= SerialProtocol::Version)
+        {
+            // v1 firmware discards this, newer firmware replies which version to use
+            m_helloBuffer.clear();
+            m_serialState = SerialState::Negotiating;
+            m_serialPort.write(SerialProtocol::EncodeHello(SerialProtocol::Version, quint32(m_v2BaudRate)));
+        }
+        else
         {
-            // Version checking
-            m_serialVersion = ba.front();
-            if (m_serialVersion == SERIAL_VERSION)
+            m_serialState = SerialState::FeedbackOK;
+        }
+        break;
+    }
+    case SerialState::Negotiating:
+    {
+        m_helloBuffer.append(ba);
+        qsizetype const start = m_helloBuffer.indexOf((char)SerialProtocol::V2Hello);
+        if (start < 0)
+        {
+            m_helloBuffer.clear();
+            break;
+        }
+
+        m_helloBuffer.remove(0, start);
+        if (m_helloBuffer.size() < SerialProtocol::HelloSize) break;
+
+        if (quint8(m_helloBuffer[1]) == SerialProtocol::Version)
+        {
+            // firmware switches baud rate once the reply is out, give it time before we do
+            m_serialState = SerialState::Upgrading;
+            QTimer::singleShot(SERIAL_V2_SWITCH_DELAY_MS, this, &SerialHolder::OnUpgradeBaudRate);
+        }
+        else
+        {
+            m_serialState = SerialState::FeedbackOK;
+        }
+        break;
+    }
+    case SerialState::Connected:
+    {
+        // every accepted packet is echoed in order, packets merged on the wire only get one
+        qint64 const now = InputScheduler::Now();
+        ExpireEchoes(now);
+        for (char const c : std::as_const(ba))
+        {
+            if (quint8(c) != SERIAL_VERSION)
             {
-                m_serialState = SerialState::FeedbackOK;
+                m_linkHealth.AddGarbled();
             }
-            else
+            else if (!m_echoPending.isEmpty())
             {
-                m_serialState = SerialState::FeedbackFailed;
+                m_linkHealth.AddRtt(now - m_echoPending.dequeue());
             }
         }
-        return;
+        break;
+    }
+    default: break;
     }
 }
 
@@ -72,10 +209,21 @@ void SerialHolder::OnErrorOccured(QSerialPort::SerialPortError error)
 void SerialHolder::OnConnectClicked(QString const& name)
 {
     QMutexLocker locker(&m_mutex);
-    if (m_serialPort.isOpen())
+    if (m_serialPort.isOpen() || m_virtual)
     {
         Disconnect();
     }
+    else if (name == GetReplayPortName())
+    {
+        // no handshake, states are only recorded
+        ResetProtocol();
+        m_protocolVersion = 1;
+        m_virtual = true;
+        m_serialState = SerialState::Connected;
+        emit notifyLog("Global", "Serial Connected (replay)", LOG_Success);
+        emit notifySerialStatus();
+        emit notifyConnectTimeout(false);
+    }
     else if (!name.isEmpty())
     {
         Connect(name);
@@ -85,10 +233,25 @@ void SerialHolder::OnConnectClicked(QString const& name)
 void SerialHolder::OnConnectTimeout()
 {
     QMutexLocker locker(&m_mutex);
+    if (m_serialState == SerialState::Negotiating)
+    {
+        // no reply to hello, v1 firmware
+        m_serialState = SerialState::FeedbackOK;
+    }
+
     if (m_serialState == SerialState::FeedbackOK)
     {
         m_serialState = SerialState::Connected;
-        emit notifyLog("Global", "Serial Connected", LOG_Success);
+        StartLinkHealth();
+        if (m_protocolVersion >= SerialProtocol::Version)
+        {
+            m_keepAliveTimer.start();
+            emit notifyLog("Global", "Serial Connected (protocol v" + QString::number(m_protocolVersion) + ", " + QString::number(m_v2BaudRate) + " baud)", LOG_Success);
+        }
+        else
+        {
+            emit notifyLog("Global", "Serial Connected (protocol v1)", LOG_Success);
+        }
         emit notifySerialStatus();
         emit notifyConnectTimeout(false);
         return;
@@ -112,6 +275,42 @@ void SerialHolder::OnDisconnectTimeout()
         m_serialPort.close();
         emit notifyLog("Global", "Serial Disconnected", LOG_Warning);
     }
+    else if (m_virtual)
+    {
+        emit notifyLog("Global", "Serial Disconnected (replay)", LOG_Warning);
+    }
+    m_virtual = false;
+
+    if (m_linkHealthTimer.isActive())
+    {
+        m_linkHealthTimer.stop();
+        LinkHealth::Snapshot const snapshot = m_linkHealth.TakeSnapshot(InputScheduler::Now());
+        emit notifyLog("Global", "Serial link: " + LinkHealth::ToString(snapshot, true));
+    }
+
+    if (m_protocolVersion >= SerialProtocol::Version)
+    {
+        QString log = "Serial v2: frames sent = " + QString::number(m_framesSent);
+        log += ", resent = " + QString::number(m_framesResent);
+        log += ", NAK = " + QString::number(m_nakCount);
+        log += ", CRC errors = " + QString::number(m_parser.GetCRCErrors());
+        log += ", device RX dropped = " + QString::number(m_deviceDropped);
+        emit notifyLog("Global", log);
+    }
+
+    if (m_statesSubmitted > 0)
+    {
+        StateCounters const counters = GetStateCounters();
+        QString log = "Serial states: submitted = " + QString::number(counters.m_submitted);
+        log += ", coalesced = " + QString::number(counters.m_coalesced);
+        log += ", duplicates = " + QString::number(counters.m_duplicates);
+        log += ", written = " + QString::number(counters.m_written);
+        log += ", dropped = " + QString::number(counters.m_dropped);
+        log += ", max latency = " + QString::number(qreal(counters.m_maxLatency) / 1000.0, 'f', 1) + "us";
+        emit notifyLog("Global", log);
+    }
+    ResetProtocol();
+    m_protocolVersion = 1;
 
     m_serialState = SerialState::Disconnected;
     emit notifySerialStatus();
@@ -128,6 +327,10 @@ void SerialHolder::Connect(const QString &name)
     m_serialPort.setStopBits(QSerialPort::OneStop);
     m_serialPort.setFlowControl(QSerialPort::NoFlowControl);
 
+    // always start with v1 handshake, v2 is negotiated after the version echo
+    ResetProtocol();
+    m_protocolVersion = 1;
+
     if (m_serialPort.open(QIODevice::ReadWrite))
     {
         m_serialState = SerialState::FeedbackTest;
@@ -150,12 +353,21 @@ void SerialHolder::Disconnect()
     QMutexLocker locker(&m_mutex);
     if (m_serialState == SerialState::Disconnecting) return;
 
-    if (m_serialPort.isOpen())
+    if (m_serialPort.isOpen() && !m_virtual)
     {
-        // clear button, we don't want feedback
-        QByteArray ba;
-        ba.append((char)0);
-        m_serialPort.write(ba);
+        if (m_protocolVersion >= SerialProtocol::Version)
+        {
+            // clear button and go back to v1, firmware ACKs then switches baud rate
+            m_keepAliveTimer.stop();
+            SendFrame(SerialProtocol::TypeBye);
+        }
+        else
+        {
+            // clear button, we don't want feedback
+            QByteArray ba;
+            ba.append((char)0);
+            m_serialPort.write(ba);
+        }
 
         QTimer::singleShot(50, this, &SerialHolder::OnDisconnectTimeout);
 
@@ -169,36 +381,581 @@ void SerialHolder::Disconnect()
     }
 }
 
-void SerialHolder::OnSendButton(quint32 buttonFlag, QPointF lStick, QPointF rStick)
+quint64 SerialHolder::SubmitState(StateSource source, quint32 buttonFlag, QPointF lStick, QPointF rStick, qint64 deadline)
+{
+    ControllerState state;
+    state.m_time = InputScheduler::Now();
+    state.m_deadline = deadline;
+    state.m_token = ++m_statesSubmitted;
+    state.m_buttonFlag = buttonFlag;
+    state.m_lx = SerialProtocol::StickToByte(lStick.x());
+    state.m_ly = SerialProtocol::StickToByte(-lStick.y());
+    state.m_rx = SerialProtocol::StickToByte(rStick.x());
+    state.m_ry = SerialProtocol::StickToByte(-rStick.y());
+    state.m_source = source;
+
+    int attempts = 0;
+    while (!m_stateQueue.Push(state))
+    {
+        // serial thread is behind, give it a moment to drain
+        if (++attempts > SERIAL_STATE_PUSH_ATTEMPTS)
+        {
+            m_statesDropped++;
+            break;
+        }
+        QThread::yieldCurrentThread();
+    }
+
+    // one drain per batch, not one event per state
+    if (!m_drainPosted.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, [this]{ DrainStates(); }, Qt::QueuedConnection);
+    }
+    return state.m_token;
+}
+
+SerialHolder::StateCounters SerialHolder::GetStateCounters() const
 {
+    StateCounters counters;
+    counters.m_submitted = m_statesSubmitted;
+    counters.m_coalesced = m_statesCoalesced;
+    counters.m_duplicates = m_statesDuplicate;
+    counters.m_written = m_statesWritten;
+    counters.m_dropped = m_statesDropped;
+    counters.m_maxLatency = m_statesMaxLatency;
+    return counters;
+}
+
+SerialHolder::StateResult SerialHolder::GetStateResult(StateSource source) const
+{
+    QMutexLocker locker(&m_resultMutex);
+    return m_stateResults[int(source)];
+}
+
+void SerialHolder::DrainStates()
+{
+    // clear before popping, anything pushed after this posts another drain
+    m_drainPosted = false;
+
+    ControllerState state;
+    ControllerState latest;
+    int count = 0;
+    while (m_stateQueue.Pop(state))
+    {
+        latest = state;
+        count++;
+    }
+    if (count == 0) return;
+
+    // states that never reached the wire are superseded by the newest one
+    m_statesCoalesced += quint64(count - 1);
+
     QMutexLocker locker(&m_mutex);
-    if (!m_serialPort.isOpen()) return;
+    if (!m_serialPort.isOpen() && !m_virtual) return;
+
+    if (m_hasLastWritten
+     && latest.m_buttonFlag == m_lastWritten.m_buttonFlag
+     && latest.m_lx == m_lastWritten.m_lx && latest.m_ly == m_lastWritten.m_ly
+     && latest.m_rx == m_lastWritten.m_rx && latest.m_ry == m_lastWritten.m_ry)
+    {
+        m_statesDuplicate++;
+        SetStateResult(latest, true);
+        return;
+    }
+
+    qint64 const latency = InputScheduler::Now() - latest.m_time;
+    if (latency > m_statesMaxLatency)
+    {
+        m_statesMaxLatency = latency;
+    }
+
+    if (SessionRecorder* recorder = m_recorder.load(std::memory_order_relaxed))
+    {
+        recorder->PushInput(InputScheduler::Now(), quint8(latest.m_source), latest.m_buttonFlag, latest.m_lx, latest.m_ly, latest.m_rx, latest.m_ry);
+    }
+
+    SendButton(latest.m_buttonFlag, latest.m_lx, latest.m_ly, latest.m_rx, latest.m_ry);
+    SetStateResult(latest, false);
+    if (latest.m_deadline > 0)
+    {
+        m_metricWriteLateness->Observe(m_lastWriteTime - latest.m_deadline);
+    }
+}
 
-    quint8 lx = qCeil((lStick.x() + 1.0) * 0.5 * 255);
-    quint8 ly = qCeil((-lStick.y() + 1.0) * 0.5 * 255);
-    quint8 rx = qCeil((rStick.x() + 1.0) * 0.5 * 255);
-    quint8 ry = qCeil((-rStick.y() + 1.0) * 0.5 * 255);
+void SerialHolder::SetStateResult(const ControllerState &state, bool duplicate)
+{
+    StateResult result;
+    result.m_token = state.m_token;
+    result.m_deadline = state.m_deadline;
+    result.m_time = duplicate ? InputScheduler::Now() : qint64(m_lastWriteTime);
+    result.m_duplicate = duplicate;
 
-    SendButton(buttonFlag, lx, ly, rx, ry);
+    QMutexLocker locker(&m_resultMutex);
+    m_stateResults[int(state.m_source)] = result;
 }
 
 void SerialHolder::SendButton(quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry)
+{
+    TRACE_SCOPE("serial", "SerialHolder::SendButton");
+    QMutexLocker locker(&m_mutex);
+    if (!m_serialPort.isOpen() && !m_virtual) return;
+
+    m_lastWritten.m_buttonFlag = buttonFlag;
+    m_lastWritten.m_lx = lx;
+    m_lastWritten.m_ly = ly;
+    m_lastWritten.m_rx = rx;
+    m_lastWritten.m_ry = ry;
+    m_hasLastWritten = true;
+    m_statesWritten++;
+    m_lastWriteTime = InputScheduler::Now();
+    if (m_virtual) return;
+
+    if (m_protocolVersion >= SerialProtocol::Version)
+    {
+        // payload is kept for retransmits
+        QByteArray state(SerialProtocol::StateSize, Qt::Uninitialized);
+        SerialProtocol::WriteState(state.data(), buttonFlag, lx, ly, rx, ry);
+        m_lastState = state;
+        SendFrame(SerialProtocol::TypeState, state);
+        return;
+    }
+
+    m_packet[0] = (char)SerialProtocol::V1Mode; // mode = FF
+    int const size = 1 + SerialProtocol::WriteState(m_packet.data() + 1, buttonFlag, lx, ly, rx, ry);
+    m_serialPort.write(m_packet.data(), size);
+    m_linkHealth.AddTxBytes(size);
+    m_metricTxBytes->Add(size);
+    m_metricPackets->Add();
+
+    if (m_serialState == SerialState::Connected)
+    {
+        m_echoPending.enqueue(InputScheduler::Now());
+        m_linkHealth.AddSent();
+    }
+}
+
+void SerialHolder::OnSendTimeline(const QVector<SerialProtocol::TimelineEntry> &entries, bool end)
 {
     QMutexLocker locker(&m_mutex);
-    if (!m_serialPort.isOpen()) return;
+    if (!m_serialPort.isOpen() || m_protocolVersion < SerialProtocol::Version) return;
 
-    QByteArray ba;
-    ba.append((char)0xFF); // mode = FF
+    // a state frame resent after this would override the timeline
+    m_lastState.clear();
+    m_hasLastWritten = false;
+    m_busyReported = false;
+    RecordTimeline(entries);
 
-    ba.append((char)(buttonFlag & 0x000000FF));
-    ba.append((char)((buttonFlag & 0x0000FF00) >> 8));
-    ba.append((char)((buttonFlag & 0x00FF0000) >> 16));
-    ba.append((char)((buttonFlag & 0xFF000000) >> 24));
+    int index = 0;
+    do
+    {
+        int const count = qMin(int(entries.size()) - index, int(SerialProtocol::TimelineMaxEntries));
+        bool const last = index + count >= entries.size();
+        SendFrame(SerialProtocol::TypeTimelinePush, SerialProtocol::EncodeTimeline(entries.constData() + index, count, end && last));
+        index += count;
+    }
+    while (index < entries.size());
+}
 
-    ba.append((char)lx);
-    ba.append((char)ly);
-    ba.append((char)rx);
-    ba.append((char)ry);
+void SerialHolder::ClearTimeline()
+{
+    {
+        // a status already on its way may still say the previous timeline is done
+        QMutexLocker locker(&m_mutex);
+        m_timelineSynced = false;
+        m_timelineClearSeq = -1;
+    }
+    QMetaObject::invokeMethod(this, [this]{ OnClearTimeline(); }, Qt::QueuedConnection);
+}
 
-    m_serialPort.write(ba);
+void SerialHolder::OnClearTimeline()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_serialPort.isOpen() || m_protocolVersion < SerialProtocol::Version) return;
+
+    m_hasLastWritten = false;
+    m_timelineRecordEnd = 0;
+    m_timelineClearSeq = m_txSeq;
+    SendFrame(SerialProtocol::TypeTimelineClear);
+}
+
+void SerialHolder::RecordTimeline(const QVector<SerialProtocol::TimelineEntry> &entries)
+{
+    SessionRecorder* recorder = m_recorder.load(std::memory_order_relaxed);
+    if (!recorder || !recorder->IsRecording()) return;
+
+    // recorded as the states firmware would play, queued behind what was pushed earlier,
+    // so a replay without timeline support compares against the same state changes
+    qint64 const now = InputScheduler::Now();
+    qint64 time = qMax(now, m_timelineRecordEnd);
+    SerialProtocol::TimelineEntry const* previous = Q_NULLPTR;
+    for (SerialProtocol::TimelineEntry const& entry : entries)
+    {
+        if (!previous || entry.m_buttonFlag != previous->m_buttonFlag
+         || entry.m_lx != previous->m_lx || entry.m_ly != previous->m_ly
+         || entry.m_rx != previous->m_rx || entry.m_ry != previous->m_ry)
+        {
+            recorder->PushInput(time, quint8(StateSource::Command), entry.m_buttonFlag, entry.m_lx, entry.m_ly, entry.m_rx, entry.m_ry);
+        }
+        time += qint64(entry.m_frames) * m_reportInterval * 1000;
+        previous = &entry;
+    }
+    m_timelineRecordEnd = time;
+}
+
+void SerialHolder::OnUpgradeBaudRate()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_serialState != SerialState::Upgrading || !m_serialPort.isOpen()) return;
+
+    m_serialPort.clear();
+    m_serialPort.setBaudRate(m_v2BaudRate);
+
+    ResetProtocol();
+    m_protocolVersion = SerialProtocol::Version;
+
+    // first ACK confirms the link at the new baud rate
+    SendFrame(SerialProtocol::TypePing);
+}
+
+void SerialHolder::OnRetransmitTimeout()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_unacked.isEmpty())
+    {
+        m_retransmitTimer.stop();
+        return;
+    }
+
+    if (++m_retries > SERIAL_V2_MAX_RETRIES)
+    {
+        emit notifyLog("Global", "Serial v2: no acknowledgement after " + QString::number(SERIAL_V2_MAX_RETRIES) + " retries", LOG_Error);
+        OnDisconnectTimeout();
+        emit notifyErrorOccured();
+        return;
+    }
+
+    // firmware answered FULL since the last resend, nothing went missing
+    ResendUnacked(!m_backoff);
+}
+
+void SerialHolder::OnKeepAliveTimeout()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_serialState != SerialState::Connected || m_protocolVersion < SerialProtocol::Version) return;
+
+    // firmware falls back to v1 if the link is idle for too long
+    if (m_unacked.isEmpty() && m_pending.isEmpty())
+    {
+        SendFrame(SerialProtocol::TypePing);
+    }
+}
+
+void SerialHolder::OnLinkHealthTimeout()
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 const now = InputScheduler::Now();
+    ExpireEchoes(now);
+
+    LinkHealth::Snapshot const snapshot = m_linkHealth.TakeSnapshot(now);
+    emit notifyLinkHealth(snapshot);
+
+    // rate limited so a bad cable doesn't flood the log
+    if (snapshot.m_lost > m_lostReported && now - m_lostReportTime >= qint64(SERIAL_LINK_LOSS_LOG_MS) * 1000000)
+    {
+        emit notifyLog("Global", "Serial link: " + QString::number(snapshot.m_lost - m_lostReported) + " packet(s) lost, " + LinkHealth::ToString(snapshot), LOG_Warning);
+        m_lostReported = snapshot.m_lost;
+        m_lostReportTime = now;
+    }
+
+    if (m_deviceDropped > m_deviceDroppedReported && now - m_deviceDroppedReportTime >= qint64(SERIAL_LINK_LOSS_LOG_MS) * 1000000)
+    {
+        emit notifyLog("Global", "Serial link: firmware dropped " + QString::number(m_deviceDropped - m_deviceDroppedReported) + " received byte(s), baud rate may be too high for the board", LOG_Warning);
+        m_deviceDroppedReported = m_deviceDropped;
+        m_deviceDroppedReportTime = now;
+    }
+
+    if (++m_linkHealthTicks % SERIAL_LINK_LOG_TICKS == 0)
+    {
+        emit notifyLog("Global", "Serial link: " + LinkHealth::ToString(snapshot));
+    }
+}
+
+void SerialHolder::SendFrame(quint8 type, const QByteArray &payload)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // window is full, a newer state replaces the one still waiting behind it
+    if (type == SerialProtocol::TypeState && m_unacked.size() >= SERIAL_V2_WINDOW
+     && !m_pending.isEmpty() && m_pending.back().m_type == SerialProtocol::TypeState)
+    {
+        m_pending.back().m_payload = payload;
+        m_statesCoalesced++;
+        return;
+    }
+
+    SerialProtocol::Frame frame;
+    frame.m_seq = m_txSeq++;
+    frame.m_type = type;
+    frame.m_payload = payload;
+
+    if (m_unacked.size() < SERIAL_V2_WINDOW)
+    {
+        m_unacked.enqueue(frame);
+        WriteFrame(frame);
+        if (!m_retransmitTimer.isActive())
+        {
+            m_retransmitTimer.start();
+        }
+    }
+    else
+    {
+        m_pending.enqueue(frame);
+    }
+}
+
+void SerialHolder::WriteFrame(const SerialProtocol::Frame &frame, bool resend)
+{
+    int const size = SerialProtocol::WriteFrame(m_packet.data(), frame);
+    m_serialPort.write(m_packet.data(), size);
+    m_linkHealth.AddTxBytes(size);
+    m_metricTxBytes->Add(size);
+    m_metricPackets->Add();
+    m_framesSent++;
+
+    if (resend)
+    {
+        m_seqResent[frame.m_seq] = true;
+    }
+    else
+    {
+        m_seqSendTime[frame.m_seq] = InputScheduler::Now();
+        m_seqResent[frame.m_seq] = false;
+        m_linkHealth.AddSent();
+    }
+}
+
+void SerialHolder::HandleFrame(const SerialProtocol::Frame &frame)
+{
+    switch (frame.m_type)
+    {
+    case SerialProtocol::TypeAck:
+    {
+        if (frame.m_payload.size() < 2) break;
+        if (frame.m_payload.size() >= 3 && m_serialState == SerialState::Upgrading)
+        {
+            // timeline is empty on connect, so free slots is the capacity
+            m_timelineCapacity = quint8(frame.m_payload[2]);
+        }
+        if (frame.m_payload.size() >= 5)
+        {
+            // 16-bit count since the baud rate switch, wraps
+            quint16 const dropped = quint8(frame.m_payload[3]) | (quint16(quint8(frame.m_payload[4])) << 8);
+            quint16 const added = dropped - m_deviceDroppedLast;
+            m_deviceDroppedLast = dropped;
+            m_deviceDropped += added;
+            m_metricDeviceDropped->Add(added);
+        }
+        HandleAck(quint8(frame.m_payload[0]), quint8(frame.m_payload[1]));
+        if (frame.m_payload.size() >= 10)
+        {
+            // same as TIMELINE_STATUS, so a lost one is repaired by the next ACK or keep alive
+            quint16 const started = quint8(frame.m_payload[5]) | (quint16(quint8(frame.m_payload[6])) << 8);
+            quint16 const underruns = quint8(frame.m_payload[7]) | (quint16(quint8(frame.m_payload[8])) << 8);
+            UpdateTimelineStatus(started, underruns, quint8(frame.m_payload[9]));
+        }
+        break;
+    }
+    case SerialProtocol::TypeTimelineStatus:
+    {
+        if (frame.m_payload.size() < 6) break;
+        quint16 const started = quint8(frame.m_payload[0]) | (quint16(quint8(frame.m_payload[1])) << 8);
+        quint16 const underruns = quint8(frame.m_payload[3]) | (quint16(quint8(frame.m_payload[4])) << 8);
+        UpdateTimelineStatus(started, underruns, quint8(frame.m_payload[5]));
+        break;
+    }
+    default: break;
+    }
+}
+
+void SerialHolder::HandleAck(quint8 expectedSeq, quint8 status)
+{
+    // firmware has seen the clear, everything it reports from here on comes after it
+    if (!m_timelineSynced && m_timelineClearSeq >= 0)
+    {
+        quint8 const diff = quint8(expectedSeq - quint8(m_timelineClearSeq));
+        m_timelineSynced = diff > 0 && diff <= 128;
+    }
+
+    // cumulative, everything before expectedSeq has been received
+    bool progressed = false;
+    quint8 lastSeq = 0;
+    while (!m_unacked.isEmpty())
+    {
+        quint8 const diff = quint8(expectedSeq - m_unacked.head().m_seq);
+        if (diff == 0 || diff > 128) break;
+
+        lastSeq = m_unacked.dequeue().m_seq;
+        progressed = true;
+    }
+
+    if (progressed)
+    {
+        // the newest frame acknowledged, unless it was resent and we can't tell which copy got through
+        if (!m_seqResent[lastSeq])
+        {
+            m_linkHealth.AddRtt(InputScheduler::Now() - m_seqSendTime[lastSeq]);
+        }
+
+        m_retries = 0;
+        m_resentSinceAck = false;
+        m_backoff = false;
+
+        if (m_serialState == SerialState::Upgrading)
+        {
+            m_serialState = SerialState::FeedbackOK;
+        }
+    }
+
+    // slide the window
+    while (m_unacked.size() < SERIAL_V2_WINDOW && !m_pending.isEmpty())
+    {
+        SerialProtocol::Frame const frame = m_pending.dequeue();
+        m_unacked.enqueue(frame);
+        WriteFrame(frame);
+    }
+
+    switch (status)
+    {
+    case SerialProtocol::StatusBadCRC:
+    case SerialProtocol::StatusOutOfOrder:
+    {
+        // go back to the first frame firmware is missing, only once until it makes progress
+        m_nakCount++;
+        m_metricNak->Add();
+        if (status == SerialProtocol::StatusBadCRC)
+        {
+            m_linkHealth.AddGarbled();
+        }
+        if (!m_resentSinceAck && !m_unacked.isEmpty())
+        {
+            ResendUnacked(true);
+        }
+        break;
+    }
+    case SerialProtocol::StatusFull:
+    {
+        // link is fine, firmware will take it after playing some entries, keep resending on timer
+        m_retries = 0;
+        m_backoff = true;
+        break;
+    }
+    case SerialProtocol::StatusBadType:
+    {
+        emit notifyLog("Global", "Serial v2: firmware rejected a frame", LOG_Warning);
+        break;
+    }
+    case SerialProtocol::StatusBusy:
+    {
+        // not on the wire, the same state must be sent again once the timeline is done
+        m_hasLastWritten = false;
+        if (!m_busyReported)
+        {
+            m_busyReported = true;
+            emit notifyLog("Global", "Serial v2: manual input ignored while a timeline is playing", LOG_Warning);
+        }
+        break;
+    }
+    default: break;
+    }
+
+    if (m_unacked.isEmpty())
+    {
+        m_retransmitTimer.stop();
+    }
+    else if (progressed)
+    {
+        m_retransmitTimer.start();
+    }
+}
+
+void SerialHolder::ResendUnacked(bool lost)
+{
+    for (SerialProtocol::Frame const& frame : std::as_const(m_unacked))
+    {
+        // an older state is superseded by the newest one, no point replaying it
+        if (frame.m_type == SerialProtocol::TypeState && !m_lastState.isEmpty())
+        {
+            SerialProtocol::Frame latest = frame;
+            latest.m_payload = m_lastState;
+            WriteFrame(latest, true);
+        }
+        else
+        {
+            WriteFrame(frame, true);
+        }
+        m_framesResent++;
+        m_metricResent->Add();
+    }
+
+    // the first unacked frame or its ACK went missing, the rest of the window is collateral
+    if (lost)
+    {
+        m_linkHealth.AddLost();
+    }
+    m_backoff = false;
+    m_resentSinceAck = true;
+    m_retransmitTimer.start();
+}
+
+void SerialHolder::UpdateTimelineStatus(quint16 started, quint16 underruns, quint8 flags)
+{
+    if (!m_timelineSynced) return;
+    emit notifyTimelineStatus(started, underruns, flags);
+}
+
+void SerialHolder::ResetProtocol()
+{
+    m_retransmitTimer.stop();
+    m_keepAliveTimer.stop();
+    m_parser.Reset();
+    m_txSeq = 0;
+    m_unacked.clear();
+    m_pending.clear();
+    m_lastState.clear();
+    m_hasLastWritten = false;
+    m_timelineRecordEnd = 0;
+    m_helloBuffer.clear();
+    m_resentSinceAck = false;
+    m_backoff = false;
+    m_timelineSynced = true;
+    m_timelineClearSeq = -1;
+    m_retries = 0;
+    m_framesSent = 0;
+    m_framesResent = 0;
+    m_nakCount = 0;
+    m_deviceDropped = 0;
+    m_deviceDroppedLast = 0;
+}
+
+void SerialHolder::StartLinkHealth()
+{
+    qint64 const now = InputScheduler::Now();
+    m_linkHealth.Reset(now);
+    m_echoPending.clear();
+    m_linkHealthTicks = 0;
+    m_lostReported = 0;
+    m_lostReportTime = now;
+    m_deviceDroppedReported = 0;
+    m_deviceDroppedReportTime = now;
+    m_linkHealthTimer.start();
+}
+
+void SerialHolder::ExpireEchoes(qint64 now)
+{
+    // v1 has no sequence numbers, a packet without an echo in time is lost or was merged with another
+    while (!m_echoPending.isEmpty() && now - m_echoPending.head() > qint64(SERIAL_V1_ECHO_TIMEOUT_MS) * 1000000)
+    {
+        m_echoPending.dequeue();
+        m_linkHealth.AddLost();
+    }
 }
@@ -3,22 +3,88 @@
 
 #include <QMutex>
 #include <QPointF>
+#include <QQueue>
 #include <QSerialPort>
 #include <QThread>
 #include <QTimer>
 
+#include <array>
+#include <atomic>
+
+#include "Helpers/linkhealth.h"
+#include "Helpers/metrics.h"
+#include "Helpers/mpscqueue.h"
+#include "Helpers/serialprotocol.h"
 #include "Types/system.h"
 
+class SessionRecorder;
+
 class SerialHolder : public QThread
 {
     Q_OBJECT
 
+public:
+    enum class StateSource : quint8
+    {
+        Keyboard,
+        Joystick,
+        Command,
+        Scheduler,
+    };
+
+    struct StateCounters
+    {
+        quint64 m_submitted = 0;
+        quint64 m_coalesced = 0;    // superseded by a newer state before being written
+        quint64 m_duplicates = 0;   // same as the state already on the wire
+        quint64 m_written = 0;
+        quint64 m_dropped = 0;      // queue was full
+        qint64  m_maxLatency = 0;   // submit to write, nanoseconds
+    };
+
+    // what the serial thread did with the newest handled state of a source,
+    // states coalesced into a later one of the same batch are never handled
+    struct StateResult
+    {
+        quint64 m_token = 0;        // from SubmitState(), 0 if nothing handled yet
+        qint64  m_deadline = 0;
+        qint64  m_time = 0;         // InputScheduler::Now() when written or found on the wire
+        bool    m_duplicate = false;    // same as the state already on the wire, not written again
+    };
+
 public:
     explicit SerialHolder(QObject *parent = nullptr);
     ~SerialHolder();
 
     bool IsOpen() const;
     bool IsConnected() const;
+    bool IsVirtual() const;
+    quint8 GetProtocolVersion() const;
+
+    // connecting to this name accepts states without a serial port, used by session replay
+    static QString GetReplayPortName() { return "Replay"; }
+
+    // every state handed to the port is also pushed to the recorder
+    void SetRecorder(SessionRecorder* recorder) { m_recorder = recorder; }
+
+    // applied on next connect, protocol = 1 never attempts v2
+    void SetProtocolOptions(quint8 maxVersion, qint32 baudRate, qint32 reportInterval);
+
+    // timeline playback on firmware, v2 only
+    bool SupportsTimeline() const;
+    int GetTimelineCapacity() const;
+    qint32 GetReportInterval() const;   // microseconds per USB report
+
+    // any thread, stops the timeline and releases everything,
+    // no status is reported from now on until firmware acknowledges the clear
+    void ClearTimeline();
+
+    // any thread, lock-free, the serial thread only writes the newest state
+    // deadline is the InputScheduler::Now() the state was due, the write is measured against it
+    // returns a token that identifies the state in GetStateResult()
+    quint64 SubmitState(StateSource source, quint32 buttonFlag, QPointF lStick = QPointF(), QPointF rStick = QPointF(), qint64 deadline = 0);
+    StateCounters GetStateCounters() const;
+    StateResult GetStateResult(StateSource source) const;
 
 signals:
     void notifyErrorOccured();
@@ -31,6 +97,10 @@ signals:
     void notifyDisconnecting();
     void notifyDisconnectTimeout();
 
+    // called from serial thread
+    void notifyTimelineStatus(quint16 started, quint16 underruns, quint8 flags);
+    void notifyLinkHealth(LinkHealth::Snapshot const& snapshot);
+
 public slots:
     // serial
     void OnReadyRead();
@@ -39,30 +109,146 @@ public slots:
     void OnConnectTimeout();
     void OnDisconnectClicked();
     void OnDisconnectTimeout();
-    void OnSendButton(quint32 buttonFlag, QPointF lStick = QPointF(), QPointF rStick = QPointF());
+    void OnSendTimeline(QVector<SerialProtocol::TimelineEntry> const& entries, bool end);
+
+private slots:
+    void OnClearTimeline();
+
+    // v2
+    void OnUpgradeBaudRate();
+    void OnRetransmitTimeout();
+    void OnKeepAliveTimeout();
+
+    // link health
+    void OnLinkHealthTimeout();
 
 private:
     void Connect(QString const& name);
     void Disconnect();
 
+    void DrainStates();
     void SendButton(quint32 buttonFlag, quint8 lx = 128, quint8 ly = 128, quint8 rx = 128, quint8 ry = 128);
+    void RecordTimeline(QVector<SerialProtocol::TimelineEntry> const& entries);
+
+    // v2
+    void SendFrame(quint8 type, QByteArray const& payload = QByteArray());
+    void WriteFrame(SerialProtocol::Frame const& frame, bool resend = false);
+    void HandleFrame(SerialProtocol::Frame const& frame);
+    void HandleAck(quint8 expectedSeq, quint8 status);
+    void ResendUnacked(bool lost);
+    void UpdateTimelineStatus(quint16 started, quint16 underruns, quint8 flags);
+    void ResetProtocol();
+
+    // link health
+    void StartLinkHealth();
+    void ExpireEchoes(qint64 now);
 
 private: // types
+    struct ControllerState
+    {
+        qint64      m_time = 0;
+        qint64      m_deadline = 0;     // 0 if not scheduled
+        quint64     m_token = 0;
+        quint32     m_buttonFlag = 0;
+        quint8      m_lx = 128;
+        quint8      m_ly = 128;
+        quint8      m_rx = 128;
+        quint8      m_ry = 128;
+        StateSource m_source = StateSource::Keyboard;
+    };
+
     enum class SerialState
     {
         Disconnected,
         FeedbackTest,
+        Negotiating,    // v1 feedback OK, waiting for v2 hello reply
+        Upgrading,      // baud rate switched, waiting for first v2 ACK
         FeedbackOK,
         FeedbackFailed,
         Disconnecting,
         Connected,
     };
 
+private:
+    void SetStateResult(ControllerState const& state, bool duplicate);
+
 private:
     mutable QRecursiveMutex m_mutex;
     QSerialPort     m_serialPort;
     SerialState     m_serialState = SerialState::Disconnected;
     quint8          m_serialVersion = 0;
+    bool            m_virtual = false;
+
+    // Protocol
+    quint8          m_maxProtocolVersion = SerialProtocol::Version;
+    qint32          m_v2BaudRate = 500000;
+    qint32          m_reportInterval = 8000;
+    int             m_timelineCapacity = SerialProtocol::TimelineCapacity;
+    quint8          m_protocolVersion = 1;
+    QByteArray      m_helloBuffer;
+    std::array<char, SerialProtocol::MaxFrameSize> m_packet;
+
+    // controller states from any thread
+    MpscQueue<ControllerState, 1024>    m_stateQueue;
+    std::atomic_bool                    m_drainPosted = false;
+    ControllerState                     m_lastWritten;
+    bool                                m_hasLastWritten = false;
+    std::atomic<quint64>                m_statesSubmitted = 0;
+    std::atomic<quint64>                m_statesCoalesced = 0;
+    std::atomic<quint64>                m_statesDuplicate = 0;
+    std::atomic<quint64>                m_statesWritten = 0;
+    std::atomic<quint64>                m_statesDropped = 0;
+    std::atomic<qint64>                 m_statesMaxLatency = 0;
+    std::atomic<qint64>                 m_lastWriteTime = 0;
+    mutable QMutex                      m_resultMutex;
+    std::array<StateResult, 4>          m_stateResults;     // indexed by StateSource
+
+    // session recording
+    std::atomic<SessionRecorder*>       m_recorder = Q_NULLPTR;
+    qint64                              m_timelineRecordEnd = 0;   // when the recorded timeline runs out
+
+    // v2, go-back-N with a small window
+    SerialProtocol::Parser          m_parser;
+    quint8                          m_txSeq = 0;
+    QQueue<SerialProtocol::Frame>   m_unacked;      // written, waiting for ACK
+    QQueue<SerialProtocol::Frame>   m_pending;      // window full, not written yet
+    QByteArray                      m_lastState;    // resends always carry the newest state
+    bool                            m_resentSinceAck = false;
+    bool                            m_backoff = false;          // last ACK was FULL, a resend on timer is not a loss
+    bool                            m_busyReported = false;     // once per timeline
+    bool                            m_timelineSynced = true;    // statuses are from after the last clear
+    int                             m_timelineClearSeq = -1;    // -1 until the clear is sent
+    int                             m_retries = 0;
+    QTimer                          m_retransmitTimer;
+    QTimer                          m_keepAliveTimer;
+
+    // v2 statistics
+    quint64         m_framesSent = 0;
+    quint64         m_framesResent = 0;
+    quint64         m_nakCount = 0;
+    quint64         m_deviceDropped = 0;        // firmware RX bytes lost, from ACKs
+    quint16         m_deviceDroppedLast = 0;
+
+    // metrics, v1 state packets and v2 frames are both counted as packets
+    MetricCounter*  m_metricPackets = Q_NULLPTR;
+    MetricCounter*  m_metricResent = Q_NULLPTR;
+    MetricCounter*  m_metricNak = Q_NULLPTR;
+    MetricCounter*  m_metricDeviceDropped = Q_NULLPTR;
+    MetricCounter*  m_metricTxBytes = Q_NULLPTR;
+    MetricCounter*  m_metricRxBytes = Q_NULLPTR;
+    MetricHistogram*    m_metricWriteLateness = Q_NULLPTR;
+
+    // link health, v1 matches echoes to packets in order, v2 matches ACKs to sequence numbers
+    LinkHealth                  m_linkHealth;
+    QTimer                      m_linkHealthTimer;
+    QQueue<qint64>              m_echoPending;      // v1 send times waiting for an echo
+    std::array<qint64, 256>     m_seqSendTime = {}; // v2 first transmission time per sequence number
+    std::array<bool, 256>       m_seqResent = {};   // v2 RTT of resent frames is ambiguous, skip them
+    int                         m_linkHealthTicks = 0;
+    quint64                     m_lostReported = 0;
+    qint64                      m_lostReportTime = 0;
+    quint64                     m_deviceDroppedReported = 0;
+    qint64                      m_deviceDroppedReportTime = 0;
 };
 
 #endif // SERIALHOLDER_H
@@ -0,0 +1,157 @@
+#include "serialprotocol.h"
+
+quint8 SerialProtocol::Crc8(quint8 crc, quint8 data)
+{
+    crc ^= data;
+    for (int i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+    }
+    return crc;
+}
+
+QByteArray SerialProtocol::EncodeHello(quint8 version, quint32 baudRate)
+{
+    QByteArray ba;
+    ba.append((char)V2Hello);
+    ba.append((char)version);
+    ba.append((char)(baudRate & 0x000000FF));
+    ba.append((char)((baudRate & 0x0000FF00) >> 8));
+    ba.append((char)((baudRate & 0x00FF0000) >> 16));
+    ba.append((char)((baudRate & 0xFF000000) >> 24));
+    return ba;
+}
+
+QByteArray SerialProtocol::EncodeFrame(const Frame &frame)
+{
+    QByteArray ba(MaxFrameSize, Qt::Uninitialized);
+    ba.resize(WriteFrame(ba.data(), frame));
+    return ba;
+}
+
+QByteArray SerialProtocol::EncodeState(quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry)
+{
+    QByteArray ba(StateSize, Qt::Uninitialized);
+    WriteState(ba.data(), buttonFlag, lx, ly, rx, ry);
+    return ba;
+}
+
+int SerialProtocol::WriteState(char *out, quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry)
+{
+    out[0] = (char)(buttonFlag & 0x000000FF);
+    out[1] = (char)((buttonFlag & 0x0000FF00) >> 8);
+    out[2] = (char)((buttonFlag & 0x00FF0000) >> 16);
+    out[3] = (char)((buttonFlag & 0xFF000000) >> 24);
+
+    out[4] = (char)lx;
+    out[5] = (char)ly;
+    out[6] = (char)rx;
+    out[7] = (char)ry;
+    return StateSize;
+}
+
+int SerialProtocol::WriteFrame(char *out, const Frame &frame)
+{
+    quint8 const length = quint8(frame.m_payload.size() + 2);
+    Q_ASSERT(length <= MaxLength);
+
+    out[0] = (char)Sync;
+    out[1] = (char)length;
+    out[2] = (char)frame.m_seq;
+    out[3] = (char)frame.m_type;
+    memcpy(out + 4, frame.m_payload.constData(), frame.m_payload.size());
+
+    int const size = length + 2;
+    quint8 crc = 0;
+    for (int i = 1; i < size; i++)
+    {
+        crc = Crc8(crc, quint8(out[i]));
+    }
+    out[size] = (char)crc;
+    return size + 1;
+}
+
+QByteArray SerialProtocol::EncodeTimeline(const TimelineEntry *entries, int count, bool end)
+{
+    Q_ASSERT(count <= TimelineMaxEntries);
+
+    QByteArray ba;
+    ba.reserve(1 + count * TimelineEntrySize);
+    ba.append((char)(end ? TimelineEnd : 0));
+    for (int i = 0; i < count; i++)
+    {
+        TimelineEntry const& entry = entries[i];
+        ba.append(EncodeState(entry.m_buttonFlag, entry.m_lx, entry.m_ly, entry.m_rx, entry.m_ry));
+        ba.append((char)(entry.m_frames & 0x00FF));
+        ba.append((char)((entry.m_frames & 0xFF00) >> 8));
+    }
+    return ba;
+}
+
+void SerialProtocol::Parser::Reset()
+{
+    m_state = State::Sync;
+    m_body.clear();
+    m_crcErrors = 0;
+}
+
+void SerialProtocol::Parser::Feed(const QByteArray &data, QVector<Frame> &frames)
+{
+    for (char ch : data)
+    {
+        quint8 const c = quint8(ch);
+        switch (m_state)
+        {
+        case State::Sync:
+        {
+            if (c == Sync)
+            {
+                m_state = State::Length;
+            }
+            break;
+        }
+        case State::Length:
+        {
+            if (c >= MinLength && c <= MaxLength)
+            {
+                m_length = c;
+                m_crc = Crc8(0, c);
+                m_body.clear();
+                m_state = State::Body;
+            }
+            else
+            {
+                // not a frame, resync on the next sync byte
+                m_state = (c == Sync) ? State::Length : State::Sync;
+            }
+            break;
+        }
+        case State::Body:
+        {
+            m_body.append(ch);
+            m_crc = Crc8(m_crc, c);
+            if (m_body.size() >= m_length)
+            {
+                m_state = State::CRC;
+            }
+            break;
+        }
+        case State::CRC:
+        {
+            m_state = State::Sync;
+            if (c != m_crc)
+            {
+                m_crcErrors++;
+                break;
+            }
+
+            Frame frame;
+            frame.m_seq = quint8(m_body[0]);
+            frame.m_type = quint8(m_body[1]);
+            frame.m_payload = m_body.mid(2);
+            frames.push_back(frame);
+            break;
+        }
+        }
+    }
+}
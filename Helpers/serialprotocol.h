@@ -0,0 +1,122 @@
+#ifndef SERIALPROTOCOL_H
+#define SERIALPROTOCOL_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QtMath>
+#include <QVector>
+
+// matches Hex/Config/protocol.h
+namespace SerialProtocol
+{
+    enum : quint8
+    {
+        V1Mode          = 0xFF,
+        V2Hello         = 0xFE,
+        Version         = 2,
+        HelloSize       = 6,
+
+        Sync            = 0xAA,
+        MinLength       = 2,
+        MaxLength       = 64,
+        MaxFrameSize    = MaxLength + 3,
+        StateSize       = 8,
+
+        TimelineEntrySize   = 10,
+        TimelineMaxEntries  = (MaxLength - 3) / TimelineEntrySize,  // per frame
+        TimelineCapacity    = 64,   // firmware ring size until the first ACK reports it, 8 on 8u2/16u2
+    };
+
+    enum Type : quint8
+    {
+        // host -> device
+        TypePing        = 0x00,
+        TypeState       = 0x01,
+        TypeBye         = 0x02,
+        TypeTimelinePush    = 0x03,
+        TypeTimelineClear   = 0x04,
+
+        // device -> host
+        TypeAck             = 0x80,
+        TypeTimelineStatus  = 0x81,
+    };
+
+    enum TimelineFlag : quint8
+    {
+        TimelineEnd     = 0x01, // push: no more entries after these
+        TimelineActive  = 0x01, // status: timeline is playing
+        TimelineDone    = 0x02, // status: reached the end
+    };
+
+    enum Status : quint8
+    {
+        StatusOK            = 0x00,
+        StatusDuplicate     = 0x01,
+        StatusOutOfOrder    = 0x02,
+        StatusBadCRC        = 0x03,
+        StatusBadType       = 0x04,
+        StatusFull          = 0x05, // timeline has no room, frame not consumed
+        StatusBusy          = 0x06, // state ignored while a timeline is playing, frame consumed
+    };
+
+    struct Frame
+    {
+        quint8      m_seq = 0;
+        quint8      m_type = TypePing;
+        QByteArray  m_payload;
+    };
+
+    // one state held for a number of USB reports
+    struct TimelineEntry
+    {
+        quint32 m_buttonFlag = 0;
+        quint8  m_lx = 128;
+        quint8  m_ly = 128;
+        quint8  m_rx = 128;
+        quint8  m_ry = 128;
+        quint16 m_frames = 1;
+    };
+
+    // CRC-8 poly 0x07 init 0, same as avr-libc _crc8_ccitt_update
+    quint8 Crc8(quint8 crc, quint8 data);
+
+    QByteArray EncodeHello(quint8 version, quint32 baudRate);
+    QByteArray EncodeFrame(Frame const& frame);
+
+    // write into a caller owned buffer, out must hold StateSize/MaxFrameSize bytes, returns size written
+    int WriteState(char* out, quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry);
+    int WriteFrame(char* out, Frame const& frame);
+    QByteArray EncodeState(quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry);
+    QByteArray EncodeTimeline(TimelineEntry const* entries, int count, bool end);
+
+    // -1.0 to 1.0 to byte, y axis is flipped by caller
+    inline quint8 StickToByte(qreal pos) { return quint8(qCeil((pos + 1.0) * 0.5 * 255)); }
+
+    // Incremental decoder, bytes can arrive split at any point
+    class Parser
+    {
+    public:
+        void Reset();
+        void Feed(QByteArray const& data, QVector<Frame>& frames);
+        quint64 GetCRCErrors() const { return m_crcErrors; }
+
+    private:
+        enum class State
+        {
+            Sync,
+            Length,
+            Body,
+            CRC,
+        };
+
+        State       m_state = State::Sync;
+        quint8      m_length = 0;
+        quint8      m_crc = 0;
+        QByteArray  m_body;
+        quint64     m_crcErrors = 0;
+    };
+};
+
+Q_DECLARE_METATYPE(SerialProtocol::TimelineEntry)
+
+#endif // SERIALPROTOCOL_H
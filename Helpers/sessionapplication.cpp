@@ -0,0 +1,56 @@
+#include "sessionapplication.h"
+
+#include <QJsonArray>
+
+#include "Helpers/jsonhelper.h"
+#include "Helpers/sessioncontext.h"
+
+SessionApplication::SessionApplication(int &argc, char **argv)
+    : QApplication(argc, argv)
+{
+
+}
+
+int SessionApplication::ConfigureSessions()
+{
+    int count = 1;
+    QVector<quint64> affinities;
+
+    // shared by all sessions, read before any session exists
+    QJsonObject const settings = JsonHelper::ReadSetting("Sessions");
+    {
+        QVariant sessionCount;
+        if (JsonHelper::ReadValue(settings, "Count", sessionCount))
+        {
+            count = qBound(1, sessionCount.toInt(), SESSION_MAX_COUNT);
+        }
+
+        // one core list per session e.g. ["0-3", "4-7"], empty or missing runs on any core
+        QJsonArray const cores = settings.value("Cores").toArray();
+        for (QJsonValue const& value : cores)
+        {
+            affinities.push_back(SessionContext::ParseCoreList(value.toString()));
+        }
+    }
+
+    SessionContext::Configure(count, affinities);
+    return count;
+}
+
+bool SessionApplication::notify(QObject *receiver, QEvent *event)
+{
+    // nothing to switch with a single console
+    if (SessionContext::GetCount() <= 1)
+    {
+        return QApplication::notify(receiver, event);
+    }
+
+    int const session = SessionContext::FromObject(receiver);
+    if (session < 0)
+    {
+        return QApplication::notify(receiver, event);
+    }
+
+    SessionContext::Scope scope(session);
+    return QApplication::notify(receiver, event);
+}
@@ -0,0 +1,22 @@
+#ifndef SESSIONAPPLICATION_H
+#define SESSIONAPPLICATION_H
+
+#include <QApplication>
+
+// All sessions share the GUI thread, every event is delivered in the session of its receiver
+// (or the nearest parent with one) so slots find their own managers without passing them around
+class SessionApplication : public QApplication
+{
+    Q_OBJECT
+
+public:
+    SessionApplication(int& argc, char** argv);
+
+    // reads "Sessions" from settings, returns the number of sessions
+    int ConfigureSessions();
+
+    // from QApplication
+    bool notify(QObject* receiver, QEvent* event) override;
+};
+
+#endif // SESSIONAPPLICATION_H
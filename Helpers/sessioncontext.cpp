@@ -0,0 +1,126 @@
+#include "sessioncontext.h"
+
+#include <QStringList>
+#include <QThread>
+#include <QVariant>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+int s_count = 1;
+quint64 s_affinities[SESSION_MAX_COUNT] = {};
+
+thread_local int s_current = 0;
+thread_local quint64 s_pinnedMask = 0;
+}
+
+void SessionContext::Configure(int count, const QVector<quint64> &affinities)
+{
+    s_count = qBound(1, count, SESSION_MAX_COUNT);
+    for (int i = 0; i < SESSION_MAX_COUNT; i++)
+    {
+        s_affinities[i] = i < affinities.size() ? affinities[i] : 0;
+    }
+}
+
+int SessionContext::GetCount()
+{
+    return s_count;
+}
+
+int SessionContext::Current()
+{
+    return s_current;
+}
+
+void SessionContext::SetCurrent(int session)
+{
+    s_current = qBound(0, session, SESSION_MAX_COUNT - 1);
+}
+
+int SessionContext::FromObject(const QObject *object)
+{
+    for (; object; object = object->parent())
+    {
+        QVariant const session = object->property(SESSION_PROPERTY);
+        if (session.isValid())
+        {
+            return session.toInt();
+        }
+    }
+    return -1;
+}
+
+void SessionContext::SetObjectSession(QObject *object, int session)
+{
+    object->setProperty(SESSION_PROPERTY, session);
+}
+
+void SessionContext::AttachThread(QThread *thread)
+{
+    int const session = Current();
+    SetObjectSession(thread, session);
+    QObject::connect(thread, &QThread::started, thread, [session]
+    {
+        SetCurrent(session);
+        PinCurrentThread();
+    }, Qt::DirectConnection);
+}
+
+void SessionContext::PinCurrentThread()
+{
+    quint64 const mask = s_affinities[s_current];
+    if (mask == 0 || mask == s_pinnedMask) return;
+    s_pinnedMask = mask;
+
+#ifdef Q_OS_WIN
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(mask));
+#elif defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < 64; i++)
+    {
+        if (mask & (1ULL << i))
+        {
+            CPU_SET(i, &set);
+        }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+QString SessionContext::GetSuffix(int session)
+{
+    return session == 0 ? QString() : "_Session" + QString::number(session + 1);
+}
+
+QString SessionContext::GetTitle(const QString &title)
+{
+    return s_count <= 1 ? title : title + " - Session " + QString::number(Current() + 1);
+}
+
+quint64 SessionContext::ParseCoreList(const QString &cores)
+{
+    quint64 mask = 0;
+    for (QString const& part : cores.split(',', Qt::SkipEmptyParts))
+    {
+        QStringList const range = part.trimmed().split('-');
+        bool okFirst = false;
+        bool okLast = true;
+        int const first = range[0].toInt(&okFirst);
+        int const last = range.size() > 1 ? range[1].toInt(&okLast) : first;
+        if (!okFirst || !okLast) continue;
+
+        for (int i = qMax(0, first); i <= qMin(63, last); i++)
+        {
+            mask |= 1ULL << i;
+        }
+    }
+    return mask;
+}
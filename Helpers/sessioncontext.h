@@ -0,0 +1,58 @@
+#ifndef SESSIONCONTEXT_H
+#define SESSIONCONTEXT_H
+
+#include <QString>
+#include <QVector>
+
+class QObject;
+class QThread;
+
+#define SESSION_MAX_COUNT   16
+#define SESSION_PROPERTY    "session"
+
+// A session drives one console with its own capture, audio, serial link, program and modules
+// The session of the calling thread decides which managers, settings and media timeline are used,
+// thread pools and FFT/LUT caches are shared by all sessions
+class SessionContext
+{
+public:
+    // call once at startup before any session is created, affinities are core masks, 0 = any core
+    static void Configure(int count, QVector<quint64> const& affinities);
+    static int GetCount();
+
+    // session of the calling thread, 0 unless set
+    static int Current();
+    static void SetCurrent(int session);
+
+    // session of the object or its nearest parent, -1 if none was set
+    static int FromObject(QObject const* object);
+    static void SetObjectSession(QObject* object, int session);
+
+    // call before start(), the thread runs in the current session and is pinned to its cores
+    static void AttachThread(QThread* thread);
+    static void PinCurrentThread();
+
+    // empty for session 0 so a single console keeps its settings, logs and titles
+    static QString GetSuffix(int session);
+    static QString GetSettingKey(QString const& key) { return key + GetSuffix(Current()); }
+    static QString GetTitle(QString const& title);
+
+    // "0-3,8" to a core mask
+    static quint64 ParseCoreList(QString const& cores);
+
+    // switches the calling thread to another session until destroyed
+    class Scope
+    {
+    public:
+        explicit Scope(int session) : m_previous(Current()) { SetCurrent(session); }
+        ~Scope() { SetCurrent(m_previous); }
+
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        int m_previous;
+    };
+};
+
+#endif // SESSIONCONTEXT_H
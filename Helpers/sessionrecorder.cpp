@@ -0,0 +1,255 @@
+#include "sessionrecorder.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QJsonDocument>
+
+#include "Helpers/inputscheduler.h"
+#include "Helpers/sessioncontext.h"
+
+#define SESSION_RECORDER_BATCH_MS       20
+#define SESSION_RECORDER_JPEG_QUALITY   95  // color matches have a threshold of 10, keep artifacts well below it
+
+SessionRecorder::SessionRecorder(QObject *parent)
+    : QThread{parent}
+{
+    SessionContext::AttachThread(this);
+    this->start(QThread::LowPriority);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    Stop();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_terminate = true;
+        m_condition.wakeAll();
+    }
+    this->wait();
+}
+
+void SessionRecorder::Start(const QString &file, const QJsonObject &header)
+{
+    Stop();
+
+    {
+        QMutexLocker locker(&m_inputsMutex);
+        m_inputs.clear();
+    }
+    m_dropped = 0;
+    m_fileSize = 0;
+    m_startTime = InputScheduler::Now();
+
+    if (!file.isEmpty())
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_closed = false;
+        }
+
+        Record record;
+        record.m_command = Command::Open;
+        record.m_data = file.toUtf8();
+        record.m_header = header;
+        record.m_header.insert("Version", SessionRecording::Version);
+        record.m_header.insert("Created", QDateTime::currentDateTime().toString(Qt::ISODate));
+        Push(record, true);
+        m_writing = true;
+    }
+    m_recording = true;
+}
+
+void SessionRecorder::Stop()
+{
+    if (!m_recording.exchange(false)) return;
+    if (!m_writing.exchange(false)) return;
+
+    // everything pushed before this is written before the file is closed
+    Record record;
+    record.m_command = Command::Close;
+    Push(record, true);
+
+    QMutexLocker locker(&m_mutex);
+    while (!m_closed)
+    {
+        m_closedCondition.wait(&m_mutex);
+    }
+}
+
+void SessionRecorder::PushFrame(const QImage &frame)
+{
+    if (!m_writing.load(std::memory_order_relaxed)) return;
+
+    Record record;
+    record.m_type = SessionRecording::RecordType::Video;
+    record.m_time = InputScheduler::Now() - m_startTime;
+    record.m_frame = frame;
+    Push(record, false);
+}
+
+void SessionRecorder::PushAudio(const char *data, int size, qint64 ptsLead)
+{
+    if (!m_writing.load(std::memory_order_relaxed)) return;
+
+    Record record;
+    record.m_type = SessionRecording::RecordType::Audio;
+    record.m_time = InputScheduler::Now() - m_startTime;
+    record.m_data = SessionRecording::EncodeAudio(data, size, ptsLead);
+    Push(record, false);
+}
+
+void SessionRecorder::PushInput(qint64 time, quint8 source, quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry)
+{
+    if (!m_recording.load(std::memory_order_relaxed)) return;
+
+    SessionRecording::Input input;
+    input.m_time = time;
+    input.m_source = source;
+    input.m_buttonFlag = buttonFlag;
+    input.m_lx = lx;
+    input.m_ly = ly;
+    input.m_rx = rx;
+    input.m_ry = ry;
+
+    // only a replay keeps them in memory, a live recording can run for days
+    if (!m_writing.load(std::memory_order_relaxed))
+    {
+        QMutexLocker locker(&m_inputsMutex);
+        m_inputs.push_back(input);
+        return;
+    }
+
+    Record record;
+    record.m_type = SessionRecording::RecordType::Input;
+    record.m_time = input.m_time - m_startTime;
+    record.m_data = SessionRecording::EncodeInput(input);
+    Push(record, true);
+}
+
+void SessionRecorder::PushMarker(const QJsonObject &marker)
+{
+    if (!m_writing.load(std::memory_order_relaxed)) return;
+
+    Record record;
+    record.m_type = SessionRecording::RecordType::Marker;
+    record.m_time = InputScheduler::Now() - m_startTime;
+    record.m_data = QJsonDocument(marker).toJson(QJsonDocument::Compact);
+    Push(record, true);
+}
+
+QVector<SessionRecording::Input> SessionRecorder::GetInputs() const
+{
+    QMutexLocker locker(&m_inputsMutex);
+    return m_inputs;
+}
+
+void SessionRecorder::run()
+{
+    while (true)
+    {
+        bool terminate = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_terminate)
+            {
+                m_condition.wait(&m_mutex, SESSION_RECORDER_BATCH_MS);
+            }
+            terminate = m_terminate;
+        }
+
+        Record record;
+        while (m_queue.Pop(record))
+        {
+            Write(record);
+        }
+
+        // flushed every batch so a crash loses at most one batch
+        if (m_file.isOpen())
+        {
+            m_file.flush();
+            m_fileSize = m_file.size();
+        }
+
+        if (terminate) break;
+    }
+
+    Close();
+}
+
+void SessionRecorder::Push(const Record &record, bool wait)
+{
+    // inputs, markers and commands are never dropped, frames and audio are
+    while (!m_queue.Push(record))
+    {
+        if (!wait)
+        {
+            m_dropped++;
+            return;
+        }
+        QThread::msleep(1);
+    }
+
+    if (record.m_command != Command::Record)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_condition.wakeAll();
+    }
+}
+
+void SessionRecorder::Write(const Record &record)
+{
+    switch (record.m_command)
+    {
+    case Command::Open:
+    {
+        Open(QString::fromUtf8(record.m_data), record.m_header);
+        return;
+    }
+    case Command::Close:
+    {
+        Close();
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_closedCondition.wakeAll();
+        return;
+    }
+    case Command::Record: break;
+    }
+
+    if (!m_file.isOpen()) return;
+
+    QByteArray payload = record.m_data;
+    if (record.m_type == SessionRecording::RecordType::Video)
+    {
+        QBuffer buffer(&payload);
+        buffer.open(QIODevice::WriteOnly);
+        record.m_frame.save(&buffer, "JPG", SESSION_RECORDER_JPEG_QUALITY);
+    }
+
+    m_stream << quint8(record.m_type) << record.m_time << payload;
+}
+
+void SessionRecorder::Open(const QString &file, const QJsonObject &header)
+{
+    Close();
+
+    m_file.setFileName(file);
+    if (!m_file.open(QIODevice::WriteOnly))
+    {
+        emit notifyLog("Recording", "Unable to open " + file + ", " + m_file.errorString(), LOG_Error);
+        return;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_6_0);
+    m_stream.writeRawData("AC2R", 4);
+    m_stream << SessionRecording::Version << QJsonDocument(header).toJson(QJsonDocument::Compact);
+}
+
+void SessionRecorder::Close()
+{
+    if (!m_file.isOpen()) return;
+
+    m_stream.setDevice(Q_NULLPTR);
+    m_file.close();
+}
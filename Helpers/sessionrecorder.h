@@ -0,0 +1,99 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QFile>
+#include <QImage>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+#include "Helpers/mpscqueue.h"
+#include "Helpers/sessionrecording.h"
+#include "Types/system.h"
+
+// Producers push frames, audio and controller states without locking while recording,
+// a writer thread compresses frames and appends everything to a SessionRecording file
+// Without a file only controller states are kept, in memory, so a replay can compare them without reading a file back
+class SessionRecorder : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SessionRecorder(QObject *parent = nullptr);
+    ~SessionRecorder();
+
+    // GUI thread, empty file only keeps controller states in memory
+    void Start(QString const& file, QJsonObject const& header);
+    void Stop();
+    bool IsRecording() const { return m_recording.load(std::memory_order_relaxed); }
+
+    // any thread, ignored when not recording, frames are counted as dropped if the writer falls behind
+    void PushFrame(QImage const& frame);
+    void PushAudio(char const* data, int size, qint64 ptsLead);
+    void PushInput(qint64 time, quint8 source, quint32 buttonFlag, quint8 lx, quint8 ly, quint8 rx, quint8 ry);
+    void PushMarker(QJsonObject const& marker);
+
+    // controller states of the current or last memory-only recording, on the InputScheduler clock
+    // timeline states are pushed ahead of time so these are not always in time order
+    QVector<SessionRecording::Input> GetInputs() const;
+
+    quint64 GetDroppedCount() const { return m_dropped; }
+    qint64 GetFileSize() const { return m_fileSize; }
+
+signals:
+    // writer thread
+    void notifyLog(QString const& category, QString const& log, LogType type = LOG_Normal) const;
+
+protected:
+    // from QThread
+    void run() override;
+
+private: // types
+    enum class Command : quint8
+    {
+        Record,
+        Open,       // m_data is the file name, m_header the header
+        Close,
+    };
+
+    struct Record
+    {
+        Command     m_command = Command::Record;
+        SessionRecording::RecordType m_type = SessionRecording::RecordType::Marker;
+        qint64      m_time = 0;
+        QImage      m_frame;
+        QByteArray  m_data;
+        QJsonObject m_header;
+    };
+
+private:
+    void Push(Record const& record, bool wait);
+    void Write(Record const& record);
+    void Open(QString const& file, QJsonObject const& header);
+    void Close();
+
+private:
+    MpscQueue<Record, 256>  m_queue;
+    std::atomic_bool        m_recording = false;
+    std::atomic_bool        m_writing = false;  // recording to a file, not just controller states
+    std::atomic<qint64>     m_startTime = 0;
+    std::atomic<quint64>    m_dropped = 0;
+    std::atomic<qint64>     m_fileSize = 0;
+
+    QMutex          m_mutex;
+    QWaitCondition  m_condition;
+    QWaitCondition  m_closedCondition;
+    bool            m_terminate = false;
+    bool            m_closed = true;
+
+    mutable QMutex                      m_inputsMutex;
+    QVector<SessionRecording::Input>    m_inputs;
+
+    // writer thread only
+    QFile           m_file;
+    QDataStream     m_stream;
+};
+
+#endif // SESSIONRECORDER_H
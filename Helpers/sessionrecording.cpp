@@ -0,0 +1,165 @@
+#include "sessionrecording.h"
+
+#include <QJsonDocument>
+#include <QtEndian>
+
+#define SESSION_RECORDING_MAGIC         "AC2R"
+#define SESSION_RECORDING_INPUT_SIZE    9
+#define SESSION_RECORDING_MISMATCHES    10
+
+namespace SessionRecording
+{
+
+bool Input::IsSameState(const Input &other) const
+{
+    return m_buttonFlag == other.m_buttonFlag
+        && m_lx == other.m_lx && m_ly == other.m_ly
+        && m_rx == other.m_rx && m_ry == other.m_ry;
+}
+
+QString Input::ToString() const
+{
+    QString str = "0x" + QString::number(m_buttonFlag, 16);
+    str += " L(" + QString::number(m_lx) + "," + QString::number(m_ly) + ")";
+    str += " R(" + QString::number(m_rx) + "," + QString::number(m_ry) + ")";
+    str += " at " + QString::number(qreal(m_time) / 1000000.0, 'f', 1) + "ms";
+    return str;
+}
+
+QByteArray EncodeInput(const Input &input)
+{
+    QByteArray data(SESSION_RECORDING_INPUT_SIZE, Qt::Uninitialized);
+    data[0] = char(input.m_source);
+    qToLittleEndian<quint32>(input.m_buttonFlag, data.data() + 1);
+    data[5] = char(input.m_lx);
+    data[6] = char(input.m_ly);
+    data[7] = char(input.m_rx);
+    data[8] = char(input.m_ry);
+    return data;
+}
+
+bool DecodeInput(const Record &record, Input &input)
+{
+    if (record.m_type != RecordType::Input || record.m_data.size() < SESSION_RECORDING_INPUT_SIZE) return false;
+
+    uchar const* data = (uchar const*)record.m_data.constData();
+    input.m_time = record.m_time;
+    input.m_source = data[0];
+    input.m_buttonFlag = qFromLittleEndian<quint32>(data + 1);
+    input.m_lx = data[5];
+    input.m_ly = data[6];
+    input.m_rx = data[7];
+    input.m_ry = data[8];
+    return true;
+}
+
+QByteArray EncodeAudio(const char *data, int size, qint64 ptsLead)
+{
+    QByteArray audio(int(sizeof(qint64)) + size, Qt::Uninitialized);
+    qToLittleEndian<qint64>(ptsLead, audio.data());
+    memcpy(audio.data() + sizeof(qint64), data, size);
+    return audio;
+}
+
+bool DecodeAudio(const Record &record, QByteArray &pcm, qint64 &ptsLead)
+{
+    if (record.m_type != RecordType::Audio || record.m_data.size() < int(sizeof(qint64))) return false;
+
+    ptsLead = qFromLittleEndian<qint64>(record.m_data.constData());
+    pcm = record.m_data.mid(sizeof(qint64));
+    return true;
+}
+
+Comparison CompareInputs(const QVector<Input> &expected, const QVector<Input> &actual, qint64 tolerance)
+{
+    Comparison comparison;
+    comparison.m_expected = expected.size();
+    comparison.m_actual = actual.size();
+
+    auto addMismatch = [&comparison](QString const& mismatch)
+    {
+        if (comparison.m_mismatches.size() < SESSION_RECORDING_MISMATCHES)
+        {
+            comparison.m_mismatches << mismatch;
+        }
+    };
+
+    qint64 totalError = 0;
+    int const count = qMin(expected.size(), actual.size());
+    for (int i = 0; i < count; i++)
+    {
+        Input const& e = expected[i];
+        Input const& a = actual[i];
+        qint64 const error = qAbs(a.m_time - e.m_time);
+        if (!e.IsSameState(a))
+        {
+            addMismatch("Input " + QString::number(i) + ": expected " + e.ToString() + ", got " + a.ToString());
+        }
+        else if (error > tolerance)
+        {
+            addMismatch("Input " + QString::number(i) + ": " + e.ToString() + " is off by " + QString::number(qreal(a.m_time - e.m_time) / 1000000.0, 'f', 1) + "ms");
+        }
+        else
+        {
+            comparison.m_matched++;
+            comparison.m_maxError = qMax(comparison.m_maxError, error);
+            totalError += error;
+        }
+    }
+
+    if (expected.size() > count)
+    {
+        addMismatch(QString::number(expected.size() - count) + " expected inputs never sent, first is " + expected[count].ToString());
+    }
+    else if (actual.size() > count)
+    {
+        addMismatch(QString::number(actual.size() - count) + " extra inputs sent, first is " + actual[count].ToString());
+    }
+
+    comparison.m_meanError = comparison.m_matched > 0 ? totalError / comparison.m_matched : 0;
+    return comparison;
+}
+
+bool Reader::Open(const QString &fileName, QString &errorMsg)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        errorMsg = "Unable to open " + fileName;
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_6_0);
+
+    char magic[4];
+    quint16 version = 0;
+    QByteArray header;
+    if (m_stream.readRawData(magic, 4) != 4 || memcmp(magic, SESSION_RECORDING_MAGIC, 4) != 0)
+    {
+        errorMsg = fileName + " is not a session recording";
+        return false;
+    }
+
+    m_stream >> version >> header;
+    if (m_stream.status() != QDataStream::Ok || version > Version)
+    {
+        errorMsg = fileName + " has unsupported version " + QString::number(version);
+        return false;
+    }
+
+    m_header = QJsonDocument::fromJson(header).object();
+    return true;
+}
+
+bool Reader::ReadNext(Record &record)
+{
+    if (m_stream.atEnd()) return false;
+
+    quint8 type = 0;
+    m_stream >> type >> record.m_time >> record.m_data;
+    record.m_type = RecordType(type);
+    return m_stream.status() == QDataStream::Ok;
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef SESSIONRECORDING_H
+#define SESSIONRECORDING_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QJsonObject>
+#include <QStringList>
+#include <QVector>
+
+// Single file recording of a session: "AC2R", version, JSON header, then records in time order
+// each record is type (quint8), time since recording started (qint64 ns) and payload (QByteArray)
+// records are appended as they come, a recording cut short is readable up to the last whole record
+// inputs of a firmware timeline carry the time they are played, which can be ahead of the records around them
+namespace SessionRecording
+{
+    constexpr quint16 Version = 1;
+
+    inline QString GetDirectory() { return "../Recordings/"; }
+    inline QString GetFormat() { return ".ac2rec"; }
+
+    enum class RecordType : quint8
+    {
+        Video,      // JPEG at capture resolution
+        Audio,      // pts lead (qint64 us) then PCM in the header's audio format
+        Input,      // controller state handed to the serial port
+        Marker,     // JSON, e.g. {"Type":"ProgramStart", ...}
+    };
+
+    struct Record
+    {
+        RecordType  m_type = RecordType::Marker;
+        qint64      m_time = 0;
+        QByteArray  m_data;
+    };
+
+    struct Input
+    {
+        qint64  m_time = 0;
+        quint8  m_source = 0;       // SerialHolder::StateSource
+        quint32 m_buttonFlag = 0;
+        quint8  m_lx = 128;
+        quint8  m_ly = 128;
+        quint8  m_rx = 128;
+        quint8  m_ry = 128;
+
+        bool IsSameState(Input const& other) const;
+        QString ToString() const;
+    };
+
+    QByteArray EncodeInput(Input const& input);
+    bool DecodeInput(Record const& record, Input& input);
+    QByteArray EncodeAudio(char const* data, int size, qint64 ptsLead);
+    bool DecodeAudio(Record const& record, QByteArray& pcm, qint64& ptsLead);
+
+    struct Comparison
+    {
+        int     m_expected = 0;
+        int     m_actual = 0;
+        int     m_matched = 0;      // same state within tolerance
+        qint64  m_maxError = 0;     // ns, of the matched inputs
+        qint64  m_meanError = 0;
+        QStringList m_mismatches;   // first few only
+
+        bool IsPassed() const { return m_matched == m_expected && m_matched == m_actual; }
+    };
+
+    // inputs are paired in order, times are relative to the program start in each run
+    Comparison CompareInputs(QVector<Input> const& expected, QVector<Input> const& actual, qint64 tolerance);
+
+    class Reader
+    {
+    public:
+        bool Open(QString const& fileName, QString& errorMsg);
+        QJsonObject const& GetHeader() const { return m_header; }
+
+        // false at the end or at a partly written record
+        bool ReadNext(Record& record);
+
+    private:
+        QFile       m_file;
+        QDataStream m_stream;
+        QJsonObject m_header;
+    };
+}
+
+#endif // SESSIONRECORDING_H
@@ -0,0 +1,107 @@
+#include "sessionreplayer.h"
+
+#include <QJsonDocument>
+
+#include "Helpers/inputscheduler.h"
+#include "Helpers/mediatimeline.h"
+#include "Helpers/sessioncontext.h"
+#include "Helpers/sessionrecording.h"
+#include "Managers/audiomanager.h"
+#include "Managers/videomanager.h"
+
+#define SESSION_REPLAYER_SLEEP_MS   50  // longest sleep between checking for stop
+
+SessionReplayer::SessionReplayer(const QString &file, VideoManager *videoManager, AudioManager *audioManager, QObject *parent)
+    : QThread{parent}
+    , m_file(file)
+    , m_videoManager(videoManager)
+    , m_audioManager(audioManager)
+{
+    SessionContext::AttachThread(this);
+}
+
+SessionReplayer::~SessionReplayer()
+{
+    Stop();
+    this->wait();
+}
+
+void SessionReplayer::Stop()
+{
+    m_stop = true;
+}
+
+void SessionReplayer::run()
+{
+    SessionRecording::Reader reader;
+    QString errorMsg;
+    if (!reader.Open(m_file, errorMsg))
+    {
+        emit notifyFinished(errorMsg);
+        return;
+    }
+
+    // PCM is handed over as is, it must match what AudioManager converts
+    QJsonObject const& header = reader.GetHeader();
+    QAudioFormat const format = m_audioManager->GetAudioFormat();
+    if (header.value("SampleRate").toInt() != format.sampleRate()
+     || header.value("Channels").toInt() != format.channelCount()
+     || header.value("SampleFormat").toInt() != int(format.sampleFormat()))
+    {
+        emit notifyFinished("Recorded audio format does not match the current audio format");
+        return;
+    }
+
+    int const bytesPerFrame = format.bytesPerFrame();
+    m_startTime = InputScheduler::Now();
+
+    SessionRecording::Record record;
+    while (!m_stop && reader.ReadNext(record))
+    {
+        if (!WaitUntil(record.m_time)) break;
+
+        switch (record.m_type)
+        {
+        case SessionRecording::RecordType::Video:
+        {
+            QImage const frame = QImage::fromData(record.m_data, "JPG").convertToFormat(QImage::Format_ARGB32);
+            if (!frame.isNull())
+            {
+                m_videoManager->PushFrameData(frame, MediaTimeline::Now());
+            }
+            break;
+        }
+        case SessionRecording::RecordType::Audio:
+        {
+            QByteArray pcm;
+            qint64 ptsLead = 0;
+            if (SessionRecording::DecodeAudio(record, pcm, ptsLead) && bytesPerFrame > 0)
+            {
+                m_audioManager->PushAudioData(pcm.constData(), pcm.size() / bytesPerFrame, MediaTimeline::Now() + ptsLead);
+            }
+            break;
+        }
+        case SessionRecording::RecordType::Marker:
+        {
+            emit notifyMarker(QJsonDocument::fromJson(record.m_data).object());
+            break;
+        }
+        default: break;
+        }
+    }
+
+    emit notifyFinished(QString());
+}
+
+bool SessionReplayer::WaitUntil(qint64 time) const
+{
+    while (!m_stop)
+    {
+        qint64 const remaining = m_startTime + time - InputScheduler::Now();
+        if (remaining <= 0) return true;
+
+        // records are far apart compared to sleep accuracy, no need to spin
+        QThread::msleep(qMax(quint64(1), qMin(quint64(remaining / 1000000), quint64(SESSION_REPLAYER_SLEEP_MS))));
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+#ifndef SESSIONREPLAYER_H
+#define SESSIONREPLAYER_H
+
+#include <QJsonObject>
+#include <QThread>
+
+#include <atomic>
+
+class AudioManager;
+class VideoManager;
+
+// Feeds the frames and audio of a SessionRecording to the managers at the recorded pace,
+// as if they came from LibVLC; recorded inputs are left for the caller to compare against
+class SessionReplayer : public QThread
+{
+    Q_OBJECT
+
+public:
+    // not started until start() so signals can be connected first
+    explicit SessionReplayer(QString const& file, VideoManager* videoManager, AudioManager* audioManager, QObject *parent = nullptr);
+    ~SessionReplayer();
+
+    void Stop();
+
+signals:
+    void notifyMarker(QJsonObject const& marker);
+    void notifyFinished(QString const& errorMsg);   // empty when the end of the recording is reached
+
+protected:
+    // from QThread
+    void run() override;
+
+private:
+    bool WaitUntil(qint64 time) const;
+
+private:
+    QString         m_file;
+    VideoManager*   m_videoManager = Q_NULLPTR;
+    AudioManager*   m_audioManager = Q_NULLPTR;
+    std::atomic_bool m_stop = false;
+    qint64          m_startTime = 0;
+};
+
+#endif // SESSIONREPLAYER_H
@@ -0,0 +1,103 @@
+#include "settingsstore.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "Helpers/jsonhelper.h"
+
+#define SETTINGS_WRITE_DELAY_MS 500
+
+SettingsStore *SettingsStore::GetInstance()
+{
+    // never deleted, flushed when the application quits
+    static SettingsStore* instance = new SettingsStore(SETTINGS_FILE);
+    return instance;
+}
+
+SettingsStore::SettingsStore(const QString &path, QObject *parent)
+    : QObject{parent}
+    , m_path(path)
+{
+    m_writeTimer.setSingleShot(true);
+    m_writeTimer.setInterval(SETTINGS_WRITE_DELAY_MS);
+    connect(&m_writeTimer, &QTimer::timeout, this, &SettingsStore::Flush);
+
+    if (QCoreApplication::instance())
+    {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &SettingsStore::Flush);
+    }
+}
+
+QJsonObject SettingsStore::Read(const QString &key)
+{
+    QMutexLocker locker(&m_mutex);
+    Load();
+    return JsonHelper::ReadObject(m_settings, key);
+}
+
+void SettingsStore::Write(const QString &key, const QJsonObject &object)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        Load();
+        if (m_settings.value(key) == object) return;
+
+        m_settings.insert(key, object);
+        m_dirty = true;
+    }
+
+    ScheduleWrite();
+}
+
+void SettingsStore::Flush()
+{
+    QByteArray json;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_dirty) return;
+
+        json = QJsonDocument(m_settings).toJson();
+        m_dirty = false;
+    }
+
+    // temporary file renamed over the old one on commit
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text) || file.write(json) != json.size() || !file.commit())
+    {
+        // try again with the next change
+        QMutexLocker locker(&m_mutex);
+        m_dirty = true;
+    }
+}
+
+void SettingsStore::Load()
+{
+    if (m_loaded) return;
+    m_loaded = true;
+
+    QFile file(m_path);
+    if (!file.open(QFile::ReadOnly)) return;
+
+    QJsonParseError error;
+    QJsonDocument const jsonDocument = QJsonDocument::fromJson(file.readAll(), &error);
+    file.close();
+
+    if (error.error == QJsonParseError::NoError)
+    {
+        m_settings = jsonDocument.object();
+    }
+    else
+    {
+        // keep the broken file around instead of overwriting it with defaults
+        QFile::remove(m_path + ".bad");
+        QFile::copy(m_path, m_path + ".bad");
+    }
+}
+
+void SettingsStore::ScheduleWrite()
+{
+    // restarts the timer, a burst of writes is saved once after it settles
+    QMetaObject::invokeMethod(&m_writeTimer, qOverload<>(&QTimer::start), Qt::AutoConnection);
+}
@@ -0,0 +1,42 @@
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+
+// Settings file parsed once and served from memory, writes are debounced
+// and saved with QSaveFile so a crash never leaves a half written file
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    // created on first use, lives in the thread that first used it (GUI)
+    static SettingsStore* GetInstance();
+
+    // any thread
+    QJsonObject Read(QString const& key);
+    void Write(QString const& key, QJsonObject const& object);
+
+    // write now if anything changed, call before exit
+    void Flush();
+
+private:
+    explicit SettingsStore(QString const& path, QObject* parent = nullptr);
+
+    void Load();
+    void ScheduleWrite();
+
+private:
+    QString     m_path;
+    QTimer      m_writeTimer;
+
+    QMutex      m_mutex;
+    QJsonObject m_settings;
+    bool        m_loaded = false;
+    bool        m_dirty = false;
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,165 @@
+#include "tracer.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <limits>
+
+#include "Helpers/inputscheduler.h"
+
+#define TRACER_RING_SIZE    16384   // events per thread, oldest are overwritten
+
+std::atomic_bool Tracer::s_enabled = false;
+
+namespace
+{
+struct TraceEvent
+{
+    char const* m_category = nullptr;
+    char const* m_name = nullptr;
+    qint64      m_start = 0;
+    qint64      m_end = 0;
+};
+
+// written only by its own thread
+struct ThreadRing
+{
+    int                     m_tid = 0;
+    QString                 m_threadName;
+    std::atomic<quint32>    m_count = 0;
+    std::atomic_bool        m_alive = true;
+    TraceEvent              m_events[TRACER_RING_SIZE];
+};
+
+QMutex s_ringsMutex;
+QVector<ThreadRing*> s_rings;
+int s_nextTid = 1;
+
+// marks the ring as reusable when its thread exits, events stay until the next Start()
+struct ThreadRingOwner
+{
+    ThreadRing* m_ring = nullptr;
+    ~ThreadRingOwner()
+    {
+        if (m_ring)
+        {
+            m_ring->m_alive = false;
+        }
+    }
+};
+
+thread_local ThreadRingOwner s_ringOwner;
+
+ThreadRing* GetThreadRing()
+{
+    if (s_ringOwner.m_ring) return s_ringOwner.m_ring;
+
+    QThread* thread = QThread::currentThread();
+    QString name = thread->objectName();
+    if (name.isEmpty())
+    {
+        // module class for our threads, plain QThread for the ones LibVLC creates
+        name = thread->metaObject()->className();
+    }
+
+    ThreadRing* ring = new ThreadRing();
+    QMutexLocker locker(&s_ringsMutex);
+    ring->m_tid = s_nextTid++;
+    ring->m_threadName = name + " " + QString::number(ring->m_tid);
+    s_rings.push_back(ring);
+
+    s_ringOwner.m_ring = ring;
+    return ring;
+}
+}
+
+void Tracer::Start()
+{
+    QMutexLocker locker(&s_ringsMutex);
+    for (int i = s_rings.size() - 1; i >= 0; i--)
+    {
+        ThreadRing* ring = s_rings[i];
+        if (!ring->m_alive)
+        {
+            delete ring;
+            s_rings.removeAt(i);
+        }
+        else
+        {
+            ring->m_count = 0;
+        }
+    }
+
+    s_enabled = true;
+}
+
+void Tracer::Stop()
+{
+    s_enabled = false;
+}
+
+int Tracer::Save(const QString &fileName)
+{
+    QMutexLocker locker(&s_ringsMutex);
+
+    // timestamps are relative to the earliest event so the viewer starts at 0
+    qint64 origin = std::numeric_limits<qint64>::max();
+    for (ThreadRing const* ring : std::as_const(s_rings))
+    {
+        quint32 const count = ring->m_count.load(std::memory_order_acquire);
+        quint32 const first = count > TRACER_RING_SIZE ? count - TRACER_RING_SIZE : 0;
+        for (quint32 i = first; i < count; i++)
+        {
+            origin = qMin(origin, ring->m_events[i % TRACER_RING_SIZE].m_start);
+        }
+    }
+
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"AutoController2\"}}";
+
+    int written = 0;
+    for (ThreadRing const* ring : std::as_const(s_rings))
+    {
+        QByteArray const tid = QByteArray::number(ring->m_tid);
+        json += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":\"" + ring->m_threadName.toUtf8() + "\"}}";
+
+        quint32 const count = ring->m_count.load(std::memory_order_acquire);
+        quint32 const first = count > TRACER_RING_SIZE ? count - TRACER_RING_SIZE : 0;
+        for (quint32 i = first; i < count; i++)
+        {
+            TraceEvent const& event = ring->m_events[i % TRACER_RING_SIZE];
+            json += ",\n{\"name\":\"" + QByteArray(event.m_name) + "\",\"cat\":\"" + QByteArray(event.m_category) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid;
+            json += ",\"ts\":" + QByteArray::number(double(event.m_start - origin) / 1000.0, 'f', 3);
+            json += ",\"dur\":" + QByteArray::number(double(event.m_end - event.m_start) / 1000.0, 'f', 3) + "}";
+            written++;
+        }
+    }
+    json += "\n]}\n";
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size())
+    {
+        return -1;
+    }
+    return written;
+}
+
+qint64 Tracer::Now()
+{
+    // same clock as the input deadlines
+    return InputScheduler::Now();
+}
+
+void Tracer::AddEvent(const char *category, const char *name, qint64 start, qint64 end)
+{
+    ThreadRing* ring = GetThreadRing();
+    quint32 const count = ring->m_count.load(std::memory_order_relaxed);
+    TraceEvent& event = ring->m_events[count % TRACER_RING_SIZE];
+    event.m_category = category;
+    event.m_name = name;
+    event.m_start = start;
+    event.m_end = end;
+    ring->m_count.store(count + 1, std::memory_order_release);
+}
@@ -0,0 +1,63 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+
+#include <atomic>
+
+// Scoped timing events recorded into per-thread rings, saved in the Chrome trace event format
+// (chrome://tracing or ui.perfetto.dev). A disabled scope costs one relaxed atomic load.
+//
+//     TRACE_SCOPE("video", "VideoManager::PushFrameData");
+//
+// category and name must be string literals, only the pointers are stored
+class Tracer
+{
+public:
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Start() clears whatever was recorded before
+    static void Start();
+    static void Stop();
+
+    // call after Stop(), returns the number of events written or -1 on failure
+    static int Save(QString const& fileName);
+
+    static qint64 Now();
+    static void AddEvent(char const* category, char const* name, qint64 start, qint64 end);
+
+private:
+    static std::atomic_bool s_enabled;
+};
+
+class TraceScope
+{
+public:
+    TraceScope(char const* category, char const* name)
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::IsEnabled() ? Tracer::Now() : -1)
+    {}
+
+    ~TraceScope()
+    {
+        if (m_start >= 0 && Tracer::IsEnabled())
+        {
+            Tracer::AddEvent(m_category, m_name, m_start, Tracer::Now());
+        }
+    }
+
+    TraceScope(TraceScope const&) = delete;
+    TraceScope& operator=(TraceScope const&) = delete;
+
+private:
+    char const* m_category;
+    char const* m_name;
+    qint64      m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(category, name) TraceScope const TRACE_CONCAT(traceScope, __LINE__)(category, name)
+
+#endif // TRACER_H
@@ -25,12 +25,18 @@ This project is based on auto-controller code written by brianuuuuSonic
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <stdint.h>
+#include <util/crc16.h>
+#include "../Config/protocol.h"
 #include "../Config/uart.h"
 #include "../Joystick.h"
 
 #define CPU_PRESCALE(n) (CLKPR = 0x80, CLKPR = (n))
 #define CHECK_BIT(var,pos) (var & (1UL << pos))
 #define VERSION 1
+#define V1_BAUD 9600
+
+// Timer1 runs at 16 MHz / 1024
+#define TIMER1_MS_TO_TICKS(ms) ((uint16_t)((ms) * 15625UL / 1000UL))
 
 // Main entry point.
 int main(void) {
@@ -61,7 +67,11 @@ void SetupHardware(void) {
 	// We can then initialize our hardware and peripherals, including the USB stack.
 	
 	CPU_PRESCALE(0);  // run at 16 MHz
-	uart_init(9600);
+	uart_init(V1_BAUD);
+	
+	// Free running Timer1 for serial idle timeout
+	TCCR1A = 0;
+	TCCR1B = (1 << CS12) | (1 << CS10);
 	
 	#ifdef ALERT_WHEN_DONE
 	// Both PORTD and PORTB will be used for the optional LED flashing and buzzer.
@@ -114,7 +124,6 @@ uint8_t left_y = STICK_CENTER;
 uint8_t right_x = STICK_CENTER;
 uint8_t right_y = STICK_CENTER;
 
-bool waiting_input = false;
 bool should_spam = false;
 
 // Process and deliver data from IN and OUT endpoints.
@@ -158,50 +167,543 @@ void HID_Task(void) {
 		Endpoint_ClearIN();
 	}
 	
-	// Check first byte in the queue, if not the mode we want, clear everything
-	if (!waiting_input && uart_available() > 0)
+	// Then process any incoming serial data
+	Serial_Task();
+}
+
+uint8_t protocol_version = 1;
+
+// v1 receive state, one byte at a time so a bad byte never costs the packets after it
+typedef enum {
+	V1_MODE,
+	V1_STATE,
+	V1_HELLO,
+} V1State_t;
+
+V1State_t v1_state = V1_MODE;
+uint8_t v1_count = 0;
+uint8_t v1_data[8];
+
+// v2 receive state
+typedef enum {
+	RX_SYNC,
+	RX_LEN,
+	RX_BODY,
+	RX_CRC,
+} RxState_t;
+
+RxState_t rx_state = RX_SYNC;
+uint8_t rx_len = 0;
+uint8_t rx_count = 0;
+uint8_t rx_crc = 0;
+uint8_t rx_frame[PROTOCOL_MAX_LEN];
+
+// bytes of a frame that failed CRC, parsed again so a frame starting inside it isn't lost,
+// the 8u2/16u2 have no room for it and rely on the host resending after the NAK
+#if !defined(__AVR_ATmega16U2__) && !defined(__AVR_ATmega8U2__)
+#define RX_REPLAY
+uint8_t rx_replay[PROTOCOL_MAX_LEN + 2];
+uint8_t rx_replay_len = 0;
+uint8_t rx_replay_pos = 0;
+#endif
+uint8_t rx_expected_seq = 0;
+uint16_t rx_last_tick = 0;
+uint8_t tx_seq = 0;
+
+// Timeline of (state, duration in reports) played back by GetNextReport
+typedef struct {
+	uint32_t button_flag;
+	uint8_t left_x;
+	uint8_t left_y;
+	uint8_t right_x;
+	uint8_t right_y;
+	uint16_t frames;
+} TimelineEntry_t;
+
+// 10 bytes per entry, the 8u2/16u2 only have 512 bytes of RAM shared with the UART buffers and the stack
+#if defined(__AVR_ATmega16U2__) || defined(__AVR_ATmega8U2__)
+#define TIMELINE_SIZE 8
+#else
+#define TIMELINE_SIZE 64
+#endif
+
+TimelineEntry_t timeline[TIMELINE_SIZE];
+uint8_t timeline_head = 0;
+uint8_t timeline_count = 0;
+uint16_t timeline_remaining = 0;
+uint16_t timeline_started = 0;
+uint16_t timeline_underruns = 0;
+bool timeline_active = false;
+bool timeline_end = false;
+bool timeline_starved = false;
+bool timeline_done = false;
+bool timeline_status_pending = false;
+
+void TimelineClear(void) {
+	timeline_head = 0;
+	timeline_count = 0;
+	timeline_remaining = 0;
+	timeline_started = 0;
+	timeline_underruns = 0;
+	timeline_active = false;
+	timeline_end = false;
+	timeline_starved = false;
+	timeline_done = false;
+	timeline_status_pending = false;
+}
+
+uint8_t TimelinePush(uint8_t const* payload, uint8_t size) {
+	// [flags][entry x N], each entry is [button x4][lx][ly][rx][ry][frames x2]
+	if (size < 1 || (size - 1) % PROTOCOL_TIMELINE_ENTRY_SIZE != 0)
+		return PROTOCOL_STATUS_BAD_TYPE;
+	
+	uint8_t const flags = payload[0];
+	uint8_t const count = (size - 1) / PROTOCOL_TIMELINE_ENTRY_SIZE;
+	
+	// an entry must last at least one report, 0 would wrap the countdown
+	for (uint8_t n = 0; n < count; n++)
+	{
+		uint8_t const* frames = &payload[1 + n * PROTOCOL_TIMELINE_ENTRY_SIZE + 8];
+		if (frames[0] == 0 && frames[1] == 0)
+			return PROTOCOL_STATUS_BAD_TYPE;
+	}
+	
+	if (count > TIMELINE_SIZE - timeline_count)
+		return PROTOCOL_STATUS_FULL;
+	
+	// a new timeline after the previous one finished
+	if (!timeline_active)
 	{
-		if (uart_getchar() == 0xFF)
+		TimelineClear();
+		timeline_active = true;
+	}
+	
+	uint8_t const* data = &payload[1];
+	for (uint8_t n = 0; n < count; n++)
+	{
+		TimelineEntry_t* entry = &timeline[(timeline_head + timeline_count) % TIMELINE_SIZE];
+		entry->button_flag = 0;
+		for (uint8_t i = 0; i < 4; i++)
 		{
-			waiting_input = true;
+			entry->button_flag |= ((uint32_t)(data[i]) << (8UL * i));
 		}
-		else
+		entry->left_x = data[4];
+		entry->left_y = data[5];
+		entry->right_x = data[6];
+		entry->right_y = data[7];
+		entry->frames = (uint16_t)data[8] | ((uint16_t)data[9] << 8);
+		
+		timeline_count++;
+		data += PROTOCOL_TIMELINE_ENTRY_SIZE;
+	}
+	
+	if (flags & PROTOCOL_TIMELINE_FLAG_END)
+	{
+		timeline_end = true;
+	}
+	return PROTOCOL_STATUS_OK;
+}
+
+// Called once per report, move to the next entry when the current one is used up
+void TimelineAdvance(void) {
+	if (!timeline_active)
+		return;
+	
+	if (timeline_remaining == 0)
+	{
+		if (timeline_count > 0)
 		{
+			TimelineEntry_t const* entry = &timeline[timeline_head];
+			timeline_head = (timeline_head + 1) % TIMELINE_SIZE;
+			timeline_count--;
+			
+			button_flag = entry->button_flag;
+			left_x = entry->left_x;
+			left_y = entry->left_y;
+			right_x = entry->right_x;
+			right_y = entry->right_y;
+			timeline_remaining = entry->frames;
+			
+			// new state applies on this report, not after the echoes
 			echoes = 0;
+			timeline_started++;
+			timeline_starved = false;
+			timeline_status_pending = true;
+		}
+		else if (timeline_end)
+		{
+			// finished, release everything
+			timeline_active = false;
+			timeline_done = true;
+			timeline_status_pending = true;
 			button_flag = 0;
 			left_x = STICK_CENTER;
 			left_y = STICK_CENTER;
 			right_x = STICK_CENTER;
 			right_y = STICK_CENTER;
-			
-			while (uart_available() > 0)
+			echoes = 0;
+			return;
+		}
+		else
+		{
+			// host is late, hold the current state until more entries arrive
+			if (!timeline_starved)
 			{
-				uart_getchar();
+				timeline_starved = true;
+				timeline_underruns++;
+				timeline_status_pending = true;
 			}
+			return;
 		}
 	}
-	else if (waiting_input && uart_available() >= 8)
+	
+	timeline_remaining--;
+}
+
+// Apply [button x4][lx][ly][rx][ry], overrides any timeline
+void ApplyState(uint8_t const* data) {
+	TimelineClear();
+	echoes = 0;
+	button_flag = 0;
+	for (uint8_t i = 0; i < 4; i++)
 	{
-		echoes = 0;
-		button_flag = 0;
-		for (uint8_t i = 0; i < 4; i++)
+		button_flag |= ((uint32_t)(data[i]) << (8UL * i));
+	}
+	
+	left_x = data[4];
+	left_y = data[5];
+	right_x = data[6];
+	right_y = data[7];
+}
+
+void ResetState(void) {
+	TimelineClear();
+	echoes = 0;
+	button_flag = 0;
+	left_x = STICK_CENTER;
+	left_y = STICK_CENTER;
+	right_x = STICK_CENTER;
+	right_y = STICK_CENTER;
+}
+
+// Change protocol, any pending output is sent at the current baud rate first
+void SetProtocol(uint8_t version, uint32_t baud) {
+	uart_flush();
+	uart_init(baud);
+	
+	protocol_version = version;
+	v1_state = V1_MODE;
+	rx_state = RX_SYNC;
+#ifdef RX_REPLAY
+	rx_replay_len = 0;
+	rx_replay_pos = 0;
+#endif
+	rx_expected_seq = 0;
+	rx_last_tick = TCNT1;
+	tx_seq = 0;
+}
+
+bool IsBaudSupported(uint32_t baud) {
+	// all of these are exact at 16 MHz with double speed
+	return baud == 250000UL || baud == 500000UL || baud == 1000000UL || baud == 2000000UL;
+}
+
+void Serial_SendFrame(uint8_t type, uint8_t const* payload, uint8_t size) {
+	uint8_t const len = size + 2;
+	uint8_t crc = _crc8_ccitt_update(0, len);
+	
+	uart_putchar(PROTOCOL_SYNC);
+	uart_putchar(len);
+	uart_putchar(tx_seq);
+	crc = _crc8_ccitt_update(crc, tx_seq);
+	uart_putchar(type);
+	crc = _crc8_ccitt_update(crc, type);
+	for (uint8_t i = 0; i < size; i++)
+	{
+		uart_putchar(payload[i]);
+		crc = _crc8_ccitt_update(crc, payload[i]);
+	}
+	uart_putchar(crc);
+	tx_seq++;
+}
+
+uint8_t Serial_TimelineFlags(void) {
+	return (timeline_active ? PROTOCOL_TIMELINE_FLAG_ACTIVE : 0) | (timeline_done ? PROTOCOL_TIMELINE_FLAG_DONE : 0);
+}
+
+void Serial_SendAck(uint8_t status) {
+	// dropped count wraps and restarts on every baud rate change, host tracks the difference
+	// timeline status rides along so a lost TIMELINE_STATUS is repaired by the next ACK
+	uint16_t const dropped = uart_dropped();
+	uint8_t payload[10];
+	payload[0] = rx_expected_seq;
+	payload[1] = status;
+	payload[2] = TIMELINE_SIZE - timeline_count;
+	payload[3] = (uint8_t)(dropped & 0xFF);
+	payload[4] = (uint8_t)(dropped >> 8);
+	payload[5] = (uint8_t)(timeline_started & 0xFF);
+	payload[6] = (uint8_t)(timeline_started >> 8);
+	payload[7] = (uint8_t)(timeline_underruns & 0xFF);
+	payload[8] = (uint8_t)(timeline_underruns >> 8);
+	payload[9] = Serial_TimelineFlags();
+	Serial_SendFrame(PROTOCOL_TYPE_ACK, payload, sizeof(payload));
+}
+
+void Serial_SendTimelineStatus(void) {
+	uint8_t payload[6];
+	payload[0] = (uint8_t)(timeline_started & 0xFF);
+	payload[1] = (uint8_t)(timeline_started >> 8);
+	payload[2] = TIMELINE_SIZE - timeline_count;
+	payload[3] = (uint8_t)(timeline_underruns & 0xFF);
+	payload[4] = (uint8_t)(timeline_underruns >> 8);
+	payload[5] = Serial_TimelineFlags();
+	Serial_SendFrame(PROTOCOL_TYPE_TIMELINE_STATUS, payload, sizeof(payload));
+	timeline_status_pending = false;
+}
+
+void Serial_HandleFrame(void) {
+	uint8_t const seq = rx_frame[0];
+	uint8_t const type = rx_frame[1];
+	uint8_t const* payload = &rx_frame[2];
+	uint8_t const size = rx_len - 2;
+	uint8_t status = PROTOCOL_STATUS_OK;
+	bool bye = false;
+	
+	rx_last_tick = TCNT1;
+	if (seq != rx_expected_seq)
+	{
+		// already applied (our ACK was lost) or a previous frame was lost, host will resend from rx_expected_seq
+		status = ((uint8_t)(rx_expected_seq - seq) < 128) ? PROTOCOL_STATUS_DUPLICATE : PROTOCOL_STATUS_OUT_OF_ORDER;
+	}
+	else
+	{
+		switch (type)
 		{
-			button_flag |= ((uint32_t)(uart_getchar()) << (8UL * i));
+		case PROTOCOL_TYPE_PING:
+			break;
+		case PROTOCOL_TYPE_STATE:
+			if (size < 8)
+			{
+				status = PROTOCOL_STATUS_BAD_TYPE;
+			}
+			else if (timeline_active)
+			{
+				// clearing here would reset started/free slots under the host streaming the timeline,
+				// host has to send TIMELINE_CLEAR to take over
+				status = PROTOCOL_STATUS_BUSY;
+			}
+			else
+			{
+				ApplyState(payload);
+			}
+			break;
+		case PROTOCOL_TYPE_BYE:
+			ResetState();
+			bye = true;
+			break;
+		case PROTOCOL_TYPE_TIMELINE_PUSH:
+			status = TimelinePush(payload, size);
+			break;
+		case PROTOCOL_TYPE_TIMELINE_CLEAR:
+			ResetState();
+			break;
+		default:
+			status = PROTOCOL_STATUS_BAD_TYPE;
+			break;
 		}
 		
-		left_x = uart_getchar();
-		left_y = uart_getchar();
-		right_x = uart_getchar();
-		right_y = uart_getchar();
-		
-		// Discard the rest
-		while (uart_available() > 0)
+		// consumed even if rejected, otherwise host would resend it forever
+		// except when full, host will resend it after entries are played
+		if (status != PROTOCOL_STATUS_FULL)
 		{
-			uart_getchar();
+			rx_expected_seq++;
 		}
-		
-		uart_putchar((char)VERSION);
-		waiting_input = false;
+	}
+	
+	Serial_SendAck(status);
+	
+	if (bye)
+	{
+		SetProtocol(1, V1_BAUD);
+	}
+}
+
+void Serial_HandleHello(void) {
+	// [version][baud x4]
+	uint8_t const version = v1_data[0];
+	uint32_t baud = 0;
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		baud |= ((uint32_t)(v1_data[1 + i]) << (8UL * i));
+	}
+	
+	// Reply with the version we will use, host switches baud rate after receiving it
+	bool const upgrade = version >= PROTOCOL_VERSION && IsBaudSupported(baud);
+	uart_putchar(PROTOCOL_V2_HELLO);
+	uart_putchar(upgrade ? PROTOCOL_VERSION : 1);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		uart_putchar(v1_data[1 + i]);
+	}
+	
+	if (upgrade)
+	{
+		SetProtocol(PROTOCOL_VERSION, baud);
+	}
+}
+
+void Serial_TaskV1(void) {
+	// Every packet is applied and echoed, the last one wins if several arrived since the previous report
+	while (uart_available() > 0 && protocol_version == 1)
+	{
+		uint8_t const c = uart_getchar();
+		switch (v1_state)
+		{
+		case V1_MODE:
+			if (c == PROTOCOL_V1_MODE)
+			{
+				v1_count = 0;
+				v1_state = V1_STATE;
+			}
+			else if (c == PROTOCOL_V2_HELLO)
+			{
+				v1_count = 0;
+				v1_state = V1_HELLO;
+			}
+			else
+			{
+				// Anything else releases everything, host sends a single 0 when disconnecting
+				ResetState();
+			}
+			break;
+		case V1_STATE:
+			v1_data[v1_count++] = c;
+			if (v1_count >= 8)
+			{
+				ApplyState(v1_data);
+				uart_putchar((char)VERSION);
+				v1_state = V1_MODE;
+			}
+			break;
+		case V1_HELLO:
+			v1_data[v1_count++] = c;
+			if (v1_count >= PROTOCOL_HELLO_SIZE - 1)
+			{
+				v1_state = V1_MODE;
+				Serial_HandleHello();
+			}
+			break;
+		}
+	}
+}
+
+// Queue the bad frame after its sync byte to be parsed again, ahead of anything left from a previous replay
+void Serial_Resync(uint8_t crc) {
+#ifdef RX_REPLAY
+	uint8_t const remaining = rx_replay_len - rx_replay_pos;
+	uint8_t const size = rx_len + 2;
+	
+	// a frame can only fail inside the replay if it ends there too, so this never exceeds one frame
+	memmove(&rx_replay[size], &rx_replay[rx_replay_pos], remaining);
+	rx_replay[0] = rx_len;
+	memcpy(&rx_replay[1], rx_frame, rx_len);
+	rx_replay[size - 1] = crc;
+	rx_replay_pos = 0;
+	rx_replay_len = size + remaining;
+#endif
+}
+
+void Serial_ParseV2(uint8_t c) {
+	switch (rx_state)
+	{
+	case RX_SYNC:
+		if (c == PROTOCOL_SYNC)
+		{
+			rx_state = RX_LEN;
+		}
+		break;
+	case RX_LEN:
+		if (c >= PROTOCOL_MIN_LEN && c <= PROTOCOL_MAX_LEN)
+		{
+			rx_len = c;
+			rx_count = 0;
+			rx_crc = _crc8_ccitt_update(0, c);
+			rx_state = RX_BODY;
+		}
+		else
+		{
+			// not a frame, resync on the next sync byte
+			rx_state = (c == PROTOCOL_SYNC) ? RX_LEN : RX_SYNC;
+		}
+		break;
+	case RX_BODY:
+		rx_frame[rx_count++] = c;
+		rx_crc = _crc8_ccitt_update(rx_crc, c);
+		if (rx_count >= rx_len)
+		{
+			rx_state = RX_CRC;
+		}
+		break;
+	case RX_CRC:
+		rx_state = RX_SYNC;
+		if (c == rx_crc)
+		{
+			Serial_HandleFrame();
+		}
+		else
+		{
+			// the sync or length may have been noise, look for a frame inside these bytes
+			Serial_Resync(c);
+			
+			// ask for a resend from the expected seq right away
+			Serial_SendAck(PROTOCOL_STATUS_BAD_CRC);
+		}
+		break;
+	}
+}
+
+void Serial_TaskV2(void) {
+	// Host went away without saying bye, go back to v1 so it can reconnect
+	if ((uint16_t)(TCNT1 - rx_last_tick) > TIMER1_MS_TO_TICKS(PROTOCOL_IDLE_TIMEOUT_MS))
+	{
+		ResetState();
+		SetProtocol(1, V1_BAUD);
+		return;
+	}
+	
+	if (timeline_status_pending)
+	{
+		Serial_SendTimelineStatus();
+	}
+	
+	while (protocol_version == PROTOCOL_VERSION)
+	{
+#ifdef RX_REPLAY
+		if (rx_replay_pos < rx_replay_len)
+		{
+			Serial_ParseV2(rx_replay[rx_replay_pos++]);
+		}
+		else
+#endif
+		if (uart_available() > 0)
+		{
+			Serial_ParseV2(uart_getchar());
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+void Serial_Task(void) {
+	if (protocol_version == PROTOCOL_VERSION)
+	{
+		Serial_TaskV2();
+	}
+	else
+	{
+		Serial_TaskV1();
 	}
 }
 
@@ -218,6 +720,9 @@ void GetNextReport(USB_JoystickReport_Input_t* const ReportData) {
 	ReportData->RY = STICK_CENTER;
 	ReportData->HAT = HAT_CENTER;
 	
+	// Timeline counts every report, including echoes
+	TimelineAdvance();
+	
 	// Repeat ECHOES times the last report
 	if (echoes > 0)
 	{
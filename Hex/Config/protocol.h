@@ -0,0 +1,49 @@
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+// Serial protocol shared with the PC (Helpers/serialprotocol.h must match)
+//
+// v1: 9600 baud, [0xFF][button x4][lx][ly][rx][ry], device echoes VERSION
+// v2: negotiated after a v1 echo with [0xFE][PROTOCOL_VERSION][baud x4],
+//     device replies the same 6 bytes then both sides switch baud rate
+//
+// v2 frame: [SYNC][len][seq][type][payload (len - 2)][crc8 of len..payload]
+// every frame received is answered by an ACK carrying the next expected seq
+
+#define PROTOCOL_V1_MODE		0xFF
+#define PROTOCOL_V2_HELLO		0xFE
+#define PROTOCOL_VERSION		2
+#define PROTOCOL_HELLO_SIZE		6
+
+#define PROTOCOL_SYNC			0xAA
+#define PROTOCOL_MIN_LEN		2
+#define PROTOCOL_MAX_LEN		64
+
+// host -> device
+#define PROTOCOL_TYPE_PING		0x00
+#define PROTOCOL_TYPE_STATE		0x01	// [button x4][lx][ly][rx][ry]
+#define PROTOCOL_TYPE_BYE		0x02	// revert to v1 at 9600
+#define PROTOCOL_TYPE_TIMELINE_PUSH		0x03	// [flags][button x4][lx][ly][rx][ry][frames x2] x N, frames >= 1
+#define PROTOCOL_TYPE_TIMELINE_CLEAR	0x04	// stop timeline and release everything
+
+// device -> host
+#define PROTOCOL_TYPE_ACK		0x80	// [next expected seq][status][timeline free slots][rx bytes dropped x2][started x2][underruns x2][flags]
+#define PROTOCOL_TYPE_TIMELINE_STATUS	0x81	// [started x2][free slots][underruns x2][flags]
+
+#define PROTOCOL_TIMELINE_ENTRY_SIZE	10
+#define PROTOCOL_TIMELINE_FLAG_END		0x01	// push: no more entries after these
+#define PROTOCOL_TIMELINE_FLAG_ACTIVE	0x01	// status: timeline is playing
+#define PROTOCOL_TIMELINE_FLAG_DONE		0x02	// status: reached the end
+
+#define PROTOCOL_STATUS_OK			0x00
+#define PROTOCOL_STATUS_DUPLICATE	0x01
+#define PROTOCOL_STATUS_OUT_OF_ORDER	0x02
+#define PROTOCOL_STATUS_BAD_CRC		0x03
+#define PROTOCOL_STATUS_BAD_TYPE	0x04
+#define PROTOCOL_STATUS_FULL		0x05	// timeline has no room, not consumed
+#define PROTOCOL_STATUS_BUSY		0x06	// state ignored while a timeline is playing, consumed
+
+// v2 falls back to v1 when nothing valid arrives for this long (host sends PING to keep alive)
+#define PROTOCOL_IDLE_TIMEOUT_MS	2000
+
+#endif
@@ -23,23 +23,38 @@
 
 // Version 1.0: Initial Release
 // Version 1.1: Add support for Teensy 2.0, minor optimizations
+// AutoController2: larger receive buffer with 16 bit indices, dropped byte count
 
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #include "uart.h"
 
-// These buffers may be any size from 2 to 256 bytes.
-#define RX_BUFFER_SIZE 128
-#define TX_BUFFER_SIZE 128
+// TX may be any size from 2 to 256 bytes, RX from 2 to 65535
+#define RX_BUFFER_SIZE UART_RX_BUFFER_SIZE
+#define TX_BUFFER_SIZE UART_TX_BUFFER_SIZE
 
 static volatile uint8_t tx_buffer[TX_BUFFER_SIZE];
 static volatile uint8_t tx_buffer_head;
 static volatile uint8_t tx_buffer_tail;
 static volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
-static volatile uint8_t rx_buffer_head;
-static volatile uint8_t rx_buffer_tail;
+static volatile uint16_t rx_buffer_head;
+static volatile uint16_t rx_buffer_tail;
+static volatile uint16_t rx_dropped;
+static volatile uint8_t tx_active;
+
+// rx_buffer_head is written by the RX interrupt, 16 bit reads need interrupts off
+static inline uint16_t rx_head(void)
+{
+	uint16_t head;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		head = rx_buffer_head;
+	}
+	return head;
+}
 
 // Initialize the UART
 void uart_init(uint32_t baud)
@@ -51,6 +66,8 @@ void uart_init(uint32_t baud)
 	UCSR1C = (1<<UCSZ11) | (1<<UCSZ10);
 	tx_buffer_head = tx_buffer_tail = 0;
 	rx_buffer_head = rx_buffer_tail = 0;
+	rx_dropped = 0;
+	tx_active = 0;
 	sei();
 }
 
@@ -65,6 +82,7 @@ void uart_putchar(uint8_t c)
 	//cli();
 	tx_buffer[i] = c;
 	tx_buffer_head = i;
+	tx_active = 1;
 	UCSR1B = (1<<RXEN1) | (1<<TXEN1) | (1<<RXCIE1) | (1<<UDRIE1);
 	//sei();
 }
@@ -72,29 +90,54 @@ void uart_putchar(uint8_t c)
 // Receive a byte
 uint8_t uart_getchar(void)
 {
-        uint8_t c, i;
-
-	while (rx_buffer_head == rx_buffer_tail) ; // wait for character
-        i = rx_buffer_tail + 1;
-        if (i >= RX_BUFFER_SIZE) i = 0;
-        c = rx_buffer[i];
-        rx_buffer_tail = i;
-        return c;
+	uint8_t c;
+	uint16_t i;
+
+	while (rx_head() == rx_buffer_tail) ; // wait for character
+	i = rx_buffer_tail + 1;
+	if (i >= RX_BUFFER_SIZE) i = 0;
+	c = rx_buffer[i];
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		rx_buffer_tail = i;
+	}
+	return c;
 }
 
 // Return the number of bytes waiting in the receive buffer.
 // Call this before uart_getchar() to check if it will need
 // to wait for a byte to arrive.
-uint8_t uart_available(void)
+uint16_t uart_available(void)
 {
-	uint8_t head, tail;
+	uint16_t head, tail;
 
-	head = rx_buffer_head;
+	head = rx_head();
 	tail = rx_buffer_tail;
 	if (head >= tail) return head - tail;
 	return RX_BUFFER_SIZE + head - tail;
 }
 
+// Bytes lost since uart_init() because the buffer was full or the hardware overran
+uint16_t uart_dropped(void)
+{
+	uint16_t dropped;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		dropped = rx_dropped;
+	}
+	return dropped;
+}
+
+// Wait until every queued byte has left the shift register,
+// must be called before changing baud rate with uart_init()
+void uart_flush(void)
+{
+	if (!tx_active) return;
+	while (tx_buffer_head != tx_buffer_tail) ;
+	while (!(UCSR1A & (1<<TXC1))) ;
+	tx_active = 0;
+}
+
 // Transmit Interrupt
 ISR(USART1_UDRE_vect)
 {
@@ -106,6 +149,7 @@ ISR(USART1_UDRE_vect)
 	} else {
 		i = tx_buffer_tail + 1;
 		if (i >= TX_BUFFER_SIZE) i = 0;
+		UCSR1A |= (1<<TXC1); // clear transmit complete, set again once this byte is out
 		UDR1 = tx_buffer[i];
 		tx_buffer_tail = i;
 	}
@@ -114,14 +158,19 @@ ISR(USART1_UDRE_vect)
 // Receive Interrupt
 ISR(USART1_RX_vect)
 {
-	uint8_t c, i;
+	uint8_t c, overrun;
+	uint16_t i;
 
+	overrun = UCSR1A & (1<<DOR1); // must be read before UDR1
 	c = UDR1;
+	if (overrun) rx_dropped++;
 	i = rx_buffer_head + 1;
 	if (i >= RX_BUFFER_SIZE) i = 0;
 	if (i != rx_buffer_tail) {
 		rx_buffer[i] = c;
 		rx_buffer_head = i;
+	} else {
+		rx_dropped++;
 	}
 }
 
@@ -3,9 +3,21 @@
 
 #include <stdint.h>
 
+// Receive buffer holds a full window of v2 frames at 2000000 baud while USB is busy,
+// the 8u2/16u2 have 512 bytes of RAM for everything so they hold about two frames
+#if defined(__AVR_ATmega16U2__) || defined(__AVR_ATmega8U2__)
+#define UART_RX_BUFFER_SIZE 128
+#define UART_TX_BUFFER_SIZE 64
+#else
+#define UART_RX_BUFFER_SIZE 1024
+#define UART_TX_BUFFER_SIZE 128
+#endif
+
 void uart_init(uint32_t baud);
 void uart_putchar(uint8_t c);
 uint8_t uart_getchar(void);
-uint8_t uart_available(void);
+uint16_t uart_available(void);
+uint16_t uart_dropped(void);
+void uart_flush(void);
 
 #endif
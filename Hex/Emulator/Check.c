@@ -0,0 +1,391 @@
+/*
+AutoController2 serial host check
+
+Walks the firmware through one short session like the PC program does and
+checks the timing and the HID reports it produces, needs the emulator's
+report log to see what the Switch would have received.
+
+	./Emulator -l /tmp/ttyAutoController2 -o reports.csv &
+	./Check -p /tmp/ttyAutoController2 -r reports.csv
+
+Checks:
+	v1 packet is echoed with VERSION
+	v2 hello is accepted and a PING is acknowledged
+	a timeline entry of 0 reports is rejected
+	a timeline of 3 + 2 reports plays on exactly those reports, then releases
+	the next ACK repeats the timeline's done status
+	BYE falls back to v1 at 9600
+
+Options:
+	-p path		serial port, required
+	-r file		emulator report log, required
+	-b baud		v2 baud rate, default 1000000
+*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Config/protocol.h"
+
+#define V1_BAUD 9600
+#define V1_ECHO_MS 100
+#define V2_REPLY_MS 100
+#define V2_SWITCH_DELAY_MS 10
+#define TIMELINE_DONE_MS 1000
+
+// stick values that only the timeline entries use, buttons stay released
+#define STICK_FIRST 0
+#define STICK_SECOND 255
+#define STICK_CENTER 128
+#define FIRST_REPORTS 3
+#define SECOND_REPORTS 2
+
+static int port = -1;
+static uint8_t seq = 0;
+
+int64_t Check_Now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+uint8_t Check_Crc8(uint8_t crc, uint8_t data) {
+	// same as _crc8_ccitt_update() in avr-libc
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+bool Check_SetBaud(uint32_t baud) {
+	speed_t speed;
+	switch (baud)
+	{
+	case 9600: speed = B9600; break;
+	case 500000: speed = B500000; break;
+	case 1000000: speed = B1000000; break;
+	case 2000000: speed = B2000000; break;
+	default:
+		fprintf(stderr, "Unsupported baud rate %u\n", baud);
+		return false;
+	}
+
+	struct termios tio;
+	if (tcgetattr(port, &tio) != 0)
+		return false;
+	cfmakeraw(&tio);
+	cfsetspeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	return tcsetattr(port, TCSANOW, &tio) == 0;
+}
+
+bool Check_Write(uint8_t const* data, size_t size) {
+	while (size > 0)
+	{
+		ssize_t const written = write(port, data, size);
+		if (written < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+			{
+				struct pollfd fd = { port, POLLOUT, 0 };
+				poll(&fd, 1, 10);
+				continue;
+			}
+			fprintf(stderr, "Write failed: %s\n", strerror(errno));
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+// Reads exactly size bytes, false if they did not all arrive within timeout_ms
+bool Check_ReadExact(uint8_t* buffer, size_t size, int timeout_ms) {
+	int64_t const deadline = Check_Now() + (int64_t)timeout_ms * 1000000LL;
+	size_t received = 0;
+	while (received < size)
+	{
+		int64_t const left = (deadline - Check_Now()) / 1000000LL;
+		struct pollfd fd = { port, POLLIN, 0 };
+		if (left <= 0 || poll(&fd, 1, (int)left) <= 0)
+			return false;
+		ssize_t const count = read(port, buffer + received, size - received);
+		if (count > 0)
+			received += count;
+	}
+	return true;
+}
+
+// Sends a neutral v1 packet and waits for the echo
+bool Check_V1(char const* name) {
+	uint8_t const packet[9] = { PROTOCOL_V1_MODE, 0, 0, 0, 0, STICK_CENTER, STICK_CENTER, STICK_CENTER, STICK_CENTER };
+	uint8_t echo = 0;
+
+	tcflush(port, TCIFLUSH);
+	int64_t const start = Check_Now();
+	if (!Check_Write(packet, sizeof(packet)) || !Check_ReadExact(&echo, 1, V1_ECHO_MS))
+	{
+		fprintf(stderr, "%s: no v1 echo\n", name);
+		return false;
+	}
+
+	printf("%s: v1 echo %u after %.1f ms\n", name, echo, (double)(Check_Now() - start) / 1000000.0);
+	return echo == 1;
+}
+
+bool Check_Hello(uint32_t baud) {
+	uint8_t hello[PROTOCOL_HELLO_SIZE] = { PROTOCOL_V2_HELLO, PROTOCOL_VERSION };
+	for (uint8_t i = 0; i < 4; i++)
+		hello[2 + i] = (uint8_t)(baud >> (8 * i));
+
+	uint8_t reply[PROTOCOL_HELLO_SIZE];
+	if (!Check_Write(hello, sizeof(hello)) || !Check_ReadExact(reply, sizeof(reply), V1_ECHO_MS))
+	{
+		fprintf(stderr, "No reply to hello\n");
+		return false;
+	}
+	if (reply[0] != PROTOCOL_V2_HELLO || reply[1] != PROTOCOL_VERSION || memcmp(&reply[2], &hello[2], 4) != 0)
+	{
+		fprintf(stderr, "Firmware refused v%u at %u baud\n", PROTOCOL_VERSION, baud);
+		return false;
+	}
+
+	printf("hello: v%u at %u baud\n", reply[1], baud);
+	tcdrain(port);
+	usleep(V2_SWITCH_DELAY_MS * 1000);
+	return Check_SetBaud(baud);
+}
+
+bool Check_Send(uint8_t type, uint8_t const* payload, uint8_t size) {
+	uint8_t frame[PROTOCOL_MAX_LEN + 3];
+	uint8_t length = 0;
+	frame[length++] = PROTOCOL_SYNC;
+	frame[length++] = size + 2;
+	frame[length++] = seq;
+	frame[length++] = type;
+	for (uint8_t i = 0; i < size; i++)
+		frame[length++] = payload[i];
+
+	uint8_t crc = 0;
+	for (uint8_t i = 1; i < length; i++)
+		crc = Check_Crc8(crc, frame[i]);
+	frame[length++] = crc;
+	return Check_Write(frame, length);
+}
+
+// Waits for the next frame of this type, other frames are skipped, returns the payload size or -1
+int Check_Receive(uint8_t type, uint8_t* payload, int timeout_ms) {
+	int64_t const deadline = Check_Now() + (int64_t)timeout_ms * 1000000LL;
+	uint8_t header[2];
+	while (Check_Now() < deadline)
+	{
+		int const left = (int)((deadline - Check_Now()) / 1000000LL) + 1;
+		if (!Check_ReadExact(&header[0], 1, left) || header[0] != PROTOCOL_SYNC)
+			continue;
+		if (!Check_ReadExact(&header[1], 1, left) || header[1] < PROTOCOL_MIN_LEN || header[1] > PROTOCOL_MAX_LEN)
+			continue;
+
+		// [seq][type][payload][crc]
+		uint8_t body[PROTOCOL_MAX_LEN + 1];
+		if (!Check_ReadExact(body, header[1] + 1, left))
+			return -1;
+
+		uint8_t crc = Check_Crc8(0, header[1]);
+		for (uint8_t i = 0; i < header[1]; i++)
+			crc = Check_Crc8(crc, body[i]);
+		if (crc != body[header[1]])
+		{
+			fprintf(stderr, "Bad CRC from firmware\n");
+			continue;
+		}
+		if (body[1] != type)
+			continue;
+
+		memcpy(payload, &body[2], header[1] - 2);
+		return header[1] - 2;
+	}
+	return -1;
+}
+
+// Sends a frame and waits for an ACK with this status that moves to the next seq, returns the ACK payload size or -1
+int Check_ExchangeStatus(char const* name, uint8_t type, uint8_t const* payload, uint8_t size, uint8_t status, uint8_t* ack) {
+	int64_t const start = Check_Now();
+	if (!Check_Send(type, payload, size))
+		return -1;
+
+	int const received = Check_Receive(PROTOCOL_TYPE_ACK, ack, V2_REPLY_MS);
+	if (received < 2)
+	{
+		fprintf(stderr, "%s: no ACK\n", name);
+		return -1;
+	}
+
+	seq++;
+	printf("%s: ACK status %u in %.2f ms\n", name, ack[1], (double)(Check_Now() - start) / 1000000.0);
+	return (ack[0] == seq && ack[1] == status) ? received : -1;
+}
+
+// Sends a frame and waits for an OK ACK that moves to the next seq
+bool Check_Exchange(char const* name, uint8_t type, uint8_t const* payload, uint8_t size) {
+	uint8_t ack[PROTOCOL_MAX_LEN];
+	return Check_ExchangeStatus(name, type, payload, size, PROTOCOL_STATUS_OK, ack) >= 0;
+}
+
+bool Check_Timeline(void) {
+	// consumed but not played, the countdown would wrap
+	uint8_t ack[PROTOCOL_MAX_LEN];
+	uint8_t const empty[1 + PROTOCOL_TIMELINE_ENTRY_SIZE] = { PROTOCOL_TIMELINE_FLAG_END, 0, 0, 0, 0, STICK_CENTER, STICK_CENTER, STICK_CENTER, STICK_CENTER, 0, 0 };
+	if (Check_ExchangeStatus("empty entry", PROTOCOL_TYPE_TIMELINE_PUSH, empty, sizeof(empty), PROTOCOL_STATUS_BAD_TYPE, ack) < 0)
+		return false;
+
+	uint8_t push[1 + 2 * PROTOCOL_TIMELINE_ENTRY_SIZE] = { PROTOCOL_TIMELINE_FLAG_END };
+	uint8_t const sticks[2] = { STICK_FIRST, STICK_SECOND };
+	uint16_t const frames[2] = { FIRST_REPORTS, SECOND_REPORTS };
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		// [button x4][lx][ly][rx][ry][frames x2]
+		uint8_t* entry = &push[1 + i * PROTOCOL_TIMELINE_ENTRY_SIZE];
+		entry[4] = sticks[i];
+		entry[5] = STICK_CENTER;
+		entry[6] = STICK_CENTER;
+		entry[7] = STICK_CENTER;
+		entry[8] = (uint8_t)(frames[i] & 0xFF);
+		entry[9] = (uint8_t)(frames[i] >> 8);
+	}
+	if (!Check_Exchange("timeline", PROTOCOL_TYPE_TIMELINE_PUSH, push, sizeof(push)))
+		return false;
+
+	uint8_t status[PROTOCOL_MAX_LEN];
+	int64_t const deadline = Check_Now() + TIMELINE_DONE_MS * 1000000LL;
+	while (Check_Now() < deadline)
+	{
+		if (Check_Receive(PROTOCOL_TYPE_TIMELINE_STATUS, status, TIMELINE_DONE_MS) >= 6 && (status[5] & PROTOCOL_TIMELINE_FLAG_DONE))
+		{
+			uint16_t const started = (uint16_t)status[0] | ((uint16_t)status[1] << 8);
+			uint16_t const underruns = (uint16_t)status[3] | ((uint16_t)status[4] << 8);
+			printf("timeline: done, %u entries started, %u underruns\n", started, underruns);
+			if (started != 2 || underruns != 0)
+				return false;
+			
+			// [next expected seq][status][free slots][rx dropped x2][started x2][underruns x2][flags]
+			if (Check_ExchangeStatus("done ping", PROTOCOL_TYPE_PING, NULL, 0, PROTOCOL_STATUS_OK, ack) < 10)
+				return false;
+			uint16_t const acked = (uint16_t)ack[5] | ((uint16_t)ack[6] << 8);
+			return acked == started && (ack[9] & PROTOCOL_TIMELINE_FLAG_DONE);
+		}
+	}
+
+	fprintf(stderr, "timeline: never finished\n");
+	return false;
+}
+
+// Finds the reports where the timeline entries started and where it released
+bool Check_Reports(char const* path) {
+	FILE* log = fopen(path, "r");
+	if (!log)
+	{
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	long long first = -1;
+	long long second = -1;
+	long long release = -1;
+	char line[256];
+	while (fgets(line, sizeof(line), log))
+	{
+		long long time;
+		unsigned long long report;
+		unsigned button, hat, lx, ly, rx, ry;
+		if (sscanf(line, "%lld,%llu,0x%x,%u,%u,%u,%u,%u", &time, &report, &button, &hat, &lx, &ly, &rx, &ry) != 8)
+			continue;
+
+		// the power-on report is all zero too, the last first entry is the timeline's
+		if (lx == STICK_FIRST)
+		{
+			first = (long long)report;
+			second = release = -1;
+		}
+		else if (first >= 0 && second < 0 && lx == STICK_SECOND)
+			second = (long long)report;
+		else if (second >= 0 && release < 0 && lx == STICK_CENTER)
+			release = (long long)report;
+	}
+	fclose(log);
+
+	if (first < 0 || second < 0 || release < 0)
+	{
+		fprintf(stderr, "reports: timeline not found in %s\n", path);
+		return false;
+	}
+
+	printf("reports: first entry %lld reports, second %lld reports\n", second - first, release - second);
+	return second - first == FIRST_REPORTS && release - second == SECOND_REPORTS;
+}
+
+int main(int argc, char* argv[]) {
+	char const* path = NULL;
+	char const* reports = NULL;
+	uint32_t baud = 1000000;
+
+	int option;
+	while ((option = getopt(argc, argv, "p:r:b:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'p': path = optarg; break;
+		case 'r': reports = optarg; break;
+		case 'b': baud = (uint32_t)atol(optarg); break;
+		default:
+			path = NULL;
+			break;
+		}
+	}
+
+	if (!path || !reports)
+	{
+		fprintf(stderr, "Usage: %s -p port -r report_log [-b baud]\n", argv[0]);
+		return 1;
+	}
+
+	port = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (port < 0)
+	{
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	bool ok = Check_SetBaud(V1_BAUD);
+	tcflush(port, TCIOFLUSH);
+	ok = ok && Check_V1("start");
+	ok = ok && Check_Hello(baud);
+	ok = ok && Check_Exchange("ping", PROTOCOL_TYPE_PING, NULL, 0);
+	ok = ok && Check_Timeline();
+	ok = ok && Check_Exchange("bye", PROTOCOL_TYPE_BYE, NULL, 0);
+
+	// firmware is back on v1 at 9600 after the bye's ACK
+	tcdrain(port);
+	usleep(V2_SWITCH_DELAY_MS * 1000);
+	ok = ok && Check_SetBaud(V1_BAUD);
+	ok = ok && Check_V1("bye");
+	close(port);
+
+	ok = ok && Check_Reports(reports);
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+/*
+AutoController2 firmware emulator
+
+Runs AutoController2.c unchanged on Linux. The UART is a pseudo-terminal so
+the PC program can connect to it like a real port, and every HID report the
+Switch would poll is written to a timestamped log.
+
+	make
+	./Emulator -l /tmp/ttyAutoController2 -o reports.csv
+
+Options:
+	-l path		create a symlink to the pty (otherwise only /dev/pts/N is printed)
+	-i us		USB polling interval in microseconds, default 8000
+	-o file		report log, default stdout
+	-a			log every report instead of only the ones that changed
+	-n			no byte pacing, serial data arrives instantly instead of at the baud rate
+*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Config/uart.h"
+#include "../Joystick.h"
+
+// same sizes as Hex/Config/uart.c, one slot is always left empty
+#define RX_BUFFER_SIZE UART_RX_BUFFER_SIZE
+#define TX_BUFFER_SIZE UART_TX_BUFFER_SIZE
+
+// bytes read from the pty but still "on the wire"
+#define WIRE_SIZE 4096
+
+typedef struct {
+	uint8_t data;
+	int64_t time;	// ns, when the last bit has arrived/left
+} WireByte_t;
+
+uint8_t MCUSR;
+uint8_t CLKPR;
+uint8_t TCCR1A;
+uint8_t TCCR1B;
+uint8_t USB_DeviceState = DEVICE_STATE_Configured;
+
+int Firmware_Main(void);
+
+static int pty_master = -1;
+static int pty_slave = -1;
+static char const* pty_link = NULL;
+static FILE* report_log = NULL;
+static bool log_all = false;
+static bool pacing = true;
+static volatile sig_atomic_t terminate = 0;
+
+static struct timespec start_time;
+static uint32_t baud = 9600;
+
+static WireByte_t rx_wire[WIRE_SIZE];
+static uint32_t rx_wire_head = 0;
+static uint32_t rx_wire_tail = 0;
+static int64_t rx_wire_last = 0;
+static uint64_t rx_overflows = 0;
+static uint16_t rx_dropped = 0;
+
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+static uint16_t rx_buffer_head = 0;
+static uint16_t rx_buffer_tail = 0;
+
+static WireByte_t tx_wire[TX_BUFFER_SIZE];
+static uint8_t tx_wire_head = 0;
+static uint8_t tx_wire_tail = 0;
+static int64_t tx_wire_last = 0;
+
+static uint8_t selected_endpoint = 0;
+static int64_t report_interval = 8000000;
+static int64_t next_report = 0;
+static uint64_t report_count = 0;
+static USB_JoystickReport_Input_t last_logged;
+static bool has_logged = false;
+
+int64_t Emulator_Now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)(now.tv_sec - start_time.tv_sec) * 1000000000LL + (now.tv_nsec - start_time.tv_nsec);
+}
+
+uint16_t Emulator_Timer1(void) {
+	return (uint16_t)(Emulator_Now() / 64000);
+}
+
+// 8N1, 10 bits per byte
+int64_t Emulator_ByteTime(void) {
+	return pacing ? 10000000000LL / baud : 0;
+}
+
+void Emulator_Log(char const* format, ...) {
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "[%10.3f ms] ", (double)Emulator_Now() / 1000000.0);
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+// Move serial data between the pty and the emulated UART buffers,
+// returns when the deadline has passed or a new byte reached the RX buffer
+void Emulator_Pump(int64_t deadline) {
+	while (!terminate)
+	{
+		int64_t const now = Emulator_Now();
+		bool received = false;
+
+		// RX interrupt, drops the byte if the buffer is full just like uart.c
+		while (rx_wire_tail != rx_wire_head && rx_wire[rx_wire_tail].time <= now)
+		{
+			uint16_t const i = (rx_buffer_head + 1) % RX_BUFFER_SIZE;
+			if (i != rx_buffer_tail)
+			{
+				rx_buffer[i] = rx_wire[rx_wire_tail].data;
+				rx_buffer_head = i;
+			}
+			else
+			{
+				rx_overflows++;
+				rx_dropped++;
+			}
+			rx_wire_tail = (rx_wire_tail + 1) % WIRE_SIZE;
+			received = true;
+		}
+
+		// bytes that have finished transmitting
+		while (tx_wire_tail != tx_wire_head && tx_wire[tx_wire_tail].time <= now)
+		{
+			uint8_t const c = tx_wire[tx_wire_tail].data;
+			if (write(pty_master, &c, 1) < 0 && errno != EAGAIN && errno != EIO)
+			{
+				Emulator_Log("pty write failed: %s", strerror(errno));
+			}
+			tx_wire_tail = (tx_wire_tail + 1) % TX_BUFFER_SIZE;
+		}
+
+		// everything the host has written so far, stamped with when it would arrive
+		uint8_t data[256];
+		ssize_t size;
+		while ((size = read(pty_master, data, sizeof(data))) > 0)
+		{
+			for (ssize_t n = 0; n < size; n++)
+			{
+				uint32_t const next = (rx_wire_head + 1) % WIRE_SIZE;
+				if (next == rx_wire_tail)
+				{
+					rx_overflows++;
+					continue;
+				}
+
+				rx_wire_last = (rx_wire_last > now ? rx_wire_last : now) + Emulator_ByteTime();
+				rx_wire[rx_wire_head].data = data[n];
+				rx_wire[rx_wire_head].time = rx_wire_last;
+				rx_wire_head = next;
+			}
+		}
+
+		if (received || now >= deadline)
+			return;
+
+		// sleep until the deadline or the next byte event
+		int64_t wake = deadline;
+		if (rx_wire_tail != rx_wire_head && rx_wire[rx_wire_tail].time < wake)
+			wake = rx_wire[rx_wire_tail].time;
+		if (tx_wire_tail != tx_wire_head && tx_wire[tx_wire_tail].time < wake)
+			wake = tx_wire[tx_wire_tail].time;
+
+		int64_t const timeout = wake - now;
+		struct timespec ts = { (time_t)(timeout / 1000000000LL), (long)(timeout % 1000000000LL) };
+		struct pollfd fd = { pty_master, POLLIN, 0 };
+		if (ppoll(&fd, 1, &ts, NULL) > 0 && (fd.revents & POLLHUP))
+		{
+			// no slave open, nothing to read until the host connects
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	if (terminate)
+	{
+		Emulator_Log("Stopped after %llu reports, %llu RX bytes dropped", (unsigned long long)report_count, (unsigned long long)rx_overflows);
+		if (pty_link)
+			unlink(pty_link);
+		fflush(report_log);
+		exit(0);
+	}
+}
+
+// UART, see Hex/Config/uart.c
+void uart_init(uint32_t rate) {
+	if (rate != baud)
+		Emulator_Log("UART %u baud", rate);
+	baud = rate;
+	rx_buffer_head = rx_buffer_tail = 0;
+	rx_dropped = 0;
+	tx_wire_head = tx_wire_tail = 0;
+}
+
+void uart_putchar(uint8_t c) {
+	// wait until space in buffer
+	while ((uint8_t)((tx_wire_head + 1) % TX_BUFFER_SIZE) == tx_wire_tail)
+	{
+		Emulator_Pump(tx_wire[tx_wire_tail].time);
+	}
+
+	int64_t const now = Emulator_Now();
+	tx_wire_last = (tx_wire_last > now ? tx_wire_last : now) + Emulator_ByteTime();
+	tx_wire[tx_wire_head].data = c;
+	tx_wire[tx_wire_head].time = tx_wire_last;
+	tx_wire_head = (tx_wire_head + 1) % TX_BUFFER_SIZE;
+}
+
+uint8_t uart_getchar(void) {
+	// wait for character
+	while (rx_buffer_head == rx_buffer_tail)
+	{
+		Emulator_Pump(Emulator_Now() + 1000000);
+	}
+
+	rx_buffer_tail = (rx_buffer_tail + 1) % RX_BUFFER_SIZE;
+	return rx_buffer[rx_buffer_tail];
+}
+
+uint16_t uart_available(void) {
+	if (rx_buffer_head >= rx_buffer_tail)
+		return rx_buffer_head - rx_buffer_tail;
+	return RX_BUFFER_SIZE + rx_buffer_head - rx_buffer_tail;
+}
+
+uint16_t uart_dropped(void) {
+	return rx_dropped;
+}
+
+void uart_flush(void) {
+	while (tx_wire_tail != tx_wire_head)
+	{
+		Emulator_Pump(tx_wire[(tx_wire_head + TX_BUFFER_SIZE - 1) % TX_BUFFER_SIZE].time);
+	}
+}
+
+// USB, the Switch polls the IN endpoint once per interval
+void USB_Init(void) {
+	next_report = Emulator_Now() + report_interval;
+}
+
+void USB_USBTask(void) {
+	Emulator_Pump(next_report);
+}
+
+void Endpoint_SelectEndpoint(uint8_t address) {
+	selected_endpoint = address;
+}
+
+bool Endpoint_ConfigureEndpoint(uint8_t address, uint8_t type, uint16_t size, uint8_t banks) {
+	return true;
+}
+
+bool Endpoint_IsOUTReceived(void) {
+	return false;
+}
+
+bool Endpoint_IsReadWriteAllowed(void) {
+	return true;
+}
+
+bool Endpoint_IsINReady(void) {
+	return selected_endpoint == JOYSTICK_IN_EPADDR && Emulator_Now() >= next_report;
+}
+
+uint8_t Endpoint_Read_Stream_LE(void* buffer, uint16_t length, uint16_t* bytesProcessed) {
+	memset(buffer, 0, length);
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t Endpoint_Write_Stream_LE(void const* buffer, uint16_t length, uint16_t* bytesProcessed) {
+	USB_JoystickReport_Input_t const* report = (USB_JoystickReport_Input_t const*)buffer;
+	int64_t const time = Emulator_Now();
+
+	if (log_all || !has_logged || memcmp(report, &last_logged, sizeof(USB_JoystickReport_Input_t)) != 0)
+	{
+		fprintf(report_log, "%lld,%llu,0x%04x,%u,%u,%u,%u,%u\n", (long long)(time / 1000), (unsigned long long)report_count,
+			report->Button, report->HAT, report->LX, report->LY, report->RX, report->RY);
+		fflush(report_log);
+		memcpy(&last_logged, report, sizeof(USB_JoystickReport_Input_t));
+		has_logged = true;
+	}
+
+	report_count++;
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+void Endpoint_ClearOUT(void) {
+}
+
+void Endpoint_ClearIN(void) {
+	// next poll, skip ahead instead of bursting if we fell behind
+	next_report += report_interval;
+	if (next_report <= Emulator_Now())
+		next_report = Emulator_Now() + report_interval;
+}
+
+void OnSignal(int signal) {
+	terminate = 1;
+}
+
+bool OpenPty(void) {
+	pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (pty_master < 0 || grantpt(pty_master) != 0 || unlockpt(pty_master) != 0)
+		return false;
+
+	char const* name = ptsname(pty_master);
+	if (!name)
+		return false;
+
+	// keep the slave open so the master never sees a hangup between connections,
+	// raw mode so nothing is echoed back, the host restores this when it closes
+	pty_slave = open(name, O_RDWR | O_NOCTTY);
+	if (pty_slave < 0)
+		return false;
+
+	struct termios tio;
+	tcgetattr(pty_slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(pty_slave, TCSANOW, &tio);
+
+	fcntl(pty_master, F_SETFL, fcntl(pty_master, F_GETFL) | O_NONBLOCK);
+
+	if (pty_link)
+	{
+		unlink(pty_link);
+		if (symlink(name, pty_link) != 0)
+		{
+			fprintf(stderr, "Failed to create %s: %s\n", pty_link, strerror(errno));
+			return false;
+		}
+	}
+
+	Emulator_Log("Serial port %s%s%s", name, pty_link ? " -> " : "", pty_link ? pty_link : "");
+	return true;
+}
+
+int main(int argc, char** argv) {
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	report_log = stdout;
+
+	int option;
+	while ((option = getopt(argc, argv, "l:i:o:anh")) != -1)
+	{
+		switch (option)
+		{
+		case 'l':
+			pty_link = optarg;
+			break;
+		case 'i':
+			report_interval = atoll(optarg) * 1000LL;
+			if (report_interval <= 0)
+				report_interval = 8000000;
+			break;
+		case 'o':
+			report_log = fopen(optarg, "w");
+			if (!report_log)
+			{
+				fprintf(stderr, "Failed to open %s: %s\n", optarg, strerror(errno));
+				return 1;
+			}
+			break;
+		case 'a':
+			log_all = true;
+			break;
+		case 'n':
+			pacing = false;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-l link] [-i interval_us] [-o report_log] [-a] [-n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	if (!OpenPty())
+	{
+		fprintf(stderr, "Failed to open pseudo-terminal: %s\n", strerror(errno));
+		return 1;
+	}
+
+	fprintf(report_log, "# AutoController2 emulator, report interval %lld us\n", (long long)(report_interval / 1000));
+	fprintf(report_log, "time_us,report,button,hat,lx,ly,rx,ry\n");
+
+	// never returns, Emulator_Pump() exits on SIGINT/SIGTERM
+	return Firmware_Main();
+}
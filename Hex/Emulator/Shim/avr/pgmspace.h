@@ -0,0 +1,2 @@
+// Emulator stand-in, see emulator.h
+#include <emulator.h>
@@ -0,0 +1,63 @@
+#ifndef _EMULATOR_H_
+#define _EMULATOR_H_
+
+// Replaces the AVR and LUFA headers so AutoController2.c builds unchanged on a PC,
+// everything here is implemented by Emulator.c
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// AVR registers touched by SetupHardware()
+extern uint8_t MCUSR;
+extern uint8_t CLKPR;
+extern uint8_t TCCR1A;
+extern uint8_t TCCR1B;
+#define WDRF	3
+#define CS10	0
+#define CS12	2
+
+// Timer1 free running at 16 MHz / 1024, derived from the host clock
+uint16_t Emulator_Timer1(void);
+#define TCNT1	Emulator_Timer1()
+
+#define wdt_disable()
+#define GlobalInterruptEnable()
+#define cli()
+#define sei()
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+// USB device, always configured, IN endpoint is ready once per polling interval
+#define DEVICE_STATE_Configured		4
+#define ENDPOINT_RWSTREAM_NoError	0
+#define EP_TYPE_INTERRUPT			3
+#define ENDPOINT_DIR_IN				0x80
+#define ENDPOINT_DIR_OUT			0x00
+#define JOYSTICK_IN_EPADDR			(ENDPOINT_DIR_IN  | 1)
+#define JOYSTICK_OUT_EPADDR			(ENDPOINT_DIR_OUT | 2)
+#define JOYSTICK_EPSIZE				64
+
+extern uint8_t USB_DeviceState;
+
+void USB_Init(void);
+void USB_USBTask(void);
+void Endpoint_SelectEndpoint(uint8_t address);
+bool Endpoint_ConfigureEndpoint(uint8_t address, uint8_t type, uint16_t size, uint8_t banks);
+bool Endpoint_IsOUTReceived(void);
+bool Endpoint_IsReadWriteAllowed(void);
+bool Endpoint_IsINReady(void);
+uint8_t Endpoint_Read_Stream_LE(void* buffer, uint16_t length, uint16_t* bytesProcessed);
+uint8_t Endpoint_Write_Stream_LE(void const* buffer, uint16_t length, uint16_t* bytesProcessed);
+void Endpoint_ClearOUT(void);
+void Endpoint_ClearIN(void);
+
+#endif
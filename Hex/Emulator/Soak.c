@@ -0,0 +1,435 @@
+/*
+AutoController2 serial soak test
+
+Streams serial traffic at the firmware through the emulator's pty or a real
+USB-serial adapter, corrupting some of it on purpose, and checks that every
+v1 packet is echoed and every v2 frame is acknowledged in order.
+
+	./Emulator -l /tmp/ttyAutoController2 -o /dev/null &
+	./Soak -p /tmp/ttyAutoController2 -b 2000000 -n 20000 -e 20
+
+Options:
+	-p path		serial port, required
+	-b baud		v2 baud rate, default 1000000 (9600, 500000, 1000000 or 2000000 on real ports)
+	-v count	v1 packets before upgrading, default 200
+	-n count	v2 frames, default 10000
+	-e permille	chance per frame of a bit flip, and separately of garbage bytes before it, default 10
+	-s seed		random seed, default time
+*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Config/protocol.h"
+
+#define V1_BAUD 9600
+#define V1_IDLE_MS 1000
+#define V2_WINDOW 8
+#define V2_RETRANSMIT_MS 50
+#define V2_STALL_MS 2000
+#define V2_SWITCH_DELAY_MS 10
+
+typedef struct {
+	uint8_t data[PROTOCOL_MAX_LEN + 3];
+	uint8_t size;
+} Frame_t;
+
+static int port = -1;
+static uint32_t error_permille = 10;
+
+static Frame_t frames[256];
+static uint64_t bytes_sent = 0;
+static uint64_t frames_sent = 0;
+static uint64_t frames_resent = 0;
+static uint64_t bit_flips = 0;
+static uint64_t garbage_bytes = 0;
+static uint64_t acks[PROTOCOL_STATUS_BUSY + 1];
+static uint64_t rx_crc_errors = 0;
+
+int64_t Soak_Now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+uint8_t Soak_Crc8(uint8_t crc, uint8_t data) {
+	// same as _crc8_ccitt_update() in avr-libc
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+bool Soak_Chance(void) {
+	return (uint32_t)(rand() % 1000) < error_permille;
+}
+
+bool Soak_SetBaud(uint32_t baud) {
+	speed_t speed;
+	switch (baud)
+	{
+	case 9600: speed = B9600; break;
+	case 500000: speed = B500000; break;
+	case 1000000: speed = B1000000; break;
+	case 2000000: speed = B2000000; break;
+	default:
+		fprintf(stderr, "Unsupported baud rate %u\n", baud);
+		return false;
+	}
+
+	struct termios tio;
+	if (tcgetattr(port, &tio) != 0)
+		return false;
+	cfmakeraw(&tio);
+	cfsetspeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	return tcsetattr(port, TCSANOW, &tio) == 0;
+}
+
+bool Soak_Write(uint8_t const* data, size_t size) {
+	while (size > 0)
+	{
+		ssize_t const written = write(port, data, size);
+		if (written < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+			{
+				struct pollfd fd = { port, POLLOUT, 0 };
+				poll(&fd, 1, 10);
+				continue;
+			}
+			fprintf(stderr, "Write failed: %s\n", strerror(errno));
+			return false;
+		}
+		data += written;
+		size -= written;
+		bytes_sent += written;
+	}
+	return true;
+}
+
+// Returns the number of bytes read, 0 if nothing arrived within timeout_ms
+int Soak_Read(uint8_t* buffer, size_t size, int timeout_ms) {
+	struct pollfd fd = { port, POLLIN, 0 };
+	if (poll(&fd, 1, timeout_ms) <= 0)
+		return 0;
+	ssize_t const count = read(port, buffer, size);
+	return count > 0 ? (int)count : 0;
+}
+
+// Garbage between packets, never a v1 mode byte so it only resets the state
+bool Soak_WriteGarbage(bool v1) {
+	uint8_t garbage[4];
+	uint8_t const count = 1 + rand() % sizeof(garbage);
+	for (uint8_t i = 0; i < count; i++)
+	{
+		garbage[i] = v1 ? (uint8_t)(rand() % PROTOCOL_V2_HELLO) : (uint8_t)rand();
+		if (!v1 && rand() % 4 == 0)
+			garbage[i] = PROTOCOL_SYNC;	// a fake frame start that swallows the real one
+	}
+	garbage_bytes += count;
+	return Soak_Write(garbage, count);
+}
+
+bool Soak_V1(uint32_t count) {
+	uint32_t echoes = 0;
+	uint32_t wrong = 0;
+	uint8_t buffer[256];
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (Soak_Chance() && !Soak_WriteGarbage(true))
+			return false;
+
+		uint8_t packet[9];
+		packet[0] = PROTOCOL_V1_MODE;
+		for (uint8_t j = 1; j < sizeof(packet); j++)
+			packet[j] = (uint8_t)rand();
+		if (!Soak_Write(packet, sizeof(packet)))
+			return false;
+
+		int const read = Soak_Read(buffer, sizeof(buffer), 0);
+		for (int j = 0; j < read; j++)
+			buffer[j] == 1 ? echoes++ : wrong++;
+	}
+
+	// 9600 baud is slow, wait for the rest
+	int read;
+	while (echoes + wrong < count && (read = Soak_Read(buffer, sizeof(buffer), V1_IDLE_MS)) > 0)
+	{
+		for (int j = 0; j < read; j++)
+			buffer[j] == 1 ? echoes++ : wrong++;
+	}
+
+	printf("v1: %u packets, %u echoes, %u unexpected bytes, %llu garbage bytes\n", count, echoes, wrong, (unsigned long long)garbage_bytes);
+	return echoes == count && wrong == 0;
+}
+
+bool Soak_Hello(uint32_t baud) {
+	uint8_t hello[PROTOCOL_HELLO_SIZE] = { PROTOCOL_V2_HELLO, PROTOCOL_VERSION };
+	for (uint8_t i = 0; i < 4; i++)
+		hello[2 + i] = (uint8_t)(baud >> (8 * i));
+
+	tcflush(port, TCIFLUSH);
+	if (!Soak_Write(hello, sizeof(hello)))
+		return false;
+
+	uint8_t reply[PROTOCOL_HELLO_SIZE];
+	size_t received = 0;
+	while (received < sizeof(reply))
+	{
+		int const read = Soak_Read(reply + received, sizeof(reply) - received, V1_IDLE_MS);
+		if (read == 0)
+		{
+			fprintf(stderr, "No reply to hello\n");
+			return false;
+		}
+		received += read;
+	}
+
+	if (reply[0] != PROTOCOL_V2_HELLO || reply[1] != PROTOCOL_VERSION || memcmp(&reply[2], &hello[2], 4) != 0)
+	{
+		fprintf(stderr, "Firmware refused v%u at %u baud\n", PROTOCOL_VERSION, baud);
+		return false;
+	}
+
+	tcdrain(port);
+	usleep(V2_SWITCH_DELAY_MS * 1000);
+	return Soak_SetBaud(baud);
+}
+
+void Soak_Encode(uint8_t seq, uint32_t index, uint32_t total) {
+	uint8_t payload[PROTOCOL_MAX_LEN - 2];
+	uint8_t size = 0;
+	uint8_t type;
+
+	if (index + 1 == total)
+	{
+		type = PROTOCOL_TYPE_BYE;
+	}
+	else if (index % 8 == 7)
+	{
+		type = PROTOCOL_TYPE_TIMELINE_CLEAR;
+	}
+	else if (index % 8 == 3)
+	{
+		// largest frame there is, cleared again before the next one so even the 8 entry timeline never fills up
+		type = PROTOCOL_TYPE_TIMELINE_PUSH;
+		uint8_t const entries = (sizeof(payload) - 1) / PROTOCOL_TIMELINE_ENTRY_SIZE;
+		payload[size++] = 0;
+		for (uint8_t i = 0; i < entries * PROTOCOL_TIMELINE_ENTRY_SIZE; i++)
+			payload[size++] = (uint8_t)rand();
+		
+		// firmware rejects entries of 0 reports
+		for (uint8_t i = 0; i < entries; i++)
+			payload[1 + i * PROTOCOL_TIMELINE_ENTRY_SIZE + 8] |= 1;
+	}
+	else
+	{
+		type = PROTOCOL_TYPE_STATE;
+		for (uint8_t i = 0; i < 8; i++)
+			payload[size++] = (uint8_t)rand();
+	}
+
+	Frame_t* frame = &frames[seq];
+	uint8_t const len = size + 2;
+	uint8_t crc = Soak_Crc8(0, len);
+	frame->size = 0;
+	frame->data[frame->size++] = PROTOCOL_SYNC;
+	frame->data[frame->size++] = len;
+	frame->data[frame->size++] = seq;
+	frame->data[frame->size++] = type;
+	crc = Soak_Crc8(Soak_Crc8(crc, seq), type);
+	for (uint8_t i = 0; i < size; i++)
+	{
+		frame->data[frame->size++] = payload[i];
+		crc = Soak_Crc8(crc, payload[i]);
+	}
+	frame->data[frame->size++] = crc;
+}
+
+bool Soak_Send(uint8_t seq) {
+	if (Soak_Chance() && !Soak_WriteGarbage(false))
+		return false;
+
+	Frame_t frame = frames[seq];
+	if (Soak_Chance())
+	{
+		frame.data[rand() % frame.size] ^= (uint8_t)(1 << (rand() % 8));
+		bit_flips++;
+	}
+
+	frames_sent++;
+	return Soak_Write(frame.data, frame.size);
+}
+
+bool Soak_V2(uint32_t count) {
+	uint32_t base = 0;	// oldest unacked
+	uint32_t next = 0;	// next to send
+	uint32_t encoded = 0;
+	uint32_t rewound_base = UINT32_MAX;
+	int64_t const start = Soak_Now();
+	int64_t progress_time = start;
+	int64_t send_time = start;
+
+	// firmware frame parser
+	uint8_t rx[PROTOCOL_MAX_LEN + 3];
+	uint8_t rx_size = 0;
+
+	while (base < count)
+	{
+		while (next < count && next - base < V2_WINDOW)
+		{
+			if (next == encoded)
+				Soak_Encode((uint8_t)encoded++, next, count);
+			if (!Soak_Send((uint8_t)next++))
+				return false;
+			send_time = Soak_Now();
+		}
+
+		uint8_t buffer[256];
+		int const read = Soak_Read(buffer, sizeof(buffer), 1);
+		for (int i = 0; i < read; i++)
+		{
+			if (rx_size == 0 && buffer[i] != PROTOCOL_SYNC)
+				continue;
+			if (rx_size == 1 && (buffer[i] < PROTOCOL_MIN_LEN || buffer[i] > PROTOCOL_MAX_LEN))
+			{
+				rx_size = 0;
+				continue;
+			}
+			rx[rx_size++] = buffer[i];
+			if (rx_size < 2 || rx_size < rx[1] + 3)
+				continue;
+
+			uint8_t crc = 0;
+			for (uint8_t j = 1; j < rx_size - 1; j++)
+				crc = Soak_Crc8(crc, rx[j]);
+			rx_size = 0;
+			if (crc != rx[rx[1] + 2])
+			{
+				rx_crc_errors++;
+				continue;
+			}
+			if (rx[3] != PROTOCOL_TYPE_ACK)
+				continue;
+
+			// [next expected seq][status][timeline free slots][rx bytes dropped x2][timeline status]
+			uint8_t const expected = rx[4];
+			uint8_t const status = rx[5];
+			if (status <= PROTOCOL_STATUS_BUSY)
+				acks[status]++;
+
+			uint8_t const acked = (uint8_t)(expected - (uint8_t)base);
+			if (acked > 0 && acked <= next - base)
+			{
+				base += acked;
+				progress_time = Soak_Now();
+			}
+			else if ((status == PROTOCOL_STATUS_BAD_CRC || status == PROTOCOL_STATUS_OUT_OF_ORDER) && rewound_base != base)
+			{
+				// go back N, once per loss so the NAKs for the rest of the window don't resend it again
+				frames_resent += next - base;
+				next = base;
+				rewound_base = base;
+			}
+		}
+
+		int64_t const now = Soak_Now();
+		if (base < next && now - send_time > V2_RETRANSMIT_MS * 1000000LL)
+		{
+			frames_resent += next - base;
+			next = base;
+			send_time = now;
+		}
+		if (now - progress_time > V2_STALL_MS * 1000000LL)
+		{
+			fprintf(stderr, "v2: stalled at frame %u of %u\n", base, count);
+			return false;
+		}
+	}
+
+	double const seconds = (double)(Soak_Now() - start) / 1e9;
+	printf("v2: %u frames in %.2fs, %.0f frames/s, %.0f bytes/s\n", count, seconds, count / seconds, bytes_sent / seconds);
+	printf("v2: %llu sent, %llu resent, %llu bit flips, %llu garbage bytes, %llu ACK CRC errors\n",
+		(unsigned long long)frames_sent, (unsigned long long)frames_resent, (unsigned long long)bit_flips,
+		(unsigned long long)garbage_bytes, (unsigned long long)rx_crc_errors);
+	printf("v2: ACK ok %llu, duplicate %llu, out of order %llu, bad crc %llu, bad type %llu, full %llu, busy %llu\n",
+		(unsigned long long)acks[PROTOCOL_STATUS_OK], (unsigned long long)acks[PROTOCOL_STATUS_DUPLICATE],
+		(unsigned long long)acks[PROTOCOL_STATUS_OUT_OF_ORDER], (unsigned long long)acks[PROTOCOL_STATUS_BAD_CRC],
+		(unsigned long long)acks[PROTOCOL_STATUS_BAD_TYPE], (unsigned long long)acks[PROTOCOL_STATUS_FULL],
+		(unsigned long long)acks[PROTOCOL_STATUS_BUSY]);
+	return acks[PROTOCOL_STATUS_BAD_TYPE] == 0;
+}
+
+int main(int argc, char** argv) {
+	char const* path = NULL;
+	uint32_t baud = 1000000;
+	uint32_t v1_count = 200;
+	uint32_t v2_count = 10000;
+	unsigned seed = (unsigned)time(NULL);
+
+	int option;
+	while ((option = getopt(argc, argv, "p:b:v:n:e:s:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'p': path = optarg; break;
+		case 'b': baud = (uint32_t)atol(optarg); break;
+		case 'v': v1_count = (uint32_t)atol(optarg); break;
+		case 'n': v2_count = (uint32_t)atol(optarg); break;
+		case 'e': error_permille = (uint32_t)atol(optarg); break;
+		case 's': seed = (unsigned)atol(optarg); break;
+		default:
+			path = NULL;
+			break;
+		}
+	}
+
+	if (!path || v2_count == 0)
+	{
+		fprintf(stderr, "Usage: %s -p port [-b baud] [-v v1_packets] [-n v2_frames] [-e permille] [-s seed]\n", argv[0]);
+		return 1;
+	}
+
+	port = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (port < 0)
+	{
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	printf("seed %u, error rate %u/1000\n", seed, error_permille);
+	srand(seed);
+
+	bool ok = Soak_SetBaud(V1_BAUD);
+	tcflush(port, TCIOFLUSH);
+	ok = ok && Soak_V1(v1_count);
+	ok = ok && Soak_Hello(baud);
+	ok = ok && Soak_V2(v2_count);
+
+	// the last frame is a bye, firmware is back on v1 at 9600, a single 0 releases everything like the PC program does
+	uint8_t const reset = 0;
+	tcdrain(port);
+	usleep(V2_SWITCH_DELAY_MS * 1000);
+	Soak_SetBaud(V1_BAUD);
+	Soak_Write(&reset, 1);
+	tcdrain(port);
+	close(port);
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -146,6 +146,9 @@ void SetupHardware(void);
 // Process and deliver data from IN and OUT endpoints.
 void HID_Task(void);
 
+// Process serial data from the PC, v1 or v2 protocol.
+void Serial_Task(void);
+
 // USB device event handlers.
 void EVENT_USB_Device_Connect(void);
 void EVENT_USB_Device_Disconnect(void);
@@ -1,14 +1,17 @@
 #include "audiomanager.h"
 
 #include "../ui_mainwindow.h"
-#include "Helpers/audioconversionutils.h"
 #include "Helpers/jsonhelper.h"
+#include "Helpers/mediatimeline.h"
+#include "Helpers/sessionrecorder.h"
+#include "Helpers/tracer.h"
 
 #define AUDIO_HEIGHT 100
 #define AUDIO_RAW_WAVE_SCALE 0.04
 
 AudioManager::~AudioManager()
 {
+    delete m_player;
     fftwf_free(m_fftDataIn);
     fftwf_free(m_fftDataOut);
 }
@@ -23,17 +26,31 @@ void AudioManager::Initialize(Ui::MainWindow *ui)
     m_displayImage = QImage(this->size(), QImage::Format_RGB32);
     m_displayImage.fill(Qt::black);
 
-    // Spectrogram data
-    m_fftBufferData.resize(FFT_SAMPLE_COUNT * 8);
-    m_fftDataIn = fftwf_alloc_complex(FFT_SAMPLE_COUNT);
-    m_fftDataOut = fftwf_alloc_complex(FFT_SAMPLE_COUNT);
-
     // Set up global audio format
     m_audioFormat.setSampleRate(48000);
     m_audioFormat.setChannelCount(2);
     m_audioFormat.setChannelConfig(QAudioFormat::ChannelConfigStereo);
     m_audioFormat.setSampleFormat(QAudioFormat::SampleFormat::Int16);
 
+    // Playback runs in its own thread, fed by a jitter buffer
+    m_player = new AudioPlayer();
+    m_player->Initialize(m_audioFormat);
+
+    QString const session = Metrics::SessionLabel();
+    m_metricFFTWindows = Metrics::GetCounter("ac2_audio_fft_windows_total", "FFT windows analysed", session);
+    Metrics::AddCallback("ac2_audio_playback_overruns_total", "Playback jitter buffer overruns, reset when playback restarts", true, session, this, [this]
+    {
+        return double(m_player->GetStats().m_overruns);
+    });
+    Metrics::AddCallback("ac2_audio_playback_underruns_total", "Playback jitter buffer underruns, reset when playback restarts", true, session, this, [this]
+    {
+        return double(m_player->GetStats().m_underruns);
+    });
+
+    // Spectrogram data
+    m_analysisRate = m_audioFormat.sampleRate();
+    SetupAnalysis();
+
     connect(m_listOutput, &QComboBox::currentTextChanged, this, &AudioManager::OnOutputChanged);
     connect(m_listDisplay, &QComboBox::currentIndexChanged, this, &AudioManager::OnDisplayChanged);
     connect(m_volumeSlider, &QSlider::valueChanged, this, &AudioManager::OnVolumeChanged);
@@ -52,6 +69,7 @@ void AudioManager::Start()
 {
     m_listInput->setEnabled(false);
 
+    SetupAnalysis();
     StartAudioSink();
     ClearRawWaveData();
     ClearFFTBufferData();
@@ -68,37 +86,69 @@ void AudioManager::Stop()
 
 void AudioManager::PushAudioData(const void *samples, unsigned int count, int64_t pts)
 {
+    TRACE_SCOPE("audio", "AudioManager::PushAudioData");
     size_t const sampleSize = count * m_audioFormat.bytesPerFrame();
 
-    // this is called from LibVLC thread, not thread safe
-    QMutexLocker locker(&m_sinkMutex);
-    if (m_audioDevice)
+    // Hand over to playback thread, this never blocks on the sink
+    m_player->PushAudioData((const char*)samples, sampleSize);
+
+    if (SessionRecorder* recorder = m_recorder.load(std::memory_order_relaxed))
     {
-        m_audioDevice->write((const char*)samples, sampleSize);
+        recorder->PushAudio((const char*)samples, int(sampleSize), pts - MediaTimeline::Now());
     }
 
+    // this is called from LibVLC thread, not thread safe
+    QMutexLocker locker(&m_analysisMutex);
+
     // Convert raw samples to float
     QVector<float> newData;
     AudioConversionUtils::convertSamplesToFloat(m_audioFormat, (const char*)samples, sampleSize, newData);
 
+    // Mix down to mono and low-pass/decimate to analysis rate, playback above is untouched
+    // pts is the media time the first sample is played, shift by where the first output lands and filter delay
+    int const inputRate = m_audioFormat.sampleRate();
+    qint64 const firstInput = m_decimator.GetPhase() - m_decimator.GetGroupDelay();
+    m_analysisTime = pts + firstInput * 1000000 / inputRate;
+    m_decimator.Process(newData, m_analysisData);
+    m_analysisEndTime = pts + qint64(count) * 1000000 / inputRate;
+
+    // Envelope is a few multiply-adds per sample, cheap enough to always run
+    quint64 const crossingCount = m_envelope.GetCrossingCount();
+    m_envelope.Process(m_analysisData.constData(), m_analysisData.size(), m_analysisTime);
+    AudioEnvelope::Crossing crossing;
+    if (m_envelope.GetCrossingCount() != crossingCount && m_envelope.GetLastCrossing(crossing))
+    {
+        MediaTimeline::AddEvent(MediaStream::Audio, crossing.m_time, GetEnvelopeEventName(), crossing.m_active ? 1.0 : 0.0);
+    }
+
     // Processing
     switch (m_displayType)
     {
     case AudioDisplayType::RawWave:
     {
-        WriteRawWaveData(newData);
+        WriteRawWaveData(m_analysisData);
         break;
     }
     case AudioDisplayType::FreqBars:
     case AudioDisplayType::Spectrogram:
     {
-        WriteFFTBufferData(newData);
+        WriteFFTBufferData(m_analysisData, m_analysisTime);
         break;
     }
     default: break;
     }
 }
 
+bool AudioManager::GetLastSpectrogram(QVector<float> &data, qint64 &time)
+{
+    QMutexLocker locker(&m_displayMutex);
+    if (m_spectrogramData.empty()) return false;
+
+    data = m_spectrogramData.back();
+    time = m_spectrogramTimes.back();
+    return true;
+}
+
 void AudioManager::LoadSettings()
 {
     QJsonObject settings = JsonHelper::ReadSetting("AudioSettings");
@@ -126,6 +176,43 @@ void AudioManager::LoadSettings()
         {
             m_volumeSlider->setValue(volume.toInt());
         }
+
+        QVariant playbackLatency;
+        if (JsonHelper::ReadValue(settings, "PlaybackLatency", playbackLatency))
+        {
+            m_playbackLatency = qBound(10, playbackLatency.toInt(), 500);
+        }
+
+        QVariant envelopeAttack;
+        if (JsonHelper::ReadValue(settings, "EnvelopeAttack", envelopeAttack))
+        {
+            m_envelopeAttack = qBound(0.1f, envelopeAttack.toFloat(), 1000.0f);
+        }
+
+        QVariant envelopeRelease;
+        if (JsonHelper::ReadValue(settings, "EnvelopeRelease", envelopeRelease))
+        {
+            m_envelopeRelease = qBound(0.1f, envelopeRelease.toFloat(), 5000.0f);
+        }
+
+        QVariant envelopeThreshold;
+        if (JsonHelper::ReadValue(settings, "EnvelopeThreshold", envelopeThreshold))
+        {
+            m_envelopeThreshold = qBound(-100.0f, envelopeThreshold.toFloat(), 0.0f);
+        }
+
+        QVariant envelopeHysteresis;
+        if (JsonHelper::ReadValue(settings, "EnvelopeHysteresis", envelopeHysteresis))
+        {
+            m_envelopeHysteresis = qBound(0.0f, envelopeHysteresis.toFloat(), 40.0f);
+        }
+
+        QVariant analysisRate;
+        if (JsonHelper::ReadValue(settings, "AnalysisRate", analysisRate))
+        {
+            // 48000 (full rate), 24000 or 16000, applied on next start
+            m_analysisRate = analysisRate.toInt();
+        }
     }
 }
 
@@ -136,6 +223,12 @@ void AudioManager::SaveSettings() const
     settings.insert("OutputName", m_listOutput->currentText());
     settings.insert("DisplayType", m_listDisplay->currentText());
     settings.insert("Volume", m_volumeSlider->value());
+    settings.insert("AnalysisRate", m_analysisRate);
+    settings.insert("PlaybackLatency", m_playbackLatency);
+    settings.insert("EnvelopeAttack", m_envelopeAttack);
+    settings.insert("EnvelopeRelease", m_envelopeRelease);
+    settings.insert("EnvelopeThreshold", m_envelopeThreshold);
+    settings.insert("EnvelopeHysteresis", m_envelopeHysteresis);
 
     JsonHelper::WriteSetting("AudioSettings", settings);
 }
@@ -149,55 +242,66 @@ void AudioManager::paintEvent(QPaintEvent *event)
     QPainter painter(this);
     painter.fillRect(this->rect(), Qt::black);
 
+    if (width <= 0 || height <= 0) return;
+
     QMutexLocker locker(&m_displayMutex);
+    if (m_displayImage.size() != this->size())
+    {
+        locker.unlock();
+        ResizeDisplayImage();
+        locker.relock();
+    }
+
+    // columns are written directly, avoid QImage::scanLine() detach check per pixel
+    QRgb const* colorTable = AudioConversionUtils::getMagnitudeColorTable();
+    uchar* const imageBits = m_displayImage.bits();
+    qsizetype const bytesPerLine = m_displayImage.bytesPerLine();
     switch (m_displayType)
     {
     case AudioDisplayType::RawWave:
     {
-        painter.setPen(QColor(Qt::cyan));
-
         // If no samples, draw a null sound line
         if (m_rawWaveData.isEmpty())
         {
             // Draw null sound line
             QPainter imagePainter(&m_displayImage);
-            imagePainter.fillRect(this->rect(), Qt::black);
+            imagePainter.fillRect(m_displayImage.rect(), Qt::black);
             imagePainter.setPen(QColor(Qt::cyan));
-            imagePainter.drawLine(0, int(heightHalf + 0.5f), this->width(), int(heightHalf + 0.5f));
-            painter.drawImage(this->rect(), m_displayImage);
+            imagePainter.drawLine(0, int(heightHalf + 0.5f), width, int(heightHalf + 0.5f));
+            m_displayCursor = 0;
+            painter.drawImage(0, 0, m_displayImage);
             break;
         }
 
-        QPoint lastPointPos(0, int(heightHalf + 0.5f));
-
-        // Shift previously drawn wave data
-        int const drawWidth = int(float(m_rawWaveData.size()) * AUDIO_RAW_WAVE_SCALE);
-        m_displayImage = m_displayImage.copy(drawWidth, 0, width, height);
-        QPainter imagePainter(&m_displayImage);
-        imagePainter.setPen(QColor(Qt::cyan));
+        // Keep the same time scale regardless of analysis rate
+        float const waveScale = AUDIO_RAW_WAVE_SCALE * float(m_audioFormat.sampleRate()) / float(m_decimator.GetOutputRate());
 
-        // Draw the new data at the right side end of the image
-        int const xPosStart = width - drawWidth;
+        // Write new data at the cursor, each column is a vertical span joining the previous sample
+        QRgb const cyan = QColor(Qt::cyan).rgb();
+        QRgb const black = QColor(Qt::black).rgb();
+        int const drawWidth = qMin(int(float(m_rawWaveData.size()) * waveScale), width);
         for (int i = 0; i < drawWidth; i++)
         {
-            int sampleIndex = int(float(i) / AUDIO_RAW_WAVE_SCALE);
+            int sampleIndex = int(float(i) / waveScale);
             if (sampleIndex >= m_rawWaveData.size()) break;
 
-            float const p = m_rawWaveData[sampleIndex] * heightHalf + heightHalf;
-            if (i == 0)
-            {
-                lastPointPos = QPoint(xPosStart, int(p + 0.5f));
-            }
-            else
+            int const y = qBound(0, int(m_rawWaveData[sampleIndex] * heightHalf + heightHalf + 0.5f), height - 1);
+            int const yStart = qMin(y, m_rawWaveLastY);
+            int const yEnd = qMax(y, m_rawWaveLastY);
+            m_rawWaveLastY = y;
+
+            int const x = m_displayCursor;
+            for (int row = 0; row < height; row++)
             {
-                QPoint newPointPos = QPoint(xPosStart + i, int(p + 0.5f));
-                imagePainter.drawLine(lastPointPos, newPointPos);
-                lastPointPos = newPointPos;
+                QRgb* rowData = (QRgb*)(imageBits + row * bytesPerLine);
+                rowData[x] = (row >= yStart && row <= yEnd) ? cyan : black;
             }
+
+            m_displayCursor = (m_displayCursor + 1) % width;
         }
 
         // Finally draw the image on widget
-        painter.drawImage(this->rect(), m_displayImage);
+        DrawDisplayRing(painter);
         break;
     }
     case AudioDisplayType::FreqBars:
@@ -210,76 +314,65 @@ void AudioManager::paintEvent(QPaintEvent *event)
         // only draw the latest data
         QVector<float> const& spectrogramData = m_spectrogramData.back();
 
-        float const freqRes = float(m_audioFormat.sampleRate()) / FFT_SAMPLE_COUNT;
+        float const freqRes = float(m_decimator.GetOutputRate()) / m_fftSampleCount;
         int const indexStart = int(float(m_freqLow) / freqRes);
-        int const indexEnd = int(float(m_freqHigh) / freqRes) + 1;
+        int const indexEnd = qMin(int(float(m_freqHigh) / freqRes) + 1, int(spectrogramData.size()));
         int const drawWidth = indexEnd - indexStart;
 
-        if (drawWidth >= width)
+        // Bar top and color per column, bins are repeated or skipped to fit the width
+        m_barTops.resize(width);
+        m_barColors.resize(width);
+        for (int i = 0; i < width; i++)
         {
-            // More samples then width, will need to ignore some
-            float const sampleRatio = float(drawWidth) / float(width);
-            for (int i = 0; i < width; i++)
-            {
-                int sampleIndex = indexStart + int(sampleRatio * i);
-                if (sampleIndex >= spectrogramData.size()) break;
+            int const sampleIndex = indexStart + int(float(i) * float(drawWidth) / float(width));
+            float const logMag = (sampleIndex < indexEnd) ? spectrogramData[sampleIndex] : 0.0f;
 
-                float const logMag = spectrogramData[sampleIndex];
-                if (logMag > 0.0f)
-                {
-                    painter.setPen(AudioConversionUtils::getMagnitudeColor(logMag));
-                    painter.drawLine(i, height, i, int((1.0f - logMag) * height));
-                }
-            }
+            m_barTops[i] = (logMag > 0.0f) ? int((1.0f - qMin(logMag, 1.0f)) * height) : height;
+            m_barColors[i] = colorTable[AudioConversionUtils::getMagnitudeIndex(logMag)];
         }
-        else
+
+        QRgb const black = QColor(Qt::black).rgb();
+        for (int row = 0; row < height; row++)
         {
-            // fewer samples than width, we need to scale it up
-            float nextXPos = 0.0f;
-            float const barWidth = float(width) / float(drawWidth);
-            for (int i = 0; i < drawWidth; i++)
+            QRgb* rowData = (QRgb*)(imageBits + row * bytesPerLine);
+            for (int i = 0; i < width; i++)
             {
-                int sampleIndex = indexStart + i;
-                if (sampleIndex >= spectrogramData.size()) break;
-
-                float const logMag = spectrogramData[sampleIndex];
-                if (logMag > 0.0f)
-                {
-                    painter.fillRect(int(nextXPos), int((1.0f - logMag) * height), int(barWidth), height, AudioConversionUtils::getMagnitudeColor(logMag));
-                }
-                nextXPos += barWidth;
+                rowData[i] = (row >= m_barTops[i]) ? m_barColors[i] : black;
             }
         }
+
+        m_displayCursor = 0;
+        painter.drawImage(0, 0, m_displayImage);
         break;
     }
     case AudioDisplayType::Spectrogram:
     {
+        // Don't draw spectrogram if audio is not started
+        if (!m_player->IsPlaying()) return;
+
         for (QVector<float> const& spectrogramData : std::as_const(m_spectrogramData))
         {
-            // Don't draw spectrogram if audio is not started
-            if (!m_audioSink) return;
-
-            // Shift previously drawn spectrogram data
-            m_displayImage = m_displayImage.copy(1, 0, width, height);
-            QPainter imagePainter(&m_displayImage);
-
-            float const freqRes = float(m_audioFormat.sampleRate()) / FFT_SAMPLE_COUNT;
+            float const freqRes = float(m_decimator.GetOutputRate()) / m_fftSampleCount;
             int const indexStart = int(float(m_freqLow) / freqRes);
-            int const indexEnd = int(float(m_freqHigh) / freqRes);
+            int const indexEnd = qMin(int(float(m_freqHigh) / freqRes), int(spectrogramData.size()) - 1);
 
+            // Write a new column at the cursor
+            int const x = m_displayCursor;
             float const sampleRatio = float(indexEnd - indexStart + 1) / float(height);
             for (int i = 0; i < height; i++)
             {
                 int sampleIndex = indexStart + int(sampleRatio * i);
                 if (sampleIndex >= spectrogramData.size()) break;
 
-                imagePainter.setPen(AudioConversionUtils::getMagnitudeColor(spectrogramData[sampleIndex]));
-                imagePainter.drawPoint(width - 1, i);
+                QRgb* rowData = (QRgb*)(imageBits + i * bytesPerLine);
+                rowData[x] = colorTable[AudioConversionUtils::getMagnitudeIndex(spectrogramData[sampleIndex])];
             }
 
-            // Finally draw the image on widget
-            painter.drawImage(this->rect(), m_displayImage);
+            m_displayCursor = (m_displayCursor + 1) % width;
         }
+
+        // Finally draw the image on widget
+        DrawDisplayRing(painter);
         break;
     }
     default: break;
@@ -288,8 +381,8 @@ void AudioManager::paintEvent(QPaintEvent *event)
 
 void AudioManager::resizeEvent(QResizeEvent *event)
 {
-    // shift image to right side
-    m_displayImage = m_displayImage.copy(m_displayImage.width() - this->width(), 0, this->width(), this->height());
+    ResizeDisplayImage();
+    QWidget::resizeEvent(event);
 }
 
 void AudioManager::OnRefreshInputList()
@@ -352,10 +445,9 @@ void AudioManager::OnOutputChanged(QString const& str)
         {
             m_audioOutput.setDevice(device);
 
-            // device changed, may have to start audio again
-            if (m_audioSink)
+            // device changed, may have to start audio again, player swaps the sink in its own thread
+            if (m_player->IsPlaying())
             {
-                ClearAudioSink();
                 StartAudioSink();
             }
             return;
@@ -375,10 +467,7 @@ void AudioManager::OnDisplayChanged(int index)
 void AudioManager::OnVolumeChanged(int value)
 {
     qreal const norm = (qreal)value * 0.01;
-    if (m_audioSink)
-    {
-        m_audioSink->setVolume(norm);
-    }
+    m_player->SetVolume(norm);
 }
 
 void AudioManager::OnDraw()
@@ -386,42 +475,90 @@ void AudioManager::OnDraw()
     this->update();
 }
 
-void AudioManager::StartAudioSink()
+void AudioManager::SetupAnalysis()
 {
-    QMutexLocker locker(&m_sinkMutex);
-    m_audioSink = new QAudioSink(m_audioOutput.device(), m_audioFormat, this);
-    m_audioSink->setVolume((qreal)m_volumeSlider->value() * 0.01);
-    m_audioDevice = m_audioSink->start();
-}
+    // LibVLC may already be pushing data, lock in the same order as PushAudioData
+    QMutexLocker analysisLocker(&m_analysisMutex);
+    QMutexLocker locker(&m_displayMutex);
 
-void AudioManager::ClearAudioSink()
-{
-    QMutexLocker locker(&m_sinkMutex);
-    if (m_audioSink)
+    int const inputRate = m_audioFormat.sampleRate();
+    m_decimator.Initialize(inputRate, m_audioFormat.channelCount(), m_analysisRate);
+    if (m_decimator.GetOutputRate() != m_analysisRate)
     {
-        m_audioSink->stop();
-        delete m_audioSink;
+        // unsupported rate, fallback to full rate
+        m_analysisRate = m_decimator.GetOutputRate();
+    }
+    m_envelope.Initialize(m_analysisRate, m_envelopeAttack, m_envelopeRelease, m_envelopeThreshold, m_envelopeHysteresis);
 
-        m_audioSink = Q_NULLPTR;
-        m_audioDevice = Q_NULLPTR;
+    // Scale FFT size with sample rate so frequency resolution stays the same
+    int const fftSampleCount = FFT_SAMPLE_COUNT / m_decimator.GetFactor();
+    int const fftWindowStep = FFT_WINDOW_STEP / m_decimator.GetFactor();
+    if (m_fftDataIn && m_fftSampleCount == fftSampleCount)
+    {
+        return;
     }
+
+    m_fftSampleCount = fftSampleCount;
+    m_fftWindowStep = fftWindowStep;
+    m_fftBufferData.resize(m_fftSampleCount * 8);
+
+    fftwf_free(m_fftDataIn);
+    fftwf_free(m_fftDataOut);
+    m_fftDataIn = fftwf_alloc_complex(m_fftSampleCount);
+    m_fftDataOut = fftwf_alloc_complex(m_fftSampleCount);
+
+    locker.unlock();
+    ClearFFTBufferData();
 }
 
-void AudioManager::WriteRawWaveData(const QVector<float> &newData)
+void AudioManager::ResizeDisplayImage()
 {
     QMutexLocker locker(&m_displayMutex);
+    if (m_displayImage.size() == this->size()) return;
 
-    int const size = newData.size() / 2;
-    if (m_rawWaveData.size() != size)
+    // keep the newest data on the right side
+    QImage image(this->size(), QImage::Format_RGB32);
+    image.fill(Qt::black);
+    if (!m_displayImage.isNull())
     {
-        m_rawWaveData.resize(size);
+        QPainter imagePainter(&image);
+        imagePainter.translate(image.width() - m_displayImage.width(), 0);
+        DrawDisplayRing(imagePainter);
     }
 
-    // Average LR channels
-    for (int i = 0; i < size; i++)
+    m_displayImage = image;
+    m_displayCursor = 0;
+}
+
+void AudioManager::DrawDisplayRing(QPainter &painter) const
+{
+    int const width = m_displayImage.width();
+    int const height = m_displayImage.height();
+
+    // Oldest column is at the cursor, so [cursor, width) goes to the left then [0, cursor) to the right
+    painter.drawImage(QPoint(0, 0), m_displayImage, QRect(m_displayCursor, 0, width - m_displayCursor, height));
+    if (m_displayCursor > 0)
     {
-        m_rawWaveData[i] = (newData[2*i] + newData[2*i+1]) * 0.5f;
+        painter.drawImage(QPoint(width - m_displayCursor, 0), m_displayImage, QRect(0, 0, m_displayCursor, height));
     }
+}
+
+void AudioManager::StartAudioSink()
+{
+    m_player->Play(m_audioOutput.device(), (qreal)m_volumeSlider->value() * 0.01, m_playbackLatency);
+}
+
+void AudioManager::ClearAudioSink()
+{
+    m_player->Stop();
+}
+
+void AudioManager::WriteRawWaveData(const QVector<float> &monoData)
+{
+    QMutexLocker locker(&m_displayMutex);
+
+    // LR channels are already averaged by the decimator
+    m_rawWaveData = monoData;
 
     emit notifyDraw();
 }
@@ -434,15 +571,17 @@ void AudioManager::ClearRawWaveData()
     }
 }
 
-void AudioManager::WriteFFTBufferData(const QVector<float> &newData)
+void AudioManager::WriteFFTBufferData(const QVector<float> &monoData, qint64 time)
 {
+    TRACE_SCOPE("audio", "AudioManager::WriteFFTBufferData");
     QMutexLocker locker(&m_displayMutex);
+    qint64 const analysisRate = m_decimator.GetOutputRate();
 
     // Push new data to buffer
-    int const frameCount = newData.size() / 2;
+    int const frameCount = monoData.size();
     for (int i = 0; i < frameCount && i < m_fftBufferData.size() - 1; i++)
     {
-        m_fftBufferData[m_fftNewDataStart] = (newData[2*i] + newData[2*i+1]) * 0.5f;
+        m_fftBufferData[m_fftNewDataStart] = monoData[i];
 
         // Warp back to beginning of the buffer
         m_fftNewDataStart++;
@@ -459,21 +598,31 @@ void AudioManager::WriteFFTBufferData(const QVector<float> &newData)
         unprocessedDataSize += m_fftBufferData.size();
     }
 
-    if (unprocessedDataSize >= FFT_SAMPLE_COUNT)
+    if (unprocessedDataSize >= m_fftSampleCount)
     {
         // if we have more data ready, do multiple FFT a frame
-        int const fftCount = unprocessedDataSize / FFT_SAMPLE_COUNT;
+        int const fftCount = unprocessedDataSize / m_fftSampleCount;
         if (m_spectrogramData.size() != fftCount)
         {
             m_spectrogramData.resize(fftCount);
+            m_spectrogramTimes.resize(fftCount);
         }
 
-        for (QVector<float>& spectrogramData : m_spectrogramData)
+        // newest sample written is the last of this block, walk back to the analysis start
+        int const writtenCount = qMin(frameCount, int(m_fftBufferData.size()) - 1);
+        qint64 const newDataTime = time + qint64(writtenCount) * 1000000 / analysisRate;
+        qint64 windowTime = newDataTime - qint64(unprocessedDataSize - m_fftSampleCount / 2) * 1000000 / analysisRate;
+
+        for (int w = 0; w < fftCount; w++)
         {
+            QVector<float>& spectrogramData = m_spectrogramData[w];
+            m_spectrogramTimes[w] = windowTime;
+            windowTime += qint64(m_fftWindowStep) * 1000000 / analysisRate;
+
             // Grab input FFT data, apply Hanning window to reduce leakage
-            QVector<float> const& hanningFunction = AudioConversionUtils::getHanningFunction();
+            QVector<float> const& hanningFunction = AudioConversionUtils::getHanningFunction(m_fftSampleCount);
             int pos = m_fftAnalysisStart;
-            for (int i = 0; i < FFT_SAMPLE_COUNT; i++)
+            for (int i = 0; i < m_fftSampleCount; i++)
             {
                 m_fftDataIn[i][REAL] = m_fftBufferData[pos] * hanningFunction[i];
                 m_fftDataIn[i][IMAG] = 0.0f;
@@ -486,10 +635,12 @@ void AudioManager::WriteFFTBufferData(const QVector<float> &newData)
             }
 
             // Shift to the next window
-            m_fftAnalysisStart = (m_fftAnalysisStart + FFT_WINDOW_STEP) % m_fftBufferData.size();
+            m_fftAnalysisStart = (m_fftAnalysisStart + m_fftWindowStep) % m_fftBufferData.size();
 
-            AudioConversionUtils::fft(FFT_SAMPLE_COUNT, m_fftDataIn, m_fftDataOut);
-            AudioConversionUtils::fftOutToSpectrogram(FFT_SAMPLE_COUNT, m_fftDataOut, spectrogramData);
+            TRACE_SCOPE("audio", "FFT window");
+            AudioConversionUtils::fft(m_fftSampleCount, m_fftDataIn, m_fftDataOut);
+            AudioConversionUtils::fftOutToSpectrogram(m_fftSampleCount, m_fftDataOut, spectrogramData);
+            m_metricFFTWindows->Add();
         }
     }
     else
@@ -507,13 +658,14 @@ void AudioManager::ClearFFTBufferData()
     m_fftNewDataStart = 0;
     m_fftAnalysisStart = 0;
     m_spectrogramData.clear();
+    m_spectrogramTimes.clear();
 
     for (float& f : m_fftBufferData)
     {
         f = 0.0f;
     }
 
-    for (int i = 0; i < FFT_SAMPLE_COUNT; i++)
+    for (int i = 0; i < m_fftSampleCount; i++)
     {
         m_fftDataIn[i][REAL] = 0.0f;
         m_fftDataIn[i][IMAG] = 0.0f;
@@ -522,4 +674,5 @@ void AudioManager::ClearFFTBufferData()
     }
 
     m_displayImage.fill(Qt::black);
+    m_displayCursor = 0;
 }
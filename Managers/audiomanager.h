@@ -16,6 +16,16 @@
 
 #include <fftw3.h>
 
+#include <atomic>
+
+#include "Helpers/audioconversionutils.h"
+#include "Helpers/audiodecimator.h"
+#include "Helpers/audioenvelope.h"
+#include "Helpers/audioplayer.h"
+#include "Helpers/metrics.h"
+
+class SessionRecorder;
+
 namespace Ui { class MainWindow; }
 
 class AudioManager : public QWidget
@@ -29,6 +39,13 @@ public:
     void Initialize(Ui::MainWindow* ui);
 
     QAudioFormat const GetAudioFormat() const { return m_audioFormat; }
+    AudioJitterBuffer::Stats GetPlaybackStats() const { return m_player->GetStats(); }
+    int GetAnalysisRate() const { return m_analysisRate; }
+    int GetFFTSampleCount() const { return m_fftSampleCount; }
+    qint64 GetAudioTime() const { return m_analysisEndTime; }
+    bool GetLastSpectrogram(QVector<float>& data, qint64& time);
+    AudioEnvelope* GetEnvelope() { return &m_envelope; }
+    static QString GetEnvelopeEventName() { return "Audio-Envelope"; }
     QString GetDeviceName() const { return m_listInput->currentText(); }
     QComboBox* GetInputList() const { return m_listInput; }
 
@@ -37,6 +54,9 @@ public:
 
     void PushAudioData(const void *samples, unsigned int count, int64_t pts);
 
+    // samples are recorded with how far ahead of the media clock they are played
+    void SetRecorder(SessionRecorder* recorder) { m_recorder = recorder; }
+
     void LoadSettings();
     void SaveSettings() const;
 
@@ -67,15 +87,21 @@ private slots:
     void OnDraw();
 
 private:
+    void SetupAnalysis();
+
+    // Display
+    void ResizeDisplayImage();
+    void DrawDisplayRing(QPainter& painter) const;
+
     void StartAudioSink();
     void ClearAudioSink();
 
     // Raw Wave
-    void WriteRawWaveData(QVector<float> const& newData);
+    void WriteRawWaveData(QVector<float> const& monoData);
     void ClearRawWaveData();
 
     // Spectrogram
-    void WriteFFTBufferData(QVector<float> const& newData);
+    void WriteFFTBufferData(QVector<float> const& monoData, qint64 time);
     void ClearFFTBufferData();
 
 private:
@@ -92,26 +118,53 @@ private:
 
     // Display
     QMutex              m_displayMutex;
-    QImage              m_displayImage;
+    QImage              m_displayImage;     // ring buffer, m_displayCursor is the next column to write
+    int                 m_displayCursor = 0;
+    QVector<int>        m_barTops;
+    QVector<QRgb>       m_barColors;
     AudioDisplayType    m_displayType = AudioDisplayType::None;
 
+    // Analysis stream (mono, optionally decimated)
+    QMutex              m_analysisMutex;
+    AudioDecimator      m_decimator;
+    int                 m_analysisRate = 48000;
+    QVector<float>      m_analysisData;
+    qint64              m_analysisTime = 0;     // media time of m_analysisData[0]
+    std::atomic<qint64> m_analysisEndTime = 0;  // media time just after the last sample
+
+    // Envelope, always running regardless of display
+    AudioEnvelope       m_envelope;
+    float               m_envelopeAttack = 5.0f;        // ms
+    float               m_envelopeRelease = 200.0f;     // ms
+    float               m_envelopeThreshold = -40.0f;   // dBFS
+    float               m_envelopeHysteresis = 6.0f;    // dB
+
     // Raw Wave data
     QVector<float>      m_rawWaveData;
+    int                 m_rawWaveLastY = 0;
 
     // Spectrogram data
     QVector<float>      m_fftBufferData;
     int                 m_fftNewDataStart = 0;
     int                 m_fftAnalysisStart = 0;
+    int                 m_fftSampleCount = FFT_SAMPLE_COUNT;
+    int                 m_fftWindowStep = FFT_WINDOW_STEP;
     int                 m_freqLow = 0;
     int                 m_freqHigh = 10000;
-    fftwf_complex*      m_fftDataIn;
-    fftwf_complex*      m_fftDataOut;
+    fftwf_complex*      m_fftDataIn = Q_NULLPTR;
+    fftwf_complex*      m_fftDataOut = Q_NULLPTR;
     QVector<QVector<float>> m_spectrogramData;
+    QVector<qint64>         m_spectrogramTimes; // media time at the center of each window
 
     // Output
-    QMutex          m_sinkMutex;
-    QAudioSink*     m_audioSink = Q_NULLPTR;
-    QIODevice*      m_audioDevice = Q_NULLPTR;
+    AudioPlayer*    m_player = Q_NULLPTR;
+    int             m_playbackLatency = 60;
+
+    // Metrics
+    MetricCounter*  m_metricFFTWindows = Q_NULLPTR;
+
+    // Session recording
+    std::atomic<SessionRecorder*>   m_recorder = Q_NULLPTR;
 };
 
 #endif // AUDIOMANAGER_H
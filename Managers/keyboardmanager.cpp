@@ -18,14 +18,17 @@ void KeyboardManager::Initialize(Ui::MainWindow *ui)
 
     connect(ui->PB_KeyboardSettings, &QPushButton::clicked, this, &KeyboardManager::OnShow);
     connect(m_serialManager->GetHolder(), &SerialHolder::notifySerialStatus, this, &KeyboardManager::OnUpdateStatus);
-    connect(this, &KeyboardManager::notifyUserInput, m_serialManager->GetHolder(), &SerialHolder::OnSendButton);
+    connect(this, &KeyboardManager::notifyUserInput, m_serialManager->GetHolder(), [this](quint32 buttonFlag, QPointF lStick, QPointF rStick)
+    {
+        m_serialManager->GetHolder()->SubmitState(SerialHolder::StateSource::Keyboard, buttonFlag, lStick, rStick);
+    }, Qt::DirectConnection);
     connect(m_programManager, &ProgramManager::notifyStartStop, this, &KeyboardManager::OnUpdateStatus);
     connect(m_joystickManager, &JoystickManager::notifyChanged, this, &KeyboardManager::OnJoystickChanged);
 
     // Setup layout
     m_vlcManager->installEventFilter(this);
     this->installEventFilter(this);
-    this->setWindowTitle("Virtual Controller");
+    this->setWindowTitle(SessionContext::GetTitle("Virtual Controller"));
     this->setFixedSize(668,504);
 
     QLabel* image = new QLabel(this);
@@ -445,7 +448,7 @@ void KeyboardManager::OnJoystickChanged(quint32 buttonFlag, QPointF lStick, QPoi
 
     // allow input even if not on active window
     OnDisplayButton(buttonFlag, lStick, rStick);
-    emit notifyUserInput(buttonFlag, lStick, rStick);
+    m_serialManager->GetHolder()->SubmitState(SerialHolder::StateSource::Joystick, buttonFlag, lStick, rStick);
 }
 
 void KeyboardManager::OnUpdateStatus()
@@ -1,9 +1,17 @@
 #include "logmanager.h"
 
+#include <QScrollBar>
+#include <QtConcurrent>
+
 #include "../ui_mainwindow.h"
 #include "Helpers/jsonhelper.h"
+#include "Helpers/sessioncontext.h"
+#include "Helpers/tracer.h"
 
 #define LOG_PATH "../Logs/"
+#define TRACE_PATH "../Traces/"
+#define LOG_BROWSER_UPDATES_PER_SEC 10
+#define LOG_BROWSER_MAX_LINES       5000
 
 void LogManager::Initialize(Ui::MainWindow *ui)
 {
@@ -15,12 +23,13 @@ void LogManager::Initialize(Ui::MainWindow *ui)
     connect(ui->PB_OutputWindow, &QPushButton::clicked, this, &LogManager::OnShow);
 
     // Setup layout
-    this->setWindowTitle("Output Log");
+    this->setWindowTitle(SessionContext::GetTitle("Output Log"));
     this->resize(640,480);
 
     QVBoxLayout* vBoxLayout = new QVBoxLayout(this);
 
     m_browser = new QTextBrowser();
+    m_browser->document()->setMaximumBlockCount(LOG_BROWSER_MAX_LINES);
     vBoxLayout->addWidget(m_browser);
 
     m_btnClear = new QPushButton("Clear Log");
@@ -30,6 +39,14 @@ void LogManager::Initialize(Ui::MainWindow *ui)
         ClearLog();
     });
 
+    m_writer = new LogWriter(this);
+    m_browserTimer.setParent(this);
+    connect(&m_browserTimer, &QTimer::timeout, this, &LogManager::OnUpdateBrowser);
+    m_browserTimer.start(1000 / LOG_BROWSER_UPDATES_PER_SEC);
+
+    new QShortcut(QKeySequence("F3"), ui->centralwidget, this, [this]{ OnToggleTrace(); }, Qt::WindowShortcut);
+    new QShortcut(QKeySequence("F3"), this, [this]{ OnToggleTrace(); }, Qt::WindowShortcut);
+
     ClearLog();
     LoadSettings();
 }
@@ -97,6 +114,28 @@ void LogManager::LoadSettings()
             m_defaultShow = defaultShow.toBool();
         }
     }
+    {
+        QJsonObject rotation = JsonHelper::ReadObject(settings, "Rotation");
+
+        QVariant maxFileMB, maxFileHours, keepDays, maxTotalMB;
+        if (JsonHelper::ReadValue(rotation, "MaxFileMB", maxFileMB))
+        {
+            m_rotation.m_maxSegmentBytes = qMax(1, maxFileMB.toInt()) * 1024LL * 1024;
+        }
+        if (JsonHelper::ReadValue(rotation, "MaxFileHours", maxFileHours))
+        {
+            m_rotation.m_maxSegmentSecs = qMax(1, maxFileHours.toInt()) * 3600LL;
+        }
+        if (JsonHelper::ReadValue(rotation, "KeepDays", keepDays))
+        {
+            m_rotation.m_keepDays = qMax(1, keepDays.toInt());
+        }
+        if (JsonHelper::ReadValue(rotation, "MaxTotalMB", maxTotalMB))
+        {
+            m_rotation.m_maxTotalBytes = qMax(1, maxTotalMB.toInt()) * 1024LL * 1024;
+        }
+        m_writer->SetRotation(m_rotation);
+    }
 }
 
 void LogManager::SaveSettings() const
@@ -107,16 +146,29 @@ void LogManager::SaveSettings() const
     windowSize.insert("X", this->pos().x());
     windowSize.insert("Y", this->pos().y());
 
+    QJsonObject rotation;
+    rotation.insert("MaxFileMB", int(m_rotation.m_maxSegmentBytes / (1024 * 1024)));
+    rotation.insert("MaxFileHours", int(m_rotation.m_maxSegmentSecs / 3600));
+    rotation.insert("KeepDays", m_rotation.m_keepDays);
+    rotation.insert("MaxTotalMB", int(m_rotation.m_maxTotalBytes / (1024 * 1024)));
+
     QJsonObject settings;
     settings.insert("WindowSize", windowSize);
     settings.insert("DefaultShow", m_defaultShow);
+    settings.insert("Rotation", rotation);
 
     JsonHelper::WriteSetting("LogWindow", settings);
 }
 
 void LogManager::SetCurrentLogFile(const QString &file)
 {
-    m_logFile = file;
+    m_writer->SetFile(file);
+}
+
+void LogManager::StartRunLog(const QString &name)
+{
+    // one file per run, split and archived by the writer
+    SetCurrentLogFile(LOG_PATH + name + SessionContext::GetSuffix(SessionContext::Current()) + "_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".log");
 }
 
 void LogManager::SetClearLogEnabled(bool enable)
@@ -126,31 +178,84 @@ void LogManager::SetClearLogEnabled(bool enable)
 
 void LogManager::PrintLog(const QString &category, const QString &log, LogType type)
 {
-    QString const header = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz") + " - [" + category + "]";
-    QColor const color = LogTypeToColor(type);
-    QString r,g,b;
-    r.setNum(color.red(), 16); if (color.red() < 0x10) r = "0" + r;
-    g.setNum(color.green(), 16); if (color.green() < 0x10) g = "0" + g;
-    b.setNum(color.blue(), 16); if (color.blue() < 0x10) b = "0" + b;
-    QString const html = "<font color=\"#FF" + r + g + b + "\">" + header + " " + log + "</font>";
-
-    m_logCount++;
-    m_browser->append(html);
-
-    if (!m_logFile.isEmpty())
+    m_writer->Push(category, log, type);
+}
+
+void LogManager::OnUpdateBrowser()
+{
+    int skipped = 0;
+    QStringList const lines = m_writer->TakeLines(skipped);
+    if (lines.isEmpty() && skipped == 0) return;
+
+    // one edit block for everything since the last update, stay at the bottom only if we were already there
+    QScrollBar* scrollBar = m_browser->verticalScrollBar();
+    bool const atBottom = scrollBar->value() == scrollBar->maximum();
+
+    QTextCursor cursor(m_browser->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+    bool first = m_browser->document()->isEmpty();
+    auto insertLine = [&cursor, &first](QString const& html)
     {
-        QFile file(m_logFile);
-        if(file.open(QIODevice::Append))
+        if (!first)
         {
-            QTextStream stream(&file);
-            stream << header + LogTypeDisplayText(type) + " " + log + "\n";
-            file.close();
+            cursor.insertBlock();
         }
+        cursor.insertHtml(html);
+        first = false;
+    };
+
+    if (skipped > 0)
+    {
+        insertLine("<font color=\"" + LogTypeToColor(LOG_Warning).name(QColor::HexArgb) + "\">... " + QString::number(skipped) + " line(s) not shown</font>");
+    }
+    for (QString const& html : lines)
+    {
+        insertLine(html);
+    }
+    cursor.endEditBlock();
+
+    if (atBottom)
+    {
+        scrollBar->setValue(scrollBar->maximum());
+    }
+}
+
+void LogManager::OnToggleTrace()
+{
+    if (!Tracer::IsEnabled())
+    {
+        Tracer::Start();
+        PrintLog("Global", "Tracing started, press F3 again to save");
+        return;
     }
+
+    Tracer::Stop();
+    if (!QDir(TRACE_PATH).exists())
+    {
+        QDir().mkdir(TRACE_PATH);
+    }
+
+    // can be a few MB of json, don't hold up the GUI
+    QString const fileName = TRACE_PATH + QString("Trace_") + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".json";
+    (void)QtConcurrent::run([this, fileName]
+    {
+        // let scopes that were open when tracing stopped finish writing
+        QThread::msleep(50);
+
+        int const count = Tracer::Save(fileName);
+        if (count < 0)
+        {
+            PrintLog("Global", "Failed to save trace to " + fileName, LOG_Error);
+        }
+        else
+        {
+            PrintLog("Global", "Saved " + QString::number(count) + " trace events to " + fileName + ", open it in chrome://tracing or ui.perfetto.dev", LOG_Success);
+        }
+    });
 }
 
 void LogManager::ClearLog()
 {
-    m_logCount = 0;
     m_browser->clear();
 }
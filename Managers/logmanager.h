@@ -4,10 +4,13 @@
 #include <QDateTime>
 #include <QDir>
 #include <QPushButton>
+#include <QShortcut>
 #include <QTextBrowser>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QWidget>
 
+#include "Helpers/logwriter.h"
 #include "Types/system.h"
 
 namespace Ui { class MainWindow; }
@@ -24,17 +27,23 @@ public:
     bool OnInitShow();
 
     void SetCurrentLogFile(QString const& file);
+    void StartRunLog(QString const& name);
     void SetClearLogEnabled(bool enable);
 
 protected:
     void closeEvent(QCloseEvent *event) override;
 
 public slots:
+    // any thread, connect with Qt::DirectConnection so nothing queues on the GUI thread
     void PrintLog(QString const& category, QString const& log, LogType type = LOG_Normal);
     void ClearLog();
 
     void OnShow();
 
+private slots:
+    void OnUpdateBrowser();
+    void OnToggleTrace();
+
 private:
     void LoadSettings();
     void SaveSettings() const;
@@ -46,8 +55,9 @@ private:
 
     // Members
     bool        m_defaultShow = false;
-    int         m_logCount = 0;
-    QString     m_logFile;
+    LogWriter*  m_writer = Q_NULLPTR;
+    LogWriter::Rotation m_rotation;
+    QTimer      m_browserTimer;
 };
 
 #endif // LOGMANAGER_H
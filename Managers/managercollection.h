@@ -4,6 +4,8 @@
 #include <QMap>
 #include <QObject>
 
+#include "Helpers/sessioncontext.h"
+
 class AudioManager;
 class JoystickManager;
 class KeyboardManager;
@@ -23,21 +25,32 @@ private:
     }
 
 private:
-    QMap<QString, QObject*> m_managers;
+    // one set per session, all sessions are created at startup
+    QMap<QString, QObject*> m_managers[SESSION_MAX_COUNT];
 
 public:
+    // managers belong to the session of the calling thread, events are only delivered in it
+    // to objects parented to the manager (member timers need setParent(this))
     template <class T>
     static T* AddManager(QWidget* parent = nullptr)
     {
+        int const session = SessionContext::Current();
         T* manager = new T(parent);
-        instance().m_managers.insert(T::GetTypeID(), manager);
+        SessionContext::SetObjectSession(manager, session);
+        instance().m_managers[session].insert(T::GetTypeID(), manager);
         return manager;
     }
 
     template <class T>
     static T* GetManager()
     {
-        return qobject_cast<T*>(instance().m_managers.value(T::GetTypeID()));
+        return GetManager<T>(SessionContext::Current());
+    }
+
+    template <class T>
+    static T* GetManager(int session)
+    {
+        return qobject_cast<T*>(instance().m_managers[session].value(T::GetTypeID()));
     }
 };
 
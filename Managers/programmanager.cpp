@@ -1,20 +1,42 @@
 #include "programmanager.h"
 
+#include <QDateTime>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QShortcut>
+
 #include "../ui_mainwindow.h"
+#include "Helpers/inputscheduler.h"
 #include "Helpers/jsonhelper.h"
+#include "Helpers/sessionrecorder.h"
+#include "Managers/audiomanager.h"
 #include "Managers/logmanager.h"
 #include "Managers/keyboardmanager.h"
+#include "Managers/serialmanager.h"
+#include "Managers/videomanager.h"
+#include "Managers/vlcmanager.h"
 
 #include "Programs/Development/devframecapture.h"
+#include "Programs/Development/devinputlatency.h"
+#include "Programs/Development/devloadtest.h"
 #include "Programs/System/commandrecorder.h"
 #include "Programs/System/customcommand.h"
 
 #define PROGRAM_MANUAL_PATH "../Manuals/"
+#define PROGRAM_REPLAY_GRACE_MS 2000    // program may still be finishing after the last recorded frame
 
 void ProgramManager::Initialize(Ui::MainWindow *ui)
 {
     m_logManager = ManagerCollection::GetManager<LogManager>();
 
+    QString const session = Metrics::SessionLabel();
+    m_metricRunning = Metrics::GetGauge("ac2_program_running", "1 while a program is running", session);
+    m_metricStarted = Metrics::GetCounter("ac2_program_started_total", "Programs started", session);
+    m_metricSucceeded = Metrics::GetCounter("ac2_program_finished_total", "Programs that ended by themselves or were stopped", session + ",result=\"success\"");
+    m_metricFailed = Metrics::GetCounter("ac2_program_finished_total", "Programs that ended by themselves or were stopped", session + ",result=\"error\"");
+    m_metricStopped = Metrics::GetCounter("ac2_program_finished_total", "Programs that ended by themselves or were stopped", session + ",result=\"stopped\"");
+
     m_programCategory = ui->CB_ProgramCategory;
     m_programList = ui->LW_ProgramList;
     m_settingsParent = ui->SA_ProgramSetting;
@@ -34,8 +56,28 @@ void ProgramManager::Initialize(Ui::MainWindow *ui)
     connect(m_btnResetDefault, &QPushButton::clicked, this, &ProgramManager::OnResetDefault);
     connect(m_btnManual, &QPushButton::clicked, this, &ProgramManager::OnManualOpen);
 
+    // session recording, everything the program sees and sends
+    m_recorder = new SessionRecorder(this);
+    connect(m_recorder, &SessionRecorder::notifyLog, ManagerCollection::GetManager<LogManager>(), &LogManager::PrintLog, Qt::DirectConnection);
+    ManagerCollection::GetManager<VideoManager>()->SetRecorder(m_recorder);
+    ManagerCollection::GetManager<AudioManager>()->SetRecorder(m_recorder);
+    ManagerCollection::GetManager<SerialManager>()->GetHolder()->SetRecorder(m_recorder);
+
+    VlcManager* vlcManager = ManagerCollection::GetManager<VlcManager>();
+    connect(vlcManager, &VlcManager::notifyReplayMarker, this, &ProgramManager::OnReplayMarker);
+    connect(vlcManager, &VlcManager::notifyReplayFinished, this, &ProgramManager::OnReplayMediaFinished);
+
+    m_replayGraceTimer.setParent(this);
+    m_replayGraceTimer.setSingleShot(true);
+    m_replayGraceTimer.setInterval(PROGRAM_REPLAY_GRACE_MS);
+    connect(&m_replayGraceTimer, &QTimer::timeout, this, [this]{ FinishReplay(QString()); });
+
+    new QShortcut(QKeySequence("F4"), ui->centralwidget, this, [this]{ OnToggleRecording(); }, Qt::WindowShortcut);
+
     // register all programs
     RegisterProgram<Program::Development::DevFrameCapture>();
+    RegisterProgram<Program::Development::DevInputLatency>();
+    RegisterProgram<Program::Development::DevLoadTest>();
     RegisterProgram<Program::System::CommandRecorder>();
     RegisterProgram<Program::System::CustomCommand>();
 
@@ -53,6 +95,12 @@ void ProgramManager::Initialize(Ui::MainWindow *ui)
 
 bool ProgramManager::OnCloseEvent()
 {
+    if (m_replay.m_active)
+    {
+        FinishReplay("Closed before the replay finished");
+    }
+    StopRecording();
+
     SaveSettings();
     RemoveProgram();
     return true;
@@ -107,7 +155,7 @@ void ProgramManager::OnCanRunChanged(bool canRun)
         StopProgram();
 
         m_logManager->PrintLog(m_program->GetInternalName(), "Program forced stopped as Serial or Camera is turned off", LOG_Warning);
-        // TODO: log file name
+        m_metricStopped->Add();
         m_logManager->SetCurrentLogFile("");
     }
 
@@ -136,13 +184,13 @@ void ProgramManager::OnProgramStartStop()
         StopProgram();
 
         m_logManager->PrintLog(m_program->GetInternalName(), "Program stopped by user", LOG_Warning);
-        // TODO: log file name
+        m_metricStopped->Add();
         m_logManager->SetCurrentLogFile("");
     }
     else if (canRun)
     {
         m_logManager->ClearLog();
-        // TODO: set log file
+        m_logManager->StartRunLog(m_program->GetInternalName());
         m_logManager->PrintLog(m_program->GetInternalName(), "Program started");
 
         StartProgram();
@@ -155,17 +203,23 @@ void ProgramManager::OnProgramFinished(int result)
 {
     if (m_program && m_program->IsRunning())
     {
+        QJsonObject marker;
+        marker.insert("Type", "ProgramFinished");
+        marker.insert("Result", result);
+        m_recorder->PushMarker(marker);
+
         StopProgram();
 
         if (result < 0)
         {
             m_logManager->PrintLog(m_program->GetInternalName(), "Program finished with an error", LOG_Error);
+            m_metricFailed->Add();
         }
         else
         {
             m_logManager->PrintLog(m_program->GetInternalName(), "Program finished successfully!", LOG_Success);
+            m_metricSucceeded->Add();
         }
-        // TODO: log file name
         m_logManager->SetCurrentLogFile("");
     }
 }
@@ -228,7 +282,24 @@ void ProgramManager::StartProgram()
 {
     if (!m_program || m_program->IsRunning() || !m_program->CanRun()) return;
 
+    if (m_recorder->IsRecording())
+    {
+        // settings are saved with the start so a replay runs the same program the same way
+        m_program->SaveSettings();
+        QJsonObject const allSettings = JsonHelper::ReadSetting("ProgramSettings");
+
+        QJsonObject marker;
+        marker.insert("Type", "ProgramStart");
+        marker.insert("Category", m_programCategory->currentText());
+        marker.insert("Name", m_programList->currentItem() ? m_programList->currentItem()->text() : "");
+        marker.insert("InternalName", m_program->GetInternalName());
+        marker.insert("Settings", allSettings.value(m_program->GetInternalName()).toObject());
+        m_recorder->PushMarker(marker);
+    }
+
     m_program->Start();
+    m_metricStarted->Add();
+    m_metricRunning->Set(1);
     m_btnStart->setText("Stop Program");
     m_btnResetDefault->setEnabled(false);
     m_programCategory->setEnabled(false);
@@ -242,7 +313,12 @@ void ProgramManager::StopProgram()
 {
     if (!m_program || !m_program->IsRunning()) return;
 
+    QJsonObject marker;
+    marker.insert("Type", "ProgramStop");
+    m_recorder->PushMarker(marker);
+
     m_program->Stop();
+    m_metricRunning->Set(0);
     m_btnStart->setText("Start Program");
     m_btnResetDefault->setEnabled(m_program->HaveSavedSettings());
     m_programCategory->setEnabled(true);
@@ -250,6 +326,11 @@ void ProgramManager::StopProgram()
     m_settingsParent->setEnabled(true);
 
     emit notifyStartStop();
+
+    if (m_replay.m_active && m_replay.m_started)
+    {
+        FinishReplay(QString());
+    }
 }
 
 template<class T>
@@ -286,3 +367,310 @@ void ProgramManager::RemoveProgram()
 
     m_btnResetDefault->setEnabled(false);
 }
+
+bool ProgramManager::StartReplay(const QString &file, qreal tolerance, const QString &reportFile, QString &errorMsg)
+{
+    if (m_replay.m_active || IsRunning())
+    {
+        errorMsg = "A program is already running";
+        return false;
+    }
+
+    // expected inputs are what the program sent between its start and stop,
+    // keyboard and joystick were the user and aren't replayed
+    SessionRecording::Reader reader;
+    if (!reader.Open(file, errorMsg)) return false;
+
+    ReplayState replay;
+    QJsonObject startMarker;
+    qint64 startTime = -1;
+    SessionRecording::Record record;
+    while (reader.ReadNext(record))
+    {
+        if (record.m_type == SessionRecording::RecordType::Marker)
+        {
+            QJsonObject const marker = QJsonDocument::fromJson(record.m_data).object();
+            QString const type = marker.value("Type").toString();
+            if (startTime < 0 && type == "ProgramStart")
+            {
+                startMarker = marker;
+                startTime = record.m_time;
+            }
+            else if (startTime >= 0 && (type == "ProgramFinished" || type == "ProgramStop"))
+            {
+                break;
+            }
+        }
+        else if (startTime >= 0)
+        {
+            SessionRecording::Input input;
+            if (SessionRecording::DecodeInput(record, input)
+             && (input.m_source == quint8(SerialHolder::StateSource::Command) || input.m_source == quint8(SerialHolder::StateSource::Scheduler)))
+            {
+                input.m_time = input.m_time - startTime;
+                replay.m_expected.push_back(input);
+            }
+        }
+    }
+
+    if (startTime < 0)
+    {
+        errorMsg = "No program was started in " + file;
+        return false;
+    }
+
+    // timeline inputs are recorded ahead of when they are played
+    std::stable_sort(replay.m_expected.begin(), replay.m_expected.end(), [](SessionRecording::Input const& a, SessionRecording::Input const& b)
+    {
+        return a.m_time < b.m_time;
+    });
+
+    QString const category = startMarker.value("Category").toString();
+    QString const name = startMarker.value("Name").toString();
+    if (!m_categoryToPrograms.value(category).contains(name))
+    {
+        errorMsg = "Program " + category + "/" + name + " does not exist";
+        return false;
+    }
+
+    SerialHolder* serialHolder = ManagerCollection::GetManager<SerialManager>()->GetHolder();
+    if (serialHolder->IsOpen() || serialHolder->IsConnected())
+    {
+        errorMsg = "Serial must be disconnected before replaying";
+        return false;
+    }
+
+    // run with the recorded settings, the current ones are put back afterwards
+    RemoveProgram();
+    replay.m_internalName = startMarker.value("InternalName").toString();
+    QJsonObject allSettings = JsonHelper::ReadSetting("ProgramSettings");
+    replay.m_savedSettings = allSettings.value(replay.m_internalName).toObject();
+    allSettings.insert(replay.m_internalName, startMarker.value("Settings").toObject());
+    JsonHelper::WriteSetting("ProgramSettings", allSettings);
+
+    m_programCategory->setCurrentText(category);
+    QList<QListWidgetItem*> const items = m_programList->findItems(name, Qt::MatchExactly);
+    if (!items.isEmpty() && m_programList->currentItem() != items.front())
+    {
+        m_programList->setCurrentItem(items.front());
+    }
+    else
+    {
+        OnProgramChanged(name);
+    }
+
+    StopRecording();
+    SetVirtualSerial(true);
+    m_recorder->Start(QString(), QJsonObject());
+
+    replay.m_active = true;
+    replay.m_file = file;
+    replay.m_reportFile = reportFile;
+    replay.m_tolerance = qint64(tolerance * 1000000.0);
+    m_replay = replay;
+
+    if (!ManagerCollection::GetManager<VlcManager>()->StartReplay(file, errorMsg))
+    {
+        FinishReplay(errorMsg);
+        return false;
+    }
+
+    m_logManager->PrintLog("Global", "Replaying " + category + "/" + name + ", expecting " + QString::number(m_replay.m_expected.size()) + " inputs");
+    return true;
+}
+
+void ProgramManager::OnToggleRecording()
+{
+    if (m_replay.m_active) return;
+
+    if (m_recorder->IsRecording())
+    {
+        StopRecording();
+    }
+    else
+    {
+        StartRecording();
+    }
+}
+
+void ProgramManager::OnReplayMarker(const QJsonObject &marker)
+{
+    if (!m_replay.m_active || m_replay.m_started) return;
+    if (marker.value("Type").toString() != "ProgramStart") return;
+
+    m_replay.m_started = true;
+    if (!m_program || !m_program->CanRun())
+    {
+        FinishReplay("Program cannot run");
+        return;
+    }
+
+    // inputs are compared relative to here, same as the recording
+    m_replay.m_startTime = InputScheduler::Now();
+    OnProgramStartStop();
+}
+
+void ProgramManager::OnReplayMediaFinished(const QString &errorMsg)
+{
+    if (!m_replay.m_active) return;
+
+    if (!errorMsg.isEmpty() || !IsRunning())
+    {
+        FinishReplay(errorMsg);
+        return;
+    }
+
+    m_replayGraceTimer.start();
+}
+
+void ProgramManager::StartRecording()
+{
+    if (!QDir(SessionRecording::GetDirectory()).exists())
+    {
+        QDir().mkdir(SessionRecording::GetDirectory());
+    }
+
+    if (IsRunning())
+    {
+        m_logManager->PrintLog("Global", "Program started before recording, it cannot be replayed from this recording", LOG_Warning);
+    }
+
+    QAudioFormat const format = ManagerCollection::GetManager<AudioManager>()->GetAudioFormat();
+    QSize const resolution = FrameAnalysis::GetCaptureResolution();
+    QJsonObject header;
+    header.insert("Width", resolution.width());
+    header.insert("Height", resolution.height());
+    header.insert("VideoFormat", "JPG");
+    header.insert("SampleRate", format.sampleRate());
+    header.insert("Channels", format.channelCount());
+    header.insert("SampleFormat", int(format.sampleFormat()));
+
+    QString const file = SessionRecording::GetDirectory() + QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss") + SessionContext::GetSuffix(SessionContext::Current()) + SessionRecording::GetFormat();
+    m_recorder->Start(file, header);
+    m_logManager->PrintLog("Global", "Session recording started, press F4 again to stop");
+}
+
+void ProgramManager::StopRecording()
+{
+    if (!m_recorder->IsRecording()) return;
+
+    m_recorder->Stop();
+    QString log = "Session recording saved (" + QString::number(qreal(m_recorder->GetFileSize()) / 1048576.0, 'f', 1) + "MB";
+    if (m_recorder->GetDroppedCount() > 0)
+    {
+        log += ", " + QString::number(m_recorder->GetDroppedCount()) + " frames/audio dropped";
+    }
+    log += "): " + QDir(SessionRecording::GetDirectory()).absolutePath();
+    m_logManager->PrintLog("Global", log, m_recorder->GetDroppedCount() > 0 ? LOG_Warning : LOG_Success);
+}
+
+void ProgramManager::FinishReplay(const QString &errorMsg)
+{
+    if (!m_replay.m_active) return;
+
+    // cleared first, stopping the program below comes back here
+    ReplayState const replay = m_replay;
+    m_replay = ReplayState();
+    m_replayGraceTimer.stop();
+
+    if (IsRunning())
+    {
+        StopProgram();
+        m_logManager->PrintLog(m_program->GetInternalName(), "Program stopped by replay", LOG_Warning);
+        m_metricStopped->Add();
+        m_logManager->SetCurrentLogFile("");
+    }
+
+    QVector<SessionRecording::Input> actual;
+    for (SessionRecording::Input input : m_recorder->GetInputs())
+    {
+        if (input.m_source != quint8(SerialHolder::StateSource::Command) && input.m_source != quint8(SerialHolder::StateSource::Scheduler)) continue;
+        input.m_time -= replay.m_startTime;
+        actual.push_back(input);
+    }
+    std::stable_sort(actual.begin(), actual.end(), [](SessionRecording::Input const& a, SessionRecording::Input const& b)
+    {
+        return a.m_time < b.m_time;
+    });
+
+    m_recorder->Stop();
+    ManagerCollection::GetManager<VlcManager>()->StopReplay();
+    SetVirtualSerial(false);
+
+    QJsonObject allSettings = JsonHelper::ReadSetting("ProgramSettings");
+    allSettings.insert(replay.m_internalName, replay.m_savedSettings);
+    JsonHelper::WriteSetting("ProgramSettings", allSettings);
+    if (m_program && m_program->GetInternalName() == replay.m_internalName)
+    {
+        m_program->LoadSettings();
+    }
+
+    QString error = errorMsg;
+    if (error.isEmpty() && !replay.m_started)
+    {
+        error = "Program start was never reached";
+    }
+
+    SessionRecording::Comparison comparison;
+    if (error.isEmpty())
+    {
+        comparison = SessionRecording::CompareInputs(replay.m_expected, actual, replay.m_tolerance);
+    }
+    bool const passed = error.isEmpty() && comparison.IsPassed();
+
+    QString summary = QString::number(comparison.m_matched) + "/" + QString::number(comparison.m_expected) + " inputs matched";
+    summary += " (" + QString::number(comparison.m_actual) + " sent)";
+    summary += ", max error " + QString::number(qreal(comparison.m_maxError) / 1000000.0, 'f', 1) + "ms";
+    summary += ", mean error " + QString::number(qreal(comparison.m_meanError) / 1000000.0, 'f', 1) + "ms";
+    if (passed)
+    {
+        m_logManager->PrintLog("Global", "Replay passed: " + summary, LOG_Success);
+    }
+    else
+    {
+        m_logManager->PrintLog("Global", "Replay failed: " + (error.isEmpty() ? summary : error), LOG_Error);
+        for (QString const& mismatch : std::as_const(comparison.m_mismatches))
+        {
+            m_logManager->PrintLog("Global", mismatch, LOG_Error);
+        }
+    }
+
+    if (!replay.m_reportFile.isEmpty())
+    {
+        // times in milliseconds
+        QJsonObject report;
+        report.insert("Recording", replay.m_file);
+        report.insert("Program", replay.m_internalName);
+        report.insert("Tolerance", qreal(replay.m_tolerance) / 1000000.0);
+        report.insert("Passed", passed);
+        report.insert("Error", error);
+        report.insert("Expected", comparison.m_expected);
+        report.insert("Actual", comparison.m_actual);
+        report.insert("Matched", comparison.m_matched);
+        report.insert("MaxError", qreal(comparison.m_maxError) / 1000000.0);
+        report.insert("MeanError", qreal(comparison.m_meanError) / 1000000.0);
+        report.insert("Mismatches", QJsonArray::fromStringList(comparison.m_mismatches));
+        JsonHelper::WriteJson(replay.m_reportFile, report);
+    }
+
+    emit notifyReplayFinished(passed);
+}
+
+void ProgramManager::SetVirtualSerial(bool connect)
+{
+    // serial thread owns the port, wait so the state is settled when this returns
+    SerialHolder* serialHolder = ManagerCollection::GetManager<SerialManager>()->GetHolder();
+    if (serialHolder->IsVirtual() == connect) return;
+
+    QMetaObject::invokeMethod(serialHolder, [serialHolder, connect]
+    {
+        if (connect)
+        {
+            serialHolder->OnConnectClicked(SerialHolder::GetReplayPortName());
+        }
+        else
+        {
+            serialHolder->OnDisconnectClicked();
+        }
+    }, Qt::BlockingQueuedConnection);
+}
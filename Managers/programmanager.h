@@ -5,11 +5,16 @@
 #include <QDesktopServices>
 #include <QMessageBox>
 #include <QListWidget>
+#include <QTimer>
 #include <QWidget>
 
+#include "Helpers/metrics.h"
+#include "Helpers/sessionrecording.h"
 #include "Managers/managercollection.h"
 #include "Programs/programbase.h"
 
+class SessionRecorder;
+
 namespace Ui { class MainWindow; }
 
 class ProgramManager : public QWidget
@@ -26,8 +31,14 @@ public:
     bool AllowKeyboardInput() const { return !IsRunning() || !m_program->RequireSerial() || m_program->CanControlWhileRunning(); }
     bool IsRunning() const { return m_program && m_program->IsRunning(); }
 
+    // runs the recorded program against a session recording and compares the inputs it sends,
+    // tolerance is in milliseconds, an empty report file writes no report
+    bool StartReplay(QString const& file, qreal tolerance, QString const& reportFile, QString& errorMsg);
+    bool IsReplaying() const { return m_replay.m_active; }
+
 signals:
     void notifyStartStop();
+    void notifyReplayFinished(bool passed);
 
 private slots:
     void OnCategoryChanged(QString const& category);
@@ -38,6 +49,11 @@ private slots:
     void OnResetDefault();
     void OnManualOpen();
 
+    // session recording
+    void OnToggleRecording();
+    void OnReplayMarker(QJsonObject const& marker);
+    void OnReplayMediaFinished(QString const& errorMsg);
+
 private:
     void LoadSettings();
     void SaveSettings() const;
@@ -49,6 +65,12 @@ private:
     void RegisterProgram();
     void RemoveProgram();
 
+    // session recording
+    void StartRecording();
+    void StopRecording();
+    void FinishReplay(QString const& errorMsg);
+    void SetVirtualSerial(bool connect);
+
 private:
     // Managers
     LogManager*     m_logManager = Q_NULLPTR;
@@ -72,6 +94,31 @@ private:
 
     // Members
     Program::ProgramBase*   m_program = Q_NULLPTR;
+
+    // Session recording
+    struct ReplayState
+    {
+        bool        m_active = false;
+        bool        m_started = false;          // program started at the recorded start marker
+        QString     m_file;
+        QString     m_reportFile;
+        QString     m_internalName;
+        qint64      m_tolerance = 0;            // ns
+        qint64      m_startTime = 0;            // InputScheduler::Now() when the program started
+        QJsonObject m_savedSettings;            // restored once the replay is done
+        QVector<SessionRecording::Input> m_expected;  // relative to program start
+    };
+
+    SessionRecorder*    m_recorder = Q_NULLPTR;
+    ReplayState         m_replay;
+    QTimer              m_replayGraceTimer;
+
+    // Metrics
+    MetricGauge*    m_metricRunning = Q_NULLPTR;
+    MetricCounter*  m_metricStarted = Q_NULLPTR;
+    MetricCounter*  m_metricSucceeded = Q_NULLPTR;
+    MetricCounter*  m_metricFailed = Q_NULLPTR;
+    MetricCounter*  m_metricStopped = Q_NULLPTR;
 };
 
 #endif // PROGRAMMANAGER_H
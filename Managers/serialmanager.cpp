@@ -1,8 +1,11 @@
 #include "serialmanager.h"
 
+#include <QJsonArray>
+
 #include "../ui_mainwindow.h"
 #include "defines.h"
 #include "Types/system.h"
+#include "Helpers/commandcompiler.h"
 #include "Helpers/jsonhelper.h"
 #include "Managers/keyboardmanager.h"
 #include "Managers/logmanager.h"
@@ -11,11 +14,16 @@ SerialManager::SerialManager(QWidget* parent) : QWidget(parent)
 {
     connect(this, &SerialManager::notifyClose, parent, &QWidget::close);
 
+    // serial holder is part of the core library and doesn't know about managers
     m_serialHolder = new SerialHolder();
+    LogManager* logManager = ManagerCollection::GetManager<LogManager>();
+    connect(m_serialHolder, &SerialHolder::notifyLog, logManager, &LogManager::PrintLog, Qt::DirectConnection);
+    m_inputScheduler = new InputScheduler();
 }
 
 SerialManager::~SerialManager()
 {
+    delete m_inputScheduler;
     delete m_serialHolder;
 }
 
@@ -27,6 +35,7 @@ void SerialManager::Initialize(Ui::MainWindow *ui)
     m_list = ui->CB_SerialPort;
     m_btnRefresh = ui->PB_SerialRefresh;
     m_btnConnect = ui->PB_SerialConnect;
+    m_labelHealth = ui->L_SerialHealth;
 
     connect(m_btnRefresh, &QPushButton::clicked, this, &SerialManager::OnRefreshList);
     connect(m_btnConnect, &QPushButton::clicked, this, &SerialManager::OnConnectClicked);
@@ -38,6 +47,13 @@ void SerialManager::Initialize(Ui::MainWindow *ui)
     connect(m_serialHolder, &SerialHolder::notifyConnectTimeout, this, &SerialManager::OnConnectTimeout);
     connect(m_serialHolder, &SerialHolder::notifyDisconnecting, this, &SerialManager::OnDisconnecting);
     connect(m_serialHolder, &SerialHolder::notifyDisconnectTimeout, this, &SerialManager::OnDisconnectTimeout);
+    connect(m_serialHolder, &SerialHolder::notifyLinkHealth, this, &SerialManager::OnLinkHealth);
+    connect(m_inputScheduler, &InputScheduler::notifyButton, m_serialHolder, [this](quint32 buttonFlag, QPointF lStick, QPointF rStick, qint64 deadline)
+    {
+        // straight from the scheduler thread, no event loop hop before the state is queued
+        m_serialHolder->SubmitState(SerialHolder::StateSource::Scheduler, buttonFlag, lStick, rStick, deadline);
+    }, Qt::DirectConnection);
+    connect(m_inputScheduler, &InputScheduler::notifyButton, m_keyboardManager, &KeyboardManager::OnDisplayButton);
 
     OnRefreshList();
     LoadSettings();
@@ -61,154 +77,69 @@ void SerialManager::LoadSettings()
 {
     QJsonObject settings = JsonHelper::ReadSetting("SerialSettings");
     {
-        QVariant portName;
-        if (JsonHelper::ReadValue(settings, "PortName", portName) && !portName.toString().isEmpty())
-        {
-            m_list->setCurrentText(portName.toString());
-        }
-    }
-}
-
-void SerialManager::SaveSettings() const
-{
-    QJsonObject settings;
-    settings.insert("PortName", m_list->currentText());
-
-    JsonHelper::WriteSetting("SerialSettings", settings);
-}
-
-bool SerialManager::VerifyCommand(const QString &command, QString &errorMsg)
-{
-    if (command.isEmpty())
-    {
-        errorMsg = "Command is empty";
-        return false;
-    }
-
-    if (command.count('(') != command.count(')'))
-    {
-        errorMsg = "Number of '(' is not matching number of ')'";
-        return false;
-    }
-
-    if (command.contains("))"))
-    {
-        errorMsg = "Double loop ending '))' is not allowed";
-        return false;
-    }
-
-    int minDuration = INT_MAX;
-    bool isLoopCount = false;
-    bool hasInfiniteLoop = false;
-    for (int i = 0; i < command.size();)
-    {
-        qsizetype endIndex = command.indexOf(',', i + 1);
-        QString str = command.mid(i, endIndex == -1 ? -1 : endIndex - i);
-
-        if (hasInfiniteLoop)
+        QVariant extraPorts;
+        if (JsonHelper::ReadValue(settings, "ExtraPorts", extraPorts))
         {
-            errorMsg = "No more command should be after infinite loop";
-            return false;
+            // ports not found by QSerialPortInfo, e.g. the firmware emulator's pty on Linux
+            m_extraPorts = extraPorts.toStringList();
+            OnRefreshList();
         }
 
-        // look for loop start
-        qsizetype const loopStartIndex = str.indexOf('(');
-        if (loopStartIndex > 0)
-        {
-            errorMsg = "Loop start '(' is not expected at index " + QString::number(i + loopStartIndex);
-            return false;
-        }
-        else if (loopStartIndex == 0)
+        QVariant portName;
+        if (JsonHelper::ReadValue(settings, "PortName", portName) && !portName.toString().isEmpty())
         {
-            i++;
-            continue;
+            m_list->setCurrentText(portName.toString());
         }
 
-        // look for loop end
-        qsizetype const loopEndIndex = str.indexOf(')');
-        if (loopEndIndex >= 0)
+        QVariant protocolVersion;
+        if (JsonHelper::ReadValue(settings, "ProtocolVersion", protocolVersion))
         {
-            if (loopEndIndex == 0)
-            {
-                // first index is ')' expecting loop count next
-                i++;
-                isLoopCount = true;
-                continue;
-            }
-            else
-            {
-                // remove all char after ')' so number remains
-                str = str.mid(0, loopEndIndex);
-                endIndex = i + loopEndIndex - 1;
-            }
+            // 1 = always use 9600 baud v1 protocol
+            m_protocolVersion = qBound(1, protocolVersion.toInt(), int(SerialProtocol::Version));
         }
 
-        QStringList const buttons = str.split('|');
-        if (buttons.empty() || (buttons.size() == 1 && !isLoopCount))
+        QVariant baudRate;
+        if (JsonHelper::ReadValue(settings, "BaudRate", baudRate))
         {
-            errorMsg = "Command '" + str + "' is invalid at index " + QString::number(i) + ", expecting Button1|Button2|...|Duration";
-            return false;
+            // v2 only, firmware accepts 250000, 500000, 1000000 or 2000000
+            m_baudRate = baudRate.toInt();
         }
 
-        for (int b = 0; b < buttons.size() - 1; b++)
+        QVariant reportInterval;
+        if (JsonHelper::ReadValue(settings, "ReportInterval", reportInterval))
         {
-            QString const& button = buttons[b].toLower();
-            if (button.startsWith("lx") || button.startsWith("ly") || button.startsWith("rx") || button.startsWith("ry"))
-            {
-                bool ok = false;
-                qreal const stickPos = button.mid(2).toDouble(&ok);
-                if (!ok || qAbs(stickPos) > 1.0)
-                {
-                    errorMsg = "'" + button + "' does not have valid stick position (between -1.0 to 1.0) at index " + QString::number(i);
-                    return false;
-                }
-            }
-            else if (StringToButton(button) == BTN_COUNT)
-            {
-                errorMsg = "'" + button + "' is not a recognized button at index " + QString::number(i);
-                return false;
-            }
+            // microseconds between USB reports polled by the console, converts timeline durations to frames
+            m_reportInterval = qBound(1000, reportInterval.toInt(), 20000);
         }
 
-        bool ok = false;
-        int duration = buttons.back().toInt(&ok);
-        if (!ok || (isLoopCount && duration < 0) || (!isLoopCount && duration <= 0))
+        QVariant inputLatency;
+        if (JsonHelper::ReadValue(settings, "InputLatency", inputLatency))
         {
-            errorMsg = QString(isLoopCount ? "Loop Count" : "Duration") + " '" + buttons.back() + "' is invalid at index " + QString::number(i);
-            return false;
+            // microseconds, measured by Dev-InputLatency for the current capture card and game
+            m_inputLatency = qint64(qMax(0, inputLatency.toInt())) * 1000;
         }
+    }
 
-        if (!isLoopCount && duration < minDuration)
-        {
-            minDuration = duration;
-        }
-        else if (isLoopCount && duration == 0)
-        {
-            hasInfiniteLoop = true;
-        }
-        isLoopCount = false;
+    m_serialHolder->SetProtocolOptions(m_protocolVersion, m_baudRate, m_reportInterval);
+}
 
-        if (endIndex == -1)
-        {
-            break;
-        }
-        else
-        {
-            i = endIndex + 1;
-        }
-    }
+void SerialManager::SaveSettings() const
+{
+    QJsonObject settings;
+    settings.insert("PortName", m_list->currentText());
+    settings.insert("ExtraPorts", QJsonArray::fromStringList(m_extraPorts));
+    settings.insert("ProtocolVersion", m_protocolVersion);
+    settings.insert("BaudRate", m_baudRate);
+    settings.insert("ReportInterval", m_reportInterval);
+    settings.insert("InputLatency", int(m_inputLatency / 1000));
 
-    if (command.endsWith(',') || command.endsWith('|') || command.endsWith('-') || command.endsWith('.') || command.endsWith(')'))
-    {
-        errorMsg = "Ending character not expected";
-        return false;
-    }
+    JsonHelper::WriteSetting("SerialSettings", settings);
+}
 
-    if (minDuration < 50)
-    {
-        errorMsg = "Command with duration " + QString::number(minDuration) + " is less than 50, this may get skipped";
-    }
-    return true;
+bool SerialManager::VerifyCommand(const QString &command, QString &errorMsg)
+{
+    CommandCompiler::Program program;
+    return CommandCompiler::Compile(command, program, errorMsg);
 }
 
 //-----------------------------------------------------------
@@ -223,6 +154,14 @@ void SerialManager::OnRefreshList()
         m_list->addItem(info.portName() + ": " + info.description(), info.portName());
     }
 
+    for (QString const& port : std::as_const(m_extraPorts))
+    {
+        if (QFile::exists(port))
+        {
+            m_list->addItem(port + ": Extra Port", port);
+        }
+    }
+
     m_btnConnect->setEnabled(m_list->count() > 0);
 }
 
@@ -292,9 +231,45 @@ void SerialManager::OnDisconnectTimeout()
     m_btnConnect->setEnabled(true);
     m_btnConnect->setText("Connect");
 
+    m_labelHealth->setText("-");
+    m_labelHealth->setPalette(QPalette());
+
     if (m_aboutToClose)
     {
         m_aboutToClose = false;
         emit notifyClose();
     }
 }
+
+void SerialManager::OnLinkHealth(const LinkHealth::Snapshot &snapshot)
+{
+    if (!m_serialHolder->IsConnected()) return;
+
+    QString text = QString::number(qreal(snapshot.m_rttP50) / 1000000.0, 'f', 1);
+    text += "/" + QString::number(qreal(snapshot.m_rttP99) / 1000000.0, 'f', 1) + "ms";
+    text += " " + QString::number(snapshot.m_lossRate * 100.0, 'f', 1) + "%";
+    text += " " + QString::number(snapshot.m_txRate, 'f', 0) + "B/s";
+    m_labelHealth->setText(text);
+
+    QString toolTip = LinkHealth::ToString(snapshot);
+    toolTip.replace(", ", "\n");
+    for (int i = 0; i < LinkHealth::HistogramBuckets; i++)
+    {
+        toolTip += "\n" + LinkHealth::HistogramBucketName(i) + ": " + QString::number(snapshot.m_histogram[i]);
+    }
+    m_labelHealth->setToolTip(toolTip);
+
+    LogType type = LOG_Success;
+    if (snapshot.m_lossRate >= 0.05 || snapshot.m_rttP99 >= 100000000)
+    {
+        type = LOG_Error;
+    }
+    else if (snapshot.m_lossRate >= 0.01 || snapshot.m_rttP99 >= 20000000)
+    {
+        type = LOG_Warning;
+    }
+
+    QPalette palette = m_labelHealth->palette();
+    palette.setColor(QPalette::WindowText, LogTypeToColor(type));
+    m_labelHealth->setPalette(palette);
+}
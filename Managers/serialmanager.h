@@ -3,12 +3,14 @@
 
 #include <QCloseEvent>
 #include <QComboBox>
+#include <QLabel>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QSerialPort>
 #include <QSerialPortInfo>
 #include <QTimer>
 
+#include "Helpers/inputscheduler.h"
 #include "Helpers/serialholder.h"
 #include "Managers/managercollection.h"
 
@@ -28,6 +30,11 @@ public:
     bool OnCloseEvent();
     bool IsConnected() const { return m_serialHolder && m_serialHolder->IsConnected(); }
     SerialHolder* GetHolder() const { return m_serialHolder; }
+    InputScheduler* GetScheduler() const { return m_inputScheduler; }
+
+    // calibrated serial write to captured frame delay in nanoseconds, 0 = not calibrated
+    qint64 GetInputLatency() const { return m_inputLatency; }
+    void SetInputLatency(qint64 latency) { m_inputLatency = latency; }
 
     static bool VerifyCommand(QString const& command, QString& errorMsg);
 
@@ -47,6 +54,7 @@ private slots:
     void OnConnectTimeout(bool failed, quint8 version = 0);
     void OnDisconnecting();
     void OnDisconnectTimeout();
+    void OnLinkHealth(LinkHealth::Snapshot const& snapshot);
 
 private:
     void LoadSettings();
@@ -63,9 +71,16 @@ private:
     QComboBox*      m_list = Q_NULLPTR;
     QPushButton*    m_btnRefresh = Q_NULLPTR;
     QPushButton*    m_btnConnect = Q_NULLPTR;
+    QLabel*         m_labelHealth = Q_NULLPTR;
 
     // Serial
     SerialHolder*   m_serialHolder = Q_NULLPTR;
+    InputScheduler* m_inputScheduler = Q_NULLPTR;
+    int             m_protocolVersion = SerialProtocol::Version;
+    int             m_baudRate = 500000;
+    int             m_reportInterval = 8000;
+    QStringList     m_extraPorts;
+    std::atomic<qint64> m_inputLatency = 0;
 };
 
 #endif // SERIALMANAGER_H
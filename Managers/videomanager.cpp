@@ -1,8 +1,11 @@
 #include "videomanager.h"
 
 #include "../ui_mainwindow.h"
+#include "Helpers/inputscheduler.h"
 #include "Helpers/jsonhelper.h"
 #include "Helpers/mediadiscoverer.h"
+#include "Helpers/sessionrecorder.h"
+#include "Helpers/tracer.h"
 
 void VideoManager::Initialize(Ui::MainWindow *ui)
 {
@@ -14,14 +17,29 @@ void VideoManager::Initialize(Ui::MainWindow *ui)
     connect(m_btnCameraRefresh, &QPushButton::clicked, this, &VideoManager::OnRefreshList);
     connect(this, &VideoManager::notifyDraw, this, &VideoManager::OnDraw);
 
+    m_resolutionTimer.setParent(this);
     m_resolutionTimer.setSingleShot(true);
-    new QShortcut(QKeySequence("F1"), this, [this]{ m_showFps = !m_showFps; }, Qt::ApplicationShortcut);
-    new QShortcut(QKeySequence("F2"), this, [this]{ m_showCaptureResult = !m_showCaptureResult; }, Qt::ApplicationShortcut);
+
+    // from this console's main window or its video window, never another console's
+    for (QWidget* window : {static_cast<QWidget*>(ui->centralwidget), static_cast<QWidget*>(this)})
+    {
+        new QShortcut(QKeySequence("F1"), window, this, [this]{ m_showFps = !m_showFps; }, Qt::WindowShortcut);
+        new QShortcut(QKeySequence("F2"), window, this, [this]{ m_showCaptureResult = !m_showCaptureResult; }, Qt::WindowShortcut);
+    }
 
     OnRefreshList();
     PopulateResolution();
 
     this->resize(1280, 720);
+
+    QString const session = Metrics::SessionLabel();
+    m_metricFrames = Metrics::GetCounter("ac2_video_frames_total", "Frames received from LibVLC", session);
+    m_metricFrameTime = Metrics::GetHistogram("ac2_video_frame_seconds", "Time to scale a frame and run all captures on it", Metrics::LatencyBounds(), 1e-9, session);
+    char const* const modes[] = {"point_color", "point_range", "area_color", "area_range"};
+    for (int i = 0; i < 4; i++)
+    {
+        m_metricCapture[i] = Metrics::GetHistogram("ac2_capture_eval_seconds", "Time one capture spends on a frame", Metrics::LatencyBounds(), 1e-9, session + ",mode=\"" + modes[i] + "\"");
+    }
 }
 
 QString VideoManager::GetDeviceName() const
@@ -56,34 +74,57 @@ void VideoManager::Stop()
     m_btnCameraRefresh->setEnabled(true);
 }
 
-void VideoManager::PushFrameData(const unsigned char *data)
+void VideoManager::PushFrameData(const unsigned char *data, qint64 time)
 {
     // this is called from LibVLC thread, not thread safe
     QSize const resolution = GetResolution();
+    PushFrameData(QImage(data, resolution.width(), resolution.height(), QImage::Format_ARGB32), time);
+}
+
+void VideoManager::PushFrameData(const QImage &frame, qint64 time)
+{
+    TRACE_SCOPE("video", "VideoManager::PushFrameData");
+    qint64 const start = InputScheduler::Now();
+    m_metricFrames->Add();
 
     QMutexLocker locker(&m_mutex);
-    m_frame = QImage(data, resolution.width(), resolution.height(), QImage::Format_ARGB32);
+    m_frame = frame;
+    m_frameTime = time;
+
+    SessionRecorder* recorder = m_recorder.load(std::memory_order_relaxed);
+    bool const recording = recorder && recorder->IsRecording();
 
     QMutexLocker captureLocker(&m_captureMutex);
-    if (m_captureHolders.empty())
+    if (m_captureHolders.empty() && !recording)
     {
         // we don't need m_frame anymore
         locker.unlock();
     }
     else
     {
-        QSize const captrueRes = CaptureHolder::GetCaptureResolution();
-        QImage const fram720p = (resolution == captrueRes) ? m_frame.copy() : m_frame.scaled(captrueRes);
+        QImage const fram720p = [&]
+        {
+            TRACE_SCOPE("video", "Scale to capture resolution");
+            return FrameAnalysis::ScaleToCapture(m_frame);
+        }();
 
         // we don't need m_frame anymore
         locker.unlock();
 
+        if (recording)
+        {
+            recorder->PushFrame(fram720p);
+        }
+
         // distribute frame data to captures
         for (CaptureHolder* holder : std::as_const(m_captureHolders))
         {
-            holder->PushFrameData(fram720p);
+            qint64 const captureStart = InputScheduler::Now();
+            holder->PushFrameData(fram720p, time);
+            m_metricCapture[int(holder->GetMode())]->Observe(InputScheduler::Now() - captureStart);
         }
     }
+    m_metricFrameTime->Observe(InputScheduler::Now() - start);
 
     emit notifyDraw();
 }
@@ -94,6 +135,12 @@ QImage VideoManager::GetFrameData() const
     return m_frame.copy();
 }
 
+qint64 VideoManager::GetFrameTime() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frameTime;
+}
+
 void VideoManager::RegisterCapture(CaptureHolder *holder)
 {
     QMutexLocker locker(&m_captureMutex);
@@ -17,7 +17,12 @@
 #include <QTimer>
 #include <QVideoSink>
 
+#include <atomic>
+
 #include "Helpers/captureholder.h"
+#include "Helpers/metrics.h"
+
+class SessionRecorder;
 
 namespace Ui { class MainWindow; }
 
@@ -36,12 +41,18 @@ public:
     void Start();
     void Stop();
 
-    void PushFrameData(unsigned char const* data);
+    void PushFrameData(unsigned char const* data, qint64 time);
+    // ARGB32 frame of any resolution, used by the load test to run without LibVLC
+    void PushFrameData(QImage const& frame, qint64 time);
     QImage GetFrameData() const;
+    qint64 GetFrameTime() const;
 
     void RegisterCapture(CaptureHolder* holder);
     void UnregisterCapture(CaptureHolder* holder);
 
+    // frames are recorded at capture resolution
+    void SetRecorder(SessionRecorder* recorder) { m_recorder = recorder; }
+
     void LoadSettings();
     void SaveSettings() const;
 
@@ -81,6 +92,7 @@ private:
     // Frame data
     mutable QMutex  m_mutex;
     QImage          m_frame;
+    qint64          m_frameTime = 0;
 
     // Overlays
     QTimer          m_resolutionTimer;
@@ -93,6 +105,14 @@ private:
     // Captrues
     QMutex                  m_captureMutex;
     QSet<CaptureHolder*>    m_captureHolders;
+
+    // Session recording
+    std::atomic<SessionRecorder*>   m_recorder = Q_NULLPTR;
+
+    // Metrics
+    MetricCounter*      m_metricFrames = Q_NULLPTR;
+    MetricHistogram*    m_metricFrameTime = Q_NULLPTR;
+    MetricHistogram*    m_metricCapture[4] = {};    // by CaptureHolder::Mode
 };
 
 #endif // VIDEOMANAGER_H
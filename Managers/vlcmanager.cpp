@@ -2,6 +2,11 @@
 
 #include "../ui_mainwindow.h"
 #include "Helpers/jsonhelper.h"
+#include "Helpers/mediatimeline.h"
+#include "Helpers/metrics.h"
+#include "Helpers/sessioncontext.h"
+#include "Helpers/sessionreplayer.h"
+#include "Helpers/tracer.h"
 #include "Managers/logmanager.h"
 #include "Managers/audiomanager.h"
 #include "Managers/videomanager.h"
@@ -14,6 +19,7 @@
 
 static void* cbVideoLock(void *opaque, void **planes)
 {
+    TRACE_SCOPE("video", "VLC video lock");
     struct contextVideo *ctx = (contextVideo *)opaque;
     ctx->m_mutex.lock();
 
@@ -22,21 +28,36 @@ static void* cbVideoLock(void *opaque, void **planes)
     return nullptr;
 }
 
-// get the argb image and save it to a file
 static void cbVideoUnlock(void *opaque, void *picture, void *const *planes)
 {
     struct contextVideo *ctx = (contextVideo *)opaque;
-    unsigned char const* data = (unsigned char const*)*planes;
-
-    ctx->m_manager->PushFrameData(data);
     ctx->m_mutex.unlock();
 }
 
+// get the argb image when it is due, VLC keeps a single picture so the decoder waits for this
+static void cbVideoDisplay(void *opaque, void *picture)
+{
+    TRACE_SCOPE("video", "VLC video display");
+    struct contextVideo *ctx = (contextVideo *)opaque;
+
+    // LibVLC threads are not ours, adopt the session every frame (thread local, no OS call unless it changes)
+    SessionContext::SetCurrent(ctx->m_session);
+    SessionContext::PinCurrentThread();
+
+    // video callbacks have no pts, but display is called at the frame's pts on the clock audio pts use
+    QMutexLocker locker(&ctx->m_mutex);
+    ctx->m_manager->PushFrameData(ctx->m_pixels, libvlc_clock());
+}
+
 static void cbAudioPlay(void* p_audio_data, const void *samples, unsigned int count, int64_t pts)
 {
+    TRACE_SCOPE("audio", "VLC audio play");
     struct contextAudio *ctx = (contextAudio *)p_audio_data;
     if (!ctx->m_manager) return;
 
+    SessionContext::SetCurrent(ctx->m_session);
+    SessionContext::PinCurrentThread();
+
     // Pass new raw data to manager
     ctx->m_manager->PushAudioData(samples, count, pts);
 }
@@ -77,25 +98,40 @@ void VlcManager::Initialize(Ui::MainWindow *ui)
     // Video
     int constexpr MAX_WIDTH = 3840;
     int constexpr MAX_HEIGHT = 2160;
+    ctxVideo.m_session = SessionContext::Current();
     ctxVideo.m_manager = ManagerCollection::AddManager<VideoManager>(this);
     ctxVideo.m_manager->Initialize(ui);
     ctxVideo.m_pixels = new uchar[MAX_WIDTH * MAX_HEIGHT * 4];
     memset(ctxVideo.m_pixels, 0, MAX_WIDTH * MAX_HEIGHT * 4);
 
     // Audio
+    ctxAudio.m_session = SessionContext::Current();
     ctxAudio.m_manager = ManagerCollection::AddManager<AudioManager>(this);
     ctxAudio.m_manager->Initialize(ui);
 
+    // counted by LibVLC, only read when metrics are exported
+    Metrics::AddCallback("ac2_video_frames_lost_total", "Frames LibVLC dropped before they reached the video callback", true, Metrics::SessionLabel(), this, [this]
+    {
+        libvlc_media_t* media = libvlc_media_player_get_media(m_mediaPlayer);
+        if (!media) return 0.0;
+
+        libvlc_media_stats_t stats;
+        bool const valid = libvlc_media_get_stats(media, &stats);
+        libvlc_media_release(media);
+        return valid ? double(stats.i_lost_pictures) : 0.0;
+    });
+
     // connections
     connect(m_btnCameraStart, &QPushButton::clicked, this, &VlcManager::OnCameraClicked);
     connect(m_btnScreenshot, &QPushButton::clicked, this, &VlcManager::OnScreenshot);
+    m_startVerifyTimer.setParent(this);
     connect(&m_startVerifyTimer, &QTimer::timeout, this, &VlcManager::OnCameraStartTimeout);
     connect(m_audioDisplay, &QComboBox::currentIndexChanged, this, &VlcManager::OnAudioDisplayChanged);
     connect(ctxVideo.m_manager, &VideoManager::notifyDraw, this, &VlcManager::OnCameraStartTimeout);
     connect(this, &VlcManager::notifyStateChanged, this, &VlcManager::OnEventCallback);
 
     // Setup layout
-    this->setWindowTitle("Media View");
+    this->setWindowTitle(SessionContext::GetTitle("Media View"));
     this->resize(1280,720);
     QVBoxLayout* vBoxLayout = new QVBoxLayout(this);
     vBoxLayout->addItem(new QSpacerItem(20, 40, QSizePolicy::Minimum, QSizePolicy::Expanding));
@@ -122,6 +158,7 @@ bool VlcManager::OnCloseEvent()
     {
         Stop();
     }
+    StopReplay();
 
     SaveSettings();
     return true;
@@ -244,6 +281,66 @@ void VlcManager::mouseDoubleClickEvent(QMouseEvent *event)
     QWidget::mouseDoubleClickEvent(event);
 }
 
+bool VlcManager::StartReplay(const QString &file, QString &errorMsg)
+{
+    if (m_started || m_replayer)
+    {
+        errorMsg = "Camera must be stopped before replaying";
+        return false;
+    }
+
+    MediaTimeline::Clear();
+    ctxVideo.m_manager->Start();
+    ctxAudio.m_manager->Start();
+    m_btnCameraStart->setEnabled(false);
+
+    m_replayer = new SessionReplayer(file, ctxVideo.m_manager, ctxAudio.m_manager, this);
+    connect(m_replayer, &SessionReplayer::notifyMarker, this, &VlcManager::notifyReplayMarker);
+    connect(m_replayer, &SessionReplayer::notifyFinished, this, &VlcManager::OnReplayFinished);
+    m_replayer->start();
+    emit notifyHasVideo();
+
+    m_logManager->PrintLog("Global", "Replaying " + QFileInfo(file).fileName());
+    this->show();
+    return true;
+}
+
+void VlcManager::StopReplay()
+{
+    if (!m_replayer) return;
+
+    m_replayer->Stop();
+    m_replayer->wait();
+    delete m_replayer;
+    m_replayer = Q_NULLPTR;
+    emit notifyHasVideo();
+
+    m_btnCameraStart->setEnabled(true);
+    ctxVideo.m_manager->Stop();
+    ctxAudio.m_manager->Stop();
+
+    m_logManager->PrintLog("Global", "Replay stopped", LOG_Warning);
+    this->hide();
+}
+
+void VlcManager::OnReplayFinished(const QString &errorMsg)
+{
+    // may be queued behind a replay that was already stopped
+    if (!m_replayer || sender() != m_replayer) return;
+
+    if (!errorMsg.isEmpty())
+    {
+        m_logManager->PrintLog("Global", "Replay failed: " + errorMsg, LOG_Error);
+    }
+    else
+    {
+        m_logManager->PrintLog("Global", "Replay reached the end of the recording");
+    }
+
+    // kept until StopReplay so a running program still has video while it finishes
+    emit notifyReplayFinished(errorMsg);
+}
+
 void VlcManager::OnCameraClicked()
 {
     if (m_started)
@@ -372,7 +469,7 @@ void VlcManager::Start()
     libvlc_media_release(m_media);
 
     // Set the callback to extract the frame or display it on the screen
-    libvlc_video_set_callbacks(m_mediaPlayer, cbVideoLock, cbVideoUnlock, nullptr, &ctxVideo);
+    libvlc_video_set_callbacks(m_mediaPlayer, cbVideoLock, cbVideoUnlock, cbVideoDisplay, &ctxVideo);
     libvlc_video_set_format(m_mediaPlayer, "BGRA", resolution.width(), resolution.height(), resolution.width() * 4);
 
     // Set callback to extract raw PCM data
@@ -396,6 +493,7 @@ void VlcManager::Start()
         m_btnCameraStart->setText("Starting...");
         m_btnCameraStart->setEnabled(false);
 
+        MediaTimeline::Clear();
         ctxVideo.m_manager->Start();
         ctxAudio.m_manager->Start();
 
@@ -18,17 +18,21 @@
 
 #include "Managers/managercollection.h"
 
+class SessionReplayer;
+
 struct contextVideo
 {
     QMutex m_mutex;
     uchar *m_pixels;
 
     VideoManager* m_manager;
+    int m_session = 0;
 };
 
 struct contextAudio
 {
     AudioManager* m_manager;
+    int m_session = 0;
 };
 
 namespace Ui { class MainWindow; }
@@ -43,7 +47,12 @@ public:
     void Initialize(Ui::MainWindow* ui);
 
     bool OnCloseEvent();
-    bool HasVideo() const { return m_startVerified; }
+    bool HasVideo() const { return m_startVerified || m_replayer != Q_NULLPTR; }
+
+    // feeds a session recording instead of the camera, stays on after the end until StopReplay
+    bool StartReplay(QString const& file, QString& errorMsg);
+    void StopReplay();
+    bool IsReplaying() const { return m_replayer != Q_NULLPTR; }
 
 protected:
     void closeEvent(QCloseEvent *event) override;
@@ -53,6 +62,8 @@ protected:
 signals:
     void notifyStateChanged();
     void notifyHasVideo();
+    void notifyReplayMarker(QJsonObject const& marker);
+    void notifyReplayFinished(QString const& errorMsg);
 
 private slots:
     void OnCameraClicked();
@@ -60,6 +71,7 @@ private slots:
     void OnAudioDisplayChanged(int index);
     void OnEventCallback();
     void OnScreenshot();
+    void OnReplayFinished(QString const& errorMsg);
 
 private:
     void LoadSettings();
@@ -90,6 +102,7 @@ private:
     bool    m_started = false;
     bool    m_startVerified = false;
     QTimer  m_startVerifyTimer;
+    SessionReplayer* m_replayer = Q_NULLPTR;
 };
 
 #endif // VLCMANAGER_H
@@ -0,0 +1,128 @@
+#include "devinputlatency.h"
+#include "Helpers/captureholder.h"
+#include "Helpers/jsonhelper.h"
+#include "Managers/serialmanager.h"
+
+namespace Program::Development
+{
+
+DevInputLatency::DevInputLatency(QObject *parent) : ProgramBase(parent)
+{
+}
+
+void DevInputLatency::PopulateSettings(QBoxLayout *layout)
+{
+    QDir const directory(CaptureHolder::GetDirectory());
+    QStringList const files = directory.entryList({"*" + CaptureHolder::GetFormat()}, QDir::Files);
+
+    QStringList presets;
+    for (QString const& file : files)
+    {
+        presets << file.mid(0, file.size() - CaptureHolder::GetFormat().size());
+    }
+
+    m_preset = new Setting::SettingComboBox("CaptureType", presets);
+    m_savedSettings.insert(m_preset);
+    AddSetting(layout, "Capture Preset:", "Create one in Dev-FrameCapture, it should change while the button below is held", m_preset, false);
+
+    QStringList buttons;
+    for (int i = BTN_A; i < BTN_Spam; i++)
+    {
+        buttons << ButtonToString(ButtonType(i));
+    }
+    m_button = new Setting::SettingComboBox("Button", buttons);
+    m_savedSettings.insert(m_button);
+    AddSetting(layout, "Button:", "", m_button, true);
+
+    m_count = new Setting::SettingSpinBox("Count", 5, 500, 50);
+    m_savedSettings.insert(m_count);
+    AddSetting(layout, "Presses:", "", m_count, true);
+
+    m_apply = new Setting::SettingComboBox("Apply", {"Yes", "No"});
+    m_savedSettings.insert(m_apply);
+    AddSetting(layout, "Save As Input Latency:", "", m_apply, true);
+
+    m_labelCurrent = AddText(layout, "", false);
+    UpdateCurrentLatency();
+
+    AddSpacer(layout);
+}
+
+bool DevInputLatency::CanRun() const
+{
+    return ProgramBase::CanRun() && m_preset && m_preset->count() > 0;
+}
+
+void DevInputLatency::Start()
+{
+    ProgramBase::Start();
+
+    QString const name = CaptureHolder::GetDirectory() + m_preset->currentText() + CaptureHolder::GetFormat();
+    QJsonObject const object = JsonHelper::ReadJson(name);
+
+    QVariant value;
+    auto readInt = [&object, &value](QString const& key, int defaultValue)
+    {
+        return JsonHelper::ReadValue(object, key, value) ? value.toInt() : defaultValue;
+    };
+
+    QPoint const point(readInt("Left", 0), readInt("Top", 0));
+    QRect const rect(point, QSize(readInt("Width", 100), readInt("Height", 100)));
+    HsvRange const range(readInt("MinH", 0), readInt("MinS", 0), readInt("MinV", 0), readInt("MaxH", 359), readInt("MaxS", 255), readInt("MaxV", 255));
+    QColor const color(QRgb(readInt("Color", 0)));
+
+    Module::Common::LatencyProbe::Probe probe;
+    probe.m_buttonFlag = StringToButtonFlag(m_button->currentText());
+    probe.m_count = m_count->value();
+    if (JsonHelper::ReadValue(object, "Mean", value))
+    {
+        probe.m_meanThreshold = value.toDouble();
+    }
+
+    using Module::Common::LatencyProbe;
+    switch (CaptureHolder::Mode(readInt("Mode", 0)))
+    {
+    case CaptureHolder::Mode::PointColorMatch:
+        m_moduleProbe = AddModule<LatencyProbe>(&DevInputLatency::OnProbeFinished, point, color, probe);
+        break;
+    case CaptureHolder::Mode::PointRangeMatch:
+        m_moduleProbe = AddModule<LatencyProbe>(&DevInputLatency::OnProbeFinished, point, range, probe);
+        break;
+    case CaptureHolder::Mode::AreaColorMatch:
+        m_moduleProbe = AddModule<LatencyProbe>(&DevInputLatency::OnProbeFinished, rect, color, probe);
+        break;
+    case CaptureHolder::Mode::AreaRangeMatch:
+        m_moduleProbe = AddModule<LatencyProbe>(&DevInputLatency::OnProbeFinished, rect, range, probe);
+        break;
+    }
+}
+
+void DevInputLatency::Stop()
+{
+    ClearModule((Module::ModuleBase**)&m_moduleProbe);
+    ProgramBase::Stop();
+}
+
+void DevInputLatency::OnProbeFinished()
+{
+    if (!m_started) return;
+
+    int const result = m_moduleProbe->GetResult();
+    if (result >= 0 && m_apply->currentText() == "Yes")
+    {
+        Module::Common::LatencyProbe::Latency const latency = m_moduleProbe->GetLatency();
+        m_serialManager->SetInputLatency(latency.m_median);
+        UpdateCurrentLatency();
+        PrintLog("Input latency set to " + QString::number(qreal(latency.m_median) / 1000000.0, 'f', 2) + "ms", LOG_Success);
+    }
+
+    emit notifyFinished(result);
+}
+
+void DevInputLatency::UpdateCurrentLatency()
+{
+    qint64 const latency = m_serialManager->GetInputLatency();
+    m_labelCurrent->setText("Current input latency: " + (latency > 0 ? QString::number(qreal(latency) / 1000000.0, 'f', 2) + "ms" : QString("not calibrated")));
+}
+
+}
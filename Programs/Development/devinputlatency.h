@@ -0,0 +1,56 @@
+#ifndef DEVINPUTLATENCY_H
+#define DEVINPUTLATENCY_H
+
+#include <QDir>
+
+#include "../programbase.h"
+#include "Programs/Modules/Common/latencyprobe.h"
+#include "Programs/Settings/settingcombobox.h"
+#include "Programs/Settings/settingspinbox.h"
+
+namespace Program::Development
+{
+class DevInputLatency : public ProgramBase
+{
+    Q_OBJECT
+public:
+    explicit DevInputLatency(QObject* parent = nullptr);
+
+    static QString GetCategory() { return "Development"; }
+    static QString GetName() { return "Input Latency"; }
+
+    // from ProgramBase
+    void PopulateSettings(QBoxLayout* layout) override;
+    QString GetInternalName() const override { return "Dev-InputLatency"; }
+    QString GetDescription() const override {
+        return "Measures the delay from sending an input to seeing it in the video, using a FrameCapture preset that changes when the button is held.\n"
+            "The median is saved as the input latency used by frame triggers.";
+    }
+
+    bool RequireSerial() const override { return true; }
+    bool RequireVideo() const override { return true; }
+    bool RequireAudio() const override { return false; }
+
+    bool CanRun() const override;
+
+    void Start() override;
+    void Stop() override;
+
+private slots:
+    void OnProbeFinished();
+
+private:
+    void UpdateCurrentLatency();
+
+private:
+    Setting::SettingComboBox* m_preset = Q_NULLPTR;
+    Setting::SettingComboBox* m_button = Q_NULLPTR;
+    Setting::SettingSpinBox* m_count = Q_NULLPTR;
+    Setting::SettingComboBox* m_apply = Q_NULLPTR;
+    QLabel* m_labelCurrent = Q_NULLPTR;
+
+    Module::Common::LatencyProbe* m_moduleProbe = Q_NULLPTR;
+};
+}
+
+#endif // DEVINPUTLATENCY_H
@@ -0,0 +1,189 @@
+#include "devloadtest.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+
+#include "Helpers/jsonhelper.h"
+#include "Helpers/sessioncontext.h"
+#include "Managers/vlcmanager.h"
+
+#define LOAD_TEST_PATH "../LoadTests/"
+
+namespace Program::Development
+{
+
+namespace
+{
+QSize ParseSize(QString const& str)
+{
+    QStringList const values = str.split('x');
+    return values.size() == 2 ? QSize(values[0].toInt(), values[1].toInt()) : QSize();
+}
+
+QJsonObject LatencyToJson(Module::Common::LoadGenerator::Latency const& latency)
+{
+    QJsonObject object;
+    object.insert("Mean", latency.m_mean);
+    object.insert("P50", latency.m_p50);
+    object.insert("P90", latency.m_p90);
+    object.insert("P99", latency.m_p99);
+    object.insert("Max", latency.m_max);
+    return object;
+}
+}
+
+DevLoadTest::DevLoadTest(QObject *parent) : ProgramBase(parent)
+{
+}
+
+void DevLoadTest::PopulateSettings(QBoxLayout *layout)
+{
+    m_resolution = new Setting::SettingComboBox("Resolution", {"1280x720", "1920x1080", "3840x2160", "All"});
+    m_savedSettings.insert(m_resolution);
+    AddSetting(layout, "Frame Resolution:", "All sweeps each resolution in turn", m_resolution, true);
+
+    m_fps = new Setting::SettingSpinBox("FPS", 1, 240, 60);
+    m_savedSettings.insert(m_fps);
+    AddSetting(layout, "Frame Rate:", "", m_fps, true);
+
+    m_pointCount = new Setting::SettingSpinBox("PointCount", 0, 100, 2);
+    m_savedSettings.insert(m_pointCount);
+    m_areaCount = new Setting::SettingSpinBox("AreaCount", 0, 100, 1);
+    m_savedSettings.insert(m_areaCount);
+    m_rangeCount = new Setting::SettingSpinBox("RangeCount", 0, 100, 1);
+    m_savedSettings.insert(m_rangeCount);
+    AddSettings(layout, "Captures Per Step:", "Point, area color match and area range match captures added every step", {m_pointCount, m_areaCount, m_rangeCount}, true);
+
+    m_analysis = new Setting::SettingComboBox("Analysis", {"Capture Modules", "Video Thread"});
+    m_savedSettings.insert(m_analysis);
+    AddSetting(layout, "Analysis:", "Capture modules analyze on their own threads like programs, video thread analysis blocks frame delivery like FrameTrigger", m_analysis, true);
+
+    m_areaSize = new Setting::SettingComboBox("AreaSize", {"16x16", "64x64", "200x100", "640x360", "1280x720"});
+    m_savedSettings.insert(m_areaSize);
+    AddSetting(layout, "Area Size:", "", m_areaSize, true);
+
+    m_maxSteps = new Setting::SettingSpinBox("MaxSteps", 1, 100, 20);
+    m_savedSettings.insert(m_maxSteps);
+    m_stepSecs = new Setting::SettingSpinBox("StepSecs", 1, 60, 5);
+    m_savedSettings.insert(m_stepSecs);
+    AddSettings(layout, "Steps, Seconds Per Step:", "", {m_maxSteps, m_stepSecs}, true);
+
+    m_maxDropRate = new Setting::SettingDoubleSpinBox("MaxDropRate", 0.0, 100.0, 1.0);
+    m_savedSettings.insert(m_maxDropRate);
+    AddSetting(layout, "Max Dropped Frames (%):", "Moves on to the next resolution once a step drops or capture modules skip more than this", m_maxDropRate, true);
+
+    AddSpacer(layout);
+}
+
+bool DevLoadTest::CanRun() const
+{
+    // generated frames would be mixed with LibVLC's
+    return ProgramBase::CanRun() && !m_vlcManager->HasVideo();
+}
+
+void DevLoadTest::Start()
+{
+    ProgramBase::Start();
+
+    Module::Common::LoadGenerator::Config config;
+    if (m_resolution->currentText() == "All")
+    {
+        for (int i = 0; i < m_resolution->count() - 1; i++)
+        {
+            config.m_resolutions.push_back(ParseSize(m_resolution->itemText(i)));
+        }
+    }
+    else
+    {
+        config.m_resolutions.push_back(ParseSize(m_resolution->currentText()));
+    }
+    config.m_fps = m_fps->value();
+    config.m_pointCount = m_pointCount->value();
+    config.m_areaCount = m_areaCount->value();
+    config.m_rangeCount = m_rangeCount->value();
+    config.m_areaSize = ParseSize(m_areaSize->currentText());
+    config.m_maxSteps = m_maxSteps->value();
+    config.m_stepSecs = m_stepSecs->value();
+    config.m_maxDropRate = m_maxDropRate->value() / 100.0;
+    config.m_videoThreadAnalysis = m_analysis->currentText() == "Video Thread";
+
+    if (config.m_pointCount + config.m_areaCount + config.m_rangeCount == 0)
+    {
+        PrintLog("No captures added per step, only frame scaling is measured", LOG_Warning);
+    }
+
+    m_moduleGenerator = AddModule<Module::Common::LoadGenerator>(&DevLoadTest::OnGeneratorFinished, config);
+}
+
+void DevLoadTest::Stop()
+{
+    ClearModule((Module::ModuleBase**)&m_moduleGenerator);
+    ProgramBase::Stop();
+}
+
+void DevLoadTest::OnGeneratorFinished()
+{
+    if (!m_started) return;
+
+    SaveResults();
+    emit notifyFinished(m_moduleGenerator->GetResult());
+}
+
+void DevLoadTest::SaveResults() const
+{
+    using Module::Common::LoadGenerator;
+    QVector<LoadGenerator::StepResult> const& results = m_moduleGenerator->GetResults();
+    if (results.isEmpty()) return;
+
+    char const* const modes[] = {"PointColor", "PointRange", "AreaColor", "AreaRange"};
+
+    QJsonArray steps;
+    for (LoadGenerator::StepResult const& result : results)
+    {
+        QJsonObject step;
+        step.insert("Width", result.m_resolution.width());
+        step.insert("Height", result.m_resolution.height());
+        step.insert("Frames", result.m_frames);
+        step.insert("Dropped", result.m_dropped);
+        step.insert("FPS", result.m_fps);
+        step.insert("DropRate", result.m_dropRate);
+        step.insert("CaptureSkipRate", result.m_captureSkipRate);
+        step.insert("CpuVideo", result.m_cpuVideo);
+        step.insert("CpuProcess", result.m_cpuProcess);
+        step.insert("Frame", LatencyToJson(result.m_frame));
+        step.insert("Scale", LatencyToJson(result.m_scale));
+
+        QJsonObject counts;
+        QJsonObject captures;
+        for (int i = 0; i < 4; i++)
+        {
+            counts.insert(modes[i], result.m_captureCount[i]);
+            if (result.m_captureCount[i] > 0)
+            {
+                captures.insert(modes[i], LatencyToJson(result.m_capture[i]));
+            }
+        }
+        step.insert("CaptureCount", counts);
+        step.insert("Capture", captures);
+        steps.append(step);
+    }
+
+    // latencies in nanoseconds, CPU in percent of one core
+    QJsonObject object;
+    object.insert("FPS", m_fps->value());
+    object.insert("AreaSize", m_areaSize->currentText());
+    object.insert("Analysis", m_analysis->currentText());
+    object.insert("Threads", QThread::idealThreadCount());
+    object.insert("Steps", steps);
+
+    if (!QDir(LOAD_TEST_PATH).exists())
+    {
+        QDir().mkdir(LOAD_TEST_PATH);
+    }
+
+    QString const file = LOAD_TEST_PATH + QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss") + SessionContext::GetSuffix(SessionContext::Current()) + ".json";
+    JsonHelper::WriteJson(file, object);
+    PrintLog("Results saved to " + file, LOG_Success);
+}
+
+}
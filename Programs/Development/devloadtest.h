@@ -0,0 +1,62 @@
+#ifndef DEVLOADTEST_H
+#define DEVLOADTEST_H
+
+#include <QDir>
+
+#include "../programbase.h"
+#include "Programs/Modules/Common/loadgenerator.h"
+#include "Programs/Settings/settingcombobox.h"
+#include "Programs/Settings/settingdoublespinbox.h"
+#include "Programs/Settings/settingspinbox.h"
+
+namespace Program::Development
+{
+class DevLoadTest : public ProgramBase
+{
+    Q_OBJECT
+public:
+    explicit DevLoadTest(QObject* parent = nullptr);
+
+    static QString GetCategory() { return "Development"; }
+    static QString GetName() { return "Load Test"; }
+
+    // from ProgramBase
+    void PopulateSettings(QBoxLayout* layout) override;
+    QString GetInternalName() const override { return "Dev-LoadTest"; }
+    QString GetDescription() const override {
+        return "Feeds generated frames to the capture pipeline at a fixed rate with the video stopped, adding captures every step until frames drop.\n"
+            "Each step logs throughput, drop rate and CPU use, the full per-stage latency is saved to ../LoadTests/.";
+    }
+
+    bool RequireSerial() const override { return false; }
+    bool RequireVideo() const override { return false; }
+    bool RequireAudio() const override { return false; }
+
+    bool CanRun() const override;
+
+    void Start() override;
+    void Stop() override;
+
+private slots:
+    void OnGeneratorFinished();
+
+private:
+    void SaveResults() const;
+
+private:
+    Setting::SettingComboBox* m_resolution = Q_NULLPTR;
+    Setting::SettingSpinBox* m_fps = Q_NULLPTR;
+    Setting::SettingSpinBox* m_pointCount = Q_NULLPTR;
+    Setting::SettingSpinBox* m_areaCount = Q_NULLPTR;
+    Setting::SettingSpinBox* m_rangeCount = Q_NULLPTR;
+    Setting::SettingComboBox* m_analysis = Q_NULLPTR;
+    Setting::SettingComboBox* m_areaSize = Q_NULLPTR;
+    Setting::SettingSpinBox* m_maxSteps = Q_NULLPTR;
+    Setting::SettingSpinBox* m_stepSecs = Q_NULLPTR;
+    Setting::SettingDoubleSpinBox* m_maxDropRate = Q_NULLPTR;
+
+    Module::Common::LoadGenerator* m_moduleGenerator = Q_NULLPTR;
+};
+}
+
+#endif // DEVLOADTEST_H
@@ -1,5 +1,8 @@
 #include "framecapture.h"
 
+#include "Helpers/mediatimeline.h"
+#include "Helpers/tracer.h"
+
 namespace Module::Common
 {
 
@@ -30,12 +33,13 @@ void FrameCapture::stop()
     m_condition.wakeOne();
 }
 
-void FrameCapture::PushFrameData(const QImage &frame)
+void FrameCapture::PushFrameData(const QImage &frame, qint64 time)
 {
+    TRACE_SCOPE("capture", "FrameCapture::PushFrameData");
     QMutexLocker locker(&m_workMutex);
     if (m_pendingWork) return;
 
-    CaptureHolder::PushFrameData(frame);
+    CaptureHolder::PushFrameData(frame, time);
 
     m_pendingWork = true;
     m_condition.wakeOne();
@@ -45,6 +49,8 @@ void FrameCapture::run()
 {
     QColor pixel;
     QImage frame;
+    qint64 frameTime = 0;
+    QString eventName;
     while (!m_terminate)
     {
         {
@@ -58,10 +64,17 @@ void FrameCapture::run()
             if (m_terminate) return;
             pixel = GetPixelData();
             frame = GetFrameData();
+            frameTime = GetFrameTime();
+
+            QMutexLocker locker(&m_mutex);
+            eventName = m_eventName;
         }
         {
             // analyze
+            TRACE_SCOPE("capture", "FrameCapture analyze");
             QMutexLocker resultLocker(&m_resultMutex);
+            bool const wasMatched = m_resultMatched;
+            m_resultTime = frameTime;
             switch (m_mode)
             {
             case CaptureHolder::Mode::PointColorMatch:
@@ -93,6 +106,12 @@ void FrameCapture::run()
             }
             }
 
+            // timestamp is of the frame analyzed, not when analysis finished
+            if (!eventName.isEmpty() && m_resultMatched != wasMatched)
+            {
+                MediaTimeline::AddEvent(MediaStream::Video, frameTime, eventName, m_resultMatched ? 1.0 : 0.0);
+            }
+
             // this is free to do next work
             QMutexLocker workLocker(&m_workMutex);
             m_pendingWork = false;
@@ -22,7 +22,7 @@ public:
     void stop() override;
 
     // from CaptureHolder
-    void PushFrameData(QImage const& frame) override;
+    void PushFrameData(QImage const& frame, qint64 time) override;
 
     // from QThread
     void run() override;
@@ -0,0 +1,151 @@
+#include "frametrigger.h"
+
+#include "Helpers/inputscheduler.h"
+#include "Managers/serialmanager.h"
+
+// how long to wait for the serial thread to write the press after the scheduler sent it
+#define FRAME_TRIGGER_WRITE_TIMEOUT_MS 100
+
+namespace Module::Common
+{
+
+void FrameTrigger::Init()
+{
+    m_serialManager = ManagerCollection::GetManager<SerialManager>();
+    if (!m_serialManager->IsConnected())
+    {
+        m_result = -1;
+        m_error = "Serial not connected";
+    }
+}
+
+void FrameTrigger::stop()
+{
+    QMutexLocker locker(&m_triggerMutex);
+    ModuleBase::stop();
+    m_condition.wakeOne();
+}
+
+void FrameTrigger::PushFrameData(const QImage &frame, qint64 time)
+{
+    qint64 const eventTime = ToSchedulerTime(time);
+    CaptureHolder::PushFrameData(frame, time);
+    bool const matched = AnalyzeFrame(frame, time, m_trigger.m_meanThreshold);
+    qreal const framePeriod = GetFramePeriod();
+
+    QMutexLocker locker(&m_triggerMutex);
+    bool const edge = m_hasLastMatch && matched != m_lastMatched && matched == (m_trigger.m_edge == Edge::Rising);
+    m_hasLastMatch = true;
+    m_lastMatched = matched;
+    if (!edge || !m_armed || m_fired) return;
+
+    qreal const offsetMs = m_trigger.m_offsetInFrames ? m_trigger.m_offset * framePeriod / 1000.0 : m_trigger.m_offset;
+    m_requestedOffset = qint64(offsetMs * 1000000.0);
+    m_eventTime = eventTime;
+    m_deadline = eventTime + m_requestedOffset;
+    if (m_trigger.m_compensateLatency)
+    {
+        // the event is already this late when we see it, and the press takes as long to show up
+        m_deadline -= m_serialManager->GetInputLatency();
+    }
+
+    // straight to the scheduler thread, nothing here waits on an event loop
+    InputScheduler* scheduler = m_serialManager->GetScheduler();
+    scheduler->Submit(quintptr(this), m_deadline, m_trigger.m_buttonFlag);
+    scheduler->Submit(quintptr(this), m_deadline + qint64(m_trigger.m_holdMs) * 1000000, 0);
+    m_analyzedTime = InputScheduler::Now();
+
+    m_fired = true;
+    m_condition.wakeOne();
+}
+
+void FrameTrigger::run()
+{
+    if (m_result < 0) return;
+
+    InputScheduler* scheduler = m_serialManager->GetScheduler();
+    SerialHolder* serialHolder = m_serialManager->GetHolder();
+    quintptr const source = quintptr(this);
+    quint64 const sampleStart = scheduler->GetSampleCount();
+
+    {
+        // wait for the frame event
+        QMutexLocker locker(&m_triggerMutex);
+        m_armed = true;
+
+        QDeadlineTimer const timeout(m_trigger.m_timeoutMs);
+        while (!m_fired && !m_terminate)
+        {
+            if (!m_condition.wait(&m_triggerMutex, timeout)) break;
+        }
+
+        m_armed = false;
+        if (m_terminate) return;
+        if (!m_fired)
+        {
+            m_result = -1;
+            m_error = "Frame event not detected within " + QString::number(m_trigger.m_timeoutMs) + "ms";
+            return;
+        }
+    }
+
+    // press sent by the scheduler, release still pending
+    while (!m_terminate && !scheduler->WaitForPending(source, 1, 100)) {}
+    if (m_terminate)
+    {
+        scheduler->Cancel(source);
+        return;
+    }
+
+    InputScheduler::Stats const stats = scheduler->GetStats(sampleStart);
+
+    // serial thread handles it shortly after, only our press has this deadline among scheduled states
+    SerialHolder::StateResult result = serialHolder->GetStateResult(SerialHolder::StateSource::Scheduler);
+    qint64 const writeTimeout = InputScheduler::Now() + qint64(FRAME_TRIGGER_WRITE_TIMEOUT_MS) * 1000000;
+    while (result.m_deadline < m_deadline && InputScheduler::Now() < writeTimeout)
+    {
+        QThread::usleep(100);
+        result = serialHolder->GetStateResult(SerialHolder::StateSource::Scheduler);
+    }
+
+    while (!m_terminate && !scheduler->WaitForPending(source, 0, 100)) {}
+    scheduler->Cancel(source);
+
+    auto toMs = [](qint64 ns) { return QString::number(qreal(ns) / 1000000.0, 'f', 3); };
+    QString log = "Requested offset = " + toMs(m_requestedOffset) + "ms";
+    if (m_trigger.m_offsetInFrames)
+    {
+        log += " (" + QString::number(m_trigger.m_offset) + " frames)";
+    }
+    if (m_trigger.m_compensateLatency)
+    {
+        log += ", compensated by " + toMs(m_serialManager->GetInputLatency()) + "ms";
+    }
+    log += ", frame analyzed in " + toMs(m_analyzedTime - m_eventTime) + "ms";
+    if (stats.m_count > 0)
+    {
+        log += ", handed to serial late by " + toMs(stats.m_max) + "ms";
+    }
+
+    if (result.m_deadline != m_deadline)
+    {
+        // nothing handled in time, or the release already replaced the press
+        m_result = -1;
+        m_error = "Press was not written to serial port";
+        PrintLog(log, LOG_Warning);
+        return;
+    }
+    if (result.m_duplicate)
+    {
+        m_result = -1;
+        m_error = "Press was already on the serial port, buttons must be released before the trigger";
+        PrintLog(log, LOG_Warning);
+        return;
+    }
+
+    m_achievedOffset = result.m_time - m_eventTime;
+    log += ", achieved offset = " + toMs(m_achievedOffset) + "ms (late by " + toMs(result.m_time - m_deadline) + "ms)";
+    PrintLog(log);
+}
+
+}
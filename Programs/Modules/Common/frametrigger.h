@@ -0,0 +1,86 @@
+#ifndef FRAMETRIGGER_H
+#define FRAMETRIGGER_H
+
+#include <QDeadlineTimer>
+#include <QWaitCondition>
+
+#include "../modulebase.h"
+#include "Helpers/captureholder.h"
+#include "Managers/managercollection.h"
+
+namespace Module::Common
+{
+// Presses a button a fixed offset after a capture match changes, e.g. A 4 frames after the screen goes black
+// Analysis runs on the video thread to avoid waking a worker, keep the area small
+class FrameTrigger : public ModuleBase, public CaptureHolder
+{
+    Q_OBJECT
+public:
+    enum class Edge
+    {
+        Rising,     // match becomes true
+        Falling,    // match becomes false
+    };
+
+    struct Trigger
+    {
+        Edge    m_edge = Edge::Rising;
+        qreal   m_offset = 0.0;
+        bool    m_offsetInFrames = true;    // video frames at the measured capture rate, otherwise ms
+        quint32 m_buttonFlag = 0;
+        int     m_holdMs = 100;
+        int     m_timeoutMs = 10000;        // error if the event isn't seen by then
+        qreal   m_meanThreshold = 0.5;      // AreaRangeMatch only, matched when mean is at least this
+        bool    m_compensateLatency = false;    // press earlier by the calibrated input latency
+    };
+
+public:
+    // point or rect with a color or range, as CaptureHolder takes them
+    template <typename Area, typename Test>
+    explicit FrameTrigger(Area area, Test test, Trigger const& trigger, QObject *parent = nullptr)
+        : ModuleBase(parent)
+        , CaptureHolder(area, test)
+        , m_trigger(trigger)
+    {
+        Init();
+    }
+
+    // from ModuleBase
+    QString GetName() const override { return "Common-FrameTrigger"; }
+    void stop() override;
+
+    // from CaptureHolder
+    void PushFrameData(QImage const& frame, qint64 time) override;
+
+    // from QThread
+    void run() override;
+
+    // nanoseconds, should only be accessed when module is finished
+    qint64 GetRequestedOffset() const { return m_requestedOffset; }
+    qint64 GetAchievedOffset() const { return m_achievedOffset; }
+
+private:
+    void Init();
+
+private:
+    SerialManager*  m_serialManager = Q_NULLPTR;
+    Trigger         m_trigger;
+
+    QWaitCondition  m_condition;
+    mutable QMutex  m_triggerMutex;
+    bool    m_armed = false;
+    bool    m_fired = false;
+    bool    m_hasLastMatch = false;
+    bool    m_lastMatched = false;
+
+    // all on the InputScheduler clock
+    qint64  m_eventTime = 0;        // when the matching frame was handed over by LibVLC
+    qint64  m_analyzedTime = 0;     // when the press was submitted
+    qint64  m_deadline = 0;
+    qint64  m_requestedOffset = 0;
+    qint64  m_achievedOffset = 0;
+};
+
+}
+
+#endif // FRAMETRIGGER_H
@@ -0,0 +1,171 @@
+#include "latencyprobe.h"
+
+#include <QRandomGenerator>
+
+#include <algorithm>
+
+#include "Helpers/inputscheduler.h"
+#include "Managers/serialmanager.h"
+
+#define LATENCY_PROBE_WRITE_TIMEOUT_MS  100
+#define LATENCY_PROBE_SETTLE_MS         500
+
+namespace Module::Common
+{
+
+void LatencyProbe::Init()
+{
+    m_serialManager = ManagerCollection::GetManager<SerialManager>();
+    if (!m_serialManager->IsConnected())
+    {
+        m_result = -1;
+        m_error = "Serial not connected";
+    }
+}
+
+void LatencyProbe::stop()
+{
+    QMutexLocker locker(&m_probeMutex);
+    ModuleBase::stop();
+    m_condition.wakeOne();
+}
+
+void LatencyProbe::PushFrameData(const QImage &frame, qint64 time)
+{
+    qint64 const frameTime = ToSchedulerTime(time);
+    CaptureHolder::PushFrameData(frame, time);
+    bool const matched = AnalyzeFrame(frame, time, m_probe.m_meanThreshold);
+
+    QMutexLocker locker(&m_probeMutex);
+    if (!m_hasState || matched != m_matched)
+    {
+        m_hasState = true;
+        m_matched = matched;
+        m_stateTime = frameTime;
+        m_condition.wakeOne();
+    }
+}
+
+void LatencyProbe::run()
+{
+    if (m_result < 0) return;
+
+    // start from nothing pressed, whatever is on screen now is the resting state
+    qint64 writeTime = 0;
+    Send(0, writeTime);
+    msleep(LATENCY_PROBE_SETTLE_MS);
+
+    bool resting = false;
+    {
+        QMutexLocker locker(&m_probeMutex);
+        if (!m_hasState)
+        {
+            m_result = -1;
+            m_error = "No video frames received";
+            return;
+        }
+        resting = m_matched;
+    }
+
+    QVector<qint64> samples;
+    samples.reserve(m_probe.m_count * 2);
+    for (int i = 0; i < m_probe.m_count && !m_terminate; i++)
+    {
+        for (quint32 const buttonFlag : {m_probe.m_buttonFlag, quint32(0)})
+        {
+            if (!Send(buttonFlag, writeTime))
+            {
+                m_result = -1;
+                m_error = "Input was not written to serial port";
+                return;
+            }
+
+            qint64 frameTime = 0;
+            bool const expected = buttonFlag ? !resting : resting;
+            if (WaitForState(expected, writeTime, frameTime))
+            {
+                samples.push_back(frameTime - writeTime);
+            }
+            else if (!m_terminate)
+            {
+                m_latency.m_misses++;
+            }
+
+            // random gap so samples land on every phase of the capture frame
+            msleep(100 + QRandomGenerator::global()->bounded(200));
+            if (m_terminate) break;
+        }
+
+        if (samples.isEmpty() && m_latency.m_misses >= 6)
+        {
+            m_result = -1;
+            m_error = "No change detected, check the capture region and the button";
+            return;
+        }
+    }
+
+    Send(0, writeTime);
+    if (m_terminate) return;
+    if (samples.isEmpty())
+    {
+        m_result = -1;
+        m_error = "No samples collected";
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    m_latency.m_count = samples.size();
+    m_latency.m_min = samples.front();
+    m_latency.m_median = samples[samples.size() / 2];
+    m_latency.m_p99 = samples[qMin(int(samples.size()) - 1, int(samples.size()) * 99 / 100)];
+    m_latency.m_max = samples.back();
+    m_latency.m_framePeriod = GetFramePeriod();
+
+    auto toMs = [](qint64 ns) { return QString::number(qreal(ns) / 1000000.0, 'f', 2); };
+    QString log = "Input latency over " + QString::number(m_latency.m_count) + " samples: min = " + toMs(m_latency.m_min);
+    log += "ms, median = " + toMs(m_latency.m_median) + "ms, p99 = " + toMs(m_latency.m_p99) + "ms, max = " + toMs(m_latency.m_max) + "ms";
+    log += ", misses = " + QString::number(m_latency.m_misses);
+    log += ", frame period = " + QString::number(m_latency.m_framePeriod / 1000.0, 'f', 2) + "ms";
+    PrintLog(log, m_latency.m_misses > 0 ? LOG_Warning : LOG_Normal);
+}
+
+bool LatencyProbe::Send(quint32 buttonFlag, qint64 &writeTime)
+{
+    // straight to the serial holder, the write time is when the state is handed to the serial port
+    SerialHolder* serialHolder = m_serialManager->GetHolder();
+    quint64 const token = serialHolder->SubmitState(SerialHolder::StateSource::Command, buttonFlag);
+
+    qint64 const timeout = InputScheduler::Now() + qint64(LATENCY_PROBE_WRITE_TIMEOUT_MS) * 1000000;
+    while (InputScheduler::Now() < timeout)
+    {
+        SerialHolder::StateResult const result = serialHolder->GetStateResult(SerialHolder::StateSource::Command);
+        if (result.m_token >= token)
+        {
+            // a duplicate was already on the wire, the probe has nothing to measure
+            writeTime = result.m_time;
+            return result.m_token == token && !result.m_duplicate;
+        }
+        usleep(100);
+    }
+    return false;
+}
+
+bool LatencyProbe::WaitForState(bool matched, qint64 after, qint64 &frameTime)
+{
+    QMutexLocker locker(&m_probeMutex);
+    QDeadlineTimer const timeout(m_probe.m_timeoutMs);
+    while (!m_terminate)
+    {
+        // a frame from before the write can't show its effect
+        if (m_matched == matched && m_stateTime > after)
+        {
+            frameTime = m_stateTime;
+            return true;
+        }
+
+        if (!m_condition.wait(&m_probeMutex, timeout)) break;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#include <QDeadlineTimer>
+#include <QWaitCondition>
+
+#include "../modulebase.h"
+#include "Helpers/captureholder.h"
+#include "Managers/managercollection.h"
+
+namespace Module::Common
+{
+// Toggles a button and times how long until the capture region changes, press and release are both sampled
+class LatencyProbe : public ModuleBase, public CaptureHolder
+{
+    Q_OBJECT
+public:
+    struct Probe
+    {
+        quint32 m_buttonFlag = 0;
+        int     m_count = 50;               // presses, each gives up to two samples
+        int     m_timeoutMs = 1000;         // no change by then is a miss
+        qreal   m_meanThreshold = 0.5;      // AreaRangeMatch only, matched when mean is at least this
+    };
+
+    // nanoseconds from serial write to the first captured frame showing the change
+    struct Latency
+    {
+        int     m_count = 0;
+        int     m_misses = 0;
+        qint64  m_min = 0;
+        qint64  m_median = 0;
+        qint64  m_p99 = 0;
+        qint64  m_max = 0;
+        qreal   m_framePeriod = 0.0;        // microseconds
+    };
+
+public:
+    // point or rect with a color or range, as CaptureHolder takes them
+    template <typename Area, typename Test>
+    explicit LatencyProbe(Area area, Test test, Probe const& probe, QObject *parent = nullptr)
+        : ModuleBase(parent)
+        , CaptureHolder(area, test)
+        , m_probe(probe)
+    {
+        Init();
+    }
+
+    // from ModuleBase
+    QString GetName() const override { return "Common-LatencyProbe"; }
+    void stop() override;
+
+    // from CaptureHolder
+    void PushFrameData(QImage const& frame, qint64 time) override;
+
+    // from QThread
+    void run() override;
+
+    // should only be accessed when module is finished
+    Latency GetLatency() const { return m_latency; }
+
+private:
+    void Init();
+    bool Send(quint32 buttonFlag, qint64& writeTime);
+    bool WaitForState(bool matched, qint64 after, qint64& frameTime);
+
+private:
+    SerialManager*  m_serialManager = Q_NULLPTR;
+    Probe           m_probe;
+    Latency         m_latency;
+
+    QWaitCondition  m_condition;
+    mutable QMutex  m_probeMutex;
+    bool    m_hasState = false;
+    bool    m_matched = false;
+    qint64  m_stateTime = 0;        // InputScheduler clock of the first frame in the current state
+};
+
+}
+
+#endif // LATENCYPROBE_H
@@ -0,0 +1,377 @@
+#include "loadgenerator.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Helpers/captureholder.h"
+#include "Helpers/inputscheduler.h"
+#include "Helpers/mediatimeline.h"
+#include "Managers/videomanager.h"
+#include "framecapture.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <timeapi.h>
+#elif defined(Q_OS_LINUX)
+#include <time.h>
+#endif
+
+// sleep until this close to the next frame then spin, same as InputScheduler
+#define LOAD_GENERATOR_SPIN_NS      2000000
+#define LOAD_GENERATOR_FRAME_COUNT  8
+
+namespace Module::Common
+{
+
+namespace
+{
+// Analyzes on the video thread like FrameTrigger, and adds its time to the current frame's total of its mode
+class LoadCapture : public CaptureHolder
+{
+public:
+    template<typename Area, typename Test>
+    LoadCapture(Area area, Test test, qint64* elapsed)
+        : CaptureHolder(area, test)
+        , m_elapsed(elapsed)
+    {
+    }
+
+    void PushFrameData(QImage const& frame, qint64 time) override
+    {
+        qint64 const start = InputScheduler::Now();
+        CaptureHolder::PushFrameData(frame, time);
+        AnalyzeFrame(frame, time, 0.5);
+        m_elapsed[int(GetMode())] += InputScheduler::Now() - start;
+    }
+
+private:
+    qint64* m_elapsed = Q_NULLPTR;
+};
+
+// Analyzes on its own thread like the captures of a program, counts the frames it was still busy for
+class LoadFrameCapture : public FrameCapture
+{
+public:
+    template<typename Area, typename Test>
+    LoadFrameCapture(Area area, Test test, qint64* elapsed, int* pushed, int* skipped)
+        : FrameCapture(area, test)
+        , m_elapsed(elapsed)
+        , m_pushed(pushed)
+        , m_skipped(skipped)
+    {
+    }
+
+    void PushFrameData(QImage const& frame, qint64 time) override
+    {
+        qint64 const start = InputScheduler::Now();
+        qint64 const previous = GetFrameTime();
+        FrameCapture::PushFrameData(frame, time);
+        m_elapsed[int(GetMode())] += InputScheduler::Now() - start;
+
+        // frame is only taken when the last one has been analyzed
+        if (GetFrameTime() == previous)
+        {
+            (*m_skipped)++;
+        }
+        else
+        {
+            (*m_pushed)++;
+        }
+    }
+
+protected:
+    // hundreds are started every step
+    void OnStarted() const override {}
+    void OnFinished() const override {}
+
+private:
+    qint64* m_elapsed = Q_NULLPTR;
+    int*    m_pushed = Q_NULLPTR;
+    int*    m_skipped = Q_NULLPTR;
+};
+
+// nanoseconds
+qint64 ThreadCpuTime()
+{
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    return ((qint64(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) + (qint64(user.dwHighDateTime) << 32 | user.dwLowDateTime)) * 100;
+#elif defined(Q_OS_LINUX)
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return qint64(time.tv_sec) * 1000000000 + time.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+qint64 ProcessCpuTime()
+{
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    return ((qint64(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) + (qint64(user.dwHighDateTime) << 32 | user.dwLowDateTime)) * 100;
+#elif defined(Q_OS_LINUX)
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return qint64(time.tv_sec) * 1000000000 + time.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+LoadGenerator::Latency GetLatency(QVector<qint64>& samples)
+{
+    LoadGenerator::Latency latency;
+    if (samples.isEmpty()) return latency;
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](int p)
+    {
+        return samples[qMin(int(samples.size()) - 1, int(samples.size()) * p / 100)];
+    };
+
+    qint64 total = 0;
+    for (qint64 sample : std::as_const(samples))
+    {
+        total += sample;
+    }
+
+    latency.m_mean = total / samples.size();
+    latency.m_p50 = percentile(50);
+    latency.m_p90 = percentile(90);
+    latency.m_p99 = percentile(99);
+    latency.m_max = samples.back();
+    return latency;
+}
+
+// gradient with a moving block, so captures see matches change as they would in game
+QVector<QImage> CreateFrames(QSize resolution)
+{
+    QVector<QImage> frames;
+    for (int i = 0; i < LOAD_GENERATOR_FRAME_COUNT; i++)
+    {
+        QImage frame(resolution, QImage::Format_ARGB32);
+        for (int y = 0; y < frame.height(); y++)
+        {
+            QRgb* rowData = (QRgb*)frame.scanLine(y);
+            for (int x = 0; x < frame.width(); x++)
+            {
+                rowData[x] = qRgb(x * 255 / frame.width(), y * 255 / frame.height(), (i * 32) & 0xFF);
+            }
+        }
+
+        QPainter painter(&frame);
+        int const blockWidth = resolution.width() / 4;
+        int const blockHeight = resolution.height() / 4;
+        painter.fillRect(QRect(i * (resolution.width() - blockWidth) / LOAD_GENERATOR_FRAME_COUNT, i * (resolution.height() - blockHeight) / LOAD_GENERATOR_FRAME_COUNT, blockWidth, blockHeight), QColor(255,0,0));
+        painter.end();
+
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+QString MsString(qint64 ns)
+{
+    return QString::number(qreal(ns) / 1000000.0, 'f', 2) + "ms";
+}
+}
+
+LoadGenerator::LoadGenerator(const Config &config, QObject *parent)
+    : ModuleBase(parent)
+    , m_config(config)
+{
+    m_videoManager = ManagerCollection::GetManager<VideoManager>();
+}
+
+void LoadGenerator::run()
+{
+#ifdef Q_OS_WIN
+    // 1ms sleep granularity instead of the default ~15.6ms
+    timeBeginPeriod(1);
+#endif
+
+    for (QSize const& resolution : std::as_const(m_config.m_resolutions))
+    {
+        QString const name = QString::number(resolution.width()) + "x" + QString::number(resolution.height());
+        QVector<QImage> const frames = CreateFrames(resolution);
+
+        for (int step = 1; step <= m_config.m_maxSteps && !m_terminate; step++)
+        {
+            StepResult const result = RunStep(frames, step);
+            if (m_terminate) break;
+            m_results.push_back(result);
+
+            int const captureCount = result.m_captureCount[0] + result.m_captureCount[1] + result.m_captureCount[2] + result.m_captureCount[3];
+            QString log = name + " step " + QString::number(step) + ": " + QString::number(captureCount) + " captures, "
+                     + QString::number(result.m_fps, 'f', 1) + "fps, " + QString::number(result.m_dropRate * 100.0, 'f', 1) + "% dropped, ";
+            if (!m_config.m_videoThreadAnalysis)
+            {
+                log += QString::number(result.m_captureSkipRate * 100.0, 'f', 1) + "% skipped by captures, ";
+            }
+            log += "frame p50 " + MsString(result.m_frame.m_p50) + " p99 " + MsString(result.m_frame.m_p99) + ", "
+                 + "video CPU " + QString::number(result.m_cpuVideo, 'f', 0) + "%, process CPU " + QString::number(result.m_cpuProcess, 'f', 0) + "%";
+            PrintLog(log);
+
+            if (result.m_dropRate > m_config.m_maxDropRate || result.m_captureSkipRate > m_config.m_maxDropRate)
+            {
+                PrintLog(name + " can't keep up with " + QString::number(captureCount) + " captures", LOG_Warning);
+                break;
+            }
+        }
+
+        if (m_terminate) break;
+    }
+
+#ifdef Q_OS_WIN
+    timeEndPeriod(1);
+#endif
+}
+
+LoadGenerator::StepResult LoadGenerator::RunStep(const QVector<QImage> &frames, int step)
+{
+    StepResult result;
+    result.m_resolution = frames.front().size();
+
+    // spread over the capture resolution, the same on every run
+    qint64 elapsed[4] = {};
+    QSize const captureRes = CaptureHolder::GetCaptureResolution();
+    QSize const areaSize = m_config.m_areaSize.boundedTo(captureRes);
+    HsvRange const range(0,100,100,60,255,255);
+    QColor const color(255,0,0);
+
+    int capturePushed = 0;
+    int captureSkipped = 0;
+    std::vector<std::unique_ptr<LoadCapture>> captures;
+    std::vector<std::unique_ptr<LoadFrameCapture>> moduleCaptures;
+    int captureIndex = 0;
+    auto getPoint = [&captureIndex, &captureRes]
+    {
+        int const i = captureIndex;
+        return QPoint((i * 97) % captureRes.width(), (i * 53) % captureRes.height());
+    };
+    auto getRect = [&captureIndex, &captureRes, &areaSize]
+    {
+        int const i = captureIndex;
+        return QRect(QPoint((i * 131) % (captureRes.width() - areaSize.width() + 1), (i * 71) % (captureRes.height() - areaSize.height() + 1)), areaSize);
+    };
+    auto addCapture = [&](auto area, auto test)
+    {
+        if (m_config.m_videoThreadAnalysis)
+        {
+            captures.emplace_back(new LoadCapture(area, test, elapsed));
+            result.m_captureCount[int(captures.back()->GetMode())]++;
+        }
+        else
+        {
+            moduleCaptures.emplace_back(new LoadFrameCapture(area, test, elapsed, &capturePushed, &captureSkipped));
+            moduleCaptures.back()->start();
+            result.m_captureCount[int(moduleCaptures.back()->GetMode())]++;
+        }
+        captureIndex++;
+    };
+
+    for (int i = 0; i < m_config.m_pointCount * step; i++)
+    {
+        if (i % 2 == 0)
+        {
+            addCapture(getPoint(), color);
+        }
+        else
+        {
+            addCapture(getPoint(), range);
+        }
+    }
+    for (int i = 0; i < m_config.m_areaCount * step; i++)
+    {
+        addCapture(getRect(), color);
+    }
+    for (int i = 0; i < m_config.m_rangeCount * step; i++)
+    {
+        addCapture(getRect(), range);
+    }
+
+    QVector<qint64> frameTimes;
+    QVector<qint64> scaleTimes;
+    QVector<qint64> captureTimes[4];
+
+    qint64 const period = 1000000000 / qMax(1, m_config.m_fps);
+    qint64 const stepStart = InputScheduler::Now();
+    qint64 const stepEnd = stepStart + qint64(m_config.m_stepSecs) * 1000000000;
+    qint64 const threadCpuStart = ThreadCpuTime();
+    qint64 const processCpuStart = ProcessCpuTime();
+
+    qint64 next = stepStart;
+    while (!m_terminate && next < stepEnd)
+    {
+        qint64 const remaining = next - InputScheduler::Now();
+        if (remaining > LOAD_GENERATOR_SPIN_NS)
+        {
+            QThread::msleep(quint64(remaining - LOAD_GENERATOR_SPIN_NS) / 1000000);
+        }
+        while (InputScheduler::Now() < next)
+        {
+            QThread::yieldCurrentThread();
+        }
+
+        // frames that should have started while the previous one was still running are lost
+        qint64 const late = (InputScheduler::Now() - next) / period;
+        if (late > 0)
+        {
+            result.m_dropped += int(late);
+            next += late * period;
+        }
+
+        std::fill(std::begin(elapsed), std::end(elapsed), 0);
+        qint64 const start = InputScheduler::Now();
+        m_videoManager->PushFrameData(frames[result.m_frames % frames.size()], MediaTimeline::Now());
+        qint64 const frameTime = InputScheduler::Now() - start;
+
+        qint64 captureTotal = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            captureTotal += elapsed[i];
+            if (result.m_captureCount[i] > 0)
+            {
+                captureTimes[i].push_back(elapsed[i]);
+            }
+        }
+        frameTimes.push_back(frameTime);
+        scaleTimes.push_back(frameTime - captureTotal);
+
+        result.m_frames++;
+        next += period;
+    }
+
+    qint64 const wallTime = qMax(qint64(1), InputScheduler::Now() - stepStart);
+    result.m_cpuVideo = qreal(ThreadCpuTime() - threadCpuStart) * 100.0 / qreal(wallTime);
+    result.m_cpuProcess = qreal(ProcessCpuTime() - processCpuStart) * 100.0 / qreal(wallTime);
+    result.m_fps = qreal(result.m_frames) * 1000000000.0 / qreal(wallTime);
+    result.m_dropRate = result.m_frames + result.m_dropped > 0 ? qreal(result.m_dropped) / qreal(result.m_frames + result.m_dropped) : 0.0;
+    result.m_captureSkipRate = capturePushed + captureSkipped > 0 ? qreal(captureSkipped) / qreal(capturePushed + captureSkipped) : 0.0;
+
+    for (auto const& capture : moduleCaptures)
+    {
+        capture->stop();
+    }
+    for (auto const& capture : moduleCaptures)
+    {
+        capture->wait();
+    }
+
+    result.m_frame = GetLatency(frameTimes);
+    result.m_scale = GetLatency(scaleTimes);
+    for (int i = 0; i < 4; i++)
+    {
+        result.m_capture[i] = GetLatency(captureTimes[i]);
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QSize>
+#include <QVector>
+
+#include "../modulebase.h"
+#include "Managers/managercollection.h"
+
+namespace Module::Common
+{
+// Feeds generated frames to VideoManager at a fixed rate without LibVLC, adding captures every step
+// Frames that can't be started on time are dropped like a capture device would, a resolution stops when too many drop
+// Captures are FrameCapture modules analyzing on their own threads like programs use them,
+// or analyze on the video thread like FrameTrigger, which measures the worst case for frame delivery
+class LoadGenerator : public ModuleBase
+{
+    Q_OBJECT
+public:
+    struct Config
+    {
+        QVector<QSize>  m_resolutions;      // swept in order
+        int     m_fps = 60;
+        int     m_pointCount = 0;           // added every step, alternating color and range match
+        int     m_areaCount = 0;            // AreaColorMatch added every step
+        int     m_rangeCount = 0;           // AreaRangeMatch added every step
+        QSize   m_areaSize = QSize(200,100);
+        int     m_maxSteps = 20;
+        int     m_stepSecs = 5;
+        qreal   m_maxDropRate = 0.01;         // also the most frames module captures may skip
+        bool    m_videoThreadAnalysis = false;
+    };
+
+    // nanoseconds
+    struct Latency
+    {
+        qint64  m_mean = 0;
+        qint64  m_p50 = 0;
+        qint64  m_p90 = 0;
+        qint64  m_p99 = 0;
+        qint64  m_max = 0;
+    };
+
+    struct StepResult
+    {
+        QSize   m_resolution;
+        int     m_captureCount[4] = {};     // by CaptureHolder::Mode
+        int     m_frames = 0;
+        int     m_dropped = 0;
+        qreal   m_fps = 0.0;                // frames processed per second
+        qreal   m_dropRate = 0.0;
+        qreal   m_captureSkipRate = 0.0;    // module captures, frames that arrived while still analyzing the previous one
+        qreal   m_cpuVideo = 0.0;           // video thread, percent of one core
+        qreal   m_cpuProcess = 0.0;         // whole process, percent of one core
+        Latency m_frame;                    // whole VideoManager::PushFrameData
+        Latency m_scale;                    // everything but the captures, mostly scaling
+        Latency m_capture[4];               // video thread time of all captures of a mode together, by CaptureHolder::Mode
+                                            // the analysis itself, or only the hand-off to module captures
+    };
+
+public:
+    explicit LoadGenerator(Config const& config, QObject *parent = nullptr);
+
+    // from ModuleBase
+    QString GetName() const override { return "Common-LoadGenerator"; }
+
+    // from QThread
+    void run() override;
+
+    // should only be accessed when module is finished
+    QVector<StepResult> const& GetResults() const { return m_results; }
+
+private:
+    StepResult RunStep(QVector<QImage> const& frames, int step);
+
+private:
+    VideoManager*   m_videoManager = Q_NULLPTR;
+    Config          m_config;
+
+    QVector<StepResult> m_results;
+};
+
+}
+
+#endif // LOADGENERATOR_H
@@ -1,8 +1,13 @@
 #include "runcommand.h"
 
+#include "Helpers/commandplayer.h"
+#include "Helpers/tracer.h"
 #include "Managers/keyboardmanager.h"
 #include "Managers/serialmanager.h"
 
+// firmware may report progress this late, covers a keep alive and a few retransmits
+#define RUN_COMMAND_TIMELINE_GRACE_MS 1000
+
 namespace Module::Common
 {
 
@@ -26,14 +31,22 @@ RunCommand::RunCommand
 
     KeyboardManager* keyboardManager = ManagerCollection::GetManager<KeyboardManager>();
     connect(this, &RunCommand::notifyButton, keyboardManager, &KeyboardManager::OnDisplayButton);
+    connect(this, &RunCommand::notifyDisplayButton, keyboardManager, &KeyboardManager::OnDisplayButton);
 
     m_serialManager = ManagerCollection::GetManager<SerialManager>();
-    connect(this, &RunCommand::notifyButton, m_serialManager->GetHolder(), &SerialHolder::OnSendButton);
+    SerialHolder* serialHolder = m_serialManager->GetHolder();
+    connect(this, &RunCommand::notifyButton, serialHolder, [serialHolder](quint32 buttonFlag, QPointF lStick, QPointF rStick)
+    {
+        serialHolder->SubmitState(SerialHolder::StateSource::Command, buttonFlag, lStick, rStick);
+    }, Qt::DirectConnection);
+    connect(this, &RunCommand::notifyTimeline, serialHolder, &SerialHolder::OnSendTimeline);
+    connect(serialHolder, &SerialHolder::notifyTimelineStatus, this, &RunCommand::OnTimelineStatus, Qt::DirectConnection);
 
-    if (!SerialManager::VerifyCommand(m_command, m_error))
+    if (!CommandCompiler::Compile(m_command, m_program, m_error))
     {
         m_result = -1;
     }
+    m_interpreter.Reset(&m_program);
 
     if (!m_serialManager->IsConnected())
     {
@@ -42,6 +55,13 @@ RunCommand::RunCommand
     }
 }
 
+void RunCommand::stop()
+{
+    QMutexLocker locker(&m_timelineMutex);
+    ModuleBase::stop();
+    m_timelineCondition.wakeOne();
+}
+
 void RunCommand::run()
 {
     if (m_result < 0)
@@ -52,161 +72,220 @@ void RunCommand::run()
     if (m_name.isEmpty())
     {
         PrintLog("Running command \"" + m_command + "\"");
+        PrintLog("Compiled " + QString::number(m_program.m_code.size()) + " instructions ("
+                 + QString::number(m_program.GetMemoryUsage()) + " bytes) in "
+                 + QString::number(qreal(m_program.m_compileTime) / 1000.0, 'f', 1) + "us");
     }
     else
     {
 
     }
 
-    while(!m_terminate)
+    // firmware plays the timeline with frame exact timing, otherwise time each step here
+    if (m_serialManager->GetHolder()->SupportsTimeline())
     {
-        // check completion
-        if (m_commandIndex == -1 || m_commandIndex >= m_command.size())
-        {
-            break;
-        }
-
-        SendCurrentCommand();
-
-        // wait for QTimer event
-        exec();
+        RunTimeline();
+    }
+    else
+    {
+        RunTimer();
     }
 
-    // final stop command
+    // final stop command, a timeline that didn't finish has already been cleared
     emit notifyButton(0);
 }
 
-void RunCommand::SendCurrentCommand(bool isLoopCount)
+void RunCommand::OnTimelineStatus(quint16 started, quint16 underruns, quint8 flags)
 {
-    qsizetype endIndex = m_command.indexOf(',', m_commandIndex + 1);
-    QString str = m_command.mid(m_commandIndex, endIndex == -1 ? -1 : endIndex - m_commandIndex);
+    // called from serial thread
+    QMutexLocker locker(&m_timelineMutex);
+    m_timelineStarted = started;
+    m_timelineUnderruns = underruns;
+    m_timelineFlags = flags;
+    m_timelineCondition.wakeOne();
+}
+
+void RunCommand::RunTimer()
+{
+    InputScheduler::Stats stats;
+    CommandPlayer::Play(m_serialManager->GetScheduler(), quintptr(this), m_interpreter, m_terminate, stats);
 
-    // look for loop start
-    qsizetype const loopStartIndex = str.indexOf('(');
-    if (loopStartIndex == 0)
+    QString const timing = CommandPlayer::FormatStats(stats);
+    if (!timing.isEmpty())
     {
-        m_commandIndex++;
-        m_commandLoopCounts.push_back(-1);
-        SendCurrentCommand();
-        return;
+        PrintLog(timing);
     }
+}
+
+void RunCommand::RunTimeline()
+{
+    SerialHolder* serialHolder = m_serialManager->GetHolder();
+    int const capacity = serialHolder->GetTimelineCapacity();
+    qint32 const reportInterval = serialHolder->GetReportInterval();
 
-    // look for loop end
-    qsizetype const loopEndIndex = str.indexOf(')');
-    if (loopEndIndex >= 0)
+    // firmware still says done if the previous timeline finished, start from a clean one
+    serialHolder->ClearTimeline();
     {
-        if (loopEndIndex == 0)
-        {
-            // first index is ')' expecting loop count next
-            m_commandIndex++;
-            SendCurrentCommand(true);
-            return;
-        }
-        else
-        {
-            // remove all char after ')' so number remains
-            str = str.mid(0, loopEndIndex);
-            endIndex = m_commandIndex + loopEndIndex - 1;
-        }
+        QMutexLocker locker(&m_timelineMutex);
+        m_timelineStarted = 0;
+        m_timelineUnderruns = 0;
+        m_timelineFlags = 0;
     }
 
-    quint32 buttonFlag = 0;
-    QPointF lStick(0,0);
-    QPointF rStick(0,0);
+    // entries sent but not started yet, started count is 16-bit on firmware
+    quint16 sent = 0;
+    quint16 displayed = 0;
+    bool end = false;
+    bool endSent = false;
+    QQueue<Step> steps;
+
+    // frames of the entries sent, and of those firmware has moved past, the difference is the most it can still play
+    QQueue<quint16> entryFrames;
+    quint16 finished = 0;
+    quint16 progressStarted = 0;
+    qint64 sentFrames = 0;
+    qint64 finishedFrames = 0;
+    qint64 progressTime = InputScheduler::Now();
+
+    // current step, split into several entries if it's longer than 65535 reports
+    Step current;
+    SerialProtocol::TimelineEntry currentEntry;
+    qint64 currentFrames = 0;
 
-    QStringList const buttons = str.split('|');
-    for (int b = 0; b < buttons.size() - 1; b++)
+    QVector<SerialProtocol::TimelineEntry> entries;
+    while (!m_terminate)
     {
-        QString const& button = buttons[b].toLower();
-        if (button.startsWith("lx") || button.startsWith("ly") || button.startsWith("rx") || button.startsWith("ry"))
+        quint16 started = 0;
+        quint8 flags = 0;
         {
-            qreal const stickPos = button.mid(2).toDouble();
-            if (button.startsWith("lx"))
-            {
-                lStick.setX(stickPos);
-            }
-            else if (button.startsWith("ly"))
-            {
-                lStick.setY(stickPos);
-            }
-            else if (button.startsWith("rx"))
-            {
-                rStick.setX(stickPos);
-            }
-            else if (button.startsWith("ry"))
+            QMutexLocker locker(&m_timelineMutex);
+            started = m_timelineStarted;
+            flags = m_timelineFlags;
+        }
+
+        // show what firmware is playing now
+        if (displayed != started && !steps.isEmpty())
+        {
+            Step step;
+            while (displayed != started && !steps.isEmpty())
             {
-                rStick.setY(stickPos);
+                step = steps.dequeue();
+                displayed++;
             }
+            emit notifyDisplayButton(step.m_buttonFlag, step.m_lStick, step.m_rStick);
         }
-        else
+
+        if (flags & SerialProtocol::TimelineDone)
         {
-            buttonFlag |= StringToButtonFlag(button);
+            break;
         }
-    }
 
-    int duration = buttons.back().toInt();
-    if (isLoopCount)
-    {
-        // found a loop count
-        int& loopLeft = m_commandLoopCounts.back();
-        if (loopLeft == -1)
+        // the entry started last is still playing, the ones before it are over
+        if (progressStarted != started)
         {
-            loopLeft = duration;
+            while (quint16(started - finished) > 1 && !entryFrames.isEmpty())
+            {
+                finishedFrames += entryFrames.dequeue();
+                finished++;
+            }
+            progressStarted = started;
+            progressTime = InputScheduler::Now();
         }
 
-        if (loopLeft == 1)
+        // everything sent should have played by now, firmware or its status is gone
+        qint64 const deadline = progressTime + (sentFrames - finishedFrames) * reportInterval * 1000 + qint64(RUN_COMMAND_TIMELINE_GRACE_MS) * 1000000;
+        if (sentFrames > 0 && InputScheduler::Now() > deadline)
         {
-            m_commandLoopCounts.pop_back();
+            m_result = -1;
+            m_error = "Timeline did not finish in time";
+            break;
         }
-        else
+
+        if (!serialHolder->IsConnected())
         {
-            m_commandIndex--;
-            if (loopLeft > 1)
-            {
-                // if loopCount is 0 it loops forever
-                loopLeft--;
-            }
+            m_result = -1;
+            m_error = "Serial disconnected";
+            break;
+        }
 
-            // roll back to '('
-            int loopEndCount = 0;
-            while (m_commandIndex > 0)
+        // top up the firmware buffer, never more than it has room for
+        entries.clear();
+        while (!end && int(quint16(sent - started)) + entries.size() < capacity)
+        {
+            if (currentFrames == 0)
             {
-                m_commandIndex--;
-                if (m_command[m_commandIndex] == ')')
-                {
-                    loopEndCount++;
-                }
-                else if (m_command[m_commandIndex] == '(')
+                if (!NextCommand(current))
                 {
-                    if (loopEndCount == 0)
-                    {
-                        m_commandIndex++;
-                        SendCurrentCommand();
-                        return;
-                    }
-                    else
-                    {
-                        loopEndCount--;
-                    }
+                    end = true;
+                    break;
                 }
+
+                currentEntry.m_buttonFlag = current.m_buttonFlag;
+                currentEntry.m_lx = SerialProtocol::StickToByte(current.m_lStick.x());
+                currentEntry.m_ly = SerialProtocol::StickToByte(-current.m_lStick.y());
+                currentEntry.m_rx = SerialProtocol::StickToByte(current.m_rStick.x());
+                currentEntry.m_ry = SerialProtocol::StickToByte(-current.m_rStick.y());
+                currentFrames = qMax<qint64>(1, qRound64(qreal(current.m_duration) * 1000.0 / reportInterval));
             }
+
+            currentEntry.m_frames = quint16(qMin<qint64>(currentFrames, 0xFFFF));
+            currentFrames -= currentEntry.m_frames;
+            entries.push_back(currentEntry);
+            steps.enqueue(current);
+            entryFrames.enqueue(currentEntry.m_frames);
+            sentFrames += currentEntry.m_frames;
+        }
+
+        if (!entries.isEmpty() || (end && !endSent))
+        {
+            TRACE_SCOPE("command", "RunCommand send timeline");
+            sent += quint16(entries.size());
+            endSent = end;
+            emit notifyTimeline(entries, end);
+        }
+
+        // wait for firmware to start more entries
+        QMutexLocker locker(&m_timelineMutex);
+        if (!m_terminate && m_timelineStarted == started && m_timelineFlags == flags)
+        {
+            m_timelineCondition.wait(&m_timelineMutex, 100);
         }
     }
-    else
+
+    quint16 underruns = 0;
+    quint8 flags = 0;
     {
-        //PrintLog("Button: \"" + str + "\"");
-        emit notifyButton(buttonFlag, lStick, rStick);
-        QTimer::singleShot(duration, this, [this]{ quit(); } );
+        QMutexLocker locker(&m_timelineMutex);
+        underruns = m_timelineUnderruns;
+        flags = m_timelineFlags;
     }
 
-    if (endIndex == -1)
+    // stopped early or gave up, firmware would keep playing what it has and refuse every other state
+    if (!(flags & SerialProtocol::TimelineDone))
     {
-        m_commandIndex = -1;
+        serialHolder->ClearTimeline();
     }
-    else
+
+    if (underruns > 0)
+    {
+        PrintLog("Timeline ran dry " + QString::number(underruns) + " time(s), inputs were held longer than requested", LOG_Warning);
+    }
+}
+
+bool RunCommand::NextCommand(Step& step)
+{
+    TRACE_SCOPE("command", "RunCommand::NextCommand");
+    CommandCompiler::Instruction const* instruction = m_interpreter.Next();
+    if (!instruction)
     {
-        m_commandIndex = endIndex + 1;
+        return false;
     }
+
+    step.m_buttonFlag = instruction->m_buttonFlag;
+    step.m_lStick = QPointF(instruction->m_lx, instruction->m_ly);
+    step.m_rStick = QPointF(instruction->m_rx, instruction->m_ry);
+    step.m_duration = instruction->m_value;
+    return true;
 }
 
 }
@@ -2,9 +2,14 @@
 #define RUNCOMMAND_H
 
 #include <QElapsedTimer>
+#include <QMutex>
 #include <QPointF>
+#include <QQueue>
+#include <QWaitCondition>
 
 #include "../modulebase.h"
+#include "Helpers/commandcompiler.h"
+#include "Helpers/serialprotocol.h"
 #include "Managers/managercollection.h"
 
 namespace Module::Common
@@ -18,22 +23,48 @@ public:
     // from ModuleBase
     QString GetName() const override { return "Common-RunCommand"; }
 
+    // from ModuleBase
+    void stop() override;
+
     // from QThread
     void run() override;
 
 signals:
     void notifyButton(quint32 buttonFlag, QPointF lStick = QPointF(), QPointF rStick = QPointF());
+    void notifyDisplayButton(quint32 buttonFlag, QPointF lStick = QPointF(), QPointF rStick = QPointF());
+    void notifyTimeline(QVector<SerialProtocol::TimelineEntry> const& entries, bool end);
+
+private slots:
+    void OnTimelineStatus(quint16 started, quint16 underruns, quint8 flags);
+
+private: // types
+    struct Step
+    {
+        quint32 m_buttonFlag = 0;
+        QPointF m_lStick;
+        QPointF m_rStick;
+        int     m_duration = 0;
+    };
 
 private:
-    void SendCurrentCommand(bool isLoopCount = false);
+    void RunTimer();
+    void RunTimeline();
+    bool NextCommand(Step& step);
 
 private:
     SerialManager*  m_serialManager = Q_NULLPTR;
 
     QString         m_name;
     QString         m_command;
-    int             m_commandIndex = 0;
-    QVector<int>    m_commandLoopCounts;
+    CommandCompiler::Program        m_program;
+    CommandCompiler::Interpreter    m_interpreter;
+
+    // timeline status, written by serial thread
+    QMutex          m_timelineMutex;
+    QWaitCondition  m_timelineCondition;
+    quint16         m_timelineStarted = 0;
+    quint16         m_timelineUnderruns = 0;
+    quint8          m_timelineFlags = 0;
 };
 } // namespace Module
 
@@ -0,0 +1,56 @@
+#include "sounddetect.h"
+
+#include <QDeadlineTimer>
+
+#include "Managers/audiomanager.h"
+
+// how often to check for termination while waiting
+#define SOUND_DETECT_POLL_MS 50
+
+namespace Module::Common
+{
+
+SoundDetect::SoundDetect
+(
+    bool active,
+    int timeoutMs,
+    QObject *parent
+)
+    : ModuleBase(parent)
+    , m_active(active)
+    , m_timeoutMs(timeoutMs)
+{
+    AudioManager* audioManager = ManagerCollection::GetManager<AudioManager>();
+    m_envelope = audioManager->GetEnvelope();
+}
+
+void SoundDetect::run()
+{
+    // already in the requested state, the crossing that got us here counts
+    quint64 sinceCount = 0;
+    bool active = false;
+    if (m_envelope->GetState(sinceCount, active, m_crossing) && active == m_active)
+    {
+        m_result = 0;
+        return;
+    }
+
+    QDeadlineTimer const deadline = m_timeoutMs > 0 ? QDeadlineTimer(m_timeoutMs) : QDeadlineTimer(QDeadlineTimer::Forever);
+    while (!m_terminate)
+    {
+        unsigned long const waitMs = deadline.isForever() ? SOUND_DETECT_POLL_MS : (unsigned long)qBound<qint64>(0, deadline.remainingTime(), SOUND_DETECT_POLL_MS);
+        if (m_envelope->WaitForCrossing(m_active, sinceCount, waitMs, m_crossing))
+        {
+            m_result = 0;
+            return;
+        }
+
+        if (deadline.hasExpired())
+        {
+            m_result = 1;
+            return;
+        }
+    }
+}
+
+}
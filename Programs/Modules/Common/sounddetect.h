@@ -0,0 +1,34 @@
+#ifndef SOUNDDETECT_H
+#define SOUNDDETECT_H
+
+#include "../modulebase.h"
+#include "Helpers/audioenvelope.h"
+#include "Managers/managercollection.h"
+
+namespace Module::Common
+{
+class SoundDetect : public ModuleBase
+{
+    Q_OBJECT
+public:
+    // finish when sound starts (active = true) or goes silent (active = false), timeoutMs = 0 waits forever
+    explicit SoundDetect(bool active, int timeoutMs = 0, QObject *parent = nullptr);
+
+    // from ModuleBase
+    QString GetName() const override { return "Common-SoundDetect"; }
+
+    // from QThread
+    void run() override;
+
+    // should only be accessed when module is finished, result = 0 detected, 1 timed out
+    AudioEnvelope::Crossing GetCrossing() const { return m_crossing; }
+
+private:
+    AudioEnvelope*          m_envelope = Q_NULLPTR;
+    bool                    m_active = true;
+    int                     m_timeoutMs = 0;
+    AudioEnvelope::Crossing m_crossing;
+};
+} // namespace Module
+
+#endif // SOUNDDETECT_H
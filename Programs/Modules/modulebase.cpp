@@ -1,5 +1,6 @@
 #include "modulebase.h"
 
+#include "Helpers/sessioncontext.h"
 #include "Managers/managercollection.h"
 #include "Managers/logmanager.h"
 
@@ -8,11 +9,14 @@ namespace Module
 
 ModuleBase::ModuleBase(QObject *parent) : QThread(parent)
 {
+    // runs for the session that created it
+    SessionContext::AttachThread(this);
+
     connect(this, &ModuleBase::started, this, &ModuleBase::OnStarted, Qt::DirectConnection);
     connect(this, &ModuleBase::finished, this, &ModuleBase::OnFinished, Qt::DirectConnection);
 
     LogManager* logManager = ManagerCollection::GetManager<LogManager>();
-    connect(this, &ModuleBase::notifyLog, logManager, &LogManager::PrintLog);
+    connect(this, &ModuleBase::notifyLog, logManager, &LogManager::PrintLog, Qt::DirectConnection);
 }
 
 void ModuleBase::OnStarted() const
@@ -10,6 +10,9 @@ namespace Program
 {
 ProgramBase::ProgramBase(QObject *parent) : QObject(parent)
 {
+    // slots called from the GUI thread switch to this session, see SessionApplication
+    SessionContext::SetObjectSession(this, SessionContext::Current());
+
     m_serialManager = ManagerCollection::GetManager<SerialManager>();
     m_audioManager = ManagerCollection::GetManager<AudioManager>();
     m_vlcManager = ManagerCollection::GetManager<VlcManager>();
@@ -19,7 +22,7 @@ ProgramBase::ProgramBase(QObject *parent) : QObject(parent)
     connect(m_vlcManager, &VlcManager::notifyHasVideo, this, &ProgramBase::OnCanRunChanged);
 
     LogManager* logManager = ManagerCollection::GetManager<LogManager>();
-    connect(this, &ProgramBase::notifyLog, logManager, &LogManager::PrintLog);
+    connect(this, &ProgramBase::notifyLog, logManager, &LogManager::PrintLog, Qt::DirectConnection);
 }
 
 ProgramBase::~ProgramBase()
@@ -88,7 +91,8 @@ bool ProgramBase::ValidVideo() const
 
 bool ProgramBase::ValidAudio() const
 {
-    return !RequireAudio() || m_audioManager->GetDeviceName() != "None";
+    // a replay brings its own audio
+    return !RequireAudio() || m_audioManager->GetDeviceName() != "None" || m_vlcManager->IsReplaying();
 }
 
 void ProgramBase::OnCanRunChanged()
@@ -1,11 +1,69 @@
 #include "mainwindow.h"
 
-#include <QApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+
+#include "Helpers/metricsexporter.h"
+#include "Helpers/sessionapplication.h"
+#include "Helpers/sessioncontext.h"
+#include "Managers/logmanager.h"
+#include "Managers/programmanager.h"
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
-    return a.exec();
+    SessionApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Auto Controller 2");
+    parser.addHelpOption();
+    QCommandLineOption const replayOption("replay", "Replay a session recording on the first console, exit with 0 if the program sent the same inputs, 2 if not.", "file");
+    QCommandLineOption const toleranceOption("tolerance", "Allowed input timing error in milliseconds.", "ms", "50");
+    QCommandLineOption const reportOption("report", "Write the replay result to this JSON file.", "file");
+    parser.addOptions({replayOption, toleranceOption, reportOption});
+    parser.process(a);
+
+    // one main window per console, each with its own managers
+    int const sessionCount = a.ConfigureSessions();
+
+    QList<MainWindow*> windows;
+    for (int i = 0; i < sessionCount; i++)
+    {
+        SessionContext::Scope scope(i);
+        MainWindow* w = new MainWindow();
+        w->show();
+        windows.push_back(w);
+    }
+
+    // shared by all sessions, each metric is labelled with its session, problems go to the first console's log
+    MetricsExporter metricsExporter;
+    QObject::connect(&metricsExporter, &MetricsExporter::notifyLog, ManagerCollection::GetManager<LogManager>(0), &LogManager::PrintLog, Qt::DirectConnection);
+    metricsExporter.LoadSettings();
+
+    if (parser.isSet(replayOption))
+    {
+        QString const file = parser.value(replayOption);
+        qreal const tolerance = parser.value(toleranceOption).toDouble();
+        QString const report = parser.value(reportOption);
+
+        ProgramManager* programManager = ManagerCollection::GetManager<ProgramManager>(0);
+        QObject::connect(programManager, &ProgramManager::notifyReplayFinished, &a, [](bool passed)
+        {
+            QCoreApplication::exit(passed ? 0 : 2);
+        });
+
+        // after the windows have finished loading their settings
+        QTimer::singleShot(0, programManager, [=]
+        {
+            QString errorMsg;
+            if (!programManager->StartReplay(file, tolerance, report, errorMsg))
+            {
+                qCritical().noquote() << "Replay failed to start:" << errorMsg;
+                QCoreApplication::exit(1);
+            }
+        });
+    }
+
+    int const result = a.exec();
+    qDeleteAll(windows);
+    return result;
 }
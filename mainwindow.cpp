@@ -15,7 +15,10 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
-    this->setWindowTitle("Auto Controller 2 v" + VERSION);
+    this->setWindowTitle(SessionContext::GetTitle("Auto Controller 2 v" + VERSION));
+
+    // everything created below belongs to this session, see SessionApplication
+    SessionContext::SetObjectSession(this, SessionContext::Current());
 
     m_logManager = ManagerCollection::AddManager<LogManager>();
     m_joystickManager = ManagerCollection::AddManager<JoystickManager>(this);
@@ -84,6 +87,9 @@ void MainWindow::closeEvent(QCloseEvent *event)
     m_keyboardManager = Q_NULLPTR;
     m_logManager = Q_NULLPTR;
 
+    // everything above only updated the settings in memory
+    JsonHelper::FlushSettings();
+
     QMainWindow::closeEvent(event);
 }
 